@@ -25,10 +25,14 @@
 #define DICOM2MESH_H
 
 #include "volumeVisualizer.h"
+#include "dicomRoutines.h"
+#include "meshRoutines.h"
 
 #include <string>
 #include <vector>
 #include <optional>
+#include <array>
+#include <memory>
 #include <vtkPolyData.h>
 #include <vtkImageData.h>
 #include <vtkSmartPointer.h>
@@ -47,11 +51,29 @@ public:
         bool useBinaryExport = false;
         std::optional<double> reductionRate;
         std::optional<unsigned long> polygonLimit;
+        bool useParallelReduction = false;
+        std::vector<unsigned long> levelsOfDetail; // polygon limits of the levels, one file each
+        std::optional<unsigned long> progressiveMeshBase; // polygon limit of the base of a progressive mesh file
         std::optional<double> objectSizeRatio;
         bool enableOriginToCenterOfMass = false;
         bool enableSmoothing = false;
         int isoValue = 400; // Hard Tissue
         std::optional<int>  upperIsoValue;
+        std::vector<VTKDicomRoutines::IsoRange> isoRanges; // several meshes in one pass, replaces isoValue and upperIsoValue
+        std::optional<unsigned int> nbrOfThreads;
+        std::optional<std::string> cacheDirectory;
+        std::optional<unsigned int> slabSize;
+        std::optional<std::string> seriesSelector;
+        std::optional<std::array<int,6>> volumeOfInterest;
+        std::optional<std::array<double,6>> regionOfInterest; // box in patient coordinates (mm)
+        std::optional<unsigned int> previewStride;
+        std::optional<unsigned int> nbrOfIoThreads;
+        unsigned int prefetchQueueDepth = 0;
+        bool useParallelMarchingCubes = false;
+        std::optional<double> dualContouringTolerance;
+        std::optional<double> gaussianSigma; // volume smoothing before meshing, in mm
+        bool extractLabels = false; // label volume, one mesh per label
+        bool showReport = false;    // histogram and mesh size estimate instead of meshing
 
         bool doVisualize = false;
         bool showAsVolume = false;
@@ -68,8 +90,19 @@ public:
     static void showVersionText();
 
 private:
-    std::tuple<bool, vtkSmartPointer<vtkPolyData>, vtkSmartPointer<vtkImageData>> loadInputData();
+    std::tuple<bool, std::vector<vtkSmartPointer<vtkPolyData>>, vtkSmartPointer<vtkImageData>> loadInputData();
+    void postProcessMesh(vtkSmartPointer<vtkPolyData> mesh, vtkSmartPointer<vtkPolyData> unreducedMesh);
+    void exportMesh(vtkSmartPointer<vtkPolyData> mesh, const std::string& outputFilePath);
+    void exportLevelsOfDetail(vtkSmartPointer<vtkPolyData> mesh, const std::string& outputFilePath);
+    void exportProgressiveMesh(vtkSmartPointer<vtkPolyData> mesh, const std::string& outputFilePath);
+    std::unique_ptr<VTKMeshRoutines> createMeshRoutines() const;
+    std::vector<VTKDicomRoutines::IsoRange> getIsoRanges() const;
+    void showVolumeReport(VTKDicomRoutines& vdr, vtkSmartPointer<vtkImageData> volume);
     std::string getParametersAsString(const Dicom2MeshParameters& params) const;
+    void showResult(const std::vector<vtkSmartPointer<vtkPolyData>>& meshes, vtkSmartPointer<vtkImageData> volume);
+    static std::string getIsoRangeLabel(const VTKDicomRoutines::IsoRange& isoRange);
+    static std::string getOutputFilePath(const std::string& outputFilePath, const VTKDicomRoutines::IsoRange& isoRange);
+    static std::string addFileNameSuffix(const std::string& outputFilePath, const std::string& suffix);
     static bool parseVolumeRenderingColorEntry( const std::string& text, VolumeRenderingColoringEntry& colorEntry );
     static std::vector<std::string> parseCommaSeparatedStr(const std::string& text);
     static std::string trim(const std::string& str);
@@ -77,6 +110,8 @@ private:
 private:
     Dicom2MeshParameters m_params;
     vtkSmartPointer<vtkCallbackCommand> m_vtkCallback;
+    bool m_smallObjectsRemoved;
+    std::vector<int> m_meshLabels; // label of each mesh, if a label volume was meshed
 };
 
 #endif // DICOM2MESH_H
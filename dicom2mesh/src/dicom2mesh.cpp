@@ -22,11 +22,14 @@
 *****************************************************************************/
 
 #include <vtkAlgorithm.h>
+#include <vtkAppendPolyData.h>
 #include <iostream>
 #include <memory>
 #include <fstream>
 #include <chrono>
 #include <regex>
+#include <limits>
+#include <iomanip>
 
 #include "dicom2mesh.h"
 #include "meshRoutines.h"
@@ -59,6 +62,9 @@ Dicom2Mesh::Dicom2Mesh(const Dicom2MeshParameters& params)
 
     m_vtkCallback = vtkSmartPointer<vtkCallbackCommand>::New();
     m_vtkCallback->SetCallback(myVtkProgressCallback);
+
+    m_smallObjectsRemoved = false;
+    m_meshLabels.clear();
 }
 
 Dicom2Mesh::~Dicom2Mesh()
@@ -74,22 +80,75 @@ int Dicom2Mesh::doMesh()
     //******************************//
 
     //******** Read DICOM or Mesh *********//
-    auto[loadDataOk, mesh, volume] = loadInputData();
+    auto[loadDataOk, meshes, volume] = loadInputData();
     if( !loadDataOk )
         return -1;
     //******************************//
 
-    if( mesh->GetNumberOfCells() == 0 )
+    // the report only helps to choose iso values and reduction parameters
+    if( m_params.showReport && volume.Get() != NULL )
+        return 0;
+
+    for( const vtkSmartPointer<vtkPolyData>& mesh : meshes )
     {
-        cerr << "No mesh could be created. Wrong DICOM or wrong iso value" << endl;
-        return -1;
+        if( mesh->GetNumberOfCells() == 0 )
+        {
+            cerr << "No mesh could be created. Wrong DICOM or wrong iso value" << endl;
+            return -1;
+        }
     }
 
-    //***** Mesh post-processing *****//
-    std::unique_ptr<VTKMeshData> vmd = std::unique_ptr<VTKMeshData>( new VTKMeshData() );
-    vmd->SetProgressCallback( m_vtkCallback );
-    std::unique_ptr<VTKMeshRoutines> vmr = std::unique_ptr<VTKMeshRoutines>( new VTKMeshRoutines() );
-    vmr->SetProgressCallback( m_vtkCallback );
+    if( m_params.previewStride )
+    {
+        // the preview only helps to choose the parameters of the full resolution run
+        std::cout << "Preview: mesh post-processing and export skipped" << std::endl;
+        showResult(meshes, volume);
+        return 0;
+    }
+
+    // several iso ranges or labels give one mesh each, written to its own file
+    const std::vector<VTKDicomRoutines::IsoRange> isoRanges = getIsoRanges();
+    for( size_t m = 0; m < meshes.size(); m++ )
+    {
+        if( !m_meshLabels.empty() )
+            std::cout << "Mesh of label " << m_meshLabels[m] << std::endl << std::endl;
+        else if( meshes.size() > 1 )
+            std::cout << "Mesh of iso value " << getIsoRangeLabel(isoRanges[m]) << std::endl << std::endl;
+
+        // the progressive mesh refines up to the mesh before reduction
+        vtkSmartPointer<vtkPolyData> unreducedMesh;
+        if( m_params.outputFilePath && m_params.progressiveMeshBase && ( m_params.reductionRate || m_params.polygonLimit ) )
+            unreducedMesh = vtkSmartPointer<vtkPolyData>::New();
+
+        postProcessMesh( meshes[m], unreducedMesh );
+
+        if( m_params.outputFilePath )
+        {
+            std::string outputFilePath = m_params.outputFilePath.value();
+            if( !m_meshLabels.empty() )
+                outputFilePath = addFileNameSuffix( outputFilePath, "_label_" + std::to_string(m_meshLabels[m]) );
+            else if( meshes.size() > 1 )
+                outputFilePath = getOutputFilePath( outputFilePath, isoRanges[m] );
+            if( !m_params.levelsOfDetail.empty() )
+                exportLevelsOfDetail( meshes[m], outputFilePath );
+            else
+                exportMesh( meshes[m], outputFilePath );
+            if( m_params.progressiveMeshBase )
+                exportProgressiveMesh( unreducedMesh.Get() != NULL ? unreducedMesh : meshes[m], outputFilePath );
+        }
+    }
+
+    std::chrono::steady_clock::time_point t_done = std::chrono::steady_clock::now();
+    std::cout << std::endl << "Required computing time: " << std::chrono::duration_cast<std::chrono::seconds>(t_done - t_begin).count() << " seconds" << std::endl;
+
+    showResult(meshes, volume);
+
+    return 0;
+}
+
+void Dicom2Mesh::postProcessMesh(vtkSmartPointer<vtkPolyData> mesh, vtkSmartPointer<vtkPolyData> unreducedMesh)
+{
+    std::unique_ptr<VTKMeshRoutines> vmr = createMeshRoutines();
 
     if( m_params.enableOriginToCenterOfMass )
     {
@@ -97,6 +156,23 @@ int Dicom2Mesh::doMesh()
         cout << "Move mesh to the coordinate systems's center: Translation [" << trans.GetX() << "," << trans.GetY() << "," << trans.GetZ() << "]" << endl << endl;
     }
 
+    if( m_params.objectSizeRatio && !m_smallObjectsRemoved )
+    {
+        if( m_params.objectSizeRatio.value() < 0.0 || m_params.objectSizeRatio.value() > 1.0 )
+            std::cout << "Filtering skipped due to invalid filter rate " << m_params.objectSizeRatio.value() << " where a value of 0.0 - 1.0 is expected." << endl;
+        else
+            vmr->removeSmallObjects( mesh, m_params.objectSizeRatio.value() );
+    }
+
+    if( m_params.enableSmoothing )
+    {
+        vmr->smoothMesh( mesh, 20 );
+    }
+
+    // the reduction comes last, so that the unreduced copy is in the frame of the exported mesh
+    if( unreducedMesh.Get() != NULL )
+        unreducedMesh->DeepCopy( mesh );
+
     if( m_params.reductionRate )
     {
         // check reduction rate
@@ -118,57 +194,163 @@ int Dicom2Mesh::doMesh()
             std::cout << "Reducing polygons not necessary." << endl << endl;
         }
     }
+}
+
+void Dicom2Mesh::exportMesh(vtkSmartPointer<vtkPolyData> mesh, const std::string& outputFilePath)
+{
+    std::unique_ptr<VTKMeshData> vmd = std::unique_ptr<VTKMeshData>( new VTKMeshData() );
+    vmd->SetProgressCallback( m_vtkCallback );
 
-    if( m_params.objectSizeRatio )
+    // check if obj, stl or ply was set
+    std::string::size_type idx = outputFilePath.rfind('.');
+    if( idx != std::string::npos )
     {
-        if( m_params.objectSizeRatio.value() < 0.0 || m_params.objectSizeRatio.value() > 1.0 )
-            std::cout << "Filtering skipped due to invalid filter rate " << m_params.objectSizeRatio.value() << " where a value of 0.0 - 1.0 is expected." << endl;
+        std::string extension = outputFilePath.substr(idx+1);
+
+        if( extension == "obj" )
+            vmd->exportAsObjFile( mesh, outputFilePath );
+        else if( extension == "stl" )
+            vmd->exportAsStlFile( mesh, outputFilePath, m_params.useBinaryExport );
+        else if( extension == "ply" )
+            vmd->exportAsPlyFile( mesh, outputFilePath );
         else
-            vmr->removeSmallObjects( mesh, m_params.objectSizeRatio.value() );
+            cerr << "Unknown file type" << endl;
+
+
+        // safe mesh parameters in info file
+        std::string infoFilePath = outputFilePath.substr(0,idx+1).append("info");
+        std::ofstream infoFile;
+        infoFile.open(infoFilePath);
+        infoFile << getParametersAsString(m_params);
+        infoFile.close();
+        std::cout << "Parameters written to file:  " << infoFilePath << std::endl;
+    }
+    else
+    {
+        cerr << "No Filename." << endl;
     }
+}
 
-    if( m_params.enableSmoothing )
+void Dicom2Mesh::exportLevelsOfDetail(vtkSmartPointer<vtkPolyData> mesh, const std::string& outputFilePath)
+{
+    std::unique_ptr<VTKMeshRoutines> vmr = createMeshRoutines();
+
+    // each level is written to its own file, named after its polygon limit
+    std::vector<vtkSmartPointer<vtkPolyData>> levels = vmr->meshLevelsOfDetail( mesh, m_params.levelsOfDetail );
+    for( size_t l = 0; l < levels.size(); l++ )
+        exportMesh( levels[l], addFileNameSuffix( outputFilePath, "_lod_" + std::to_string(m_params.levelsOfDetail[l]) ) );
+}
+
+void Dicom2Mesh::exportProgressiveMesh(vtkSmartPointer<vtkPolyData> mesh, const std::string& outputFilePath)
+{
+    // the base mesh is reduced from a copy, so that the full mesh is kept for the view
+    vtkSmartPointer<vtkPolyData> baseMesh = vtkSmartPointer<vtkPolyData>::New();
+    baseMesh->DeepCopy( mesh );
+    double reductionRate = 0.0;
+    if( baseMesh->GetNumberOfCells() > vtkIdType(m_params.progressiveMeshBase.value()) )
+        reductionRate = 1.0 - double(m_params.progressiveMeshBase.value()) / double(baseMesh->GetNumberOfCells());
+
+    std::vector<VTKQuadricDecimation::VertexSplit> vertexSplits;
+    if( !createMeshRoutines()->meshReduction( baseMesh, reductionRate, vertexSplits ) )
+        return;
+
+    std::string::size_type idx = outputFilePath.rfind('.');
+    std::unique_ptr<VTKMeshData> vmd = std::unique_ptr<VTKMeshData>( new VTKMeshData() );
+    vmd->SetProgressCallback( m_vtkCallback );
+    vmd->exportAsProgressiveMeshFile( baseMesh, vertexSplits, outputFilePath.substr(0, idx).append(".pm") );
+}
+
+std::unique_ptr<VTKMeshRoutines> Dicom2Mesh::createMeshRoutines() const
+{
+    std::unique_ptr<VTKMeshRoutines> vmr = std::unique_ptr<VTKMeshRoutines>( new VTKMeshRoutines() );
+    vmr->SetProgressCallback( m_vtkCallback );
+    if( m_params.nbrOfThreads )
+        vmr->SetNumberOfThreads( m_params.nbrOfThreads.value() );
+    if( m_params.useParallelReduction )
+        vmr->SetDecimator( VTKMeshRoutines::Decimator::ParallelQuadricDecimation );
+    return vmr;
+}
+
+std::vector<VTKDicomRoutines::IsoRange> Dicom2Mesh::getIsoRanges() const
+{
+    if( !m_params.isoRanges.empty() )
+        return m_params.isoRanges;
+
+    VTKDicomRoutines::IsoRange isoRange;
+    isoRange.threshold = m_params.isoValue;
+    isoRange.useUpperThreshold = m_params.upperIsoValue.has_value();
+    isoRange.upperThreshold = m_params.upperIsoValue.value_or(0);
+    return { isoRange };
+}
+
+void Dicom2Mesh::showVolumeReport(VTKDicomRoutines& vdr, vtkSmartPointer<vtkImageData> volume)
+{
+    int* dims = volume->GetDimensions();
+    std::chrono::steady_clock::time_point t_begin = std::chrono::steady_clock::now();
+    const VTKVolumeHistogram::Histogram histogram = vdr.computeHistogram( volume, 32 );
+    std::chrono::steady_clock::time_point t_histogram = std::chrono::steady_clock::now();
+
+    std::cout << std::endl << "Histogram of " << dims[0] << " x " << dims[1] << " x " << dims[2] << " voxels ("
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t_histogram - t_begin).count() << " ms):" << std::endl;
+    size_t highestCount = 1;
+    for( size_t count : histogram.counts )
+        highestCount = std::max( highestCount, count );
+    for( size_t b = 0; b < histogram.counts.size(); b++ )
     {
-        vmr->smoothMesh( mesh, 20 );
+        const size_t count = histogram.counts[b];
+        std::cout << std::setw(10) << histogram.getBinStart(b) << " " << std::string( 40 * count / highestCount, '#' )
+                  << std::string( 40 - 40 * count / highestCount, ' ' ) << " " << count << std::endl;
     }
+    std::cout << std::endl;
 
-    //********************************//
+    if( m_params.extractLabels )
+        return;
 
-    // check if obj, stl or ply was set
-    if( m_params.outputFilePath )
+    const std::vector<VTKDicomRoutines::IsoRange> isoRanges = getIsoRanges();
+    const std::vector<VTKIsoSurface::SurfaceSize> sizes = vdr.estimateMeshSizes( volume, isoRanges );
+    std::chrono::steady_clock::time_point t_estimate = std::chrono::steady_clock::now();
+    std::cout << "Estimated meshes (" << std::chrono::duration_cast<std::chrono::milliseconds>(t_estimate - t_histogram).count() << " ms):" << std::endl;
+    for( size_t m = 0; m < sizes.size(); m++ )
     {
-        std::string::size_type idx = m_params.outputFilePath.value().rfind('.');
-        if( idx != std::string::npos )
-        {
-            std::string extension = m_params.outputFilePath.value().substr(idx+1);
+        std::cout << "Iso value " << getIsoRangeLabel(isoRanges[m]) << ": " << sizes[m].nbrOfCells << " cells, "
+                  << sizes[m].nbrOfTriangles << " triangles, " << sizes[m].nbrOfInsideVoxels << " voxels inside" << std::endl;
+        if( m_params.polygonLimit && sizes[m].nbrOfTriangles > m_params.polygonLimit.value() )
+            std::cout << "  the polygon limit of " << m_params.polygonLimit.value() << " triangles needs a reduction rate of "
+                      << 1.0 - double(m_params.polygonLimit.value()) / double(sizes[m].nbrOfTriangles) << std::endl;
+    }
+    std::cout << std::endl;
+}
 
-            if( extension == "obj" )
-                vmd->exportAsObjFile( mesh, m_params.outputFilePath.value() );
-            else if( extension == "stl" )
-                vmd->exportAsStlFile( mesh, m_params.outputFilePath.value(), m_params.useBinaryExport );
-            else if( extension == "ply" )
-                vmd->exportAsPlyFile( mesh, m_params.outputFilePath.value() );
-            else
-                cerr << "Unknown file type" << endl;
+std::string Dicom2Mesh::getIsoRangeLabel(const VTKDicomRoutines::IsoRange& isoRange)
+{
+    std::string label = std::to_string(isoRange.threshold);
+    if( isoRange.useUpperThreshold )
+        label.append(" to ").append(std::to_string(isoRange.upperThreshold));
+    return label;
+}
+
+std::string Dicom2Mesh::getOutputFilePath(const std::string& outputFilePath, const VTKDicomRoutines::IsoRange& isoRange)
+{
+    // mesh.stl becomes mesh_400.stl, or mesh_400_1200.stl with upper threshold
+    std::string suffix = "_" + std::to_string(isoRange.threshold);
+    if( isoRange.useUpperThreshold )
+        suffix.append("_").append(std::to_string(isoRange.upperThreshold));
 
+    return addFileNameSuffix(outputFilePath, suffix);
+}
 
-            // safe mesh parameters in info file
-            std::string infoFilePath = m_params.outputFilePath.value().substr(0,idx+1).append("info");
-            std::ofstream infoFile;
-            infoFile.open(infoFilePath);
-            infoFile << getParametersAsString(m_params);
-            infoFile.close();
-            std::cout << "Parameters written to file:  " << infoFilePath << std::endl;
-        }
-        else
-        {
-            cerr << "No Filename." << endl;
-        }
-    }
+std::string Dicom2Mesh::addFileNameSuffix(const std::string& outputFilePath, const std::string& suffix)
+{
+    std::string::size_type idx = outputFilePath.rfind('.');
+    std::string::size_type dirIdx = outputFilePath.find_last_of("/\\");
+    if( idx == std::string::npos || ( dirIdx != std::string::npos && idx < dirIdx ) )
+        return outputFilePath + suffix;
 
-    std::chrono::steady_clock::time_point t_done = std::chrono::steady_clock::now();
-    std::cout << std::endl << "Required computing time: " << std::chrono::duration_cast<std::chrono::seconds>(t_done - t_begin).count() << " seconds" << std::endl;
+    return outputFilePath.substr(0, idx) + suffix + outputFilePath.substr(idx);
+}
 
+void Dicom2Mesh::showResult(const std::vector<vtkSmartPointer<vtkPolyData>>& meshes, vtkSmartPointer<vtkImageData> volume)
+{
     if( m_params.doVisualize )
     {
         if( m_params.showAsVolume )
@@ -179,11 +361,21 @@ int Dicom2Mesh::doMesh()
         else
         {
             std::cout << "Show mesh..." << std::endl;
-            VTKMeshVisualizer::displayMesh(mesh);
+            if( meshes.size() == 1 )
+            {
+                VTKMeshVisualizer::displayMesh(meshes.front());
+            }
+            else
+            {
+                // all meshes in one view
+                vtkSmartPointer<vtkAppendPolyData> appender = vtkSmartPointer<vtkAppendPolyData>::New();
+                for( const vtkSmartPointer<vtkPolyData>& mesh : meshes )
+                    appender->AddInputData(mesh);
+                appender->Update();
+                VTKMeshVisualizer::displayMesh(appender->GetOutput());
+            }
         }
     }
-
-    return 0;
 }
 
 // from https://stackoverflow.com/questions/216823/whats-the-best-way-to-trim-stdstring
@@ -266,6 +458,32 @@ std::tuple<bool, Dicom2Mesh::Dicom2MeshParameters> Dicom2Mesh::parseCmdLineParam
                 return {false, param};
             }
         }
+        else if( cArg.compare("-tl") == 0 )
+        {
+            // next argument is a comma separated list of iso values, each optionally with an upper iso value
+            a++;
+            if( a < argc )
+            {
+                param.isoRanges.clear();
+                for( const std::string& entry : parseCommaSeparatedStr(std::string(argv[a])) )
+                {
+                    VTKDicomRoutines::IsoRange isoRange;
+                    std::string::size_type colon = entry.find(':', 1);
+                    isoRange.threshold = std::stoi(entry.substr(0, colon));
+                    if( colon != std::string::npos )
+                    {
+                        isoRange.useUpperThreshold = true;
+                        isoRange.upperThreshold = std::stoi(entry.substr(colon + 1));
+                    }
+                    param.isoRanges.push_back(isoRange);
+                }
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
         else if( cArg.compare("-h") == 0 )
         {
             showUsageText();
@@ -379,6 +597,211 @@ std::tuple<bool, Dicom2Mesh::Dicom2MeshParameters> Dicom2Mesh::parseCmdLineParam
             showVersionText();
             return {false, param};
         }
+        else if( cArg.compare("-j") == 0 )
+        {
+            // next argument is number of threads
+            a++;
+            if( a < argc )
+            {
+                param.nbrOfThreads = std::stoul( std::string(argv[a]) );
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-cache") == 0 )
+        {
+            // next argument is the volume cache directory
+            a++;
+            if( a < argc )
+            {
+                param.cacheDirectory = argv[a];
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-slab") == 0 )
+        {
+            // next argument is the number of slices per slab
+            a++;
+            if( a < argc )
+            {
+                param.slabSize = std::stoul( std::string(argv[a]) );
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-series") == 0 )
+        {
+            // next argument selects the dicom series
+            a++;
+            if( a < argc )
+            {
+                param.seriesSelector = argv[a];
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-voi") == 0 )
+        {
+            // next six arguments are the voxel ranges x0 x1 y0 y1 z0 z1
+            if( (a+6) < argc )
+            {
+                std::array<int,6> voi;
+                for( int& v : voi )
+                    v = std::stoi(std::string(argv[++a]));
+                param.volumeOfInterest = voi;
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-roi") == 0 )
+        {
+            // next six arguments are the box xMin xMax yMin yMax zMin zMax in mm
+            if( (a+6) < argc )
+            {
+                std::array<double,6> roi;
+                for( double& v : roi )
+                    v = std::stod(std::string(argv[++a]));
+                param.regionOfInterest = roi;
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-slices") == 0 )
+        {
+            // next two arguments are the first and the last slice
+            if( (a+2) < argc )
+            {
+                int firstSlice = std::stoi(std::string(argv[++a]));
+                int lastSlice = std::stoi(std::string(argv[++a]));
+                param.volumeOfInterest = std::array<int,6>{ 0, std::numeric_limits<int>::max(), 0, std::numeric_limits<int>::max(), firstSlice, lastSlice };
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-prefetch") == 0 )
+        {
+            // next two arguments are the number of I/O threads and the queue depth
+            if( (a+2) < argc )
+            {
+                param.nbrOfIoThreads = std::stoul(std::string(argv[++a]));
+                param.prefetchQueueDepth = std::stoul(std::string(argv[++a]));
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-pmc") == 0 )
+        {
+            param.useParallelMarchingCubes = true;
+        }
+        else if( cArg.compare("-pr") == 0 )
+        {
+            param.useParallelReduction = true;
+        }
+        else if( cArg.compare("-pm") == 0 )
+        {
+            // next argument is the polygon limit of the base mesh
+            a++;
+            if( a < argc )
+            {
+                param.progressiveMeshBase = std::stoul( std::string(argv[a]) );
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-lod") == 0 )
+        {
+            // next argument is a comma separated list of polygon limits
+            a++;
+            if( a < argc )
+            {
+                param.levelsOfDetail.clear();
+                for( const std::string& entry : parseCommaSeparatedStr(std::string(argv[a])) )
+                    param.levelsOfDetail.push_back( std::stoul(entry) );
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-report") == 0 )
+        {
+            param.showReport = true;
+        }
+        else if( cArg.compare("-labels") == 0 )
+        {
+            param.extractLabels = true;
+        }
+        else if( cArg.compare("-dc") == 0 )
+        {
+            // next argument is the merge tolerance in world units
+            a++;
+            if( a < argc )
+            {
+                param.dualContouringTolerance = std::stod( std::string(argv[a]) );
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-vs") == 0 )
+        {
+            // next argument is the standard deviation of the Gaussian in mm
+            a++;
+            if( a < argc )
+            {
+                param.gaussianSigma = std::stod( std::string(argv[a]) );
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
+        else if( cArg.compare("-preview") == 0 )
+        {
+            // next argument is the sampling stride
+            a++;
+            if( a < argc )
+            {
+                param.previewStride = std::stoul( std::string(argv[a]) );
+            }
+            else
+            {
+                showUsageText();
+                return {false, param};
+            }
+        }
         else if( cArg.compare("-sxyz") == 0 )
         {
             // next three arguments are spacings
@@ -431,7 +854,16 @@ void Dicom2Mesh::showUsageText()
     std::cout << "This creates a mesh with a limited number of polygons of 10000. This has the same effect as reducing -r the mesh. It does not make sense to use these two options together." << std::endl;
     std::cout << "> dicom2mesh -i pathToDicomDirectory  -p 10000" << std::endl << std::endl;
 
-    std::cout << "This creates a mesh where small connected objects are removed. In particular, only connected objects with a minimum number of vertices of 20% of the object with the most vertices are part of the result." << std::endl;
+    std::cout << "The reduction runs on one thread by default. With -pr, the mesh is split into slabs whose edges are collapsed in parallel with the threads set by -j, the edges at the slab borders afterwards." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -p 100000  -pr  -j 8" << std::endl << std::endl;
+
+    std::cout << "Several levels of detail are written in one run with -lod, a comma separated list of polygon limits. Each level is reduced from the one before, and written to its own file: here mesh_lod_1000000.stl, mesh_lod_200000.stl and mesh_lod_50000.stl." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -lod 1000000,200000,50000  -pr  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "This writes a progressive mesh file mesh.pm next to mesh.stl: a base mesh of at most 5000 polygons, followed by the vertex splits which refine it back to the full mesh. A viewer can stop reading after any number of splits. With -r or -p, the splits are recorded from the mesh before its reduction, so they refine beyond the reduced mesh.stl." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -pm 5000  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "This creates a mesh where small connected objects are removed. In particular, only connected objects with a minimum number of voxels of 20% of the biggest object are meshed. Objects of streamed slabs and imported meshes are compared by their number of vertices instead." << std::endl;
     std::cout << "> dicom2mesh -i pathToDicomDirectory  -e  0.2" << std::endl << std::endl;
 
     std::cout << "This creates a mesh which is shifted to the coordinate system origin." << std::endl;
@@ -440,6 +872,9 @@ void Dicom2Mesh::showUsageText()
     std::cout << "This creates a mesh which is smoothed." << std::endl;
     std::cout << "> dicom2mesh -i pathToDicomDirectory  -s" << std::endl << std::endl;
 
+    std::cout << "This smooths the volume with a Gaussian of the given standard deviation in mm before meshing. It removes stair steps and noise much faster than mesh smoothing, and gives fewer triangles." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -vs 0.8" << std::endl << std::endl;
+
     std::cout << "This creates a mesh and shows it in a 3d view." << std::endl;
     std::cout << "> dicom2mesh -i pathToDicomDirectory  -v" << std::endl << std::endl;
 
@@ -452,6 +887,44 @@ void Dicom2Mesh::showUsageText()
     std::cout << "A mesh can be created based on a list of png-file slices as input. The three floats followed after -sxyz are the x/y/z-spacing." << std::endl;
     std::cout << "> dicom2mesh -ipng [path1, path2, path3, ...] -sxyz 1.5 1.5 3.0  -c -o cba.stl " << std::endl << std::endl;
 
+    std::cout << "The number of threads used to load the images can be set with -j. By default, all cores are used. Here, the images are loaded with 4 threads." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -j 4  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "Several meshes can be extracted in one pass over the volume with -tl, a comma separated list of iso values. An iso value followed by a colon and an upper iso value sets a range. Each mesh is post-processed and written to its own file, named after its iso values: here mesh_400.stl and mesh_-500_-100.stl." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -tl 400,-500:-100  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "The surface is extracted on one thread by default. With -pmc, the volume is split into blocks which are meshed in parallel with the threads set by -j. The blocks are joined to the same mesh." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -pmc  -j 16  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "With -dc, the surface is extracted by dual contouring on an octree. Neighbouring cells are merged into bigger cells as long as the surface in them is flat within the given tolerance, in world units. Flat regions get few, large triangles, which often makes mesh reduction unnecessary. A tolerance of 0 gives a uniform mesh." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -dc 0.1  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "Iso values and reduction rates are easier to choose with -report. It loads the volume, shows a histogram of the voxel values and counts the triangles of the meshes and the voxels inside the iso values set, without meshing. With -p, the reduction rate reaching the polygon limit is shown." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -report  -tl 400,-500  -p 200000" << std::endl << std::endl;
+
+    std::cout << "A label volume, like a segmentation holding one integer id per organ and 0 as background, is meshed with -labels. The surfaces of all labels are extracted in one pass, adjacent labels share their boundary. Each label is written to its own file, here mesh_label_1.stl, mesh_label_2.stl and so on." << std::endl;
+    std::cout << "> dicom2mesh -ipng [label1.png, label2.png, ...] -sxyz 0.8 0.8 1.0  -labels  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "On slow or network storage, reading the files can overlap with decoding them. With -prefetch, 4 I/O threads read up to 16 files ahead of the decoding threads. The time spent reading, decoding and waiting is reported, which shows whether loading is I/O-bound or CPU-bound. A queue depth of 0 allows two files per decoding thread." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -prefetch 4 16  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "Loaded volumes can be cached in a directory. Later runs on the same, unchanged input files map the cached volume instead of decoding the images again." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -cache pathToCacheDirectory  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "Volumes larger than the memory can be meshed in slabs of slices with -slab. Only one slab is held in memory at a time. Here, slabs of 64 slices are used. Cropping and volume rendering need the whole volume and disable this option." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -slab 64  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "Only a part of the images can be loaded with -slices firstSlice lastSlice, or with -voi x0 x1 y0 y1 z0 z1 in voxels. Image files outside of the range are not read. Here, slices 100 to 299 are meshed." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -slices 100 299  -o mesh.stl" << std::endl << std::endl;
+    std::cout << "A box in patient coordinates, the coordinates of the mesh, can be given in mm with -roi xMin xMax yMin yMax zMin zMax. Only the voxels covering the box are loaded and meshed." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -roi -50 50 -80 20 100 180  -o mesh.stl" << std::endl << std::endl;
+
+    std::cout << "A quick low resolution preview helps to choose the iso value. With -preview 4, only every 4th slice, row and column is loaded and meshed. The number of triangles and the timing are reported. Mesh post-processing and export are skipped." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -preview 4  -t 500" << std::endl << std::endl;
+
+    std::cout << "If a directory holds several DICOM series, the series to load can be chosen with -series by its index, its SeriesInstanceUID or a part of its description. Otherwise the user is asked. This requires vtk-dicom." << std::endl;
+    std::cout << "> dicom2mesh -i pathToDicomDirectory  -series \"head\"  -o mesh.stl" << std::endl << std::endl;
+
     std::cout << "Arguments can be combined." << std::endl << std::endl;
 }
 
@@ -460,9 +933,10 @@ void Dicom2Mesh::showVersionText()
     std::cout << "dicom2Mesh version 0.8.0, https://github.com/eidelen/DicomToMesh" << std::endl;
 }
 
-std::tuple<bool, vtkSmartPointer<vtkPolyData>, vtkSmartPointer<vtkImageData>> Dicom2Mesh::loadInputData()
+std::tuple<bool, std::vector<vtkSmartPointer<vtkPolyData>>, vtkSmartPointer<vtkImageData>> Dicom2Mesh::loadInputData()
 {
     vtkSmartPointer<vtkPolyData> mesh3d;
+    std::vector<vtkSmartPointer<vtkPolyData>> meshes;
     vtkSmartPointer<vtkImageData> volume;
     bool result = false;
 
@@ -502,6 +976,89 @@ std::tuple<bool, vtkSmartPointer<vtkPolyData>, vtkSmartPointer<vtkImageData>> Di
 
         std::shared_ptr<VTKDicomRoutines> vdr = VTKDicomFactory::getDicomRoutines();
         vdr->SetProgressCallback( m_vtkCallback );
+        if( m_params.nbrOfThreads )
+            vdr->SetNumberOfThreads( m_params.nbrOfThreads.value() );
+        if( m_params.cacheDirectory )
+            vdr->SetCacheDirectory( m_params.cacheDirectory.value() );
+        if( m_params.seriesSelector )
+            vdr->SetSeriesSelector( m_params.seriesSelector.value() );
+        if( m_params.volumeOfInterest )
+        {
+            const std::array<int,6>& voi = m_params.volumeOfInterest.value();
+            vdr->SetVolumeOfInterest( voi[0], voi[1], voi[2], voi[3], voi[4], voi[5] );
+        }
+        if( m_params.regionOfInterest )
+        {
+            const std::array<double,6>& roi = m_params.regionOfInterest.value();
+            vdr->SetRegionOfInterest( roi[0], roi[1], roi[2], roi[3], roi[4], roi[5] );
+        }
+        if( m_params.previewStride )
+            vdr->SetPreviewStride( m_params.previewStride.value() );
+        if( m_params.nbrOfIoThreads )
+            vdr->SetPrefetch( m_params.nbrOfIoThreads.value(), m_params.prefetchQueueDepth );
+        if( m_params.useParallelMarchingCubes )
+            vdr->SetSurfaceExtractor( VTKDicomRoutines::SurfaceExtractor::ParallelMarchingCubes );
+        if( m_params.dualContouringTolerance )
+        {
+            vdr->SetSurfaceExtractor( VTKDicomRoutines::SurfaceExtractor::AdaptiveDualContouring );
+            vdr->SetDualContouringTolerance( m_params.dualContouringTolerance.value() );
+        }
+        if( m_params.gaussianSigma )
+            vdr->SetGaussianSigma( m_params.gaussianSigma.value() );
+
+        bool streamSlabs = m_params.slabSize.has_value();
+        if( streamSlabs && ( m_params.enableCrop || ( m_params.doVisualize && m_params.showAsVolume ) ) )
+        {
+            cout << "Cropping and volume rendering need the whole volume - slab streaming disabled." << endl;
+            streamSlabs = false;
+        }
+        if( streamSlabs && m_params.previewStride )
+        {
+            cout << "The preview reports loading and meshing separately - slab streaming disabled." << endl;
+            streamSlabs = false;
+        }
+        if( streamSlabs && m_params.showReport )
+        {
+            cout << "The report needs the whole volume - slab streaming disabled." << endl;
+            streamSlabs = false;
+        }
+        if( streamSlabs && m_params.gaussianSigma )
+        {
+            cout << "The Gaussian pre-filter needs the whole volume - slab streaming disabled." << endl;
+            streamSlabs = false;
+        }
+        if( streamSlabs && m_params.extractLabels )
+        {
+            cout << "Label surfaces are extracted from the whole volume - slab streaming disabled." << endl;
+            streamSlabs = false;
+        }
+        const std::vector<VTKDicomRoutines::IsoRange> isoRanges = getIsoRanges();
+        if( streamSlabs && isoRanges.size() > 1 )
+        {
+            cout << "Several iso values are extracted from the whole volume - slab streaming disabled." << endl;
+            streamSlabs = false;
+        }
+
+        if( streamSlabs )
+        {
+            // mesh the images slab by slab without loading the whole volume
+            if( m_params.inputImageFiles )
+                mesh3d = vdr->pngToMeshStreamed( m_params.inputImageFiles.value(), m_params.xyzSpacing[0], m_params.xyzSpacing[1], m_params.xyzSpacing[2],
+                                                 m_params.slabSize.value(), m_params.isoValue, m_params.upperIsoValue.has_value(), m_params.upperIsoValue.value_or(0) );
+            else
+                mesh3d = vdr->dicomToMeshStreamed( m_params.pathToInputData.value_or(""), m_params.slabSize.value(),
+                                                   m_params.isoValue, m_params.upperIsoValue.has_value(), m_params.upperIsoValue.value_or(0) );
+
+            if( mesh3d == NULL )
+            {
+                cerr << "No image data could be created. Maybe wrong directory?" << endl;
+                return {false, meshes, volume};
+            }
+
+            return {true, {mesh3d}, volume};
+        }
+
+        std::chrono::steady_clock::time_point t_loadBegin = std::chrono::steady_clock::now();
 
         if( m_params.inputImageFiles )
         {
@@ -521,15 +1078,66 @@ std::tuple<bool, vtkSmartPointer<vtkPolyData>, vtkSmartPointer<vtkImageData>> Di
         }
         else
         {
+            std::chrono::steady_clock::time_point t_loadDone = std::chrono::steady_clock::now();
+
             if( m_params.enableCrop )
                 vdr->cropDicom( volume );
 
-            mesh3d = vdr->dicomToMesh( volume, m_params.isoValue, m_params.upperIsoValue.has_value(), m_params.upperIsoValue.value_or(0) );
-            result = true;
+            if( m_params.showReport )
+            {
+                showVolumeReport( *vdr, volume );
+                return {true, meshes, volume};
+            }
+
+            if( !m_params.extractLabels && m_params.objectSizeRatio && m_params.objectSizeRatio.value() >= 0.0 && m_params.objectSizeRatio.value() <= 1.0 )
+            {
+                // small objects are removed from the voxels, so that they are never meshed
+                vdr->SetSmallObjectRatio( m_params.objectSizeRatio.value() );
+                m_smallObjectsRemoved = true;
+            }
+
+            std::chrono::steady_clock::time_point t_meshBegin = std::chrono::steady_clock::now();
+            if( m_params.extractLabels )
+            {
+                // one mesh per label, the meshes of adjacent labels share their boundary
+                for( const auto& [label, labelMesh] : vdr->labelsToMeshes( volume ) )
+                {
+                    meshes.push_back( labelMesh );
+                    m_meshLabels.push_back( label );
+                }
+            }
+            else if( isoRanges.size() > 1 )
+                meshes = vdr->dicomToMeshes( volume, isoRanges );
+            else
+                meshes = { vdr->dicomToMesh( volume, isoRanges.front().threshold, isoRanges.front().useUpperThreshold, isoRanges.front().upperThreshold ) };
+            std::chrono::steady_clock::time_point t_meshDone = std::chrono::steady_clock::now();
+            result = !meshes.empty();
+            if( !result )
+                cerr << "No labels found in the volume" << endl;
+
+            if( m_params.previewStride )
+            {
+                // the number of triangles grows with the square of the resolution
+                const unsigned long stride = vdr->GetPreviewStride();
+                int* dims = volume->GetDimensions();
+                std::cout << "Preview at stride " << stride << ": " << dims[0] << " x " << dims[1] << " x " << dims[2] << " voxels" << std::endl;
+                for( size_t m = 0; m < meshes.size(); m++ )
+                {
+                    std::cout << ( m_meshLabels.empty() ? "Iso value " + getIsoRangeLabel(isoRanges[m]) : "Label " + std::to_string(m_meshLabels[m]) )
+                              << ": " << meshes[m]->GetNumberOfCells() << " triangles (about "
+                              << meshes[m]->GetNumberOfCells() * stride * stride << " at full resolution)" << std::endl;
+                }
+                std::cout << "Loading: " << std::chrono::duration_cast<std::chrono::milliseconds>(t_loadDone - t_loadBegin).count() << " ms, "
+                          << "meshing: " << std::chrono::duration_cast<std::chrono::milliseconds>(t_meshDone - t_meshBegin).count() << " ms"
+                          << std::endl << std::endl;
+            }
         }
     }
 
-    return {result, mesh3d, volume};
+    if( mesh3d != NULL )
+        meshes.push_back(mesh3d);
+
+    return {result, meshes, volume};
 }
 
 std::string Dicom2Mesh::getParametersAsString(const Dicom2MeshParameters& params) const
@@ -539,14 +1147,45 @@ std::string Dicom2Mesh::getParametersAsString(const Dicom2MeshParameters& params
     ret.append("Output file path: "); ret.append(params.outputFilePath.value_or("None")); ret.append("\n");
 
     ret.append("Surface segmentation: ");
-    ret.append(std::to_string(params.isoValue));
-    if( params.upperIsoValue.has_value() )
+    if( !params.isoRanges.empty() )
+    {
+        for( size_t r = 0; r < params.isoRanges.size(); r++ )
+        {
+            if( r > 0 )
+                ret.append(", ");
+            ret.append(getIsoRangeLabel(params.isoRanges[r]));
+        }
+    }
+    else
     {
-        ret.append(" to ");
-        ret.append(std::to_string(params.upperIsoValue.value()));
+        ret.append(std::to_string(params.isoValue));
+        if( params.upperIsoValue.has_value() )
+        {
+            ret.append(" to ");
+            ret.append(std::to_string(params.upperIsoValue.value()));
+        }
     }
     ret.append("\n");
 
+    if(params.showReport)
+        ret.append("Report: histogram and mesh size estimate, no meshing\n");
+
+    ret.append("Surface extraction: ");
+    if(params.extractLabels)
+    {
+        ret.append("label surface nets\n");
+    }
+    else if(params.dualContouringTolerance)
+    {
+        ret.append("adaptive dual contouring, tolerance ");
+        ret.append(std::to_string(params.dualContouringTolerance.value()));
+        ret.append("\n");
+    }
+    else
+    {
+        ret.append(params.useParallelMarchingCubes ? "parallel marching cubes\n" : "marching cubes\n");
+    }
+
     ret.append("Mesh reduction: ");
     if(params.reductionRate)
     {
@@ -565,9 +1204,47 @@ std::string Dicom2Mesh::getParametersAsString(const Dicom2MeshParameters& params
     {
         ret.append("disabled\n");
     }
+    ret.append("Levels of detail: ");
+    if(!params.levelsOfDetail.empty())
+    {
+        for( size_t l = 0; l < params.levelsOfDetail.size(); l++ )
+        {
+            ret.append( l > 0 ? ", " : "" );
+            ret.append( std::to_string(params.levelsOfDetail[l]) );
+        }
+        ret.append(" faces\n");
+    }
+    else
+    {
+        ret.append("disabled\n");
+    }
+    ret.append("Progressive mesh: ");
+    if(params.progressiveMeshBase)
+    {
+        ret.append("enabled (base nbr="); ret.append( std::to_string(params.progressiveMeshBase.value() )); ret.append(")\n");
+    }
+    else
+    {
+        ret.append("disabled\n");
+    }
+    if(params.reductionRate || params.polygonLimit || !params.levelsOfDetail.empty())
+    {
+        ret.append("Mesh decimation: ");
+        ret.append( params.useParallelReduction ? "parallel quadric decimation\n" : "quadric decimation\n" );
+    }
     ret.append("Mesh smoothing: ");
     ret.append( params.enableSmoothing ? "enabled\n" : "disabled\n" );
 
+    ret.append("Volume smoothing: ");
+    if(params.gaussianSigma)
+    {
+        ret.append("Gaussian (sigma="); ret.append( std::to_string(params.gaussianSigma.value()) ); ret.append(" mm)\n");
+    }
+    else
+    {
+        ret.append("disabled\n");
+    }
+
     ret.append("Mesh centering: ");
     ret.append(params.enableOriginToCenterOfMass ? "enabled\n" : "disabled\n" );
 
@@ -584,6 +1261,74 @@ std::string Dicom2Mesh::getParametersAsString(const Dicom2MeshParameters& params
     ret.append("Volume cropping: ");
     ret.append(params.enableCrop ? "enabled\n" : "disabled\n");
 
+    ret.append("DICOM series: "); ret.append(params.seriesSelector.value_or("interactive")); ret.append("\n");
+
+    ret.append("Slab streaming: ");
+    if(params.slabSize)
+    {
+        ret.append("enabled (slices="); ret.append( std::to_string(params.slabSize.value() )); ret.append(")\n");
+    }
+    else
+    {
+        ret.append("disabled\n");
+    }
+
+    ret.append("Volume of interest: ");
+    if(params.volumeOfInterest)
+    {
+        const std::array<int,6>& voi = params.volumeOfInterest.value();
+        for( int a = 0; a < 3; a++ )
+        {
+            ret.append( a == 0 ? "" : ", " );
+            ret.append( std::to_string(voi[2*a]) ); ret.append(" - ");
+            ret.append( voi[2*a+1] == std::numeric_limits<int>::max() ? std::string("end") : std::to_string(voi[2*a+1]) );
+        }
+        ret.append("\n");
+    }
+    else
+    {
+        ret.append("whole volume\n");
+    }
+
+    ret.append("Region of interest: ");
+    if(params.regionOfInterest)
+    {
+        const std::array<double,6>& roi = params.regionOfInterest.value();
+        for( int a = 0; a < 3; a++ )
+        {
+            ret.append( a == 0 ? "" : ", " );
+            ret.append( std::to_string(roi[2*a]) ); ret.append(" - "); ret.append( std::to_string(roi[2*a+1]) );
+        }
+        ret.append(" mm\n");
+    }
+    else
+    {
+        ret.append("none\n");
+    }
+
+    ret.append("Preview: ");
+    if(params.previewStride)
+    {
+        ret.append("enabled (stride="); ret.append( std::to_string(params.previewStride.value() )); ret.append(")\n");
+    }
+    else
+    {
+        ret.append("disabled\n");
+    }
+
+    ret.append("Prefetching: ");
+    if(params.nbrOfIoThreads)
+    {
+        ret.append("enabled (io-threads="); ret.append( std::to_string(params.nbrOfIoThreads.value() ));
+        ret.append(", queue-depth="); ret.append( std::to_string(params.prefetchQueueDepth )); ret.append(")\n");
+    }
+    else
+    {
+        ret.append("disabled\n");
+    }
+
+    ret.append("Volume cache: "); ret.append(params.cacheDirectory.value_or("disabled")); ret.append("\n");
+
     return ret;
 }
 
@@ -164,3 +164,30 @@ TEST(D2M, TestReduce)
         remove(fname.c_str());
     }
 }
+
+TEST(D2M, MakeMeshPerIsoRange)
+{
+    Dicom2Mesh::Dicom2MeshParameters settings = getPresetImageSettings();
+    settings.outputFilePath = "testMulti.stl";
+    settings.isoRanges.resize(2);
+    settings.isoRanges[0].threshold = 100;
+    settings.isoRanges[1].threshold = 100;
+    settings.isoRanges[1].useUpperThreshold = true;
+    settings.isoRanges[1].upperThreshold = 200;
+
+    Dicom2Mesh* d2m = new Dicom2Mesh(settings);
+    int retCode = d2m->doMesh();
+    delete d2m;
+
+    ASSERT_EQ(retCode, 0);
+    ASSERT_FALSE(std::filesystem::exists(std::filesystem::path("testMulti.stl")));
+
+    for( std::string fn : {"testMulti_100.stl", "testMulti_100_200.stl"} )
+    {
+        ASSERT_TRUE(std::filesystem::exists(std::filesystem::path(fn)));
+        ASSERT_GT(filesize(fn), 0);
+        remove(fn.c_str());
+    }
+    remove("testMulti_100.info");
+    remove("testMulti_100_200.info");
+}
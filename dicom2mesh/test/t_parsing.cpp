@@ -300,3 +300,280 @@ TEST(ArgumentParser, PolygonLimitEnable)
     ASSERT_TRUE(parsedInput.polygonLimit.has_value());
     ASSERT_EQ(parsedInput.polygonLimit, 12345);
 }
+
+TEST(ArgumentParser, NumberOfThreads)
+{
+    constexpr int nInput = 4;
+    const char *input[nInput] = {"-i", "inputDir", "-j", "12"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.nbrOfThreads.has_value());
+    ASSERT_EQ(parsedInput.nbrOfThreads.value(), 12u);
+}
+
+TEST(ArgumentParser, CacheDirectory)
+{
+    constexpr int nInput = 4;
+    const char *input[nInput] = {"-i", "inputDir", "-cache", "cacheDir"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.cacheDirectory.has_value());
+    ASSERT_STREQ(parsedInput.cacheDirectory.value().c_str(), "cacheDir");
+}
+
+TEST(ArgumentParser, SlabSize)
+{
+    constexpr int nInput = 4;
+    const char *input[nInput] = {"-i", "inputDir", "-slab", "64"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.slabSize.has_value());
+    ASSERT_EQ(parsedInput.slabSize.value(), 64u);
+}
+
+TEST(ArgumentParser, SeriesSelector)
+{
+    constexpr int nInput = 4;
+    const char *input[nInput] = {"-i", "inputDir", "-series", "1.2.840.113619.2.55"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.seriesSelector.has_value());
+    ASSERT_STREQ(parsedInput.seriesSelector.value().c_str(), "1.2.840.113619.2.55");
+}
+
+TEST(ArgumentParser, VolumeOfInterest)
+{
+    constexpr int nInput = 9;
+    const char *input[nInput] = {"-i", "inputDir", "-voi", "10", "100", "20", "200", "5", "50"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.volumeOfInterest.has_value());
+    std::array<int,6> voi = {10, 100, 20, 200, 5, 50};
+    ASSERT_EQ(parsedInput.volumeOfInterest.value(), voi);
+}
+
+TEST(ArgumentParser, RegionOfInterest)
+{
+    constexpr int nInput = 9;
+    const char *input[nInput] = {"-i", "inputDir", "-roi", "-50.5", "50", "-80", "20", "100", "180.25"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.regionOfInterest.has_value());
+    std::array<double,6> roi = {-50.5, 50.0, -80.0, 20.0, 100.0, 180.25};
+    ASSERT_EQ(parsedInput.regionOfInterest.value(), roi);
+    ASSERT_FALSE(parsedInput.volumeOfInterest.has_value());
+}
+
+TEST(ArgumentParser, SliceRange)
+{
+    constexpr int nInput = 5;
+    const char *input[nInput] = {"-i", "inputDir", "-slices", "100", "299"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.volumeOfInterest.has_value());
+    ASSERT_EQ(parsedInput.volumeOfInterest.value()[0], 0);
+    ASSERT_EQ(parsedInput.volumeOfInterest.value()[4], 100);
+    ASSERT_EQ(parsedInput.volumeOfInterest.value()[5], 299);
+}
+
+TEST(ArgumentParser, PreviewStride)
+{
+    constexpr int nInput = 4;
+    const char *input[nInput] = {"-i", "inputDir", "-preview", "4"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.previewStride.has_value());
+    ASSERT_EQ(parsedInput.previewStride.value(), 4);
+}
+
+TEST(ArgumentParser, Prefetch)
+{
+    constexpr int nInput = 5;
+    const char *input[nInput] = {"-i", "inputDir", "-prefetch", "4", "16"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.nbrOfIoThreads.has_value());
+    ASSERT_EQ(parsedInput.nbrOfIoThreads.value(), 4);
+    ASSERT_EQ(parsedInput.prefetchQueueDepth, 16);
+}
+
+TEST(ArgumentParser, ParallelMarchingCubes)
+{
+    constexpr int nInput = 3;
+    const char *input[nInput] = {"-i", "inputDir", "-pmc"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+    ASSERT_TRUE(parsedInput.useParallelMarchingCubes);
+
+    auto[okDefault, defaultInput] = Dicom2Mesh::parseCmdLineParameters(2, input);
+    ASSERT_TRUE(okDefault);
+    ASSERT_FALSE(defaultInput.useParallelMarchingCubes);
+}
+
+TEST(ArgumentParser, ParallelReduction)
+{
+    constexpr int nInput = 7;
+    const char *input[nInput] = {"-i", "inputDir", "-p", "100000", "-pr", "-j", "8"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+    ASSERT_TRUE(parsedInput.useParallelReduction);
+    ASSERT_EQ(parsedInput.polygonLimit.value(), 100000);
+    ASSERT_EQ(parsedInput.nbrOfThreads.value(), 8);
+
+    auto[okDefault, defaultInput] = Dicom2Mesh::parseCmdLineParameters(4, input);
+    ASSERT_TRUE(okDefault);
+    ASSERT_FALSE(defaultInput.useParallelReduction);
+}
+
+TEST(ArgumentParser, LevelsOfDetail)
+{
+    constexpr int nInput = 5;
+    const char *input[nInput] = {"-i", "inputDir", "-lod", "1000000, 200000,50000", "-pr"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+    ASSERT_EQ(parsedInput.levelsOfDetail.size(), 3);
+    ASSERT_EQ(parsedInput.levelsOfDetail[0], 1000000);
+    ASSERT_EQ(parsedInput.levelsOfDetail[1], 200000);
+    ASSERT_EQ(parsedInput.levelsOfDetail[2], 50000);
+    ASSERT_TRUE(parsedInput.useParallelReduction);
+
+    auto[okDefault, defaultInput] = Dicom2Mesh::parseCmdLineParameters(2, input);
+    ASSERT_TRUE(okDefault);
+    ASSERT_TRUE(defaultInput.levelsOfDetail.empty());
+}
+
+TEST(ArgumentParser, ProgressiveMesh)
+{
+    constexpr int nInput = 6;
+    const char *input[nInput] = {"-i", "inputDir", "-pm", "5000", "-o", "mesh.stl"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+    ASSERT_TRUE(parsedInput.progressiveMeshBase.has_value());
+    ASSERT_EQ(parsedInput.progressiveMeshBase.value(), 5000);
+    ASSERT_FALSE(parsedInput.polygonLimit.has_value());
+
+    auto[okDefault, defaultInput] = Dicom2Mesh::parseCmdLineParameters(2, input);
+    ASSERT_TRUE(okDefault);
+    ASSERT_FALSE(defaultInput.progressiveMeshBase.has_value());
+}
+
+TEST(ArgumentParser, Report)
+{
+    constexpr int nInput = 5;
+    const char *input[nInput] = {"-i", "inputDir", "-report", "-p", "5000"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+    ASSERT_TRUE(parsedInput.showReport);
+    ASSERT_EQ(parsedInput.polygonLimit.value(), 5000);
+
+    auto[okDefault, defaultInput] = Dicom2Mesh::parseCmdLineParameters(2, input);
+    ASSERT_TRUE(okDefault);
+    ASSERT_FALSE(defaultInput.showReport);
+}
+
+TEST(ArgumentParser, GaussianSigma)
+{
+    constexpr int nInput = 4;
+    const char *input[nInput] = {"-i", "inputDir", "-vs", "0.8"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+
+    ASSERT_TRUE(parsedInput.gaussianSigma.has_value());
+    ASSERT_NEAR(parsedInput.gaussianSigma.value(), 0.8, 0.0001);
+    ASSERT_FALSE(parsedInput.enableSmoothing);
+}
+
+TEST(ArgumentParser, Labels)
+{
+    constexpr int nInput = 3;
+    const char *input[nInput] = {"-i", "inputDir", "-labels"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+    ASSERT_TRUE(parsedInput.extractLabels);
+
+    auto[okDefault, defaultInput] = Dicom2Mesh::parseCmdLineParameters(2, input);
+    ASSERT_TRUE(okDefault);
+    ASSERT_FALSE(defaultInput.extractLabels);
+}
+
+TEST(ArgumentParser, DualContouring)
+{
+    constexpr int nInput = 4;
+    const char *input[nInput] = {"-i", "inputDir", "-dc", "0.25"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+    ASSERT_TRUE(parsedInput.dualContouringTolerance.has_value());
+    ASSERT_DOUBLE_EQ(parsedInput.dualContouringTolerance.value(), 0.25);
+
+    auto[okMissing, missingInput] = Dicom2Mesh::parseCmdLineParameters(3, input);
+    ASSERT_FALSE(okMissing);
+
+    auto[okDefault, defaultInput] = Dicom2Mesh::parseCmdLineParameters(2, input);
+    ASSERT_TRUE(okDefault);
+    ASSERT_FALSE(defaultInput.dualContouringTolerance.has_value());
+}
+
+TEST(ArgumentParser, IsoRanges)
+{
+    constexpr int nInput = 4;
+    const char *input[nInput] = {"-i", "inputDir", "-tl", "400, -500:-100,100:200"};
+
+    auto[okPars, parsedInput] = Dicom2Mesh::parseCmdLineParameters(nInput, input);
+
+    ASSERT_TRUE(okPars);
+    ASSERT_EQ(parsedInput.isoRanges.size(), 3);
+
+    ASSERT_EQ(parsedInput.isoRanges[0].threshold, 400);
+    ASSERT_FALSE(parsedInput.isoRanges[0].useUpperThreshold);
+
+    ASSERT_EQ(parsedInput.isoRanges[1].threshold, -500);
+    ASSERT_TRUE(parsedInput.isoRanges[1].useUpperThreshold);
+    ASSERT_EQ(parsedInput.isoRanges[1].upperThreshold, -100);
+
+    ASSERT_EQ(parsedInput.isoRanges[2].threshold, 100);
+    ASSERT_TRUE(parsedInput.isoRanges[2].useUpperThreshold);
+    ASSERT_EQ(parsedInput.isoRanges[2].upperThreshold, 200);
+}
@@ -0,0 +1,98 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkCellClassifier_H_
+#define _vtkCellClassifier_H_
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Computes the marching cubes case index of the cells along a row of a 16 bit
+ * volume with SIMD instructions. The instruction set is chosen at runtime:
+ * AVX2 or SSE2 on x86 processors which support them, a portable loop otherwise.
+ */
+class VTKCellClassifier
+{
+
+public:
+
+    /**
+     * Implementations of the classification.
+     */
+    enum class InstructionSet
+    {
+        Portable,   // scalar loop
+        SSE2,       // 8 cells per step
+        AVX2        // 16 cells per step
+    };
+
+    /**
+     * Returns the best instruction set the processor supports.
+     * @return Instruction set.
+     */
+    static InstructionSet getSupportedInstructionSet();
+
+    /**
+     * Returns the instruction set used.
+     * @return Instruction set. By default the best supported one.
+     */
+    static InstructionSet getInstructionSet();
+
+    /**
+     * Chooses the instruction set, for comparisons and benchmarks.
+     * @param instructionSet Instruction set. Limited to the supported ones.
+     * @return Instruction set used from now on.
+     */
+    static InstructionSet setInstructionSet( InstructionSet instructionSet );
+
+    /**
+     * Returns the name of an instruction set.
+     * @param instructionSet Instruction set.
+     * @return Name.
+     */
+    static std::string getName( InstructionSet instructionSet );
+
+    /**
+     * Computes the case indices of a run of cells. A voxel counts as inside the
+     * surface if lower <= voxel < upper. Bit b of an index is set if corner b of
+     * the cell, numbered as by vtkMarchingCubes, lies inside.
+     * @param rows The four voxel rows of the cells: (j,k), (j+1,k), (j,k+1) and (j+1,k+1).
+     *             Each starts at the first cell and holds nbrOfCells + 1 voxels.
+     * @param nbrOfCells Number of cells.
+     * @param lower Lowest value inside.
+     * @param upper Values at or above are outside. Infinity for no upper bound.
+     * @param indices Case index of each cell.
+     */
+    static void computeCubeIndices( const short* const rows[4], size_t nbrOfCells, double lower, double upper,
+                                    unsigned char* indices );
+
+    /**
+     * Computes the case indices of a run of cells of an unsigned 16 bit volume.
+     * See the signed version.
+     */
+    static void computeCubeIndices( const unsigned short* const rows[4], size_t nbrOfCells, double lower, double upper,
+                                    unsigned char* indices );
+};
+
+#endif // _vtkCellClassifier_H_
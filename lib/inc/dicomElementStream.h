@@ -0,0 +1,126 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _dicomElementStream_H_
+#define _dicomElementStream_H_
+
+#include <istream>
+#include <string>
+#include <cstdint>
+
+/**
+ * Reads the data elements of a DICOM file one by one. Only the element
+ * headers and short string values are interpreted; any other value is
+ * skipped, including sequences and encapsulated values of undefined length.
+ */
+class DicomElementStream
+{
+
+public:
+
+    static const uint32_t UNDEFINED_LENGTH = 0xFFFFFFFF;
+
+    struct ElementHeader
+    {
+        uint16_t group = 0;
+        uint16_t element = 0;
+        char vr[2] = { ' ', ' ' };
+        uint32_t length = 0;
+
+        uint32_t tag() const { return ( uint32_t(group) << 16 ) | uint32_t(element); }
+    };
+
+    /**
+     * @param in Stream positioned at the start of the file.
+     */
+    explicit DicomElementStream( std::istream& in );
+
+    /**
+     * Reads the preamble and the file meta information and detects the encoding
+     * of the data set. Files without preamble are guessed to be little endian,
+     * explicit or implicit VR. Afterwards, the stream is positioned at the first
+     * element of the data set.
+     * @return False if the stream is not readable or the data set is deflated.
+     */
+    bool open();
+
+    /**
+     * Returns the transfer syntax of the file meta information.
+     * @return Transfer syntax UID, empty for files without meta information.
+     */
+    const std::string& getTransferSyntax() const;
+
+    bool isExplicitVr() const;
+    bool isBigEndian() const;
+
+    /**
+     * Reads the header of the next element. Items and delimiters have no VR.
+     * @param header Read header.
+     * @return False at the end of the stream.
+     */
+    bool readElementHeader( ElementHeader& header );
+
+    /**
+     * Skips the value of an element, of defined or undefined length.
+     * @param header Header of the element, just read.
+     * @return False if the stream ended early.
+     */
+    bool skipValue( const ElementHeader& header );
+
+    /**
+     * Reads a string value. Padding spaces and zeros are removed. Values
+     * longer than 1024 bytes are skipped and leave the string unchanged.
+     * @param length Value length.
+     * @param value Read string.
+     * @return False if the stream ended early.
+     */
+    bool readString( uint32_t length, std::string& value );
+
+    /**
+     * Reads an unsigned 16 or 32 bit value.
+     * @param length Value length, 2 or 4.
+     * @param value Read number.
+     * @return False if the length does not fit or the stream ended early.
+     */
+    bool readUnsigned( uint32_t length, uint32_t& value );
+
+    /**
+     * Converts bytes of the data set encoding to a number.
+     */
+    uint16_t toU16( const unsigned char* bytes ) const;
+    uint32_t toU32( const unsigned char* bytes ) const;
+
+private:
+
+    bool readElementHeader( bool explicitVr, ElementHeader& header );
+    bool skipBytes( uint32_t length );
+    bool skipUndefinedLength( bool explicitVr, int depth );
+    bool skipItemElements( bool explicitVr, int depth );
+
+    std::istream& m_in;
+    std::string m_transferSyntax;
+    bool m_explicitVr;
+    bool m_bigEndian;
+};
+
+#endif // _dicomElementStream_H_
@@ -0,0 +1,82 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _dicomFrameIndex_H_
+#define _dicomFrameIndex_H_
+
+#include <istream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Locates the frames within the pixel data of a multi-frame DICOM file, so
+ * that the frames can be read and decoded independently of each other.
+ * Native pixel data is cut into frames of equal size. Encapsulated frames are
+ * found by the basic offset table or, without offset table, by taking one
+ * fragment per frame.
+ */
+class DicomFrameIndex
+{
+
+public:
+
+    /**
+     * Byte range within the file.
+     */
+    struct Fragment
+    {
+        uint64_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    struct PixelData
+    {
+        std::string transferSyntax;
+        bool bigEndian = false;
+        bool encapsulated = false;
+        std::vector<std::vector<Fragment>> frames; // byte ranges of each frame, in frame order
+    };
+
+    /**
+     * Locates the frames of a DICOM file.
+     * @param file Path to the file.
+     * @param nbrOfFrames Number of frames of the file.
+     * @param frameBytes Size of a native frame in bytes.
+     * @param pixelData Transfer syntax and the byte ranges of the frames.
+     * @return False if the file has no pixel data, the pixel data is too short,
+     *         or the encapsulated fragments cannot be assigned to frames.
+     */
+    static bool locateFrames( const std::string& file, size_t nbrOfFrames, size_t frameBytes, PixelData& pixelData );
+
+    /**
+     * Reads the bytes of a frame. The fragments of an encapsulated frame are concatenated.
+     * @param in Stream of the file.
+     * @param frame Byte ranges of the frame.
+     * @param bytes Read bytes.
+     * @return False if the file ended early.
+     */
+    static bool readFrame( std::istream& in, const std::vector<Fragment>& frame, std::vector<char>& bytes );
+};
+
+#endif // _dicomFrameIndex_H_
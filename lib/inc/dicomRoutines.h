@@ -24,17 +24,44 @@
 #ifndef _vtkDicomRoutines_H_
 #define _vtkDicomRoutines_H_
 
+#include "parallelTools.h"
+#include "isoSurface.h"
+#include "minMaxBlocks.h"
+#include "voxelComponents.h"
+#include "labelSurfaces.h"
+#include "volumeHistogram.h"
+#include "volumeFilter.h"
+
 #include <vtkSmartPointer.h>
 #include <vtkPolyData.h>
 #include <vtkImageData.h>
 #include <vtkCallbackCommand.h>
 #include <string>
+#include <vector>
+#include <functional>
+#include <array>
+#include <map>
 
 class VTKDicomRoutines
 {
 
 public:   
 
+    /**
+     * Algorithms extracting the iso surface from a volume.
+     */
+    enum class SurfaceExtractor
+    {
+        MarchingCubes,          // marching cubes on one thread
+        ParallelMarchingCubes,  // marching cubes on z-blocks of the volume in parallel
+        AdaptiveDualContouring  // dual contouring on an octree, coarse cells where the surface is flat
+    };
+
+    /**
+     * Iso value of a surface, with an optional upper threshold.
+     */
+    using IsoRange = VTKIsoSurface::IsoRange;
+
     VTKDicomRoutines();
     virtual ~VTKDicomRoutines();
 
@@ -44,16 +71,218 @@ public:
      */
     void SetProgressCallback( vtkSmartPointer<vtkCallbackCommand> progressCallback );
 
+    /**
+     * Sets the number of threads used to load image data and to extract the surface.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core,
+     *                     1 loads the images sequentially.
+     */
+    void SetNumberOfThreads( unsigned int nbrOfThreads );
+
+    /**
+     * Returns the number of threads set.
+     * @return Number of threads. 0 stands for one thread per hardware core.
+     */
+    unsigned int GetNumberOfThreads() const;
+
+    /**
+     * Chooses the algorithm extracting the surface. The parallel marching cubes
+     * split the volume into z-blocks sharing one slice, extract the surface of
+     * the blocks with the threads set by SetNumberOfThreads and merge the vertices
+     * on the shared slices. The result has the vertices and triangles of the
+     * sequential marching cubes, only in a different order. Both marching cubes
+     * run VTKIsoSurface, which has the case table and vertex placement of
+     * vtkMarchingCubes. Only a single iso value without upper threshold and
+     * with empty space skipping disabled is passed to vtkMarchingCubes itself.
+     * @param extractor Surface extraction algorithm.
+     */
+    void SetSurfaceExtractor( SurfaceExtractor extractor );
+
+    /**
+     * Returns the surface extraction algorithm set.
+     * @return Surface extraction algorithm.
+     */
+    SurfaceExtractor GetSurfaceExtractor() const;
+
+    /**
+     * Sets the tolerance of the adaptive dual contouring. Cells are merged as long
+     * as the root mean square distance of the merged vertex to the tangent planes
+     * of the surface within them stays below the tolerance. Larger tolerances give
+     * fewer, larger triangles on flat regions.
+     * @param tolerance Tolerance in world units (mm). 0 keeps the resolution of the voxels.
+     */
+    void SetDualContouringTolerance( double tolerance );
+
+    /**
+     * Returns the tolerance of the adaptive dual contouring.
+     * @return Tolerance in world units.
+     */
+    double GetDualContouringTolerance() const;
+
+    /**
+     * Sets the number of relaxation steps of the label surfaces. Each step moves
+     * the vertices halfway towards the mean of their neighbours, keeping them
+     * within their cell. More steps give smoother surfaces, but shrink thin
+     * structures.
+     * @param nbrOfIterations Number of relaxation steps. 0 keeps the blocky surfaces (default 10).
+     */
+    void SetLabelSmoothingIterations( unsigned int nbrOfIterations );
+
+    /**
+     * Returns the number of relaxation steps of the label surfaces.
+     * @return Number of relaxation steps.
+     */
+    unsigned int GetLabelSmoothingIterations() const;
+
+    /**
+     * Smooths the volume with a Gaussian before meshing, which removes the stair
+     * steps of the surface at a fraction of the cost of smoothing the mesh. The
+     * separable filter runs in parallel on the threads set by SetNumberOfThreads.
+     * The image data is not changed. Not applied by the streamed meshing and the
+     * label surfaces.
+     * @param sigma Standard deviation in world units (mm). 0 disables the filter (default).
+     */
+    void SetGaussianSigma( double sigma );
+
+    /**
+     * Returns the standard deviation of the Gaussian applied before meshing.
+     * @return Standard deviation in world units. 0 if the volume is not smoothed.
+     */
+    double GetGaussianSigma() const;
+
+    /**
+     * Enables skipping empty space during meshing. The lowest and highest voxel
+     * value of each block of 8x8x8 cells is computed in parallel before the first
+     * extraction from a volume, and blocks no iso range crosses are not visited.
+     * The block ranges are kept for later extractions from the same, unchanged
+     * volume with other thresholds. The meshes are the same as without skipping.
+     * Enabled by default.
+     * @param enable Skip empty blocks.
+     */
+    void SetEmptySpaceSkipping( bool enable );
+
+    /**
+     * Tells if empty space is skipped during meshing.
+     * @return True if empty blocks are skipped.
+     */
+    bool GetEmptySpaceSkipping() const;
+
+    /**
+     * Removes small objects before meshing. The voxels inside an iso range are
+     * labelled as 26-connected components in parallel, and components having at
+     * most ratio times the voxels of the biggest component are left out of the
+     * mesh. The image data is not changed. Not applied by the streamed meshing,
+     * which never holds the whole volume.
+     * @param ratio Size ratio 0.0 - 1.0. 0 keeps all objects (default).
+     */
+    void SetSmallObjectRatio( double ratio );
+
+    /**
+     * Returns the size ratio of objects removed before meshing.
+     * @return Size ratio. 0 if all objects are kept.
+     */
+    double GetSmallObjectRatio() const;
+
+    /**
+     * Enables the persistent volume cache. Loaded volumes are written to the
+     * cache directory and memory-mapped when the same, unchanged files are
+     * loaded again.
+     * @param cacheDirectory Cache directory. An empty path disables the cache.
+     */
+    void SetCacheDirectory( const std::string& cacheDirectory );
+
+    /**
+     * Chooses the DICOM series to load, if a directory holds several series.
+     * Only the vtk-dicom based loader distinguishes series.
+     * @param seriesSelector Series index, SeriesInstanceUID or part of the series
+     *                       description. An empty selector asks the user.
+     */
+    void SetSeriesSelector( const std::string& seriesSelector );
+
+    /**
+     * Restricts loading to a volume of interest. Image files outside of the
+     * slice range are not read, and only the window x0-x1, y0-y1 of each slice
+     * is kept. The range is clamped to the volume. The loaded volume has an
+     * extent starting at 0 and its origin at the first voxel of interest.
+     * @param x0 First column.
+     * @param x1 Last column.
+     * @param y0 First row.
+     * @param y1 Last row.
+     * @param z0 First slice.
+     * @param z1 Last slice.
+     */
+    void SetVolumeOfInterest( int x0, int x1, int y0, int y1, int z0, int z1 );
+
+    /**
+     * Loads the whole volume again.
+     */
+    void ClearVolumeOfInterest();
+
+    /**
+     * Restricts loading and surface extraction to a box in patient coordinates,
+     * the coordinates of the resulting meshes. Only the voxels covering the box
+     * are loaded, so image files and slice windows outside of it are skipped as
+     * with the volume of interest. Combines with the volume of interest, the
+     * voxels of both are kept.
+     * @param xMin Lower x bound in mm.
+     * @param xMax Upper x bound in mm.
+     * @param yMin Lower y bound in mm.
+     * @param yMax Upper y bound in mm.
+     * @param zMin Lower z bound in mm.
+     * @param zMax Upper z bound in mm.
+     */
+    void SetRegionOfInterest( double xMin, double xMax, double yMin, double yMax, double zMin, double zMax );
+
+    /**
+     * Removes the region of interest.
+     */
+    void ClearRegionOfInterest();
+
+    /**
+     * Loads a low resolution preview of the volume. Only every stride-th slice
+     * is read, and of these only every stride-th row and column is kept. The
+     * spacing grows by the stride. Combines with the volume of interest, whose
+     * first voxel is the first voxel sampled.
+     * @param stride Sampling stride. 1 loads the full resolution.
+     */
+    void SetPreviewStride( unsigned int stride );
+
+    /**
+     * Returns the preview stride.
+     * @return Sampling stride. 1 stands for full resolution.
+     */
+    unsigned int GetPreviewStride() const;
+
+    /**
+     * Overlaps reading and decoding of the image files. I/O threads read the
+     * files into memory ahead of the decoder threads, which are set by
+     * SetNumberOfThreads. Helps on slow or network storage. Png images are
+     * decoded from memory, DICOM files are read again from the page cache.
+     * The phase timings are reported after loading.
+     * @param nbrOfIoThreads Number of I/O threads. 0 disables prefetching.
+     * @param queueDepth Maximum number of prefetched files waiting for a decoder.
+     *                   0 allows two per decoder thread.
+     */
+    void SetPrefetch( unsigned int nbrOfIoThreads, unsigned int queueDepth );
+
+    /**
+     * Returns the phase timings of the last prefetching load.
+     * @return Timings, all zero if the last load did not prefetch.
+     */
+    ParallelTools::PipelineStatistics GetLoadStatistics() const;
+
     /**
      * Loads the DICOM images within a directory.
      * If there are multiple DICOM sets, user interaction is needed.
+     * The slices are decoded in parallel if more than one thread is set.
      * @param pathToDicom Path to the DICOM directory.
      * @return DICOM image data.
      */
     virtual vtkSmartPointer<vtkImageData> loadDicomImage( const std::string& pathToDicom );
 
     /**
-     * Load image data from a set of png images.
+     * Load image data from a set of png images. The images are decoded in
+     * parallel and written directly into their slice of the volume.
+     * 8 bit and 16 bit images are supported.
      * @param pngPaths Png image paths
      * @param x_spacing Spatial spacing in x direction
      * @param y_spacing Spatial spacing in y direction
@@ -64,7 +293,9 @@ public:
             double x_spacing, double y_spacing, double slice_spacing );
 
     /**
-     * Creates a mesh from out DICOM raw data.
+     * Creates a mesh from out DICOM raw data. With upper threshold, voxels at or
+     * above it count as outside of the surface. They are masked while the cubes
+     * are classified, so that the image data is neither copied nor changed.
      * @param imageData DICOM image data.
      * @param threshold Threshold for surface segmentation.
      * @param useUpperThreshold Use upper threshold.
@@ -74,6 +305,88 @@ public:
     vtkSmartPointer<vtkPolyData> dicomToMesh(vtkSmartPointer<vtkImageData> imageData, int threshold,
                                              bool useUpperThreshold, int upperThreshold);
 
+    /**
+     * Creates one mesh per iso range in a single pass over the DICOM raw data,
+     * for example bone, skin and soft tissue. Each mesh equals the mesh
+     * dicomToMesh creates for its iso range. The image data is not changed.
+     * @param imageData DICOM image data.
+     * @param isoRanges Iso value and optional upper threshold of each mesh.
+     * @return One mesh per iso range, in the order of the iso ranges.
+     */
+    std::vector<vtkSmartPointer<vtkPolyData>> dicomToMeshes( vtkSmartPointer<vtkImageData> imageData,
+                                                             const std::vector<IsoRange>& isoRanges );
+
+    /**
+     * Computes the histogram of the voxel values in parallel, to choose iso values.
+     * @param imageData DICOM image data.
+     * @param nbrOfBins Maximum number of bins.
+     * @return Histogram.
+     */
+    VTKVolumeHistogram::Histogram computeHistogram( vtkSmartPointer<vtkImageData> imageData, unsigned int nbrOfBins );
+
+    /**
+     * Counts the cells and triangles of the marching cubes surfaces of several iso
+     * ranges and the voxels inside them, without creating any geometry. The cells are classified in parallel
+     * and empty space is skipped as set. The counts help to choose a reduction rate
+     * or polygon limit before meshing. Small objects are not removed, and the
+     * adaptive dual contouring creates fewer triangles than counted.
+     * @param imageData DICOM image data.
+     * @param isoRanges Iso value and optional upper threshold of each surface.
+     * @return Number of cells, triangles and inside voxels of each surface, in the order of the iso ranges.
+     */
+    std::vector<VTKIsoSurface::SurfaceSize> estimateMeshSizes( vtkSmartPointer<vtkImageData> imageData,
+                                                               const std::vector<IsoRange>& isoRanges );
+
+    /**
+     * Creates the surfaces of all labels of a label volume, like a segmentation with
+     * one integer id per organ, in one parallel pass. The boundary between two
+     * adjacent labels is one shared set of triangles. Label 0 is background.
+     * @param labelData Label volume with integer voxels.
+     * @return Mesh whose triangles carry the two labels they separate in the cell data
+     *         array VTKLabelSurfaces::LabelsArrayName.
+     */
+    vtkSmartPointer<vtkPolyData> labelsToMesh( vtkSmartPointer<vtkImageData> labelData );
+
+    /**
+     * Creates one closed mesh per label of a label volume. See labelsToMesh. Meshes
+     * of adjacent labels have the same vertices on their common boundary.
+     * @param labelData Label volume with integer voxels.
+     * @return One mesh per label other than background, by label.
+     */
+    std::map<int, vtkSmartPointer<vtkPolyData>> labelsToMeshes( vtkSmartPointer<vtkImageData> labelData );
+
+    /**
+     * Creates a mesh from a DICOM directory without holding the whole volume in memory.
+     * The volume is read and meshed in z-slabs which overlap by one slice. The vertices on
+     * the shared slices are merged, so that the mesh has no cracks or duplicated vertices at
+     * the seams. Memory is bounded by the slab size plus the resulting mesh.
+     * @param pathToDicom Path to the DICOM directory.
+     * @param slabSize Number of slices per slab (at least 2).
+     * @param threshold Threshold for surface segmentation.
+     * @param useUpperThreshold Use upper threshold.
+     * @param upperThreshold Upper threshold for surface segmentation.
+     * @return Resulting 3D mesh or NULL if the images could not be read.
+     */
+    vtkSmartPointer<vtkPolyData> dicomToMeshStreamed( const std::string& pathToDicom, unsigned int slabSize,
+                                                      int threshold, bool useUpperThreshold, int upperThreshold );
+
+    /**
+     * Creates a mesh from a set of png images, reading and meshing them in z-slabs.
+     * See dicomToMeshStreamed.
+     * @param pngPaths Png image paths
+     * @param x_spacing Spatial spacing in x direction
+     * @param y_spacing Spatial spacing in y direction
+     * @param slice_spacing Spatial spacing between slices
+     * @param slabSize Number of slices per slab (at least 2).
+     * @param threshold Threshold for surface segmentation.
+     * @param useUpperThreshold Use upper threshold.
+     * @param upperThreshold Upper threshold for surface segmentation.
+     * @return Resulting 3D mesh or NULL if the images could not be read.
+     */
+    vtkSmartPointer<vtkPolyData> pngToMeshStreamed( const std::vector<std::string>& pngPaths,
+            double x_spacing, double y_spacing, double slice_spacing, unsigned int slabSize,
+            int threshold, bool useUpperThreshold, int upperThreshold );
+
     /**
      * Crop dicom images in terms of used slice ranges.
      * This starts a dialog with the user.
@@ -85,10 +398,203 @@ private:
 
     bool checkDataLoaded( vtkSmartPointer<vtkImageData> imageData );
 
+    /**
+     * Prints the phase timings of the last load, if it prefetched.
+     */
+    void reportLoadStatistics() const;
+
+    /**
+     * Runs the surface extraction on a volume. The volume is not changed.
+     * @param imageData Volume.
+     * @param threshold Threshold for surface segmentation.
+     * @param useUpperThreshold Use upper threshold.
+     * @param upperThreshold Upper threshold for surface segmentation.
+     * @param computeNormals Compute point normals.
+     * @return Mesh.
+     */
+    vtkSmartPointer<vtkPolyData> extractSurface( vtkSmartPointer<vtkImageData> imageData, int threshold,
+                                                 bool useUpperThreshold, int upperThreshold, bool computeNormals );
+
+    /**
+     * Runs the surface extraction for several iso ranges on a volume. The volume is not changed.
+     * @param imageData Volume.
+     * @param isoRanges Iso value and optional upper threshold of each surface.
+     * @param computeNormals Compute point normals.
+     * @param activeBlocks Blocks which may hold a surface, or NULL to visit all cells.
+     * @return One mesh per iso range.
+     */
+    std::vector<vtkSmartPointer<vtkPolyData>> extractSurfaces( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                                                               bool computeNormals, const VTKIsoSurface::ActiveBlocks* activeBlocks = NULL );
+
+    /**
+     * Meshes a volume for several iso ranges, skipping empty space and removing
+     * small objects as set. The volume is not changed.
+     * @param imageData Volume.
+     * @param isoRanges Iso value and optional upper threshold of each surface.
+     * @return One mesh per iso range.
+     */
+    std::vector<vtkSmartPointer<vtkPolyData>> meshVolume( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges );
+
+    /**
+     * Runs the adaptive dual contouring on a volume, once per iso range. The volume is not changed.
+     * @param imageData Volume.
+     * @param isoRanges Iso value and optional upper threshold of each surface.
+     * @param activeBlocks Blocks which may hold a surface, or NULL to visit all cells.
+     * @return One mesh per iso range.
+     */
+    std::vector<vtkSmartPointer<vtkPolyData>> extractAdaptiveSurfaces( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                                                                       const VTKIsoSurface::ActiveBlocks* activeBlocks ) const;
+
+    /**
+     * Finds the blocks of a volume the iso ranges may cross, if empty space skipping
+     * is enabled. The block ranges are built if they do not belong to the volume.
+     * @param imageData Volume.
+     * @param isoRanges Iso value and optional upper threshold of each surface.
+     * @param activeBlocks Set to the blocks which may hold a surface.
+     * @return False if empty space skipping is disabled or not possible.
+     */
+    bool findActiveBlocks( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                           VTKIsoSurface::ActiveBlocks& activeBlocks );
+
+    /**
+     * Runs marching cubes on a volume, one pass for all iso ranges. Voxels at or above
+     * an upper threshold are masked while the cubes are classified, the volume is not changed.
+     * A single iso value without upper threshold and active blocks is run by vtkMarchingCubes.
+     * @param imageData Volume.
+     * @param isoRanges Iso value and optional upper threshold of each surface.
+     * @param computeNormals Compute point normals.
+     * @param reportProgress Pass the progress events to the progress callback.
+     * @param activeBlocks Blocks which may hold a surface, or NULL to visit all cells.
+     * @param firstSlice Slice of the block grid the volume starts at.
+     * @return One mesh per iso range.
+     */
+    std::vector<vtkSmartPointer<vtkPolyData>> runMarchingCubes( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                                                                bool computeNormals, bool reportProgress,
+                                                                const VTKIsoSurface::ActiveBlocks* activeBlocks, int firstSlice ) const;
+
+    /**
+     * Runs marching cubes on z-blocks of a volume in parallel and stitches the block meshes.
+     * @param imageData Volume with at least three slices.
+     * @param isoRanges Iso value and optional upper threshold of each surface.
+     * @param computeNormals Compute point normals.
+     * @param activeBlocks Blocks which may hold a surface, or NULL to visit all cells.
+     * @return One mesh per iso range.
+     */
+    std::vector<vtkSmartPointer<vtkPolyData>> extractSurfacesInBlocks( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                                                                       bool computeNormals, const VTKIsoSurface::ActiveBlocks* activeBlocks ) const;
+
 
 protected:
 
+    /**
+     * Reads z-slabs of a volume.
+     */
+    struct SlabReader
+    {
+        /** Number of slices of the whole volume. 0 if the input could not be read. */
+        int nbrOfSlices = 0;
+
+        /**
+         * Reads the slices zStart to zEnd. The returned slab has an extent starting at 0
+         * and its origin is placed at slice zStart of the whole volume. Returns NULL on failure.
+         */
+        std::function<vtkSmartPointer<vtkImageData>( int zStart, int zEnd )> read;
+    };
+
+    /**
+     * Prepares slab-wise reading of a DICOM directory.
+     * @param pathToDicom Path to the DICOM directory.
+     * @return Slab reader.
+     */
+    virtual SlabReader openDicomSlabs( const std::string& pathToDicom );
+
+    /**
+     * Meshes a volume slab by slab and stitches the slab meshes.
+     * @param slabReader Reader of the volume.
+     * @param slabSize Number of slices per slab.
+     * @param threshold Threshold for surface segmentation.
+     * @param useUpperThreshold Use upper threshold.
+     * @param upperThreshold Upper threshold for surface segmentation.
+     * @return Mesh or NULL if a slab could not be read.
+     */
+    vtkSmartPointer<vtkPolyData> meshSlabs( const SlabReader& slabReader, unsigned int slabSize, int threshold,
+                                            bool useUpperThreshold, int upperThreshold );
+
+    /**
+     * Returns true if a volume or region of interest restricts loading.
+     */
+    bool hasVolumeOfInterest() const;
+
+    /**
+     * Restricts an extent to the volume and region of interest, if set.
+     * @param extent Extent of the whole volume. Changed to the volume of interest.
+     * @param origin Position of the voxel at index 0 in mm.
+     * @param spacing Voxel spacing in mm.
+     * @return False if the volume of interest lies outside of the extent.
+     */
+    bool restrictToVolumeOfInterest( int extent[6], const double origin[3], const double spacing[3] ) const;
+
+    /**
+     * Returns the first slice within the volume of interest.
+     * @param nbrOfSlices Number of slices of the whole volume.
+     * @return Slice index, 0 without volume of interest.
+     */
+    size_t getFirstSliceOfInterest( size_t nbrOfSlices ) const;
+
+    /**
+     * Returns the number of slices read from an extent with the preview stride.
+     * @param extent Extent restricted to the volume of interest.
+     * @return Number of sampled slices.
+     */
+    int getNumberOfSampledSlices( const int extent[6] ) const;
+
+    /**
+     * Returns a text distinguishing cache entries of different volumes of interest
+     * and preview strides.
+     * @return Text, empty when loading the whole volume in full resolution.
+     */
+    std::string getLoadOptionsKey() const;
+
+    /**
+     * Crops a loaded volume to the volume of interest and samples it with the preview stride.
+     * @param imageData Whole volume.
+     * @return Volume of interest with extent starting at 0, or NULL if it lies outside of the volume.
+     */
+    vtkSmartPointer<vtkImageData> extractVolumeOfInterest( vtkSmartPointer<vtkImageData> imageData ) const;
+
+    /**
+     * Maps a volume from the cache, if the cache is enabled.
+     * @param cacheKey Key of the volume.
+     * @return Cached volume or NULL.
+     */
+    vtkSmartPointer<vtkImageData> loadFromCache( const std::string& cacheKey ) const;
+
+    /**
+     * Writes a volume to the cache, if the cache is enabled.
+     * @param cacheKey Key of the volume.
+     * @param volume Loaded volume.
+     */
+    void storeInCache( const std::string& cacheKey, vtkImageData* volume ) const;
+
     vtkSmartPointer<vtkCallbackCommand> m_progressCallback;
+    unsigned int m_nbrOfThreads;
+    SurfaceExtractor m_surfaceExtractor;
+    double m_dualContouringTolerance;
+    unsigned int m_labelSmoothingIterations;
+    double m_gaussianSigma;
+    bool m_useEmptySpaceSkipping;
+    VTKMinMaxBlocks m_minMaxBlocks;
+    double m_smallObjectRatio;
+    std::string m_cacheDirectory;
+    std::string m_seriesSelector;
+    bool m_useVolumeOfInterest;
+    std::array<int,6> m_volumeOfInterest;
+    bool m_useRegionOfInterest;
+    std::array<double,6> m_regionOfInterest;
+    unsigned int m_previewStride;
+    unsigned int m_nbrOfIoThreads;
+    unsigned int m_prefetchQueueDepth;
+    ParallelTools::PipelineStatistics m_loadStatistics;
 };
 
 #endif // _vtkDicomRoutines_H_
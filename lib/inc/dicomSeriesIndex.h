@@ -0,0 +1,102 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _dicomSeriesIndex_H_
+#define _dicomSeriesIndex_H_
+
+#include <string>
+#include <vector>
+
+/**
+ * Groups the DICOM files of a directory by series. Only the header of each
+ * file is read, up to the tags of interest and never into the pixel data,
+ * and the files are read in parallel. The index is kept in a sidecar file
+ * within the directory, so rescanning unchanged files is instant.
+ */
+class DicomSeriesIndex
+{
+
+public:
+
+    struct HeaderInfo
+    {
+        std::string patientId;
+        std::string studyInstanceUid;
+        std::string seriesInstanceUid;
+        std::string seriesDescription;
+        std::string modality;
+        int instanceNumber = 0;
+    };
+
+    struct Series
+    {
+        std::string patientId;
+        std::string studyInstanceUid;
+        std::string seriesInstanceUid;
+        std::string seriesDescription;
+        std::string modality;
+        std::vector<std::string> files;
+    };
+
+    /**
+     * Indexes the DICOM files of a directory. Subdirectories are not scanned.
+     * A valid sidecar index is used instead of reading the headers; otherwise
+     * a new sidecar index is written, if the directory is writable.
+     * @param directory DICOM directory.
+     * @param nbrOfThreads Number of threads reading headers.
+     * @return Series ordered by their first file name. The files of a series are ordered by instance number.
+     */
+    static std::vector<Series> indexDirectory( const std::string& directory, unsigned int nbrOfThreads );
+
+    /**
+     * Reads the header of a DICOM file until the series tags are found. The
+     * pixel data is never reached.
+     * @param file Path to the file.
+     * @param info Read header values.
+     * @return True if the file is DICOM and belongs to a series.
+     */
+    static bool readHeader( const std::string& file, HeaderInfo& info );
+
+    /**
+     * Finds a series by an index, a SeriesInstanceUID or a case-insensitive
+     * part of the series description.
+     * @param series Indexed series.
+     * @param selector Series index, UID or description part.
+     * @return Index of the series, or -1 if no or several series match.
+     */
+    static int selectSeries( const std::vector<Series>& series, const std::string& selector );
+
+    /**
+     * Returns the path of the sidecar index of a directory.
+     * @param directory DICOM directory.
+     * @return File path.
+     */
+    static std::string getIndexFilePath( const std::string& directory );
+
+private:
+
+    static bool loadIndex( const std::string& indexFile, const std::string& key, std::vector<Series>& series );
+    static bool storeIndex( const std::string& indexFile, const std::string& key, const std::vector<Series>& series );
+};
+
+#endif // _dicomSeriesIndex_H_
@@ -0,0 +1,78 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkDualContouring_H_
+#define _vtkDualContouring_H_
+
+#include "isoSurface.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkImageData.h>
+#include <vtkAlgorithm.h>
+#include <cstddef>
+
+/**
+ * Adaptive iso surface extraction by dual contouring on an octree. Each cell
+ * the surface crosses gets one vertex, placed by minimizing the quadratic error
+ * to the tangent planes at the edge intersections. Neighbouring cells are merged
+ * bottom-up into coarser cells as long as the surface within them is flat enough
+ * and its topology is kept. Flat regions thereby get few large triangles, curved
+ * regions and thin structures keep the resolution of the voxels. The cells are
+ * classified and their errors computed in parallel. As with marching cubes,
+ * voxels at or above an upper threshold count as lying below the iso value, as
+ * do excluded voxels.
+ */
+class VTKDualContouring
+{
+
+public:
+
+    /**
+     * Numbers of cells of an extraction.
+     */
+    struct Statistics
+    {
+        size_t nbrOfSurfaceCells = 0;   // voxel cells the surface crosses
+        size_t nbrOfLeafCells = 0;      // cells of the octree holding a vertex
+    };
+
+    /**
+     * Extracts the iso surface of a volume.
+     * @param volume Volume with one scalar component.
+     * @param isoRange Iso value, optional upper threshold and excluded voxels.
+     * @param tolerance Allowed root mean square distance in world units between the
+     *                  vertex of a merged cell and the tangent planes within it.
+     *                  0 keeps the resolution of the voxels.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     * @param progressReporter Algorithm firing the progress events, or NULL.
+     * @param activeBlocks Blocks which may hold the surface, or NULL to visit all cells.
+     * @param statistics Set to the numbers of cells, if not NULL.
+     * @return Mesh with point normals. Empty if the volume has no single scalar component.
+     */
+    static vtkSmartPointer<vtkPolyData> extract( vtkImageData* volume, const VTKIsoSurface::IsoRange& isoRange, double tolerance,
+                                                 unsigned int nbrOfThreads, vtkAlgorithm* progressReporter,
+                                                 const VTKIsoSurface::ActiveBlocks* activeBlocks = NULL, Statistics* statistics = NULL );
+};
+
+#endif // _vtkDualContouring_H_
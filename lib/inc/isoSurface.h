@@ -0,0 +1,267 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkIsoSurface_H_
+#define _vtkIsoSurface_H_
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkImageData.h>
+#include <vtkAlgorithm.h>
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <vector>
+
+/**
+ * Marching cubes iso surface extraction with the case table, vertex placement
+ * and normals of vtkMarchingCubes. Instead of a point locator, an edge-indexed
+ * vertex cache lets neighbouring cells share their vertices, which gives the
+ * same welded, watertight mesh without hashing point coordinates. A band
+ * segmentation is applied while the cube cases are computed: voxels at or above
+ * an upper threshold count as lying below the iso value, as do excluded voxels.
+ * Neither a masked volume is created nor is the input volume changed. Several surfaces can be extracted
+ * in one pass over the volume, and blocks of cells no surface crosses can be
+ * skipped.
+ */
+class VTKIsoSurface
+{
+
+public:
+
+    /**
+     * Voxels counting as outside of a surface whatever their value, such as the
+     * voxels of removed components. They are kept as runs [x0, x1) along x,
+     * row j of slice k having index k * dims[1] + j.
+     */
+    struct ExcludedVoxels
+    {
+        std::vector<std::array<int,2>> runs;    // x0 and x1 of each run, sorted by row and x
+        std::vector<size_t> rowStart;           // first run of each row, one entry more than rows
+
+        /**
+         * Tells if a voxel is excluded.
+         * @param row Row index of the voxel.
+         * @param x X index of the voxel.
+         * @return True if the voxel counts as outside.
+         */
+        bool contains( size_t row, int x ) const
+        {
+            auto end = runs.begin() + rowStart[row + 1];
+            auto run = std::upper_bound( runs.begin() + rowStart[row], end, x,
+                                         []( int v, const std::array<int,2>& r ) { return v < r[1]; } );
+            return run != end && ( *run )[0] <= x;
+        }
+
+        /**
+         * Clears the corner bits of the excluded voxels in the case indices of
+         * the cells [begin, end) of a row of cells.
+         * @param rows Row indices of the four voxel rows of the cells.
+         * @param begin First cell.
+         * @param end Cell after the last cell.
+         * @param lowerBits Bit of the corner at the lower x of a cell, for each voxel row.
+         * @param upperBits Bit of the corner at the upper x of a cell, for each voxel row.
+         * @param indices Case indices of the cells, starting at cell begin.
+         */
+        void clearCorners( const size_t rows[4], int begin, int end, const unsigned char lowerBits[4],
+                           const unsigned char upperBits[4], unsigned char* indices ) const
+        {
+            for( int r = 0; r < 4; r++ )
+            {
+                for( size_t run = rowStart[rows[r]]; run < rowStart[rows[r] + 1]; run++ )
+                {
+                    // voxel x is the lower corner of cell x and the upper corner of cell x - 1
+                    const int x0 = runs[run][0];
+                    const int x1 = runs[run][1];
+                    if( x0 > end )
+                        break;
+                    for( int i = std::max( x0, begin ); i < std::min( x1, end ); i++ )
+                        indices[i - begin] &= (unsigned char)~lowerBits[r];
+                    for( int i = std::max( x0 - 1, begin ); i < std::min( x1 - 1, end ); i++ )
+                        indices[i - begin] &= (unsigned char)~upperBits[r];
+                }
+            }
+        }
+
+        /**
+         * Tells if the runs cover all rows of a volume.
+         * @param nbrOfRows Rows of the volume, dims[1] * dims[2].
+         */
+        bool covers( size_t nbrOfRows ) const
+        {
+            return rowStart.size() > nbrOfRows && rowStart[nbrOfRows] <= runs.size();
+        }
+    };
+
+    /**
+     * Iso value of a surface, with an optional upper threshold.
+     */
+    struct IsoRange
+    {
+        int threshold = 0;              // iso value
+        bool useUpperThreshold = false; // voxels at or above the upper threshold count as outside
+        int upperThreshold = 0;
+        std::shared_ptr<const ExcludedVoxels> excludedVoxels; // voxels counting as outside, or none
+    };
+
+    /**
+     * Blocks of cells which may hold a surface. The cells of inactive blocks
+     * are skipped while the cubes are marched.
+     */
+    struct ActiveBlocks
+    {
+        int blockSize = 8;                  // cells per block edge
+        int nbrOfBlocks[3] = { 0, 0, 0 };   // blocks in x, y and z direction
+        std::vector<char> active;           // flag per block, x runs fastest
+        size_t nbrOfSkippedBlocks = 0;
+    };
+
+    /**
+     * Size of the surface of an iso range, counted without creating it.
+     */
+    struct SurfaceSize
+    {
+        size_t nbrOfCells = 0;          // cells the surface crosses
+        size_t nbrOfTriangles = 0;      // triangles of the marching cubes cases of these cells
+        size_t nbrOfInsideVoxels = 0;   // voxels counting as at or above the iso value
+    };
+
+    /**
+     * Value a voxel counts with in a band segmentation. Voxels at or above the
+     * upper threshold count as iso value - 1, as vtkImageThreshold replaces
+     * them. Both values are clamped to the range of the voxel type.
+     */
+    template<class T>
+    class Band
+    {
+    public:
+        Band( int threshold, bool useUpperThreshold, int upperThreshold )
+        {
+            m_masking = useUpperThreshold;
+            m_upperThreshold = static_cast<T>( std::clamp( double(upperThreshold), double(std::numeric_limits<T>::lowest()),
+                                                           double(std::numeric_limits<T>::max()) ) );
+            m_maskValue = double( static_cast<T>( std::clamp( double(threshold - 1), double(std::numeric_limits<T>::lowest()),
+                                                              double(std::numeric_limits<T>::max()) ) ) );
+        }
+
+        double operator()( T value ) const
+        {
+            return ( m_masking && value >= m_upperThreshold ) ? m_maskValue : double(value);
+        }
+
+        /**
+         * Returns the voxel values counting as at or above an iso value:
+         * lower <= voxel < upper.
+         * @param value Iso value.
+         * @param lower Lowest value inside.
+         * @param upper Values at or above are outside. Infinity without upper bound.
+         */
+        void getInsideRange( double value, double& lower, double& upper ) const
+        {
+            // a mask value at or above the iso value only occurs if all voxels are inside anyway
+            lower = value;
+            upper = ( m_masking && m_maskValue < value ) ? double(m_upperThreshold) : std::numeric_limits<double>::infinity();
+        }
+
+        /**
+         * Tells if the iso surface may cross cells whose voxels lie within a
+         * value range. False only if all voxels count as below or all count as
+         * at or above the iso value.
+         * @param minimum Lowest voxel value.
+         * @param maximum Highest voxel value.
+         * @param value Iso value.
+         * @return True if the surface may cross.
+         */
+        bool mayCross( double minimum, double maximum, double value ) const
+        {
+            double lowest = minimum;
+            double highest = maximum;
+            if( m_masking && maximum >= double(m_upperThreshold) )
+            {
+                // the unmasked voxels lie below the upper threshold
+                lowest = std::min( minimum, m_maskValue );
+                highest = minimum < double(m_upperThreshold) ? std::max( double(m_upperThreshold), m_maskValue ) : m_maskValue;
+            }
+            return lowest < value && highest >= value;
+        }
+
+    private:
+        bool m_masking;
+        T m_upperThreshold;
+        double m_maskValue;
+    };
+
+    /**
+     * Extracts the iso surface of a volume. Without upper threshold, the result
+     * equals the output of vtkMarchingCubes. With upper threshold, it equals the
+     * output of vtkMarchingCubes on the volume masked by vtkImageThreshold.
+     * @param volume Volume with one scalar component.
+     * @param threshold Iso value.
+     * @param useUpperThreshold Voxels at or above the upper threshold count as outside.
+     * @param upperThreshold Upper threshold.
+     * @param computeNormals Compute point normals.
+     * @param progressReporter Algorithm firing the progress events, or NULL.
+     * @return Mesh. Empty if the volume has no single scalar component.
+     */
+    static vtkSmartPointer<vtkPolyData> extract( vtkImageData* volume, int threshold, bool useUpperThreshold, int upperThreshold,
+                                                 bool computeNormals, vtkAlgorithm* progressReporter );
+
+    /**
+     * Extracts several iso surfaces in one pass over a volume. The voxels of
+     * each cell are read once and classified for every iso range. Each mesh
+     * equals the mesh extracted for its iso range alone.
+     * @param volume Volume with one scalar component.
+     * @param isoRanges Iso value, optional upper threshold and excluded voxels of each surface.
+     * @param computeNormals Compute point normals.
+     * @param progressReporter Algorithm firing the progress events, or NULL.
+     * @param activeBlocks Blocks which may hold a surface, or NULL to visit all cells.
+     *                     The meshes are the same, only inactive blocks are skipped.
+     * @param firstSlice Slice of the block grid and of the excluded voxels the volume starts at,
+     *                   if it is a view of a larger volume.
+     * @return One mesh per iso range, in the order of the iso ranges.
+     */
+    static std::vector<vtkSmartPointer<vtkPolyData>> extract( vtkImageData* volume, const std::vector<IsoRange>& isoRanges,
+                                                              bool computeNormals, vtkAlgorithm* progressReporter,
+                                                              const ActiveBlocks* activeBlocks = NULL, int firstSlice = 0 );
+
+    /**
+     * Counts the cells and triangles of several iso surfaces without creating
+     * them. The cells are classified as by extract, slice by slice in parallel.
+     * The triangle count is an upper bound of the triangles extract creates: it
+     * drops the triangles collapsing at voxels lying exactly on the iso value,
+     * which are rare. The voxels inside each iso range are counted exactly in the
+     * same pass, those of skipped blocks included.
+     * @param volume Volume with one scalar component.
+     * @param isoRanges Iso value, optional upper threshold and excluded voxels of each surface.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     * @param progressReporter Algorithm firing the progress events, or NULL.
+     * @param activeBlocks Blocks which may hold a surface, or NULL to visit all cells.
+     * @return Size of each surface, in the order of the iso ranges.
+     */
+    static std::vector<SurfaceSize> countTriangles( vtkImageData* volume, const std::vector<IsoRange>& isoRanges,
+                                                    unsigned int nbrOfThreads, vtkAlgorithm* progressReporter,
+                                                    const ActiveBlocks* activeBlocks = NULL );
+};
+
+#endif // _vtkIsoSurface_H_
@@ -0,0 +1,77 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkLabelSurfaces_H_
+#define _vtkLabelSurfaces_H_
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkImageData.h>
+#include <vtkAlgorithm.h>
+#include <map>
+
+/**
+ * Surfaces of the regions of a label volume, extracted by surface nets. Each
+ * voxel holds the integer id of the region it belongs to, 0 being background.
+ * Every cell of 2x2x2 voxels holding different labels gets one vertex, and
+ * every pair of neighbouring voxels with different labels gets a quad joining
+ * the vertices of the four cells around it. The surfaces of all labels are
+ * extracted in one parallel pass over the volume, and the boundary between two
+ * adjacent labels is one shared set of triangles. Voxels outside the volume
+ * count as background, so that the surfaces are closed.
+ */
+class VTKLabelSurfaces
+{
+
+public:
+
+    /**
+     * Name of the cell data array holding the two labels each triangle separates.
+     */
+    static const char* const LabelsArrayName;
+
+    /**
+     * Extracts the surfaces of all labels into one mesh. Each triangle carries the
+     * two labels it separates in the cell data array LabelsArrayName, the higher
+     * label first. The triangles face away from the higher label. The vertices are
+     * relaxed towards their neighbours, but stay within their cell.
+     * @param labels Volume with one integer scalar component.
+     * @param nbrOfSmoothingIterations Number of relaxation steps. 0 keeps the vertices at
+     *                                 the mean of the label changes within their cell.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     * @param progressReporter Algorithm firing the progress events, or NULL.
+     * @return Labelled mesh. Empty if the volume has no single integer scalar component.
+     */
+    static vtkSmartPointer<vtkPolyData> extract( vtkImageData* labels, unsigned int nbrOfSmoothingIterations,
+                                                 unsigned int nbrOfThreads, vtkAlgorithm* progressReporter );
+
+    /**
+     * Splits a labelled mesh into one closed mesh per label. The triangles between
+     * two labels belong to both meshes, facing away from each of them.
+     * @param labelledMesh Mesh created by extract.
+     * @return One mesh per label other than background, by label.
+     */
+    static std::map<int, vtkSmartPointer<vtkPolyData>> splitByLabel( vtkPolyData* labelledMesh );
+};
+
+#endif // _vtkLabelSurfaces_H_
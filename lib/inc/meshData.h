@@ -28,6 +28,9 @@
 #include <vtkPolyData.h>
 #include <vtkVector.h>
 #include <vtkCallbackCommand.h>
+#include "quadricDecimation.h"
+#include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -61,7 +64,9 @@ public:
     void exportAsObjFile( const vtkSmartPointer<vtkPolyData>& mesh, const std::string& path );
 
     /**
-     * Opens a obj file and returns a vtkPolyData mesh.
+     * Opens a obj file and returns a vtkPolyData mesh. Faces with their own
+     * normals make the reader duplicate their vertices, so that coincident
+     * vertices are welded and the face normals dropped.
      * @param pathToObjFile Path to the obj file.
      * @return Resulting 3D mesh.
      */
@@ -88,6 +93,34 @@ public:
      */
     void exportAsPlyFile( const vtkSmartPointer<vtkPolyData>& mesh, const std::string& path );
 
+    /**
+     * Export a progressive mesh in a compact binary format: the base mesh,
+     * followed by the vertex splits which refine it in their order. A reader
+     * can stop after any number of splits and still has a valid mesh.
+     * Little-endian layout:
+     *   header    "D2PM", uint32 version (1), uint32 number of base vertices,
+     *             uint32 number of base triangles, uint32 number of vertex splits
+     *   vertices  float32 x, y, z per base vertex
+     *   triangles uint32 v0, v1, v2 per base triangle
+     *   splits    uint32 vertex, float32 x, y, z of the vertex after the split,
+     *             float32 x, y, z of the new vertex, 2 x uint32 v0, v1, v2 of the
+     *             new triangles, uint32 number of moved triangles, uint32 id of each
+     * @param baseMesh Triangle mesh the vertex splits start from.
+     * @param vertexSplits Vertex splits, coarsest first.
+     * @param path Path to the exported file.
+     */
+    void exportAsProgressiveMeshFile( const vtkSmartPointer<vtkPolyData>& baseMesh,
+                                      const std::vector<VTKQuadricDecimation::VertexSplit>& vertexSplits, const std::string& path );
+
+    /**
+     * Opens a progressive mesh file and refines its base mesh.
+     * @param pathToProgressiveMeshFile Path to the progressive mesh file.
+     * @param maxNbrOfVertexSplits Number of vertex splits to apply at most. By default, all.
+     * @return Resulting 3D mesh, or NULL if the file could not be read.
+     */
+    vtkSmartPointer<vtkPolyData> importProgressiveMeshFile( const std::string& pathToProgressiveMeshFile,
+                                                            size_t maxNbrOfVertexSplits = std::numeric_limits<size_t>::max() );
+
 
     /**
      * Compute the vertex normals of a mesh.
@@ -96,6 +129,12 @@ public:
      */
     static void computeVertexNormalsTrivial( const vtkSmartPointer<vtkPolyData>& mesh, std::vector<vtkVector3d>& normals );
 
+    /**
+     * Merges vertices with identical coordinates, so that faces share them.
+     * @param mesh The mesh, welded at return.
+     */
+    static void weldVertices( vtkSmartPointer<vtkPolyData> mesh );
+
 
 private:
 
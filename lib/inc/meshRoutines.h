@@ -28,6 +28,8 @@
 #include <vtkPolyData.h>
 #include <vtkVector.h>
 #include <vtkCallbackCommand.h>
+#include <vtkAlgorithm.h>
+#include "quadricDecimation.h"
 #include <string>
 #include <vector>
 
@@ -36,6 +38,15 @@ class VTKMeshRoutines
 
 public:
 
+    /**
+     * Algorithms reducing the triangles of a mesh.
+     */
+    enum class Decimator
+    {
+        QuadricDecimation,          // vtkQuadricDecimation on one thread
+        ParallelQuadricDecimation   // quadric edge collapses on spatial partitions in parallel
+    };
+
     VTKMeshRoutines();
     ~VTKMeshRoutines();
 
@@ -45,6 +56,35 @@ public:
      */
     void SetProgressCallback( vtkSmartPointer<vtkCallbackCommand> progressCallback );
 
+    /**
+     * Sets the number of threads used by the parallel decimation.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     */
+    void SetNumberOfThreads( unsigned int nbrOfThreads );
+
+    /**
+     * Returns the number of threads set.
+     * @return Number of threads. 0 stands for one thread per hardware core.
+     */
+    unsigned int GetNumberOfThreads() const;
+
+    /**
+     * Chooses the algorithm reducing the mesh. The parallel quadric decimation
+     * collapses the edges of spatial partitions of the mesh concurrently, with
+     * the vertices at the partition borders locked, and collapses the border
+     * edges afterwards. Its result does not depend on the number of threads.
+     * It needs a mesh of triangles with welded vertices and drops the point data,
+     * otherwise vtkQuadricDecimation is used.
+     * @param decimator Decimation algorithm.
+     */
+    void SetDecimator( Decimator decimator );
+
+    /**
+     * Returns the decimation algorithm set.
+     * @return Decimation algorithm.
+     */
+    Decimator GetDecimator() const;
+
     /**
      * Moves the mesh to center of the coordinate system. In particular,
      * the center of mass is computed and the mesh is translated accordingly.
@@ -60,6 +100,32 @@ public:
      */
     void meshReduction(vtkSmartPointer<vtkPolyData> mesh, double reduction );
 
+    /**
+     * Reduces the size / details of a 3D mesh and records the vertex splits which
+     * refine the reduced mesh back to the input, as a progressive mesh. The record
+     * needs the quadric decimation of this library, which is used regardless of
+     * the decimator set.
+     * @param mesh The input mesh. Holds the reduced base mesh afterwards.
+     * @param reduction Reduction factor. 0.1 is little reduction. 0.9 is strong reduction.
+     * @param vertexSplits Set to the vertex splits, coarsest first.
+     * @return False if the mesh holds cells other than triangles. The mesh is kept then.
+     */
+    bool meshReduction( vtkSmartPointer<vtkPolyData> mesh, double reduction,
+                        std::vector<VTKQuadricDecimation::VertexSplit>& vertexSplits );
+
+    /**
+     * Reduces a mesh to several levels of detail in one run. The levels are
+     * reduced from the finest to the coarsest, each continuing from the one
+     * before instead of from the full mesh. With the parallel quadric decimation,
+     * one decimation runs through all levels and keeps its error quadrics.
+     * @param mesh The input mesh. It is not modified.
+     * @param polygonLimits Maximum number of faces of each level, in any order.
+     * @return One mesh per polygon limit, in the order of the limits. A limit above
+     *         the number of faces of the mesh gives the mesh itself.
+     */
+    std::vector<vtkSmartPointer<vtkPolyData>> meshLevelsOfDetail( vtkSmartPointer<vtkPolyData> mesh,
+                                                                  const std::vector<unsigned long>& polygonLimits );
+
     /**
      * Labels connected regions and removes regions below a certain size.
      * @param mesh The input mesh. Mesh will be modified afterwards.
@@ -79,7 +145,13 @@ public:
 
 private:
 
+    vtkSmartPointer<vtkAlgorithm> createProgressReporter() const;
+    vtkSmartPointer<vtkPolyData> quadricDecimation( vtkPolyData* mesh, double reduction ) const;
+    void printDecimationStatistics( const VTKQuadricDecimation::Statistics& statistics ) const;
+
     vtkSmartPointer<vtkCallbackCommand> m_progressCallback;
+    unsigned int m_nbrOfThreads;
+    Decimator m_decimator;
 };
 
 #endif // _vtkMeshRoutines_H_
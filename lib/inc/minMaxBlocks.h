@@ -0,0 +1,116 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkMinMaxBlocks_H_
+#define _vtkMinMaxBlocks_H_
+
+#include "isoSurface.h"
+
+#include <vtkImageData.h>
+#include <vtkType.h>
+#include <vector>
+
+/**
+ * Lowest and highest voxel value of each block of 8x8x8 cells of a volume.
+ * A block covers the voxels of its cells, so neighbouring blocks share one
+ * layer of voxels. The surface extraction skips the blocks whose value range
+ * no iso range crosses. The ranges do not depend on the iso values, so one
+ * structure serves extractions with any thresholds.
+ */
+class VTKMinMaxBlocks
+{
+
+public:
+
+    static const int BlockSize = 8; // cells per block edge
+
+    VTKMinMaxBlocks();
+    ~VTKMinMaxBlocks();
+
+    /**
+     * Computes the value range of each block of a volume, in parallel.
+     * @param volume Volume with one scalar component and at least two voxels in each direction.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     * @return False if the volume is not supported.
+     */
+    bool build( vtkImageData* volume, unsigned int nbrOfThreads );
+
+    /**
+     * Tells if the structure was built for a volume whose voxels were not modified since.
+     * @param volume Volume.
+     * @return True if the block ranges are valid for the volume.
+     */
+    bool isBuiltFor( vtkImageData* volume ) const;
+
+    /**
+     * Releases the block ranges.
+     */
+    void clear();
+
+    /**
+     * Returns the number of blocks.
+     * @return Number of blocks, 0 if not built.
+     */
+    size_t getNumberOfBlocks() const;
+
+    /**
+     * Returns the lowest voxel value of a block.
+     * @param bx Block index in x direction.
+     * @param by Block index in y direction.
+     * @param bz Block index in z direction.
+     * @return Lowest value.
+     */
+    double getMinimum( int bx, int by, int bz ) const;
+
+    /**
+     * Returns the highest voxel value of a block.
+     * @param bx Block index in x direction.
+     * @param by Block index in y direction.
+     * @param bz Block index in z direction.
+     * @return Highest value.
+     */
+    double getMaximum( int bx, int by, int bz ) const;
+
+    /**
+     * Finds the blocks one of the iso ranges may cross.
+     * @param isoRanges Iso value and optional upper threshold of each surface.
+     * @return Active blocks, for VTKIsoSurface::extract.
+     */
+    VTKIsoSurface::ActiveBlocks findActiveBlocks( const std::vector<VTKIsoSurface::IsoRange>& isoRanges ) const;
+
+private:
+
+    size_t getBlockIndex( int bx, int by, int bz ) const;
+
+    int m_nbrOfBlocks[3];
+    std::vector<double> m_minimum;
+    std::vector<double> m_maximum;
+
+    // identifies the volume the ranges belong to
+    int m_scalarType;
+    int m_dims[3];
+    const void* m_voxels;
+    vtkMTimeType m_voxelsMTime;
+};
+
+#endif // _vtkMinMaxBlocks_H_
@@ -0,0 +1,96 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _parallelTools_H_
+#define _parallelTools_H_
+
+#include <functional>
+#include <cstddef>
+
+class ParallelTools
+{
+
+public:
+
+    /**
+     * Resolves a requested number of threads.
+     * @param requested Requested number of threads. 0 stands for one thread per hardware core.
+     * @return Number of threads to use, at least 1.
+     */
+    static unsigned int resolveNumberOfThreads( unsigned int requested );
+
+    /**
+     * Calls func(i) for every index i in [begin, end) on a set of worker threads.
+     * Indices are handed out one by one, so items of unequal cost are balanced.
+     * The calling thread takes part in the work. An exception thrown by func
+     * stops the loop and is rethrown in the calling thread.
+     * @param begin First index.
+     * @param end One past the last index.
+     * @param nbrOfThreads Number of threads. 0 stands for one thread per hardware core.
+     * @param func Function called once per index. Needs to be thread-safe.
+     * @param progress Optional progress function. It is called from the calling thread only,
+     *                 with the fraction of finished items.
+     */
+    static void parallelFor( size_t begin, size_t end, unsigned int nbrOfThreads,
+                             const std::function<void(size_t)>& func,
+                             const std::function<void(double)>& progress = nullptr );
+
+    /**
+     * Time spent in the phases of a pipeline, summed over all threads of a phase.
+     */
+    struct PipelineStatistics
+    {
+        double wallSeconds = 0.0;          // duration of the whole pipeline
+        double fetchSeconds = 0.0;         // fetch threads busy
+        double processSeconds = 0.0;       // process threads busy
+        double fetchWaitSeconds = 0.0;     // fetch threads waiting for queue space
+        double processWaitSeconds = 0.0;   // process threads waiting for fetched items
+    };
+
+    /**
+     * Runs two stages for every index i in [begin, end): fetch(i) on a set of
+     * fetch threads and process(i) on a set of process threads. The fetch
+     * threads take the indices in increasing order and hand each fetched index
+     * over through a bounded queue, so that fetching runs ahead of processing
+     * by at most queueDepth items. The calling thread is one of the process
+     * threads. An exception thrown by fetch or process stops the pipeline and
+     * is rethrown in the calling thread.
+     * @param begin First index.
+     * @param end One past the last index.
+     * @param nbrOfFetchThreads Number of fetch threads, at least 1.
+     * @param nbrOfProcessThreads Number of process threads. 0 stands for one thread per hardware core.
+     * @param queueDepth Maximum number of fetched items waiting to be processed, at least 1.
+     * @param fetch Function called once per index. Needs to be thread-safe.
+     * @param process Function called once per index after fetch returned. Needs to be thread-safe.
+     * @param progress Optional progress function. It is called from the calling thread only,
+     *                 with the fraction of processed items.
+     * @return Time spent in the phases.
+     */
+    static PipelineStatistics pipelineFor( size_t begin, size_t end, unsigned int nbrOfFetchThreads,
+                                           unsigned int nbrOfProcessThreads, size_t queueDepth,
+                                           const std::function<void(size_t)>& fetch,
+                                           const std::function<void(size_t)>& process,
+                                           const std::function<void(double)>& progress = nullptr );
+};
+
+#endif // _parallelTools_H_
@@ -0,0 +1,190 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkQuadricDecimation_H_
+#define _vtkQuadricDecimation_H_
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <vtkAlgorithm.h>
+#include <vtkType.h>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+/**
+ * Parallel decimation of a triangle mesh by edge collapses ordered by the
+ * quadric error. The mesh is partitioned into slabs along its longest axis,
+ * holding the same number of vertices each. The edges inside each slab are
+ * collapsed concurrently while the vertices at the slab borders are locked,
+ * so that no two threads touch the same triangles. A second parallel round
+ * uses slabs shifted by half their width, which hold the former borders in
+ * their middle, and a final sequential pass collapses the edges still locked
+ * if the target is not reached yet. Collapses
+ * which would make the mesh non-manifold or flip a triangle are skipped, and
+ * the vertices on the border of an open mesh are kept.
+ * The state is kept between reductions, so a mesh can be reduced in steps.
+ */
+class VTKQuadricDecimation
+{
+
+public:
+
+    /**
+     * Numbers of a reduction.
+     */
+    struct Statistics
+    {
+        size_t nbrOfPartitions = 0;
+        size_t nbrOfPartitionCollapses = 0;  // edges collapsed within the partitions
+        size_t nbrOfBorderCollapses = 0;     // edges collapsed by the final border pass
+    };
+
+    /**
+     * Refinement of a progressive mesh, undoing one edge collapse. The new vertex
+     * gets the number of vertices before the split as id, the new triangles the
+     * next two triangle ids.
+     */
+    struct VertexSplit
+    {
+        vtkIdType vertex;                                    // vertex which splits
+        std::array<double,3> position;                       // its position after the split
+        std::array<double,3> newVertexPosition;
+        std::array<std::array<vtkIdType,3>,2> newTriangles;  // corners of the two triangles added
+        std::vector<vtkIdType> movedTriangles;               // triangles whose corner vertex moves to the new vertex
+    };
+
+    VTKQuadricDecimation();
+    ~VTKQuadricDecimation();
+
+    /**
+     * Takes over a triangle mesh and computes the error quadric of each vertex.
+     * @param mesh Mesh with welded vertices.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     * @return False if the mesh holds cells other than triangles.
+     */
+    bool setMesh( vtkPolyData* mesh, unsigned int nbrOfThreads );
+
+    /**
+     * Sets the number of partitions collapsed in parallel. The result does not
+     * depend on the number of threads, only on the partitions.
+     * @param nbrOfPartitions Number of partitions. 0 chooses one per 50000 triangles, at most 256 (default).
+     */
+    void setNumberOfPartitions( unsigned int nbrOfPartitions );
+
+    /**
+     * Returns the current number of triangles.
+     * @return Number of triangles.
+     */
+    size_t getNumberOfTriangles() const;
+
+    /**
+     * Collapses edges until the mesh has at most the given number of triangles,
+     * or no edge can be collapsed anymore.
+     * @param nbrOfTriangles Target number of triangles.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     * @param progressReporter Algorithm firing the progress events, or NULL.
+     * @return Numbers of the reduction.
+     */
+    Statistics reduceTo( size_t nbrOfTriangles, unsigned int nbrOfThreads, vtkAlgorithm* progressReporter );
+
+    /**
+     * Returns the current mesh, without the removed vertices.
+     * @return Triangle mesh without point data.
+     */
+    vtkSmartPointer<vtkPolyData> getMesh() const;
+
+    /**
+     * Records the edge collapses of the following reductions, so that they can
+     * be undone by vertex splits. setMesh clears the record.
+     * @param record True to record the collapses.
+     */
+    void setRecordVertexSplits( bool record );
+
+    /**
+     * Returns the vertex splits undoing the recorded collapses, in the order in
+     * which they refine the mesh of getMesh. Applying all of them gives the mesh
+     * as it was when the recording started, with the vertices renumbered.
+     * @return Vertex splits, coarsest first.
+     */
+    std::vector<VertexSplit> getVertexSplits() const;
+
+    /**
+     * Decimates a triangle mesh.
+     * @param mesh Mesh with welded vertices.
+     * @param reduction Fraction of the triangles to remove, 0.0 - 1.0.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     * @param progressReporter Algorithm firing the progress events, or NULL.
+     * @param statistics Set to the numbers of the reduction, if not NULL.
+     * @return Decimated mesh, or NULL if the mesh holds cells other than triangles.
+     */
+    static vtkSmartPointer<vtkPolyData> decimate( vtkPolyData* mesh, double reduction, unsigned int nbrOfThreads,
+                                                  vtkAlgorithm* progressReporter, Statistics* statistics = NULL );
+
+private:
+
+    /**
+     * Edge collapse as it happened, with the triangle ids of the decimation.
+     */
+    struct CollapseRecord
+    {
+        vtkIdType kept;
+        vtkIdType removed;
+        std::array<double,3> keptPosition;        // position of the kept vertex before the collapse
+        std::array<double,3> removedPosition;
+        std::array<vtkIdType,2> removedTriangles;
+        std::vector<vtkIdType> changedTriangles;  // triangles of the removed vertex, now at the kept one
+    };
+
+    unsigned int partition( unsigned int nbrOfPartitions, bool shifted, unsigned int nbrOfThreads );
+    size_t collapsePartitions( unsigned int nbrOfPartitions, bool shifted, size_t nbrOfTriangles,
+                               unsigned int nbrOfThreads, const std::function<void(double)>& progress );
+    size_t collapseEdges( const std::vector<vtkIdType>& seeds, size_t nbrOfTrianglesToRemove, int partition,
+                          std::vector<CollapseRecord>* records );
+    double computeCollapse( vtkIdType u, vtkIdType v, double position[3] ) const;
+    bool canCollapse( vtkIdType u, vtkIdType v, const double position[3] ) const;
+    size_t collapse( vtkIdType u, vtkIdType v, const double position[3], CollapseRecord* record );
+    bool isCollapsible( vtkIdType u, vtkIdType v, int partition ) const;
+    std::vector<vtkIdType> numberVertices( vtkIdType& nbrOfVertices ) const;
+
+    std::vector<std::array<double,3>> m_positions;
+    std::vector<std::array<double,10>> m_quadrics;          // symmetric 4x4 error quadric per vertex
+    std::vector<std::array<vtkIdType,3>> m_triangles;
+    std::vector<char> m_triangleAlive;
+    std::vector<std::vector<vtkIdType>> m_vertexTriangles;  // triangles around each vertex
+    std::vector<char> m_vertexAlive;
+    std::vector<char> m_onMeshBorder;                       // vertices on an open or non-manifold edge, never moved
+    std::vector<unsigned int> m_versions;                   // changes of each vertex, invalidates queued edges
+    std::vector<int> m_vertexPartition;
+    std::vector<char> m_locked;                             // vertices at a partition border
+    std::vector<double> m_cuts;                             // partition borders along the cut axis
+    int m_cutAxis;
+    size_t m_nbrOfTriangles;
+    unsigned int m_nbrOfPartitions;
+    int m_pointDataType;
+    bool m_recordCollapses;
+    std::vector<CollapseRecord> m_collapses;                // recorded collapses, in their order
+};
+
+#endif // _vtkQuadricDecimation_H_
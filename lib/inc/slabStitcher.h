@@ -0,0 +1,68 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkSlabStitcher_H_
+#define _vtkSlabStitcher_H_
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+#include <unordered_map>
+#include <cstdint>
+
+/**
+ * Joins the meshes of consecutive z-slabs of a volume into one mesh.
+ * Neighbouring slabs share one slice, so both slab meshes carry the
+ * vertices lying on that slice. Those vertices have the same x and y
+ * coordinates in both meshes and are merged, which leaves neither
+ * cracks nor duplicated vertices at the seams.
+ */
+class VTKSlabStitcher
+{
+
+public:
+
+    VTKSlabStitcher();
+    ~VTKSlabStitcher();
+
+    /**
+     * Appends the mesh of the next slab. Vertices on the lower seam plane
+     * are merged with the vertices the previous slab left on that plane.
+     * @param slabMesh Triangle mesh of the slab.
+     * @param lowerSeamZ z coordinate of the slice shared with the previous slab.
+     * @param upperSeamZ z coordinate of the slice shared with the next slab.
+     */
+    void appendSlab( vtkPolyData* slabMesh, double lowerSeamZ, double upperSeamZ );
+
+    /**
+     * Returns the stitched mesh.
+     * @return Mesh.
+     */
+    vtkSmartPointer<vtkPolyData> getMesh() const;
+
+private:
+
+    vtkSmartPointer<vtkPolyData> m_mesh;
+    std::unordered_map<uint64_t, vtkIdType> m_upperSeamVertices;
+};
+
+#endif // _vtkSlabStitcher_H_
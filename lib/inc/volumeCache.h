@@ -0,0 +1,92 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkVolumeCache_H_
+#define _vtkVolumeCache_H_
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <string>
+#include <vector>
+
+/**
+ * Persistent on-disk cache of loaded volumes. Each entry is a single file
+ * holding a small header (type, extent, spacing, origin) followed by the
+ * raw voxels at a page aligned offset. Cached volumes are memory-mapped,
+ * so the voxels are paged in on first access instead of being read upfront.
+ */
+class VTKVolumeCache
+{
+
+public:
+
+    /**
+     * @param cacheDirectory Directory of the cache files. It is created if needed.
+     */
+    VTKVolumeCache( const std::string& cacheDirectory );
+    ~VTKVolumeCache();
+
+    /**
+     * Computes the cache key of a volume. The key is a hash over the names,
+     * sizes and modification times of the input files.
+     * @param files Input files of the volume.
+     * @param variant Additional text distinguishing volumes loaded from the same files.
+     * @return Key as hex string.
+     */
+    static std::string computeKey( const std::vector<std::string>& files, const std::string& variant );
+
+    /**
+     * Lists the regular files in a directory, sorted by name.
+     * @param directory Path to directory.
+     * @return File paths.
+     */
+    static std::vector<std::string> listFiles( const std::string& directory );
+
+    /**
+     * Maps a cached volume into memory.
+     * @param key Cache key.
+     * @return Volume, or NULL if there is no valid entry for the key.
+     */
+    vtkSmartPointer<vtkImageData> load( const std::string& key ) const;
+
+    /**
+     * Writes a volume to the cache.
+     * @param key Cache key.
+     * @param volume Volume to store.
+     * @return True if stored.
+     */
+    bool store( const std::string& key, vtkImageData* volume ) const;
+
+    /**
+     * Returns the path of the cache file of a key.
+     * @param key Cache key.
+     * @return File path.
+     */
+    std::string getCacheFilePath( const std::string& key ) const;
+
+private:
+
+    std::string m_cacheDirectory;
+};
+
+#endif // _vtkVolumeCache_H_
@@ -0,0 +1,78 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkVolumeHistogram_H_
+#define _vtkVolumeHistogram_H_
+
+#include <vtkImageData.h>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Histogram of the voxel values of a volume. The value range and the bins
+ * are computed in two parallel passes over the volume, each thread counting
+ * into its own bins which are summed at the end.
+ */
+class VTKVolumeHistogram
+{
+
+public:
+
+    /**
+     * Bins of equal width from the lowest to the highest voxel value.
+     */
+    struct Histogram
+    {
+        double minimum = 0.0;       // lowest voxel value
+        double maximum = 0.0;       // highest voxel value
+        double binWidth = 1.0;      // bin b holds the values minimum + b * binWidth up to the next bin
+        std::vector<size_t> counts; // number of voxels per bin
+        size_t nbrOfVoxels = 0;
+
+        /**
+         * Returns the lowest value of a bin.
+         * @param bin Bin index.
+         * @return Lowest value counted in the bin.
+         */
+        double getBinStart( size_t bin ) const;
+
+        /**
+         * Returns the number of voxels at or above a value, to the precision of the bins.
+         * @param value Voxel value.
+         * @return Number of voxels in the bins starting at or above the value.
+         */
+        size_t countFrom( double value ) const;
+    };
+
+    /**
+     * Computes the histogram of a volume. Integer volumes get bins of an integer
+     * width, so that each value falls into one bin. NaN voxels are not counted.
+     * @param volume Volume with one scalar component.
+     * @param nbrOfBins Maximum number of bins.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     * @return Histogram. Without bins if the volume has no single scalar component.
+     */
+    static Histogram compute( vtkImageData* volume, unsigned int nbrOfBins, unsigned int nbrOfThreads );
+};
+
+#endif // _vtkVolumeHistogram_H_
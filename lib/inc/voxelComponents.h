@@ -0,0 +1,79 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#ifndef _vtkVoxelComponents_H_
+#define _vtkVoxelComponents_H_
+
+#include "isoSurface.h"
+
+#include <vtkSmartPointer.h>
+#include <vtkImageData.h>
+#include <cstddef>
+#include <memory>
+
+/**
+ * Connected components of the voxels inside an iso range. The voxels are
+ * grouped into runs along x, and the runs of z-slabs of the volume are joined
+ * by union-find in parallel before the slabs are joined at their borders.
+ * Voxels are connected if they share a face, an edge or a corner, which
+ * are the voxels of a common marching cubes cell.
+ */
+class VTKVoxelComponents
+{
+
+public:
+
+    /**
+     * Result of a component filtering.
+     */
+    struct Statistics
+    {
+        size_t nbrOfComponents = 0;
+        size_t nbrOfRemovedComponents = 0;
+        size_t biggestComponentSize = 0;   // number of voxels
+        size_t nbrOfRemovedVoxels = 0;
+    };
+
+    /**
+     * Finds the small connected components of the voxels inside an iso range,
+     * so that they are not meshed. A component is kept if it has more than ratio
+     * times the voxels of the biggest component. The voxels of the removed
+     * components are returned as excluded voxels of the iso range instead of
+     * being cleared in a copy of the volume. No cell holds voxels of a kept and
+     * of a removed component, and the gradient normals are computed from the
+     * voxels of the volume, so the surfaces of the kept components do not change,
+     * their normals included.
+     * @param volume Volume with one scalar component.
+     * @param isoRange Iso value and optional upper threshold.
+     * @param ratio Size ratio 0.0 - 1.0.
+     * @param nbrOfThreads Number of threads. 0 uses one thread per hardware core.
+     * @param statistics Set to the number of components and removed voxels.
+     * @return Voxels of the removed components, no runs if none was removed. NULL on error.
+     */
+    static std::shared_ptr<const VTKIsoSurface::ExcludedVoxels> findSmallComponents( vtkImageData* volume,
+                                                                                     const VTKIsoSurface::IsoRange& isoRange,
+                                                                                     double ratio, unsigned int nbrOfThreads,
+                                                                                     Statistics& statistics );
+};
+
+#endif // _vtkVoxelComponents_H_
@@ -25,6 +25,11 @@
 #define _vtkDicomRoutinesExtended_H_
 
 #include "dicomRoutines.h"
+#include "dicomSeriesIndex.h"
+
+#include <vtkStringArray.h>
+
+class vtkDICOMReader;
 
 class VTKDicomRoutinesExtended: public VTKDicomRoutines
 {
@@ -37,10 +42,61 @@ public:
     /**
      * Loads the DICOM images within a directory by using the vtk-dicom library.
      * This library allows to read more Dicom formats than the standard vtk implementationl
+     * The series are indexed by reading the file headers in parallel. The frames
+     * of a multi-frame file are decoded in parallel if more than one thread is set.
      * @param pathToDicom Path to the DICOM directory.
      * @return DICOM image data.
      */
     vtkSmartPointer<vtkImageData> loadDicomImage( const std::string& pathToDicom ) override;
+
+protected:
+
+    /**
+     * Prepares slab-wise reading of the chosen DICOM series. The slabs are
+     * read by requesting z update extents from vtkDICOMReader.
+     * @param pathToDicom Path to the DICOM directory.
+     * @return Slab reader.
+     */
+    SlabReader openDicomSlabs( const std::string& pathToDicom ) override;
+
+private:
+
+    /**
+     * Scans a directory for DICOM series with vtkDICOMDirectory.
+     * @param pathToDicom Path to the DICOM directory.
+     * @return Series.
+     */
+    std::vector<DicomSeriesIndex::Series> scanDicomDirectory( const std::string& pathToDicom );
+
+    /**
+     * Indexes the DICOM series of a directory. The series set by SetSeriesSelector
+     * is chosen. Without selector and multiple series, the user is asked which one to load.
+     * @param pathToDicom Path to the DICOM directory.
+     * @return Files of the chosen series, or NULL.
+     */
+    vtkSmartPointer<vtkStringArray> selectSeriesFiles( const std::string& pathToDicom );
+
+    /**
+     * Restricts an extent of the reader to the volume and region of interest,
+     * placed by the origin and spacing of the reader output.
+     * @param reader Reader with updated information.
+     * @param extent Whole extent of the reader. Changed to the volume of interest.
+     * @return False if the volume of interest lies outside of the extent.
+     */
+    bool restrictToVolume( vtkDICOMReader* reader, int extent[6] ) const;
+
+    /**
+     * Decodes the frames of a multi-frame file on a pool of threads, each frame
+     * straight into its slice of the volume. Encapsulated frames are decoded by
+     * the codecs of vtk-dicom. Only MONOCHROME2 frames which use all allocated
+     * bits are decoded, so the result equals the output of the reader.
+     * @param reader Reader of the file with updated information.
+     * @param file Path to the multi-frame file.
+     * @param extent Extent of the volume to read, within the whole extent.
+     * @return Volume with extent starting at 0 and origin at the first voxel read,
+     *         or NULL if the frames cannot be decoded independently.
+     */
+    vtkSmartPointer<vtkImageData> decodeFramesInParallel( vtkDICOMReader* reader, const std::string& file, const int extent[6] );
 };
 
 #endif // _vtkDicomRoutinesExtended_H_
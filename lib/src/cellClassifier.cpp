@@ -0,0 +1,284 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "cellClassifier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define D2M_X86_SIMD
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// the SIMD functions are compiled for their instruction set only, the caller checks the processor
+#if defined(D2M_X86_SIMD) && defined(__GNUC__)
+#define D2M_TARGET_SSE2 __attribute__((target("sse2")))
+#define D2M_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define D2M_TARGET_SSE2
+#define D2M_TARGET_AVX2
+#endif
+
+namespace
+{
+    /**
+     * Inside range of the voxels, shifted to signed 16 bit: lower <= v < upper.
+     */
+    struct Bounds
+    {
+        bool noneInside;
+        int16_t lower;
+        bool useUpper;
+        int16_t upper;
+    };
+
+    template<class T>
+    Bounds toBounds( double lower, double upper )
+    {
+        // unsigned voxels are compared as signed ones after flipping the sign bit
+        const long long minValue = std::numeric_limits<T>::lowest();
+        const long long maxValue = std::numeric_limits<T>::max();
+        const long long offset = std::is_signed<T>::value ? 0 : 32768;
+
+        const long long first = lower <= double(minValue) ? minValue : ( lower > double(maxValue) ? maxValue + 1 : (long long)std::ceil( lower ) );
+        const long long end = upper > double(maxValue) ? maxValue + 1 : ( upper <= double(minValue) ? minValue : (long long)std::ceil( upper ) );
+
+        Bounds bounds;
+        bounds.noneInside = first >= end;
+        bounds.lower = int16_t( std::min( first, maxValue ) - offset );
+        bounds.useUpper = end <= maxValue;
+        bounds.upper = int16_t( std::min( end, maxValue ) - offset );
+        return bounds;
+    }
+
+    void cubeIndicesPortable( const int16_t* const rows[4], size_t first, size_t nbrOfCells, uint16_t flip,
+                              const Bounds& bounds, unsigned char* indices )
+    {
+        // without upper bound, every voxel lies below the largest int32
+        const int lower = bounds.lower;
+        const int upper = bounds.useUpper ? int(bounds.upper) : std::numeric_limits<int>::max();
+        auto inside = [flip, lower, upper]( int16_t voxel ) -> int
+        {
+            const int v = int16_t( uint16_t(voxel) ^ flip );
+            return int( v >= lower ) & int( v < upper );
+        };
+
+        const int16_t* r0 = rows[0];
+        const int16_t* r1 = rows[1];
+        const int16_t* r2 = rows[2];
+        const int16_t* r3 = rows[3];
+        for( size_t i = first; i < nbrOfCells; i++ )
+        {
+            indices[i] = (unsigned char)( inside( r0[i] ) | ( inside( r0[i + 1] ) << 1 ) | ( inside( r1[i + 1] ) << 2 ) | ( inside( r1[i] ) << 3 ) |
+                                          ( inside( r2[i] ) << 4 ) | ( inside( r2[i + 1] ) << 5 ) | ( inside( r3[i + 1] ) << 6 ) | ( inside( r3[i] ) << 7 ) );
+        }
+    }
+
+#ifdef D2M_X86_SIMD
+    D2M_TARGET_SSE2 inline __m128i insideSSE2( const int16_t* voxels, __m128i flip, __m128i lower, __m128i upper, __m128i noUpper, __m128i bit )
+    {
+        const __m128i v = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( voxels ) ), flip );
+        const __m128i belowUpper = _mm_or_si128( _mm_cmpgt_epi16( upper, v ), noUpper );
+        return _mm_and_si128( _mm_andnot_si128( _mm_cmpgt_epi16( lower, v ), belowUpper ), bit );
+    }
+
+    D2M_TARGET_SSE2 size_t cubeIndicesSSE2( const int16_t* const rows[4], size_t nbrOfCells, uint16_t flip,
+                                            const Bounds& bounds, unsigned char* indices )
+    {
+        const __m128i f = _mm_set1_epi16( int16_t(flip) );
+        const __m128i lower = _mm_set1_epi16( bounds.lower );
+        const __m128i upper = _mm_set1_epi16( bounds.upper );
+        const __m128i noUpper = _mm_set1_epi16( bounds.useUpper ? 0 : -1 );
+
+        size_t i = 0;
+        for( ; i + 8 <= nbrOfCells; i += 8 )
+        {
+            __m128i index = insideSSE2( rows[0] + i, f, lower, upper, noUpper, _mm_set1_epi16( 1 ) );
+            index = _mm_or_si128( index, insideSSE2( rows[0] + i + 1, f, lower, upper, noUpper, _mm_set1_epi16( 2 ) ) );
+            index = _mm_or_si128( index, insideSSE2( rows[1] + i + 1, f, lower, upper, noUpper, _mm_set1_epi16( 4 ) ) );
+            index = _mm_or_si128( index, insideSSE2( rows[1] + i, f, lower, upper, noUpper, _mm_set1_epi16( 8 ) ) );
+            index = _mm_or_si128( index, insideSSE2( rows[2] + i, f, lower, upper, noUpper, _mm_set1_epi16( 16 ) ) );
+            index = _mm_or_si128( index, insideSSE2( rows[2] + i + 1, f, lower, upper, noUpper, _mm_set1_epi16( 32 ) ) );
+            index = _mm_or_si128( index, insideSSE2( rows[3] + i + 1, f, lower, upper, noUpper, _mm_set1_epi16( 64 ) ) );
+            index = _mm_or_si128( index, insideSSE2( rows[3] + i, f, lower, upper, noUpper, _mm_set1_epi16( 128 ) ) );
+            _mm_storel_epi64( reinterpret_cast<__m128i*>( indices + i ), _mm_packus_epi16( index, index ) );
+        }
+        return i;
+    }
+
+    D2M_TARGET_AVX2 inline __m256i insideAVX2( const int16_t* voxels, __m256i flip, __m256i lower, __m256i upper, __m256i noUpper, __m256i bit )
+    {
+        const __m256i v = _mm256_xor_si256( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( voxels ) ), flip );
+        const __m256i belowUpper = _mm256_or_si256( _mm256_cmpgt_epi16( upper, v ), noUpper );
+        return _mm256_and_si256( _mm256_andnot_si256( _mm256_cmpgt_epi16( lower, v ), belowUpper ), bit );
+    }
+
+    D2M_TARGET_AVX2 size_t cubeIndicesAVX2( const int16_t* const rows[4], size_t nbrOfCells, uint16_t flip,
+                                            const Bounds& bounds, unsigned char* indices )
+    {
+        const __m256i f = _mm256_set1_epi16( int16_t(flip) );
+        const __m256i lower = _mm256_set1_epi16( bounds.lower );
+        const __m256i upper = _mm256_set1_epi16( bounds.upper );
+        const __m256i noUpper = _mm256_set1_epi16( bounds.useUpper ? 0 : -1 );
+
+        size_t i = 0;
+        for( ; i + 16 <= nbrOfCells; i += 16 )
+        {
+            __m256i index = insideAVX2( rows[0] + i, f, lower, upper, noUpper, _mm256_set1_epi16( 1 ) );
+            index = _mm256_or_si256( index, insideAVX2( rows[0] + i + 1, f, lower, upper, noUpper, _mm256_set1_epi16( 2 ) ) );
+            index = _mm256_or_si256( index, insideAVX2( rows[1] + i + 1, f, lower, upper, noUpper, _mm256_set1_epi16( 4 ) ) );
+            index = _mm256_or_si256( index, insideAVX2( rows[1] + i, f, lower, upper, noUpper, _mm256_set1_epi16( 8 ) ) );
+            index = _mm256_or_si256( index, insideAVX2( rows[2] + i, f, lower, upper, noUpper, _mm256_set1_epi16( 16 ) ) );
+            index = _mm256_or_si256( index, insideAVX2( rows[2] + i + 1, f, lower, upper, noUpper, _mm256_set1_epi16( 32 ) ) );
+            index = _mm256_or_si256( index, insideAVX2( rows[3] + i + 1, f, lower, upper, noUpper, _mm256_set1_epi16( 64 ) ) );
+            index = _mm256_or_si256( index, insideAVX2( rows[3] + i, f, lower, upper, noUpper, _mm256_set1_epi16( 128 ) ) );
+
+            // the packing works per 128 bit lane, the permutation joins the low halves of both lanes
+            const __m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi16( index, index ), 0x08 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( indices + i ), _mm256_castsi256_si128( packed ) );
+        }
+        return i;
+    }
+#endif
+
+    VTKCellClassifier::InstructionSet detectInstructionSet()
+    {
+#ifdef D2M_X86_SIMD
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid( info, 0 );
+        const int maxLeaf = info[0];
+        __cpuid( info, 1 );
+        const bool sse2 = ( info[3] & ( 1 << 26 ) ) != 0;
+        const bool osAvx = ( info[2] & ( 1 << 27 ) ) != 0 && ( info[2] & ( 1 << 28 ) ) != 0 && ( _xgetbv( 0 ) & 6 ) == 6;
+        bool avx2 = false;
+        if( maxLeaf >= 7 && osAvx )
+        {
+            __cpuidex( info, 7, 0 );
+            avx2 = ( info[1] & ( 1 << 5 ) ) != 0;
+        }
+#else
+        __builtin_cpu_init();
+        const bool sse2 = __builtin_cpu_supports( "sse2" );
+        const bool avx2 = __builtin_cpu_supports( "avx2" );
+#endif
+        if( avx2 )
+            return VTKCellClassifier::InstructionSet::AVX2;
+        if( sse2 )
+            return VTKCellClassifier::InstructionSet::SSE2;
+#endif
+        return VTKCellClassifier::InstructionSet::Portable;
+    }
+
+    std::atomic<VTKCellClassifier::InstructionSet>& currentInstructionSet()
+    {
+        static std::atomic<VTKCellClassifier::InstructionSet> instructionSet( VTKCellClassifier::getSupportedInstructionSet() );
+        return instructionSet;
+    }
+
+    template<class T>
+    void computeIndices( const T* const rows[4], size_t nbrOfCells, double lower, double upper, unsigned char* indices )
+    {
+        const Bounds bounds = toBounds<T>( lower, upper );
+        if( bounds.noneInside )
+        {
+            std::memset( indices, 0, nbrOfCells );
+            return;
+        }
+
+        const uint16_t flip = std::is_signed<T>::value ? 0 : 0x8000;
+        const int16_t* signedRows[4];
+        for( int r = 0; r < 4; r++ )
+            signedRows[r] = reinterpret_cast<const int16_t*>( rows[r] );
+
+        size_t done = 0;
+#ifdef D2M_X86_SIMD
+        switch( currentInstructionSet().load() )
+        {
+            case VTKCellClassifier::InstructionSet::AVX2:
+                done = cubeIndicesAVX2( signedRows, nbrOfCells, flip, bounds, indices );
+                break;
+            case VTKCellClassifier::InstructionSet::SSE2:
+                done = cubeIndicesSSE2( signedRows, nbrOfCells, flip, bounds, indices );
+                break;
+            default:
+                break;
+        }
+#endif
+        // the cells left over by the SIMD steps
+        cubeIndicesPortable( signedRows, done, nbrOfCells, flip, bounds, indices );
+    }
+}
+
+VTKCellClassifier::InstructionSet VTKCellClassifier::getSupportedInstructionSet()
+{
+    static const InstructionSet supported = detectInstructionSet();
+    return supported;
+}
+
+VTKCellClassifier::InstructionSet VTKCellClassifier::getInstructionSet()
+{
+    return currentInstructionSet().load();
+}
+
+VTKCellClassifier::InstructionSet VTKCellClassifier::setInstructionSet( InstructionSet instructionSet )
+{
+    if( int(instructionSet) > int(getSupportedInstructionSet()) )
+        instructionSet = getSupportedInstructionSet();
+    currentInstructionSet().store( instructionSet );
+    return instructionSet;
+}
+
+std::string VTKCellClassifier::getName( InstructionSet instructionSet )
+{
+    switch( instructionSet )
+    {
+        case InstructionSet::AVX2:
+            return "AVX2";
+        case InstructionSet::SSE2:
+            return "SSE2";
+        default:
+            return "portable";
+    }
+}
+
+void VTKCellClassifier::computeCubeIndices( const short* const rows[4], size_t nbrOfCells, double lower, double upper,
+                                            unsigned char* indices )
+{
+    computeIndices( rows, nbrOfCells, lower, upper, indices );
+}
+
+void VTKCellClassifier::computeCubeIndices( const unsigned short* const rows[4], size_t nbrOfCells, double lower, double upper,
+                                            unsigned char* indices )
+{
+    computeIndices( rows, nbrOfCells, lower, upper, indices );
+}
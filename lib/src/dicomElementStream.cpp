@@ -0,0 +1,262 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "dicomElementStream.h"
+
+#include <cstring>
+#include <cctype>
+
+namespace
+{
+    const uint32_t MAX_STRING_LENGTH = 1024;
+
+    uint16_t readU16( const unsigned char* b, bool bigEndian )
+    {
+        return bigEndian ? uint16_t( (b[0] << 8) | b[1] ) : uint16_t( b[0] | (b[1] << 8) );
+    }
+
+    uint32_t readU32( const unsigned char* b, bool bigEndian )
+    {
+        return bigEndian ? ( uint32_t(b[0]) << 24 ) | ( uint32_t(b[1]) << 16 ) | ( uint32_t(b[2]) << 8 ) | uint32_t(b[3])
+                         : uint32_t(b[0]) | ( uint32_t(b[1]) << 8 ) | ( uint32_t(b[2]) << 16 ) | ( uint32_t(b[3]) << 24 );
+    }
+
+    // explicit VRs with a reserved field and a 32 bit length
+    bool hasLongLength( const char vr[2] )
+    {
+        static const char* longVrs[] = { "OB", "OD", "OF", "OL", "OV", "OW", "SQ", "SV", "UC", "UN", "UR", "UT", "UV" };
+        for( const char* longVr : longVrs )
+        {
+            if( vr[0] == longVr[0] && vr[1] == longVr[1] )
+                return true;
+        }
+        return false;
+    }
+}
+
+DicomElementStream::DicomElementStream( std::istream& in ) : m_in( in ), m_explicitVr( true ), m_bigEndian( false )
+{
+}
+
+bool DicomElementStream::open()
+{
+    m_explicitVr = true;
+    m_bigEndian = false;
+    m_transferSyntax.clear();
+
+    char preamble[132];
+    if( m_in.read( preamble, 132 ) && std::memcmp( preamble + 128, "DICM", 4 ) == 0 )
+    {
+        // file meta information is always explicit VR little endian
+        while( true )
+        {
+            std::streampos elementStart = m_in.tellg();
+            ElementHeader header;
+            if( !readElementHeader( true, header ) )
+                return false;
+
+            if( header.group != 0x0002 )
+            {
+                m_in.seekg( elementStart );
+                break;
+            }
+
+            bool read = header.element == 0x0010 ? readString( header.length, m_transferSyntax )
+                                                  : skipBytes( header.length );
+            if( !read )
+                return false;
+        }
+
+        if( m_transferSyntax == "1.2.840.10008.1.2" )
+            m_explicitVr = false;
+        else if( m_transferSyntax == "1.2.840.10008.1.2.2" )
+            m_bigEndian = true;
+        else if( m_transferSyntax == "1.2.840.10008.1.2.1.99" )
+            return false; // deflated data set
+    }
+    else
+    {
+        // raw data set without preamble: guess the encoding from the first element
+        m_in.clear();
+        m_in.seekg( 0 );
+        char start[6];
+        if( !m_in.read( start, 6 ) )
+            return false;
+        m_explicitVr = std::isupper( static_cast<unsigned char>(start[4]) ) && std::isupper( static_cast<unsigned char>(start[5]) );
+        m_in.seekg( 0 );
+    }
+
+    return true;
+}
+
+const std::string& DicomElementStream::getTransferSyntax() const
+{
+    return m_transferSyntax;
+}
+
+bool DicomElementStream::isExplicitVr() const
+{
+    return m_explicitVr;
+}
+
+bool DicomElementStream::isBigEndian() const
+{
+    return m_bigEndian;
+}
+
+uint16_t DicomElementStream::toU16( const unsigned char* bytes ) const
+{
+    return readU16( bytes, m_bigEndian );
+}
+
+uint32_t DicomElementStream::toU32( const unsigned char* bytes ) const
+{
+    return readU32( bytes, m_bigEndian );
+}
+
+bool DicomElementStream::readElementHeader( ElementHeader& header )
+{
+    return readElementHeader( m_explicitVr, header );
+}
+
+bool DicomElementStream::readElementHeader( bool explicitVr, ElementHeader& header )
+{
+    // the file meta information is read before big endian is detected
+    const bool bigEndian = m_bigEndian;
+
+    unsigned char b[4];
+    if( !m_in.read( reinterpret_cast<char*>(b), 4 ) )
+        return false;
+    header.group = readU16( b, bigEndian );
+    header.element = readU16( b + 2, bigEndian );
+    header.vr[0] = header.vr[1] = ' ';
+
+    // items and delimiters have no VR
+    if( explicitVr && header.group != 0xFFFE )
+    {
+        if( !m_in.read( header.vr, 2 ) )
+            return false;
+
+        if( hasLongLength( header.vr ) )
+        {
+            if( !m_in.read( reinterpret_cast<char*>(b), 2 ) || !m_in.read( reinterpret_cast<char*>(b), 4 ) )
+                return false;
+            header.length = readU32( b, bigEndian );
+        }
+        else
+        {
+            if( !m_in.read( reinterpret_cast<char*>(b), 2 ) )
+                return false;
+            header.length = readU16( b, bigEndian );
+        }
+    }
+    else
+    {
+        if( !m_in.read( reinterpret_cast<char*>(b), 4 ) )
+            return false;
+        header.length = readU32( b, bigEndian );
+    }
+
+    return true;
+}
+
+bool DicomElementStream::skipValue( const ElementHeader& header )
+{
+    if( header.length != UNDEFINED_LENGTH )
+        return skipBytes( header.length );
+
+    // undefined length UN values are encoded as implicit VR
+    bool unknown = m_explicitVr && header.vr[0] == 'U' && header.vr[1] == 'N';
+    return skipUndefinedLength( m_explicitVr && !unknown, 0 );
+}
+
+bool DicomElementStream::skipBytes( uint32_t length )
+{
+    m_in.seekg( std::streamoff(length), std::ios::cur );
+    return bool(m_in);
+}
+
+bool DicomElementStream::readString( uint32_t length, std::string& value )
+{
+    if( length > MAX_STRING_LENGTH )
+        return skipBytes( length );
+
+    value.assign( length, '\0' );
+    if( length > 0 && !m_in.read( &value[0], length ) )
+        return false;
+
+    // values are padded with spaces or zeros
+    size_t end = value.find_last_not_of( std::string(" \0", 2) );
+    size_t begin = value.find_first_not_of( ' ' );
+    value = ( end == std::string::npos || begin == std::string::npos ) ? "" : value.substr( begin, end - begin + 1 );
+    return true;
+}
+
+bool DicomElementStream::readUnsigned( uint32_t length, uint32_t& value )
+{
+    unsigned char b[4];
+    if( ( length != 2 && length != 4 ) || !m_in.read( reinterpret_cast<char*>(b), length ) )
+        return false;
+
+    value = length == 2 ? toU16( b ) : toU32( b );
+    return true;
+}
+
+// skips the elements of an item with undefined length up to the item delimiter
+bool DicomElementStream::skipItemElements( bool explicitVr, int depth )
+{
+    ElementHeader header;
+    while( readElementHeader( explicitVr, header ) )
+    {
+        if( header.group == 0xFFFE && header.element == 0xE00D )
+            return true;
+
+        bool skipped = header.length == UNDEFINED_LENGTH ? skipUndefinedLength( explicitVr, depth + 1 )
+                                                         : skipBytes( header.length );
+        if( !skipped )
+            return false;
+    }
+    return false;
+}
+
+// skips a sequence or encapsulated value with undefined length up to the sequence delimiter
+bool DicomElementStream::skipUndefinedLength( bool explicitVr, int depth )
+{
+    if( depth > 32 )
+        return false;
+
+    ElementHeader header;
+    while( readElementHeader( explicitVr, header ) )
+    {
+        if( header.group != 0xFFFE )
+            return false;
+        if( header.element == 0xE0DD )
+            return true;
+
+        bool skipped = header.length == UNDEFINED_LENGTH ? skipItemElements( explicitVr, depth )
+                                                         : skipBytes( header.length );
+        if( !skipped )
+            return false;
+    }
+    return false;
+}
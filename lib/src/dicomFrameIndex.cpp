@@ -0,0 +1,184 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "dicomFrameIndex.h"
+#include "dicomElementStream.h"
+
+#include <fstream>
+#include <algorithm>
+
+namespace
+{
+    const uint32_t TAG_PIXEL_DATA = 0x7FE00010;
+
+    /**
+     * Reads the items of an encapsulated pixel data value up to the sequence delimiter.
+     * @param stream Element stream positioned at the first item.
+     * @param in Underlying stream.
+     * @param offsetTable Basic offset table, empty if not present.
+     * @param fragments Fragments with the offsets of their items relative to the first fragment item.
+     * @param itemOffsets Offsets of the fragment items as used by the offset table.
+     * @return False if the items are broken.
+     */
+    bool readEncapsulatedItems( DicomElementStream& stream, std::istream& in, std::vector<uint32_t>& offsetTable,
+                                std::vector<DicomFrameIndex::Fragment>& fragments, std::vector<uint64_t>& itemOffsets )
+    {
+        bool firstItem = true;
+        std::streamoff firstFragmentItem = -1;
+        while( true )
+        {
+            const std::streamoff itemStart = in.tellg();
+            DicomElementStream::ElementHeader item;
+            if( !stream.readElementHeader( item ) || item.group != 0xFFFE )
+                return false;
+            if( item.element == 0xE0DD )
+                return true;
+            if( item.element != 0xE000 || item.length == DicomElementStream::UNDEFINED_LENGTH )
+                return false;
+
+            if( firstItem )
+            {
+                // the basic offset table holds the item offset of the first fragment of each frame
+                firstItem = false;
+                offsetTable.resize( item.length / 4 );
+                for( uint32_t& offset : offsetTable )
+                {
+                    if( !stream.readUnsigned( 4, offset ) )
+                        return false;
+                }
+                continue;
+            }
+
+            if( firstFragmentItem < 0 )
+                firstFragmentItem = itemStart;
+
+            DicomFrameIndex::Fragment fragment;
+            fragment.offset = uint64_t( in.tellg() );
+            fragment.length = item.length;
+            fragments.push_back( fragment );
+            itemOffsets.push_back( uint64_t( itemStart - firstFragmentItem ) );
+
+            in.seekg( std::streamoff(item.length), std::ios::cur );
+            if( !in )
+                return false;
+        }
+    }
+}
+
+bool DicomFrameIndex::locateFrames( const std::string& file, size_t nbrOfFrames, size_t frameBytes, PixelData& pixelData )
+{
+    std::ifstream in( file, std::ios::in | std::ios::binary );
+    DicomElementStream stream( in );
+    if( !in || !stream.open() || nbrOfFrames == 0 )
+        return false;
+
+    pixelData = PixelData();
+    pixelData.transferSyntax = stream.getTransferSyntax();
+    pixelData.bigEndian = stream.isBigEndian();
+
+    // pixel data is a top-level element after all others but the trailing padding
+    DicomElementStream::ElementHeader header;
+    bool found = false;
+    while( stream.readElementHeader( header ) )
+    {
+        if( header.tag() == TAG_PIXEL_DATA )
+        {
+            found = true;
+            break;
+        }
+        if( header.tag() > TAG_PIXEL_DATA || !stream.skipValue( header ) )
+            return false;
+    }
+    if( !found )
+        return false;
+
+    if( header.length != DicomElementStream::UNDEFINED_LENGTH )
+    {
+        // native frames follow each other without gaps
+        if( uint64_t(header.length) < uint64_t(nbrOfFrames) * uint64_t(frameBytes) || frameBytes > 0xFFFFFFFFu )
+            return false;
+
+        const uint64_t start = uint64_t( in.tellg() );
+        for( size_t f = 0; f < nbrOfFrames; f++ )
+        {
+            Fragment fragment;
+            fragment.offset = start + f * uint64_t(frameBytes);
+            fragment.length = uint32_t( frameBytes );
+            pixelData.frames.push_back( { fragment } );
+        }
+        return true;
+    }
+
+    pixelData.encapsulated = true;
+    std::vector<uint32_t> offsetTable;
+    std::vector<Fragment> fragments;
+    std::vector<uint64_t> itemOffsets;
+    if( !readEncapsulatedItems( stream, in, offsetTable, fragments, itemOffsets ) || fragments.empty() )
+        return false;
+
+    pixelData.frames.resize( nbrOfFrames );
+    if( offsetTable.size() == nbrOfFrames )
+    {
+        // a frame consists of the fragments from its offset to the offset of the next frame
+        for( size_t f = 0; f < nbrOfFrames; f++ )
+        {
+            const uint64_t frameStart = offsetTable[f];
+            const uint64_t frameEnd = f + 1 < nbrOfFrames ? uint64_t( offsetTable[f+1] ) : UINT64_MAX;
+            for( size_t i = 0; i < fragments.size(); i++ )
+            {
+                if( itemOffsets[i] >= frameStart && itemOffsets[i] < frameEnd )
+                    pixelData.frames[f].push_back( fragments[i] );
+            }
+        }
+    }
+    else if( fragments.size() == nbrOfFrames )
+    {
+        for( size_t f = 0; f < nbrOfFrames; f++ )
+            pixelData.frames[f].push_back( fragments[f] );
+    }
+    else if( nbrOfFrames == 1 )
+    {
+        pixelData.frames[0] = fragments;
+    }
+
+    return std::none_of( pixelData.frames.begin(), pixelData.frames.end(),
+                         []( const std::vector<Fragment>& frame ) { return frame.empty(); } );
+}
+
+bool DicomFrameIndex::readFrame( std::istream& in, const std::vector<Fragment>& frame, std::vector<char>& bytes )
+{
+    size_t size = 0;
+    for( const Fragment& fragment : frame )
+        size += fragment.length;
+    bytes.resize( size );
+
+    size_t position = 0;
+    for( const Fragment& fragment : frame )
+    {
+        in.seekg( std::streamoff( fragment.offset ) );
+        if( !in.read( bytes.data() + position, std::streamsize( fragment.length ) ) )
+            return false;
+        position += fragment.length;
+    }
+    return true;
+}
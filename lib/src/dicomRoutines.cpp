@@ -22,22 +22,512 @@
 *****************************************************************************/
 
 #include "dicomRoutines.h"
+#include "parallelTools.h"
+#include "volumeCache.h"
+#include "slabStitcher.h"
+#include "isoSurface.h"
+#include "minMaxBlocks.h"
+#include "dualContouring.h"
+#include "labelSurfaces.h"
+#include "volumeHistogram.h"
 
 #include <vtkDICOMImageReader.h>
+#include <vtkObjectFactory.h>
 #include <vtkMarchingCubes.h>
 #include <vtkExtractVOI.h>
-#include <vtkImageThreshold.h>
 #include <vtkPNGReader.h>
-#include <vtkStringArray.h>
+#include <vtkPointData.h>
+#include <vtkFloatArray.h>
+#include <vtkMath.h>
 #include <iostream>
 #include <vector>
 #include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <atomic>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <chrono>
 
 using namespace std;
 
+namespace
+{
+    /**
+     * DICOM reader which gives access to the slice files in the
+     * order vtkDICOMImageReader stacks them.
+     */
+    class SortedDICOMImageReader : public vtkDICOMImageReader
+    {
+    public:
+        static SortedDICOMImageReader* New();
+        vtkTypeMacro(SortedDICOMImageReader, vtkDICOMImageReader);
+
+        std::vector<std::string> GetSortedFileNames()
+        {
+            std::vector<std::string> fileNames;
+            for( int i = 0; i < GetNumberOfDICOMFileNames(); i++ )
+                fileNames.emplace_back( GetDICOMFileName(i) );
+            return fileNames;
+        }
+    };
+
+    vtkStandardNewMacro(SortedDICOMImageReader);
+
+    /**
+     * Size and type of the slice images of a volume, the window of
+     * each slice which is read and the sampling stride.
+     */
+    struct SliceLayout
+    {
+        int sliceWidth = 0;
+        int sliceHeight = 0;
+        int scalarType = VTK_VOID;
+        int nbrOfComponents = 1;
+        std::array<double,3> spacing = {{ 1.0, 1.0, 1.0 }};
+        std::array<double,3> origin = {{ 0.0, 0.0, 0.0 }}; // position of the first voxel of the first slice
+        std::array<int,4> window = {{ 0, -1, 0, -1 }};     // x0, x1, y0, y1
+        int stride = 1;                                    // every stride-th slice, row and column is read
+    };
+
+    /**
+     * Threads which read and decode the slice files.
+     */
+    struct DecodeSettings
+    {
+        unsigned int nbrOfThreads = 1;     // decoder threads
+        unsigned int nbrOfIoThreads = 0;   // threads prefetching the files, 0 lets the decoders read
+        unsigned int queueDepth = 0;       // prefetched files waiting for a decoder, 0 for two per decoder
+    };
+
+    /**
+     * Reads a whole file into memory.
+     * @param path File path.
+     * @param bytes File content.
+     * @return True if the file could be read.
+     */
+    bool readFileBytes( const std::string& path, std::vector<char>& bytes )
+    {
+        std::error_code error;
+        if( !std::filesystem::is_regular_file( path, error ) )
+            return false;
+
+        std::ifstream file( path, std::ios::binary | std::ios::ate );
+        const std::streamoff size = file.tellg();
+        if( !file || size < 0 )
+            return false;
+
+        bytes.resize( size_t( size ) );
+        file.seekg( 0 );
+        return bool( file.read( bytes.data(), std::streamsize( bytes.size() ) ) );
+    }
+
+    /**
+     * Points a slice reader to its file. Readers without memory input open the
+     * file themselves. The prefetched bytes are not used then, but reading them
+     * brought the file into the page cache.
+     */
+    template<class ReaderT>
+    void setReaderInput( ReaderT* reader, const std::string& file, const std::vector<char>& /*bytes*/ )
+    {
+        reader->SetFileName( file.c_str() );
+    }
+
+    /**
+     * Png readers decode prefetched file bytes straight from memory.
+     */
+    void setReaderInput( vtkPNGReader* reader, const std::string& file, const std::vector<char>& bytes )
+    {
+        if( bytes.empty() )
+        {
+            reader->SetFileName( file.c_str() );
+        }
+        else
+        {
+            reader->SetMemoryBuffer( bytes.data() );
+            reader->SetMemoryBufferLength( vtkIdType( bytes.size() ) );
+        }
+    }
+
+    /**
+     * Number of samples taken from the indices first to last with a stride.
+     */
+    int sampleCount( int first, int last, int stride )
+    {
+        return ( last - first ) / stride + 1;
+    }
+
+    /**
+     * Reads the layout of the slices from the information of a reader.
+     * @param reader Reader with updated information.
+     * @return Layout with a window covering the whole slice.
+     */
+    SliceLayout readSliceLayout( vtkImageReader2* reader )
+    {
+        int* extent = reader->GetDataExtent();
+        double* spacing = reader->GetDataSpacing();
+        double* origin = reader->GetDataOrigin();
+
+        SliceLayout layout;
+        layout.sliceWidth = extent[1] - extent[0] + 1;
+        layout.sliceHeight = extent[3] - extent[2] + 1;
+        layout.scalarType = reader->GetDataScalarType();
+        layout.nbrOfComponents = reader->GetNumberOfScalarComponents();
+        layout.spacing = {{ spacing[0], spacing[1], spacing[2] }};
+        layout.origin = {{ origin[0] + extent[0] * spacing[0], origin[1] + extent[2] * spacing[1], origin[2] + extent[4] * spacing[2] }};
+        layout.window = {{ 0, layout.sliceWidth - 1, 0, layout.sliceHeight - 1 }};
+        return layout;
+    }
+
+    /**
+     * Reads the layout of png slices. The spacing is given by the user.
+     */
+    SliceLayout readPngLayout( vtkPNGReader* reader, double x_spacing, double y_spacing, double slice_spacing )
+    {
+        SliceLayout layout = readSliceLayout( reader );
+        layout.spacing = {{ x_spacing, y_spacing, slice_spacing }};
+        layout.origin = {{ 0.0, 0.0, 0.0 }};
+        return layout;
+    }
+
+    /**
+     * Decodes one image file per slice on a pool of worker threads. Each file
+     * is read by its own reader of type ReaderT and the window of the layout,
+     * sampled with the stride of the layout, is written straight into its
+     * slice of the preallocated volume. With I/O threads, the files are
+     * prefetched into memory while the decoders work on earlier slices.
+     * @param files Slice files in slice order.
+     * @param volume Allocated volume with one slice per file and the size of the sampled window.
+     * @param layout Slice layout.
+     * @param settings Decoder and I/O threads.
+     * @param progressReporter Algorithm which fires the progress events.
+     * @param statistics Set to the phase timings of the prefetch pipeline, if not NULL.
+     * @return True if every slice matches the layout in size and type.
+     */
+    template<class ReaderT>
+    bool decodeSlices( const std::vector<std::string>& files, vtkImageData* volume, const SliceLayout& layout,
+                       const DecodeSettings& settings, vtkAlgorithm* progressReporter,
+                       ParallelTools::PipelineStatistics* statistics )
+    {
+        int extent[6];
+        volume->GetExtent( extent );
+        const int width = sampleCount( layout.window[0], layout.window[1], layout.stride );
+        const int height = sampleCount( layout.window[2], layout.window[3], layout.stride );
+        if( size_t(extent[5] - extent[4] + 1) != files.size() || extent[1] - extent[0] + 1 != width ||
+            extent[3] - extent[2] + 1 != height )
+            return false;
+
+        const size_t pixelBytes = size_t(layout.nbrOfComponents) * size_t(volume->GetScalarSize());
+        const size_t rowBytes = size_t(width) * pixelBytes;
+        const size_t sliceRowBytes = size_t(layout.sliceWidth) * pixelBytes;
+        char* volumeBuffer = static_cast<char*>( volume->GetScalarPointer() );
+
+        std::atomic<bool> slicesFit( true );
+        auto decodeSlice = [&]( size_t z, const std::vector<char>& bytes )
+        {
+            if( !slicesFit )
+                return;
+
+            vtkSmartPointer<ReaderT> sliceReader = vtkSmartPointer<ReaderT>::New();
+            setReaderInput( sliceReader.Get(), files.at(z), bytes );
+            sliceReader->Update();
+
+            vtkImageData* slice = sliceReader->GetOutput();
+            if( slice->GetPointData()->GetScalars() == NULL )
+            {
+                slicesFit = false;
+                return;
+            }
+
+            int sliceExtent[6];
+            slice->GetExtent( sliceExtent );
+            if( sliceExtent[1] - sliceExtent[0] + 1 != layout.sliceWidth || sliceExtent[3] - sliceExtent[2] + 1 != layout.sliceHeight ||
+                sliceExtent[5] != sliceExtent[4] || slice->GetScalarType() != layout.scalarType ||
+                slice->GetNumberOfScalarComponents() != layout.nbrOfComponents )
+            {
+                slicesFit = false;
+                return;
+            }
+
+            const char* sliceBuffer = static_cast<const char*>( slice->GetScalarPointer() );
+            char* target = volumeBuffer + z * size_t(height) * rowBytes;
+            if( layout.stride == 1 && rowBytes == sliceRowBytes )
+            {
+                std::memcpy( target, sliceBuffer + size_t(layout.window[2]) * sliceRowBytes, size_t(height) * rowBytes );
+            }
+            else if( layout.stride == 1 )
+            {
+                for( int y = 0; y < height; y++ )
+                    std::memcpy( target + size_t(y) * rowBytes, sliceBuffer + size_t(layout.window[2] + y) * sliceRowBytes +
+                                 size_t(layout.window[0]) * pixelBytes, rowBytes );
+            }
+            else
+            {
+                const size_t stride = size_t(layout.stride);
+                for( int y = 0; y < height; y++ )
+                {
+                    const char* sliceRow = sliceBuffer + ( size_t(layout.window[2]) + y * stride ) * sliceRowBytes +
+                                           size_t(layout.window[0]) * pixelBytes;
+                    for( int x = 0; x < width; x++ )
+                        std::memcpy( target + size_t(y) * rowBytes + size_t(x) * pixelBytes, sliceRow + x * stride * pixelBytes, pixelBytes );
+                }
+            }
+        };
+
+        auto reportProgress = [progressReporter]( double progress )
+        {
+            if( progressReporter != NULL )
+                progressReporter->UpdateProgress( progress );
+        };
+
+        if( settings.nbrOfIoThreads == 0 )
+        {
+            const std::vector<char> noBytes;
+            ParallelTools::parallelFor( 0, files.size(), settings.nbrOfThreads, [&]( size_t z )
+            {
+                decodeSlice( z, noBytes );
+            },
+            reportProgress );
+            return slicesFit;
+        }
+
+        // each prefetched file is released as soon as its slice is decoded
+        std::vector<std::vector<char>> fileBytes( files.size() );
+        ParallelTools::PipelineStatistics pipelineStatistics = ParallelTools::pipelineFor( 0, files.size(),
+            settings.nbrOfIoThreads, settings.nbrOfThreads,
+            settings.queueDepth > 0 ? settings.queueDepth : 2 * settings.nbrOfThreads,
+            [&]( size_t z )
+            {
+                if( slicesFit && !readFileBytes( files.at(z), fileBytes.at(z) ) )
+                    slicesFit = false;
+            },
+            [&]( size_t z )
+            {
+                decodeSlice( z, fileBytes.at(z) );
+                std::vector<char>().swap( fileBytes.at(z) );
+            },
+            reportProgress );
+
+        if( statistics != NULL )
+            *statistics = pipelineStatistics;
+
+        return slicesFit;
+    }
+
+    /**
+     * Decodes the window of the slices zStart to zEnd into a new volume. With
+     * a stride, only every stride-th slice from zStart on is read and the
+     * spacing grows accordingly. The volume extent starts at 0 and its origin
+     * is placed at the first voxel read.
+     * @param files Slice files of the whole volume in slice order.
+     * @param layout Slice layout.
+     * @param zStart First slice.
+     * @param zEnd Last slice. Not read if it does not fall on the stride.
+     * @param settings Decoder and I/O threads.
+     * @param progressReporter Algorithm which fires the progress events, or NULL.
+     * @param statistics Set to the phase timings of the prefetch pipeline, if not NULL.
+     * @return Volume, or NULL if the slices do not fit together.
+     */
+    template<class ReaderT>
+    vtkSmartPointer<vtkImageData> decodeVolume( const std::vector<std::string>& files, const SliceLayout& layout,
+                                                int zStart, int zEnd, const DecodeSettings& settings,
+                                                vtkAlgorithm* progressReporter,
+                                                ParallelTools::PipelineStatistics* statistics = NULL )
+    {
+        const int stride = layout.stride;
+        vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+        volume->SetExtent( 0, sampleCount( layout.window[0], layout.window[1], stride ) - 1,
+                           0, sampleCount( layout.window[2], layout.window[3], stride ) - 1,
+                           0, sampleCount( zStart, zEnd, stride ) - 1 );
+        volume->SetSpacing( layout.spacing[0] * stride, layout.spacing[1] * stride, layout.spacing[2] * stride );
+        volume->SetOrigin( layout.origin[0] + layout.window[0] * layout.spacing[0],
+                           layout.origin[1] + layout.window[2] * layout.spacing[1],
+                           layout.origin[2] + zStart * layout.spacing[2] );
+        volume->AllocateScalars( layout.scalarType, layout.nbrOfComponents );
+
+        std::vector<std::string> volumeFiles;
+        for( int z = zStart; z <= zEnd; z += stride )
+            volumeFiles.push_back( files.at(z) );
+        if( !decodeSlices<ReaderT>( volumeFiles, volume, layout, settings, progressReporter, statistics ) )
+            return NULL;
+
+        return volume;
+    }
+
+    /**
+     * Creates a volume showing a range of slices of another volume. The
+     * voxels are shared, not copied.
+     * @param volume Volume with extent starting at 0.
+     * @param firstSlice First slice of the view.
+     * @param nbrOfSlices Number of slices of the view.
+     * @return View with extent starting at 0.
+     */
+    vtkSmartPointer<vtkImageData> createSliceView( vtkImageData* volume, int firstSlice, int nbrOfSlices )
+    {
+        int dims[3];
+        volume->GetDimensions( dims );
+        double* spacing = volume->GetSpacing();
+        double* origin = volume->GetOrigin();
+
+        vtkDataArray* scalars = volume->GetPointData()->GetScalars();
+        const int nbrOfComponents = scalars->GetNumberOfComponents();
+        const vtkIdType sliceValues = vtkIdType(dims[0]) * vtkIdType(dims[1]) * nbrOfComponents;
+
+        vtkSmartPointer<vtkDataArray> viewScalars = vtkSmartPointer<vtkDataArray>::Take( vtkDataArray::CreateDataArray( scalars->GetDataType() ) );
+        viewScalars->SetNumberOfComponents( nbrOfComponents );
+        viewScalars->SetVoidArray( static_cast<char*>( scalars->GetVoidPointer(0) ) + firstSlice * sliceValues * scalars->GetDataTypeSize(),
+                                   nbrOfSlices * sliceValues, 1 );
+
+        vtkSmartPointer<vtkImageData> view = vtkSmartPointer<vtkImageData>::New();
+        view->SetExtent( 0, dims[0] - 1, 0, dims[1] - 1, 0, nbrOfSlices - 1 );
+        view->SetSpacing( spacing );
+        view->SetOrigin( origin[0], origin[1], origin[2] + firstSlice * spacing[2] );
+        view->GetPointData()->SetScalars( viewScalars );
+        return view;
+    }
+
+    /**
+     * Computes the point normals of a mesh extracted from a volume the same way
+     * vtkMarchingCubes does: the negative voxel gradients are interpolated along
+     * the cell edge each vertex lies on. The volume may reach beyond the meshed
+     * slices, which gives central differences on the seams of a slab.
+     * @param mesh Mesh extracted from the volume.
+     * @param volume Volume with extent starting at 0.
+     * @param scalars Voxels of the volume.
+     * @param threshold Threshold for surface segmentation.
+     * @param useUpperThreshold Voxels at or above the upper threshold count as outside.
+     * @param upperThreshold Upper threshold for surface segmentation.
+     * @param nbrOfThreads Number of threads.
+     */
+    template<class T>
+    void addGradientNormals( vtkPolyData* mesh, vtkImageData* volume, const T* scalars, int threshold,
+                             bool useUpperThreshold, int upperThreshold, unsigned int nbrOfThreads )
+    {
+        const vtkIdType nbrOfPoints = mesh->GetNumberOfPoints();
+        if( nbrOfPoints == 0 )
+            return;
+
+        int dims[3];
+        volume->GetDimensions( dims );
+        double origin[3], spacing[3];
+        volume->GetOrigin( origin );
+        volume->GetSpacing( spacing );
+        const vtkIdType sliceSize = vtkIdType(dims[0]) * vtkIdType(dims[1]);
+
+        // same masking as in the extraction
+        const VTKIsoSurface::Band<T> band( threshold, useUpperThreshold, upperThreshold );
+
+        auto voxel = [&]( const int ijk[3] ) -> double
+        {
+            return band( scalars[ijk[0] + ijk[1] * vtkIdType(dims[0]) + ijk[2] * sliceSize] );
+        };
+
+        auto gradient = [&]( const int ijk[3], double g[3] )
+        {
+            for( int a = 0; a < 3; a++ )
+            {
+                int lower[3] = { ijk[0], ijk[1], ijk[2] };
+                int upper[3] = { ijk[0], ijk[1], ijk[2] };
+                double factor = 0.5;
+                if( dims[a] == 1 )
+                {
+                    g[a] = 0.0;
+                    continue;
+                }
+                else if( ijk[a] == 0 )
+                {
+                    upper[a]++;
+                    factor = 1.0;
+                }
+                else if( ijk[a] == dims[a] - 1 )
+                {
+                    lower[a]--;
+                    factor = 1.0;
+                }
+                else
+                {
+                    lower[a]--;
+                    upper[a]++;
+                }
+                g[a] = factor * ( voxel(lower) - voxel(upper) ) / spacing[a];
+            }
+        };
+
+        vtkPoints* points = mesh->GetPoints();
+        vtkSmartPointer<vtkFloatArray> normals = vtkSmartPointer<vtkFloatArray>::New();
+        normals->SetName( "Normals" );
+        normals->SetNumberOfComponents( 3 );
+        normals->SetNumberOfTuples( nbrOfPoints );
+
+        ParallelTools::parallelFor( 0, size_t(nbrOfPoints), nbrOfThreads, [&]( size_t pointId )
+        {
+            double p[3];
+            points->GetPoint( vtkIdType(pointId), p );
+
+            // a vertex lies on a cell edge: all but one index coordinate are integral
+            double u[3];
+            int edgeAxis = -1;
+            double maxFraction = 1e-3;
+            for( int a = 0; a < 3; a++ )
+            {
+                u[a] = ( p[a] - origin[a] ) / spacing[a];
+                double fraction = std::abs( u[a] - std::round(u[a]) );
+                if( fraction > maxFraction )
+                {
+                    maxFraction = fraction;
+                    edgeAxis = a;
+                }
+            }
+
+            int v0[3];
+            for( int a = 0; a < 3; a++ )
+            {
+                int index = int( a == edgeAxis ? std::floor(u[a]) : std::round(u[a]) );
+                v0[a] = std::clamp( index, 0, dims[a] - 1 );
+            }
+
+            double n[3];
+            gradient( v0, n );
+            if( edgeAxis >= 0 && v0[edgeAxis] < dims[edgeAxis] - 1 )
+            {
+                int v1[3] = { v0[0], v0[1], v0[2] };
+                v1[edgeAxis]++;
+                double g1[3];
+                gradient( v1, g1 );
+                const double t = u[edgeAxis] - v0[edgeAxis];
+                for( int a = 0; a < 3; a++ )
+                    n[a] += t * ( g1[a] - n[a] );
+            }
+
+            vtkMath::Normalize( n );
+            normals->SetTuple( vtkIdType(pointId), n );
+        });
+
+        mesh->GetPointData()->SetNormals( normals );
+    }
+}
+
 VTKDicomRoutines::VTKDicomRoutines()
 {
     m_progressCallback = vtkSmartPointer<vtkCallbackCommand>(NULL);
+    m_nbrOfThreads = 0;
+    m_surfaceExtractor = SurfaceExtractor::MarchingCubes;
+    m_dualContouringTolerance = 0.1;
+    m_labelSmoothingIterations = 10;
+    m_gaussianSigma = 0.0;
+    m_useEmptySpaceSkipping = true;
+    m_smallObjectRatio = 0.0;
+    m_cacheDirectory = "";
+    m_seriesSelector = "";
+    m_useVolumeOfInterest = false;
+    m_volumeOfInterest = {{ 0, 0, 0, 0, 0, 0 }};
+    m_useRegionOfInterest = false;
+    m_regionOfInterest = {{ 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 }};
+    m_previewStride = 1;
+    m_nbrOfIoThreads = 0;
+    m_prefetchQueueDepth = 0;
 }
 
 VTKDicomRoutines::~VTKDicomRoutines()
@@ -49,28 +539,346 @@ void VTKDicomRoutines::SetProgressCallback( vtkSmartPointer<vtkCallbackCommand>
     m_progressCallback = progressCallback;
 }
 
+void VTKDicomRoutines::SetNumberOfThreads( unsigned int nbrOfThreads )
+{
+    m_nbrOfThreads = nbrOfThreads;
+}
+
+unsigned int VTKDicomRoutines::GetNumberOfThreads() const
+{
+    return m_nbrOfThreads;
+}
+
+void VTKDicomRoutines::SetSurfaceExtractor( SurfaceExtractor extractor )
+{
+    m_surfaceExtractor = extractor;
+}
+
+VTKDicomRoutines::SurfaceExtractor VTKDicomRoutines::GetSurfaceExtractor() const
+{
+    return m_surfaceExtractor;
+}
+
+void VTKDicomRoutines::SetDualContouringTolerance( double tolerance )
+{
+    m_dualContouringTolerance = tolerance;
+}
+
+double VTKDicomRoutines::GetDualContouringTolerance() const
+{
+    return m_dualContouringTolerance;
+}
+
+void VTKDicomRoutines::SetLabelSmoothingIterations( unsigned int nbrOfIterations )
+{
+    m_labelSmoothingIterations = nbrOfIterations;
+}
+
+unsigned int VTKDicomRoutines::GetLabelSmoothingIterations() const
+{
+    return m_labelSmoothingIterations;
+}
+
+void VTKDicomRoutines::SetGaussianSigma( double sigma )
+{
+    m_gaussianSigma = std::max( sigma, 0.0 );
+}
+
+double VTKDicomRoutines::GetGaussianSigma() const
+{
+    return m_gaussianSigma;
+}
+
+void VTKDicomRoutines::SetEmptySpaceSkipping( bool enable )
+{
+    m_useEmptySpaceSkipping = enable;
+}
+
+bool VTKDicomRoutines::GetEmptySpaceSkipping() const
+{
+    return m_useEmptySpaceSkipping;
+}
+
+void VTKDicomRoutines::SetSmallObjectRatio( double ratio )
+{
+    m_smallObjectRatio = ratio;
+}
+
+double VTKDicomRoutines::GetSmallObjectRatio() const
+{
+    return m_smallObjectRatio;
+}
+
+void VTKDicomRoutines::SetCacheDirectory( const std::string& cacheDirectory )
+{
+    m_cacheDirectory = cacheDirectory;
+}
+
+void VTKDicomRoutines::SetSeriesSelector( const std::string& seriesSelector )
+{
+    m_seriesSelector = seriesSelector;
+}
+
+void VTKDicomRoutines::SetVolumeOfInterest( int x0, int x1, int y0, int y1, int z0, int z1 )
+{
+    m_useVolumeOfInterest = true;
+    m_volumeOfInterest = {{ x0, x1, y0, y1, z0, z1 }};
+}
+
+void VTKDicomRoutines::ClearVolumeOfInterest()
+{
+    m_useVolumeOfInterest = false;
+}
+
+void VTKDicomRoutines::SetRegionOfInterest( double xMin, double xMax, double yMin, double yMax, double zMin, double zMax )
+{
+    m_useRegionOfInterest = true;
+    m_regionOfInterest = {{ xMin, xMax, yMin, yMax, zMin, zMax }};
+}
+
+void VTKDicomRoutines::ClearRegionOfInterest()
+{
+    m_useRegionOfInterest = false;
+}
+
+void VTKDicomRoutines::SetPreviewStride( unsigned int stride )
+{
+    m_previewStride = std::max( stride, 1u );
+}
+
+unsigned int VTKDicomRoutines::GetPreviewStride() const
+{
+    return m_previewStride;
+}
+
+void VTKDicomRoutines::SetPrefetch( unsigned int nbrOfIoThreads, unsigned int queueDepth )
+{
+    m_nbrOfIoThreads = nbrOfIoThreads;
+    m_prefetchQueueDepth = queueDepth;
+}
+
+ParallelTools::PipelineStatistics VTKDicomRoutines::GetLoadStatistics() const
+{
+    return m_loadStatistics;
+}
+
+void VTKDicomRoutines::reportLoadStatistics() const
+{
+    if( m_nbrOfIoThreads == 0 )
+        return;
+
+    const ParallelTools::PipelineStatistics& s = m_loadStatistics;
+    auto ms = []( double seconds ) { return long( seconds * 1000.0 + 0.5 ); };
+
+    // decoders starving for files point to the storage, readers blocked by a full queue to the CPU
+    cout << "Reading: " << ms(s.fetchSeconds) << " ms, waiting for queue space: " << ms(s.fetchWaitSeconds) << " ms" << endl;
+    cout << "Decoding: " << ms(s.processSeconds) << " ms, waiting for files: " << ms(s.processWaitSeconds) << " ms" << endl;
+    cout << "Loaded in " << ms(s.wallSeconds) << " ms, " << ( s.processWaitSeconds > s.fetchWaitSeconds ? "I/O-bound" : "CPU-bound" ) << endl;
+}
+
+bool VTKDicomRoutines::hasVolumeOfInterest() const
+{
+    return m_useVolumeOfInterest || m_useRegionOfInterest;
+}
+
+bool VTKDicomRoutines::restrictToVolumeOfInterest( int extent[6], const double origin[3], const double spacing[3] ) const
+{
+    for( int a = 0; a < 3 && m_useVolumeOfInterest; a++ )
+    {
+        // the volume of interest counts voxels from the start of the extent
+        long long lower = std::max( (long long)extent[2*a] + m_volumeOfInterest[2*a], (long long)extent[2*a] );
+        long long upper = std::min( (long long)extent[2*a] + m_volumeOfInterest[2*a+1], (long long)extent[2*a+1] );
+        if( lower > upper )
+            return false;
+        extent[2*a] = int(lower);
+        extent[2*a+1] = int(upper);
+    }
+
+    for( int a = 0; a < 3 && m_useRegionOfInterest; a++ )
+    {
+        if( spacing[a] == 0.0 )
+            continue;
+
+        // the voxels enclosing the box, so that the surface reaches up to its faces
+        double first = ( m_regionOfInterest[2*a] - origin[a] ) / spacing[a];
+        double last = ( m_regionOfInterest[2*a+1] - origin[a] ) / spacing[a];
+        if( first > last )
+            std::swap( first, last );
+        const double tolerance = 1e-6;
+        double lower = std::max( std::floor( first + tolerance ), double(extent[2*a]) );
+        double upper = std::min( std::ceil( last - tolerance ), double(extent[2*a+1]) );
+        if( lower > upper )
+            return false;
+        extent[2*a] = int(lower);
+        extent[2*a+1] = int(upper);
+    }
+
+    return extent[0] <= extent[1] && extent[2] <= extent[3] && extent[4] <= extent[5];
+}
+
+size_t VTKDicomRoutines::getFirstSliceOfInterest( size_t nbrOfSlices ) const
+{
+    if( !m_useVolumeOfInterest || nbrOfSlices == 0 )
+        return 0;
+    return size_t( std::clamp( m_volumeOfInterest[4], 0, int(nbrOfSlices) - 1 ) );
+}
+
+int VTKDicomRoutines::getNumberOfSampledSlices( const int extent[6] ) const
+{
+    return sampleCount( extent[4], extent[5], int(m_previewStride) );
+}
+
+std::string VTKDicomRoutines::getLoadOptionsKey() const
+{
+    std::string key;
+    if( m_useVolumeOfInterest )
+    {
+        key += " voi";
+        for( int v : m_volumeOfInterest )
+            key += " " + std::to_string(v);
+    }
+
+    if( m_useRegionOfInterest )
+    {
+        key += " roi";
+        for( double v : m_regionOfInterest )
+            key += " " + std::to_string(v);
+    }
+
+    if( m_previewStride > 1 )
+        key += " stride " + std::to_string(m_previewStride);
+
+    return key;
+}
+
+vtkSmartPointer<vtkImageData> VTKDicomRoutines::extractVolumeOfInterest( vtkSmartPointer<vtkImageData> imageData ) const
+{
+    int extent[6];
+    imageData->GetExtent( extent );
+    int wholeExtent[6] = { extent[0], extent[1], extent[2], extent[3], extent[4], extent[5] };
+    if( !restrictToVolumeOfInterest( extent, imageData->GetOrigin(), imageData->GetSpacing() ) )
+        return NULL;
+    if( std::equal( extent, extent + 6, wholeExtent ) && m_previewStride == 1 )
+        return imageData;
+
+    const int stride = int( m_previewStride );
+    vtkSmartPointer<vtkExtractVOI> cropper = vtkSmartPointer<vtkExtractVOI>::New();
+    cropper->SetInputData( imageData );
+    cropper->SetVOI( extent );
+    cropper->SetSampleRate( stride, stride, stride );
+    cropper->Update();
+
+    // place the volume of interest at extent 0
+    vtkSmartPointer<vtkImageData> volumeOfInterest = vtkSmartPointer<vtkImageData>::New();
+    volumeOfInterest->ShallowCopy( cropper->GetOutput() );
+    double origin[3], spacing[3];
+    imageData->GetOrigin( origin );
+    imageData->GetSpacing( spacing );
+    volumeOfInterest->SetExtent( 0, sampleCount( extent[0], extent[1], stride ) - 1, 0, sampleCount( extent[2], extent[3], stride ) - 1,
+                                 0, sampleCount( extent[4], extent[5], stride ) - 1 );
+    volumeOfInterest->SetSpacing( spacing[0] * stride, spacing[1] * stride, spacing[2] * stride );
+    volumeOfInterest->SetOrigin( origin[0] + extent[0] * spacing[0], origin[1] + extent[2] * spacing[1],
+                                 origin[2] + extent[4] * spacing[2] );
+    return volumeOfInterest;
+}
+
+vtkSmartPointer<vtkImageData> VTKDicomRoutines::loadFromCache( const std::string& cacheKey ) const
+{
+    if( m_cacheDirectory.empty() )
+        return NULL;
+
+    VTKVolumeCache cache( m_cacheDirectory );
+    vtkSmartPointer<vtkImageData> volume = cache.load( cacheKey );
+    if( volume.Get() != NULL )
+        cout << "Map cached volume " << cache.getCacheFilePath( cacheKey ) << endl << endl;
+
+    return volume;
+}
+
+void VTKDicomRoutines::storeInCache( const std::string& cacheKey, vtkImageData* volume ) const
+{
+    if( m_cacheDirectory.empty() )
+        return;
+
+    VTKVolumeCache cache( m_cacheDirectory );
+    if( cache.store( cacheKey, volume ) )
+        cout << "Volume cached in " << cache.getCacheFilePath( cacheKey ) << endl;
+}
+
 vtkSmartPointer<vtkImageData> VTKDicomRoutines::loadDicomImage( const std::string& pathToDicom )
 {
     cout << "Read DICOM images located under " << pathToDicom << endl;
 
-    vtkSmartPointer<vtkDICOMImageReader> reader = vtkSmartPointer<vtkDICOMImageReader>::New();
+    std::string cacheKey;
+    if( !m_cacheDirectory.empty() )
+    {
+        cacheKey = VTKVolumeCache::computeKey( VTKVolumeCache::listFiles( pathToDicom ), "vtkDICOMImageReader" + getLoadOptionsKey() );
+        vtkSmartPointer<vtkImageData> cachedVolume = loadFromCache( cacheKey );
+        if( cachedVolume.Get() != NULL )
+            return cachedVolume;
+    }
+
+    vtkSmartPointer<SortedDICOMImageReader> reader = vtkSmartPointer<SortedDICOMImageReader>::New();
     reader->SetDirectoryName( pathToDicom.c_str() );
     if( m_progressCallback.Get() != NULL )
     {
         reader->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
     }
-    reader->Update();
 
-    vtkSmartPointer<vtkImageData> rawVolumeData = vtkSmartPointer<vtkImageData>::New();
-    rawVolumeData->DeepCopy(reader->GetOutput());
+    // parse the headers: slice order and volume geometry
+    reader->UpdateInformation();
+
+    std::vector<std::string> files = reader->GetSortedFileNames();
+    SliceLayout layout = readSliceLayout( reader );
+    int extent[6] = { 0, layout.sliceWidth - 1, 0, layout.sliceHeight - 1, 0, int(files.size()) - 1 };
+    if( files.empty() || !restrictToVolumeOfInterest( extent, layout.origin.data(), layout.spacing.data() ) )
+    {
+        cerr << "No DICOM data in directory or volume of interest" << endl;
+        return NULL;
+    }
+    layout.window = {{ extent[0], extent[1], extent[2], extent[3] }};
+    layout.stride = int( m_previewStride );
+
+    // decode the files of the volume of interest only, slice by slice
+    vtkSmartPointer<vtkImageData> rawVolumeData;
+    unsigned int nbrOfThreads = ParallelTools::resolveNumberOfThreads( m_nbrOfThreads );
+    m_loadStatistics = ParallelTools::PipelineStatistics();
+    if( nbrOfThreads > 1 || hasVolumeOfInterest() || m_previewStride > 1 || m_nbrOfIoThreads > 0 )
+    {
+        cout << "Decode DICOM slices " << extent[4] << " - " << extent[5];
+        if( m_previewStride > 1 )
+            cout << " at stride " << m_previewStride;
+        cout << " with " << nbrOfThreads << " threads";
+        if( m_nbrOfIoThreads > 0 )
+            cout << " and " << m_nbrOfIoThreads << " prefetching I/O threads";
+        cout << endl;
+
+        rawVolumeData = decodeVolume<vtkDICOMImageReader>( files, layout, extent[4], extent[5], DecodeSettings{ nbrOfThreads, m_nbrOfIoThreads, m_prefetchQueueDepth },
+                                                           reader, &m_loadStatistics );
+        if( rawVolumeData.Get() == NULL )
+            cout << "DICOM slices differ in size or type - fall back to sequential loading" << endl;
+        else
+            reportLoadStatistics();
+    }
+
+    if( rawVolumeData.Get() == NULL )
+    {
+        reader->Update();
+        rawVolumeData = vtkSmartPointer<vtkImageData>::New();
+        rawVolumeData->ShallowCopy(reader->GetOutput());
+        if( hasVolumeOfInterest() || m_previewStride > 1 )
+            rawVolumeData = extractVolumeOfInterest( rawVolumeData );
+    }
 
     // check if load was successful
-    if( !checkDataLoaded(rawVolumeData) )
+    if( rawVolumeData.Get() == NULL || !checkDataLoaded(rawVolumeData) )
     {
         cerr << "No DICOM data in directory" << endl;
         return NULL;
     }
 
+    storeInCache( cacheKey, rawVolumeData );
+
     cout << endl << endl;
 
     return rawVolumeData;
@@ -80,37 +888,471 @@ vtkSmartPointer<vtkPolyData> VTKDicomRoutines::dicomToMesh(vtkSmartPointer<vtkIm
                                                            bool useUpperThreshold = false, int upperThreshold = 0)
 {
     if(useUpperThreshold)
-    {
         cout << "Create surface mesh with iso value range = " << threshold << " to " << upperThreshold << endl;
+    else
+        cout << "Create surface mesh with iso value = " << threshold << endl;
+
+    IsoRange isoRange;
+    isoRange.threshold = threshold;
+    isoRange.useUpperThreshold = useUpperThreshold;
+    isoRange.upperThreshold = upperThreshold;
+    vtkSmartPointer<vtkPolyData> mesh = meshVolume( imageData, { isoRange } ).front();
 
-        vtkSmartPointer<vtkImageThreshold> imageThreshold = vtkSmartPointer<vtkImageThreshold>::New();
-        imageThreshold->SetInputData(imageData);
-        imageThreshold->ThresholdByUpper(upperThreshold);
-        imageThreshold->ReplaceInOn();
-        imageThreshold->SetInValue(threshold - 1); // mask voxels with a value lower than the lower threshold
-        imageThreshold->Update();
-        imageData->DeepCopy(imageThreshold->GetOutput());
+    cout << endl << endl;
+    return mesh;
+}
+
+std::vector<vtkSmartPointer<vtkPolyData>> VTKDicomRoutines::dicomToMeshes( vtkSmartPointer<vtkImageData> imageData,
+                                                                         const std::vector<IsoRange>& isoRanges )
+{
+    cout << "Create " << isoRanges.size() << " surface meshes with iso values";
+    for( const IsoRange& isoRange : isoRanges )
+    {
+        cout << " " << isoRange.threshold;
+        if( isoRange.useUpperThreshold )
+            cout << " to " << isoRange.upperThreshold;
+        cout << ( &isoRange == &isoRanges.back() ? "" : "," );
     }
-    else
+    cout << endl;
+
+    std::vector<vtkSmartPointer<vtkPolyData>> meshes = meshVolume( imageData, isoRanges );
+
+    cout << endl << endl;
+    return meshes;
+}
+
+VTKVolumeHistogram::Histogram VTKDicomRoutines::computeHistogram( vtkSmartPointer<vtkImageData> imageData, unsigned int nbrOfBins )
+{
+    return VTKVolumeHistogram::compute( imageData, nbrOfBins, m_nbrOfThreads );
+}
+
+std::vector<VTKIsoSurface::SurfaceSize> VTKDicomRoutines::estimateMeshSizes( vtkSmartPointer<vtkImageData> imageData,
+                                                                             const std::vector<IsoRange>& isoRanges )
+{
+    VTKIsoSurface::ActiveBlocks activeBlocks;
+    bool skipEmptySpace = findActiveBlocks( imageData, isoRanges, activeBlocks );
+
+    vtkSmartPointer<vtkAlgorithm> progressReporter;
+    if( m_progressCallback.Get() != NULL )
     {
-        cout << "Create surface mesh with iso value = " << threshold << endl;
+        progressReporter = vtkSmartPointer<vtkAlgorithm>::New();
+        progressReporter->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+    }
+
+    std::vector<VTKIsoSurface::SurfaceSize> sizes = VTKIsoSurface::countTriangles( imageData, isoRanges, m_nbrOfThreads, progressReporter.Get(),
+                                                                                   skipEmptySpace ? &activeBlocks : NULL );
+    if( progressReporter.Get() != NULL )
+        cout << endl;
+    return sizes;
+}
+
+vtkSmartPointer<vtkPolyData> VTKDicomRoutines::labelsToMesh( vtkSmartPointer<vtkImageData> labelData )
+{
+    cout << "Create surface meshes of the labels" << endl;
+
+    vtkSmartPointer<vtkAlgorithm> progressReporter;
+    if( m_progressCallback.Get() != NULL )
+    {
+        progressReporter = vtkSmartPointer<vtkAlgorithm>::New();
+        progressReporter->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+    }
+
+    std::chrono::steady_clock::time_point t_begin = std::chrono::steady_clock::now();
+    vtkSmartPointer<vtkPolyData> mesh = VTKLabelSurfaces::extract( labelData, m_labelSmoothingIterations, m_nbrOfThreads,
+                                                                   progressReporter.Get() );
+    std::chrono::steady_clock::time_point t_end = std::chrono::steady_clock::now();
+    cout << endl << "Label surfaces: " << mesh->GetNumberOfCells() << " triangles in "
+         << std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_begin).count() << " ms" << endl;
+
+    cout << endl << endl;
+    return mesh;
+}
+
+std::map<int, vtkSmartPointer<vtkPolyData>> VTKDicomRoutines::labelsToMeshes( vtkSmartPointer<vtkImageData> labelData )
+{
+    vtkSmartPointer<vtkPolyData> labelledMesh = labelsToMesh( labelData );
+    std::map<int, vtkSmartPointer<vtkPolyData>> meshes = VTKLabelSurfaces::splitByLabel( labelledMesh );
+
+    cout << meshes.size() << " labels:";
+    for( const auto& [label, mesh] : meshes )
+        cout << " " << label << " (" << mesh->GetNumberOfCells() << " triangles)";
+    cout << endl << endl;
+    return meshes;
+}
+
+vtkSmartPointer<vtkPolyData> VTKDicomRoutines::extractSurface( vtkSmartPointer<vtkImageData> imageData, int threshold,
+                                                               bool useUpperThreshold, int upperThreshold, bool computeNormals )
+{
+    IsoRange isoRange;
+    isoRange.threshold = threshold;
+    isoRange.useUpperThreshold = useUpperThreshold;
+    isoRange.upperThreshold = upperThreshold;
+
+    // the slabs are stitched at the marching cubes vertices on their seams
+    if( m_surfaceExtractor == SurfaceExtractor::AdaptiveDualContouring )
+        return runMarchingCubes( imageData, std::vector<IsoRange>{ isoRange }, computeNormals, true, NULL, 0 ).front();
+
+    return extractSurfaces( imageData, std::vector<IsoRange>{ isoRange }, computeNormals, NULL ).front();
+}
+
+std::vector<vtkSmartPointer<vtkPolyData>> VTKDicomRoutines::extractSurfaces( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                                                                           bool computeNormals, const VTKIsoSurface::ActiveBlocks* activeBlocks )
+{
+    if( m_surfaceExtractor == SurfaceExtractor::AdaptiveDualContouring )
+        return extractAdaptiveSurfaces( imageData, isoRanges, activeBlocks );
+
+    if( m_surfaceExtractor == SurfaceExtractor::ParallelMarchingCubes && imageData->GetDimensions()[2] > 2 &&
+        ParallelTools::resolveNumberOfThreads( m_nbrOfThreads ) > 1 )
+        return extractSurfacesInBlocks( imageData, isoRanges, computeNormals, activeBlocks );
+
+    return runMarchingCubes( imageData, isoRanges, computeNormals, true, activeBlocks, 0 );
+}
+
+std::vector<vtkSmartPointer<vtkPolyData>> VTKDicomRoutines::extractAdaptiveSurfaces( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                                                                                   const VTKIsoSurface::ActiveBlocks* activeBlocks ) const
+{
+    vtkSmartPointer<vtkAlgorithm> progressReporter;
+    if( m_progressCallback.Get() != NULL )
+    {
+        progressReporter = vtkSmartPointer<vtkAlgorithm>::New();
+        progressReporter->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+    }
+
+    std::vector<vtkSmartPointer<vtkPolyData>> meshes;
+    for( const IsoRange& isoRange : isoRanges )
+    {
+        VTKDualContouring::Statistics statistics;
+        meshes.push_back( VTKDualContouring::extract( imageData, isoRange, m_dualContouringTolerance, m_nbrOfThreads,
+                                                      progressReporter.Get(), activeBlocks, &statistics ) );
+        cout << endl << "Adaptive dual contouring: " << statistics.nbrOfSurfaceCells << " surface cells merged into "
+             << statistics.nbrOfLeafCells << " cells (tolerance " << m_dualContouringTolerance << ")" << endl;
+    }
+    return meshes;
+}
+
+std::vector<vtkSmartPointer<vtkPolyData>> VTKDicomRoutines::meshVolume( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges )
+{
+    // the smoothed copy is meshed in place of the volume, for all iso ranges
+    vtkSmartPointer<vtkImageData> smoothed;
+    if( m_gaussianSigma > 0.0 )
+    {
+        vtkSmartPointer<vtkAlgorithm> progressReporter;
+        if( m_progressCallback.Get() != NULL )
+        {
+            progressReporter = vtkSmartPointer<vtkAlgorithm>::New();
+            progressReporter->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+        }
+
+        std::chrono::steady_clock::time_point t_begin = std::chrono::steady_clock::now();
+        smoothed = VTKVolumeFilter::gaussian( imageData, m_gaussianSigma, m_nbrOfThreads, progressReporter.Get() );
+        std::chrono::steady_clock::time_point t_end = std::chrono::steady_clock::now();
+        if( smoothed.Get() != NULL )
+        {
+            cout << endl << "Gaussian pre-filter with sigma " << m_gaussianSigma << " mm in "
+                 << std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_begin).count() << " ms" << endl;
+            imageData = smoothed;
+        }
+    }
+
+    VTKIsoSurface::ActiveBlocks activeBlocks;
+    bool skipEmptySpace = findActiveBlocks( imageData, isoRanges, activeBlocks );
+    if( m_smallObjectRatio <= 0.0 )
+        return extractSurfaces( imageData, isoRanges, true, skipEmptySpace ? &activeBlocks : NULL );
+
+    // each iso range has its own components, which are excluded from its surface without copying the volume.
+    // excluding voxels only empties blocks, the active blocks of the volume stay valid.
+    std::vector<IsoRange> filteredRanges = isoRanges;
+    for( IsoRange& isoRange : filteredRanges )
+    {
+        std::chrono::steady_clock::time_point t_begin = std::chrono::steady_clock::now();
+        VTKVoxelComponents::Statistics statistics;
+        std::shared_ptr<const VTKIsoSurface::ExcludedVoxels> excluded = VTKVoxelComponents::findSmallComponents( imageData, isoRange,
+                                                                                                                 m_smallObjectRatio,
+                                                                                                                 m_nbrOfThreads, statistics );
+        std::chrono::steady_clock::time_point t_end = std::chrono::steady_clock::now();
+        if( excluded.get() == NULL )
+            continue;
+
+        cout << "Small objects: " << statistics.nbrOfRemovedComponents << " of " << statistics.nbrOfComponents
+             << " components removed (" << statistics.nbrOfRemovedVoxels << " voxels) in "
+             << std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_begin).count() << " ms" << endl;
+        if( statistics.nbrOfRemovedComponents > 0 )
+            isoRange.excludedVoxels = excluded;
+    }
+
+    return extractSurfaces( imageData, filteredRanges, true, skipEmptySpace ? &activeBlocks : NULL );
+}
+
+bool VTKDicomRoutines::findActiveBlocks( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                                         VTKIsoSurface::ActiveBlocks& activeBlocks )
+{
+    if( !m_useEmptySpaceSkipping )
+        return false;
+
+    // the block ranges serve every threshold as long as the volume does not change
+    if( !m_minMaxBlocks.isBuiltFor( imageData ) )
+    {
+        std::chrono::steady_clock::time_point t_begin = std::chrono::steady_clock::now();
+        if( !m_minMaxBlocks.build( imageData, m_nbrOfThreads ) )
+            return false;
+        std::chrono::steady_clock::time_point t_end = std::chrono::steady_clock::now();
+        cout << "Min/max of " << m_minMaxBlocks.getNumberOfBlocks() << " blocks computed in "
+             << std::chrono::duration_cast<std::chrono::milliseconds>(t_end - t_begin).count() << " ms" << endl;
+    }
+
+    activeBlocks = m_minMaxBlocks.findActiveBlocks( isoRanges );
+    const size_t nbrOfBlocks = activeBlocks.active.size();
+    cout << "Empty space skipping: " << activeBlocks.nbrOfSkippedBlocks << " of " << nbrOfBlocks << " blocks skipped ("
+         << ( nbrOfBlocks > 0 ? 100 * activeBlocks.nbrOfSkippedBlocks / nbrOfBlocks : 0 ) << "%)" << endl;
+    return true;
+}
+
+std::vector<vtkSmartPointer<vtkPolyData>> VTKDicomRoutines::runMarchingCubes( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                                                                            bool computeNormals, bool reportProgress,
+                                                                            const VTKIsoSurface::ActiveBlocks* activeBlocks, int firstSlice ) const
+{
+    if( isoRanges.size() != 1 || isoRanges.front().useUpperThreshold || isoRanges.front().excludedVoxels || activeBlocks != NULL )
+    {
+        // one pass for all surfaces, the voxels above an upper threshold and the excluded voxels are masked while the cubes are classified
+        vtkSmartPointer<vtkAlgorithm> progressReporter;
+        if( reportProgress && m_progressCallback.Get() != NULL )
+        {
+            progressReporter = vtkSmartPointer<vtkAlgorithm>::New();
+            progressReporter->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+        }
+        return VTKIsoSurface::extract( imageData, isoRanges, computeNormals, progressReporter.Get(), activeBlocks, firstSlice );
     }
 
     vtkSmartPointer<vtkMarchingCubes> surfaceExtractor = vtkSmartPointer<vtkMarchingCubes>::New();
-    surfaceExtractor->ComputeNormalsOn();
-    surfaceExtractor->SetValue( 0,threshold ) ;
+    if( computeNormals )
+        surfaceExtractor->ComputeNormalsOn();
+    else
+        surfaceExtractor->ComputeNormalsOff();
+    surfaceExtractor->SetValue( 0, isoRanges.front().threshold ) ;
     surfaceExtractor->SetInputData( imageData );
-    if( m_progressCallback.Get() != NULL )
+    if( reportProgress && m_progressCallback.Get() != NULL )
     {
         surfaceExtractor->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
     }
     surfaceExtractor->Update();
 
     vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
-    mesh->DeepCopy( surfaceExtractor->GetOutput() );
+    mesh->ShallowCopy( surfaceExtractor->GetOutput() );
+    return { mesh };
+}
+
+std::vector<vtkSmartPointer<vtkPolyData>> VTKDicomRoutines::extractSurfacesInBlocks( vtkImageData* imageData, const std::vector<IsoRange>& isoRanges,
+                                                                                   bool computeNormals, const VTKIsoSurface::ActiveBlocks* activeBlocks ) const
+{
+    const unsigned int nbrOfThreads = ParallelTools::resolveNumberOfThreads( m_nbrOfThreads );
+
+    // the blocks are views of a volume with extent starting at 0
+    int dims[3], extent[6];
+    double origin[3], spacing[3];
+    imageData->GetDimensions( dims );
+    imageData->GetExtent( extent );
+    imageData->GetOrigin( origin );
+    imageData->GetSpacing( spacing );
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    volume->ShallowCopy( imageData );
+    volume->SetExtent( 0, dims[0] - 1, 0, dims[1] - 1, 0, dims[2] - 1 );
+    volume->SetOrigin( origin[0] + extent[0] * spacing[0], origin[1] + extent[2] * spacing[1], origin[2] + extent[4] * spacing[2] );
+
+    // a few blocks per thread balance blocks of unequal surface area, neighbouring blocks share one slice
+    const int nbrOfLayers = dims[2] - 1;
+    const int nbrOfBlocks = std::min( nbrOfLayers, int( 4 * nbrOfThreads ) );
+    cout << "Extract the surface in " << nbrOfBlocks << " blocks with " << nbrOfThreads << " threads" << endl;
+
+    vtkSmartPointer<vtkAlgorithm> progressReporter = vtkSmartPointer<vtkAlgorithm>::New();
+    if( m_progressCallback.Get() != NULL )
+    {
+        progressReporter->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+    }
+
+    // each block yields one mesh per iso range
+    std::vector<std::vector<vtkSmartPointer<vtkPolyData>>> blockMeshes( nbrOfBlocks );
+    std::vector<std::array<double,2>> blockSeams( nbrOfBlocks );
+    ParallelTools::parallelFor( 0, size_t(nbrOfBlocks), nbrOfThreads, [&]( size_t b )
+    {
+        const int z0 = int( int64_t(nbrOfLayers) * int64_t(b) / nbrOfBlocks );
+        const int z1 = int( int64_t(nbrOfLayers) * int64_t(b + 1) / nbrOfBlocks );
+        vtkSmartPointer<vtkImageData> block = createSliceView( volume, z0, z1 - z0 + 1 );
+        blockSeams[b] = {{ block->GetOrigin()[2], block->GetOrigin()[2] + ( z1 - z0 ) * spacing[2] }};
+        blockMeshes[b] = runMarchingCubes( block, isoRanges, false, false, activeBlocks, z0 );
+    },
+    [&progressReporter]( double progress )
+    {
+        progressReporter->UpdateProgress( progress );
+    });
+
+    std::vector<vtkSmartPointer<vtkPolyData>> meshes;
+    for( size_t surface = 0; surface < isoRanges.size(); surface++ )
+    {
+        VTKSlabStitcher stitcher;
+        for( int b = 0; b < nbrOfBlocks; b++ )
+        {
+            stitcher.appendSlab( blockMeshes[b][surface], blockSeams[b][0], blockSeams[b][1] );
+            blockMeshes[b][surface] = NULL;
+        }
+        vtkSmartPointer<vtkPolyData> mesh = stitcher.getMesh();
+
+        // the normals of vtkMarchingCubes, computed on the whole volume
+        if( computeNormals )
+        {
+            const IsoRange& isoRange = isoRanges[surface];
+            switch( volume->GetScalarType() )
+            {
+                vtkTemplateMacro( addGradientNormals( mesh.Get(), volume.Get(), static_cast<const VTK_TT*>( volume->GetScalarPointer() ),
+                                                      isoRange.threshold, isoRange.useUpperThreshold, isoRange.upperThreshold, nbrOfThreads ) );
+            }
+        }
+        meshes.push_back( mesh );
+    }
+
+    return meshes;
+}
+
+VTKDicomRoutines::SlabReader VTKDicomRoutines::openDicomSlabs( const std::string& pathToDicom )
+{
+    vtkSmartPointer<SortedDICOMImageReader> reader = vtkSmartPointer<SortedDICOMImageReader>::New();
+    reader->SetDirectoryName( pathToDicom.c_str() );
+    reader->UpdateInformation();
+
+    SlabReader slabReader;
+    std::vector<std::string> files = reader->GetSortedFileNames();
+    SliceLayout layout = readSliceLayout( reader );
+    int extent[6] = { 0, layout.sliceWidth - 1, 0, layout.sliceHeight - 1, 0, int(files.size()) - 1 };
+    if( files.empty() || !restrictToVolumeOfInterest( extent, layout.origin.data(), layout.spacing.data() ) )
+        return slabReader;
+    layout.window = {{ extent[0], extent[1], extent[2], extent[3] }};
+    layout.stride = int( m_previewStride );
+
+    const int firstSlice = extent[4];
+    const DecodeSettings settings{ ParallelTools::resolveNumberOfThreads( m_nbrOfThreads ), m_nbrOfIoThreads, m_prefetchQueueDepth };
+
+    // slabs count the sampled slices
+    slabReader.nbrOfSlices = getNumberOfSampledSlices( extent );
+    slabReader.read = [=]( int zStart, int zEnd )
+    {
+        return decodeVolume<vtkDICOMImageReader>( files, layout, firstSlice + zStart * layout.stride,
+                                                  firstSlice + zEnd * layout.stride, settings, NULL );
+    };
+    return slabReader;
+}
+
+vtkSmartPointer<vtkPolyData> VTKDicomRoutines::meshSlabs( const SlabReader& slabReader, unsigned int slabSize, int threshold,
+                                                          bool useUpperThreshold, int upperThreshold )
+{
+    // a slab of n slices holds n-1 layers of cells, neighbouring slabs share one slice
+    const int nbrOfSlices = slabReader.nbrOfSlices;
+    const int layersPerSlab = std::max( int(slabSize) - 1, 1 );
+    const unsigned int nbrOfThreads = ParallelTools::resolveNumberOfThreads( m_nbrOfThreads );
+
+    if(useUpperThreshold)
+        cout << "Create surface mesh with iso value range = " << threshold << " to " << upperThreshold << endl;
+    else
+        cout << "Create surface mesh with iso value = " << threshold << endl;
+    cout << "Stream " << nbrOfSlices << " slices in slabs of " << layersPerSlab + 1 << " slices" << endl;
+    if( m_surfaceExtractor == SurfaceExtractor::AdaptiveDualContouring )
+        cout << "Adaptive dual contouring needs the whole volume - the slabs are meshed by marching cubes" << endl;
+
+    VTKSlabStitcher stitcher;
+    for( int z0 = 0; z0 < nbrOfSlices - 1; z0 += layersPerSlab )
+    {
+        const int z1 = std::min( z0 + layersPerSlab, nbrOfSlices - 1 );
+
+        // one more slice on each side gives the gradients on the seams
+        const int readStart = std::max( z0 - 1, 0 );
+        const int readEnd = std::min( z1 + 1, nbrOfSlices - 1 );
+
+        cout << "Mesh slices " << z0 << " - " << z1 << endl;
+        vtkSmartPointer<vtkImageData> paddedSlab = slabReader.read( readStart, readEnd );
+        if( paddedSlab.Get() == NULL )
+        {
+            cerr << "Could not read slices " << readStart << " - " << readEnd << endl;
+            return NULL;
+        }
+
+        vtkSmartPointer<vtkImageData> slab = createSliceView( paddedSlab, z0 - readStart, z1 - z0 + 1 );
+        const double lowerSeamZ = slab->GetOrigin()[2];
+        const double upperSeamZ = lowerSeamZ + ( z1 - z0 ) * slab->GetSpacing()[2];
+
+        vtkSmartPointer<vtkPolyData> slabMesh = extractSurface( slab, threshold, useUpperThreshold, upperThreshold, false );
+
+        switch( paddedSlab->GetScalarType() )
+        {
+            vtkTemplateMacro( addGradientNormals( slabMesh.Get(), paddedSlab.Get(), static_cast<const VTK_TT*>( paddedSlab->GetScalarPointer() ),
+                                                  threshold, useUpperThreshold, upperThreshold, nbrOfThreads ) );
+        }
+
+        stitcher.appendSlab( slabMesh, lowerSeamZ, upperSeamZ );
+    }
 
     cout << endl << endl;
-    return mesh;
+    return stitcher.getMesh();
+}
+
+vtkSmartPointer<vtkPolyData> VTKDicomRoutines::dicomToMeshStreamed( const std::string& pathToDicom, unsigned int slabSize,
+                                                                    int threshold, bool useUpperThreshold, int upperThreshold )
+{
+    cout << "Read DICOM images located under " << pathToDicom << endl;
+
+    SlabReader slabReader = openDicomSlabs( pathToDicom );
+    if( slabReader.nbrOfSlices == 0 )
+    {
+        cerr << "No DICOM data in directory" << endl;
+        return NULL;
+    }
+
+    return meshSlabs( slabReader, slabSize, threshold, useUpperThreshold, upperThreshold );
+}
+
+vtkSmartPointer<vtkPolyData> VTKDicomRoutines::pngToMeshStreamed( const std::vector<std::string>& pngPaths,
+        double x_spacing, double y_spacing, double slice_spacing, unsigned int slabSize,
+        int threshold, bool useUpperThreshold, int upperThreshold )
+{
+    for( const std::string& path : pngPaths )
+    {
+        if( !std::filesystem::exists(std::filesystem::path(path)) )
+        {
+            cerr << "PNG file does not exist: " << path  << endl;
+            return NULL;
+        }
+    }
+
+    if( pngPaths.empty() )
+    {
+        cerr << "No PNG data in directory" << endl;
+        return NULL;
+    }
+
+    // the first image of interest defines size and type of every slice
+    vtkSmartPointer<vtkPNGReader> pngReader = vtkSmartPointer<vtkPNGReader>::New();
+    pngReader->SetFileName( pngPaths.at( getFirstSliceOfInterest( pngPaths.size() ) ).c_str() );
+    pngReader->UpdateInformation();
+
+    SliceLayout layout = readPngLayout( pngReader, x_spacing, y_spacing, slice_spacing );
+    int extent[6] = { 0, layout.sliceWidth - 1, 0, layout.sliceHeight - 1, 0, int(pngPaths.size()) - 1 };
+    if( !restrictToVolumeOfInterest( extent, layout.origin.data(), layout.spacing.data() ) )
+    {
+        cerr << "Volume of interest outside of the images" << endl;
+        return NULL;
+    }
+    layout.window = {{ extent[0], extent[1], extent[2], extent[3] }};
+    layout.stride = int( m_previewStride );
+
+    const int firstSlice = extent[4];
+    const DecodeSettings settings{ ParallelTools::resolveNumberOfThreads( m_nbrOfThreads ), m_nbrOfIoThreads, m_prefetchQueueDepth };
+
+    SlabReader slabReader;
+    slabReader.nbrOfSlices = getNumberOfSampledSlices( extent );
+    slabReader.read = [=]( int zStart, int zEnd )
+    {
+        return decodeVolume<vtkPNGReader>( pngPaths, layout, firstSlice + zStart * layout.stride,
+                                           firstSlice + zEnd * layout.stride, settings, NULL );
+    };
+
+    return meshSlabs( slabReader, slabSize, threshold, useUpperThreshold, upperThreshold );
 }
 
 void VTKDicomRoutines::cropDicom( vtkSmartPointer<vtkImageData> imageData )
@@ -144,7 +1386,7 @@ void VTKDicomRoutines::cropDicom( vtkSmartPointer<vtkImageData> imageData )
             cropper->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
         }
         cropper->Update();
-        imageData->DeepCopy( cropper->GetOutput() );
+        imageData->ShallowCopy( cropper->GetOutput() );
 
         cout << endl << endl;
     }
@@ -153,37 +1395,67 @@ void VTKDicomRoutines::cropDicom( vtkSmartPointer<vtkImageData> imageData )
 vtkSmartPointer<vtkImageData> VTKDicomRoutines::loadPngImages( const std::vector<std::string>& pngPaths,
         double x_spacing, double y_spacing, double slice_spacing )
 {
-    vtkSmartPointer<vtkStringArray> files = vtkSmartPointer<vtkStringArray>::New();
-    files->SetNumberOfValues(pngPaths.size());
-
-    // copy existing file paths
-    for( size_t i = 0; i < pngPaths.size(); i++ )
+    // check file paths
+    for( const std::string& path : pngPaths )
     {
-        const std::string& path = pngPaths.at(i);
         if( !std::filesystem::exists(std::filesystem::path(path)) )
         {
             cerr << "PNG file does not exist: " << path  << endl;
             return NULL;
         }
+    }
+
+    if( pngPaths.empty() )
+    {
+        cerr << "No PNG data in directory" << endl;
+        return NULL;
+    }
 
-        files->SetValue(i, path);
+    std::string cacheKey;
+    if( !m_cacheDirectory.empty() )
+    {
+        cacheKey = VTKVolumeCache::computeKey( pngPaths, "vtkPNGReader " + std::to_string(x_spacing) + " " +
+                                               std::to_string(y_spacing) + " " + std::to_string(slice_spacing) +
+                                               getLoadOptionsKey() );
+        vtkSmartPointer<vtkImageData> cachedVolume = loadFromCache( cacheKey );
+        if( cachedVolume.Get() != NULL )
+            return cachedVolume;
     }
 
+    // the first image of interest defines size and type of every slice
     vtkSmartPointer<vtkPNGReader> pngReader = vtkSmartPointer<vtkPNGReader>::New();
-    pngReader->SetFileNames(files);
-    pngReader->SetDataSpacing(x_spacing, y_spacing, slice_spacing);
-    pngReader->SetDataOrigin(0, 0, 0);
-    pngReader->Update();
+    pngReader->SetFileName( pngPaths.at( getFirstSliceOfInterest( pngPaths.size() ) ).c_str() );
+    if( m_progressCallback.Get() != NULL )
+    {
+        pngReader->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+    }
+    pngReader->UpdateInformation();
 
-    vtkSmartPointer<vtkImageData> rawVolumeData = vtkSmartPointer<vtkImageData>::New();
-    rawVolumeData->DeepCopy(pngReader->GetOutput());
+    SliceLayout layout = readPngLayout( pngReader, x_spacing, y_spacing, slice_spacing );
+    int extent[6] = { 0, layout.sliceWidth - 1, 0, layout.sliceHeight - 1, 0, int(pngPaths.size()) - 1 };
+    if( layout.sliceWidth < 1 || layout.sliceHeight < 1 || !restrictToVolumeOfInterest( extent, layout.origin.data(), layout.spacing.data() ) )
+    {
+        cerr << "No PNG data in directory or volume of interest" << endl;
+        return NULL;
+    }
+    layout.window = {{ extent[0], extent[1], extent[2], extent[3] }};
+    layout.stride = int( m_previewStride );
 
-    // check if load was successful
-    if( !checkDataLoaded(rawVolumeData) )
+    // 8 and 16 bit images: vtkPNGReader reports unsigned char or unsigned short.
+    // Only the files within the volume of interest, and with a preview stride
+    // only every stride-th of them, are decoded.
+    unsigned int nbrOfThreads = ParallelTools::resolveNumberOfThreads( m_nbrOfThreads );
+    m_loadStatistics = ParallelTools::PipelineStatistics();
+    vtkSmartPointer<vtkImageData> rawVolumeData = decodeVolume<vtkPNGReader>( pngPaths, layout, extent[4], extent[5], DecodeSettings{ nbrOfThreads, m_nbrOfIoThreads, m_prefetchQueueDepth },
+                                                                              pngReader, &m_loadStatistics );
+    if( rawVolumeData.Get() == NULL )
     {
-        cerr << "No PNG data in directory" << endl;
+        cerr << "PNG images differ in size or type" << endl;
         return NULL;
     }
+    reportLoadStatistics();
+
+    storeInCache( cacheKey, rawVolumeData );
 
     cout << endl << endl;
 
@@ -0,0 +1,302 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "dicomSeriesIndex.h"
+#include "dicomElementStream.h"
+#include "parallelTools.h"
+#include "volumeCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <map>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+#include <cstdlib>
+
+using namespace std;
+
+namespace
+{
+    const char* INDEX_FILE_NAME = ".dicom2mesh-series.idx";
+    const char* INDEX_MAGIC = "D2MSERIES 1";
+
+    // the header is read up to the last of these tags
+    const uint32_t TAG_MODALITY = 0x00080060;
+    const uint32_t TAG_SERIES_DESCRIPTION = 0x0008103E;
+    const uint32_t TAG_PATIENT_ID = 0x00100020;
+    const uint32_t TAG_STUDY_INSTANCE_UID = 0x0020000D;
+    const uint32_t TAG_SERIES_INSTANCE_UID = 0x0020000E;
+    const uint32_t TAG_INSTANCE_NUMBER = 0x00200013;
+    const uint32_t TAG_PIXEL_DATA = 0x7FE00010;
+
+    std::string lowerCase( std::string text )
+    {
+        std::transform( text.begin(), text.end(), text.begin(), []( unsigned char c ) { return char( std::tolower(c) ); } );
+        return text;
+    }
+
+    bool parseCount( const std::string& text, size_t& count )
+    {
+        if( text.empty() || !std::all_of( text.begin(), text.end(), []( unsigned char c ) { return std::isdigit(c); } ) )
+            return false;
+        count = std::strtoul( text.c_str(), NULL, 10 );
+        return true;
+    }
+
+    // index values are stored one per line
+    std::string singleLine( std::string text )
+    {
+        std::replace( text.begin(), text.end(), '\n', ' ' );
+        std::replace( text.begin(), text.end(), '\r', ' ' );
+        return text;
+    }
+}
+
+bool DicomSeriesIndex::readHeader( const std::string& file, HeaderInfo& info )
+{
+    std::ifstream in( file, ios::in | ios::binary );
+    DicomElementStream stream( in );
+    if( !in || !stream.open() )
+        return false;
+
+    uint32_t previousTag = 0;
+    DicomElementStream::ElementHeader header;
+    while( stream.readElementHeader( header ) )
+    {
+        const uint32_t tag = header.tag();
+
+        // tags ascend in a valid data set
+        if( tag < previousTag || header.group == 0xFFFE )
+            return false;
+        previousTag = tag;
+
+        if( tag > TAG_INSTANCE_NUMBER || tag >= TAG_PIXEL_DATA )
+            break;
+
+        bool read = true;
+        std::string instanceNumber;
+        switch( tag )
+        {
+            case TAG_MODALITY: read = stream.readString( header.length, info.modality ); break;
+            case TAG_SERIES_DESCRIPTION: read = stream.readString( header.length, info.seriesDescription ); break;
+            case TAG_PATIENT_ID: read = stream.readString( header.length, info.patientId ); break;
+            case TAG_STUDY_INSTANCE_UID: read = stream.readString( header.length, info.studyInstanceUid ); break;
+            case TAG_SERIES_INSTANCE_UID: read = stream.readString( header.length, info.seriesInstanceUid ); break;
+            case TAG_INSTANCE_NUMBER:
+                read = stream.readString( header.length, instanceNumber );
+                info.instanceNumber = std::atoi( instanceNumber.c_str() );
+                break;
+            default: read = stream.skipValue( header );
+        }
+
+        if( !read )
+            return false;
+    }
+
+    return !info.seriesInstanceUid.empty();
+}
+
+std::string DicomSeriesIndex::getIndexFilePath( const std::string& directory )
+{
+    return ( std::filesystem::path( directory ) / INDEX_FILE_NAME ).string();
+}
+
+std::vector<DicomSeriesIndex::Series> DicomSeriesIndex::indexDirectory( const std::string& directory, unsigned int nbrOfThreads )
+{
+    const std::string indexFile = getIndexFilePath( directory );
+
+    std::vector<std::string> files = VTKVolumeCache::listFiles( directory );
+    files.erase( std::remove_if( files.begin(), files.end(), []( const std::string& file )
+    {
+        return std::filesystem::path( file ).filename() == INDEX_FILE_NAME;
+    }), files.end() );
+
+    std::vector<Series> series;
+    const std::string key = VTKVolumeCache::computeKey( files, INDEX_MAGIC );
+    if( loadIndex( indexFile, key, series ) )
+    {
+        cout << "Use series index " << indexFile << endl;
+        return series;
+    }
+
+    std::vector<HeaderInfo> headers( files.size() );
+    std::vector<char> isDicom( files.size(), 0 );
+    ParallelTools::parallelFor( 0, files.size(), nbrOfThreads, [&]( size_t i )
+    {
+        isDicom[i] = readHeader( files[i], headers[i] ) ? 1 : 0;
+    });
+
+    // group by series uid, in order of the first file of each series
+    std::map<std::string, size_t> seriesByUid;
+    std::vector<std::vector<std::pair<int, std::string>>> seriesFiles;
+    for( size_t i = 0; i < files.size(); i++ )
+    {
+        if( !isDicom[i] )
+            continue;
+
+        const HeaderInfo& header = headers[i];
+        auto entry = seriesByUid.find( header.seriesInstanceUid );
+        if( entry == seriesByUid.end() )
+        {
+            entry = seriesByUid.emplace( header.seriesInstanceUid, series.size() ).first;
+
+            Series newSeries;
+            newSeries.patientId = header.patientId;
+            newSeries.studyInstanceUid = header.studyInstanceUid;
+            newSeries.seriesInstanceUid = header.seriesInstanceUid;
+            newSeries.seriesDescription = header.seriesDescription;
+            newSeries.modality = header.modality;
+            series.push_back( newSeries );
+            seriesFiles.emplace_back();
+        }
+        seriesFiles[entry->second].emplace_back( header.instanceNumber, files[i] );
+    }
+
+    for( size_t s = 0; s < series.size(); s++ )
+    {
+        std::stable_sort( seriesFiles[s].begin(), seriesFiles[s].end(), []( const std::pair<int, std::string>& a, const std::pair<int, std::string>& b )
+        {
+            return a.first < b.first;
+        });
+        for( const auto& file : seriesFiles[s] )
+            series[s].files.push_back( file.second );
+    }
+
+    storeIndex( indexFile, key, series );
+
+    return series;
+}
+
+int DicomSeriesIndex::selectSeries( const std::vector<Series>& series, const std::string& selector )
+{
+    if( selector.empty() )
+        return -1;
+
+    // index
+    if( std::all_of( selector.begin(), selector.end(), []( unsigned char c ) { return std::isdigit(c); } ) )
+    {
+        size_t index = std::strtoul( selector.c_str(), NULL, 10 );
+        if( index < series.size() )
+            return int(index);
+    }
+
+    // series instance uid
+    for( size_t s = 0; s < series.size(); s++ )
+    {
+        if( series[s].seriesInstanceUid == selector )
+            return int(s);
+    }
+
+    // unique part of a description
+    int match = -1;
+    const std::string lowerSelector = lowerCase( selector );
+    for( size_t s = 0; s < series.size(); s++ )
+    {
+        if( lowerCase( series[s].seriesDescription ).find( lowerSelector ) != std::string::npos )
+        {
+            if( match >= 0 )
+            {
+                cerr << "Several DICOM series match " << selector << endl;
+                return -1;
+            }
+            match = int(s);
+        }
+    }
+
+    return match;
+}
+
+bool DicomSeriesIndex::loadIndex( const std::string& indexFile, const std::string& key, std::vector<Series>& series )
+{
+    std::ifstream in( indexFile );
+    if( !in )
+        return false;
+
+    std::string line;
+    if( !std::getline( in, line ) || line != INDEX_MAGIC || !std::getline( in, line ) || line != key )
+        return false;
+
+    std::vector<Series> loaded;
+    size_t nbrOfSeries;
+    if( !std::getline( in, line ) || !parseCount( line, nbrOfSeries ) )
+        return false;
+
+    for( size_t s = 0; s < nbrOfSeries; s++ )
+    {
+        Series entry;
+        if( !std::getline( in, entry.seriesInstanceUid ) || !std::getline( in, entry.seriesDescription ) ||
+            !std::getline( in, entry.modality ) || !std::getline( in, entry.patientId ) ||
+            !std::getline( in, entry.studyInstanceUid ) || !std::getline( in, line ) )
+            return false;
+
+        size_t nbrOfFiles;
+        if( !parseCount( line, nbrOfFiles ) )
+            return false;
+        for( size_t f = 0; f < nbrOfFiles; f++ )
+        {
+            if( !std::getline( in, line ) )
+                return false;
+            entry.files.push_back( line );
+        }
+        loaded.push_back( entry );
+    }
+
+    series.swap( loaded );
+    return true;
+}
+
+bool DicomSeriesIndex::storeIndex( const std::string& indexFile, const std::string& key, const std::vector<Series>& series )
+{
+    // write to a temporary file first, a concurrent reader never sees a partial index
+    std::string tmpFile = indexFile + ".tmp";
+    {
+        std::ofstream out( tmpFile, ios::out | ios::trunc );
+        if( !out )
+            return false;
+
+        out << INDEX_MAGIC << "\n" << key << "\n" << series.size() << "\n";
+        for( const Series& entry : series )
+        {
+            out << singleLine( entry.seriesInstanceUid ) << "\n" << singleLine( entry.seriesDescription ) << "\n"
+                << singleLine( entry.modality ) << "\n" << singleLine( entry.patientId ) << "\n"
+                << singleLine( entry.studyInstanceUid ) << "\n" << entry.files.size() << "\n";
+            for( const std::string& file : entry.files )
+                out << file << "\n";
+        }
+
+        if( !out )
+        {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove( tmpFile, ec );
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename( tmpFile, indexFile, ec );
+    return !ec;
+}
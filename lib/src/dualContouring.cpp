@@ -0,0 +1,916 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "dualContouring.h"
+#include "parallelTools.h"
+#include "cellClassifier.h"
+
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkVersion.h>
+#include <vtkFloatArray.h>
+#include <vtkDataArray.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    /*
+     * Corners and children of a cell are numbered (x << 2) | (y << 1) | z.
+     * The contouring tables follow the dual contouring of Ju et al. 2002.
+     */
+
+    const int edgeCorners[12][2] = {
+        {0,4},{1,5},{2,6},{3,7},    // x-axis
+        {0,2},{1,3},{4,6},{5,7},    // y-axis
+        {0,1},{2,3},{4,5},{6,7}     // z-axis
+    };
+
+    const int cellProcFaceMask[12][3] = {
+        {0,4,0},{1,5,0},{2,6,0},{3,7,0},{0,2,1},{4,6,1},{1,3,1},{5,7,1},{0,1,2},{2,3,2},{4,5,2},{6,7,2}
+    };
+
+    const int cellProcEdgeMask[6][5] = {
+        {0,1,2,3,0},{4,5,6,7,0},{0,4,1,5,1},{2,6,3,7,1},{0,2,4,6,2},{1,3,5,7,2}
+    };
+
+    const int faceProcFaceMask[3][4][3] = {
+        {{4,0,0},{5,1,0},{6,2,0},{7,3,0}},
+        {{2,0,1},{6,4,1},{3,1,1},{7,5,1}},
+        {{1,0,2},{3,2,2},{5,4,2},{7,6,2}}
+    };
+
+    const int faceProcEdgeMask[3][4][6] = {
+        {{1,4,0,5,1,1},{1,6,2,7,3,1},{0,4,6,0,2,2},{0,5,7,1,3,2}},
+        {{0,2,3,0,1,0},{0,6,7,4,5,0},{1,2,0,6,4,2},{1,3,1,7,5,2}},
+        {{1,1,0,3,2,0},{1,5,4,7,6,0},{0,1,5,0,4,1},{0,3,7,2,6,1}}
+    };
+
+    const int edgeProcEdgeMask[3][2][5] = {
+        {{3,2,1,0,0},{7,6,5,4,0}},
+        {{5,1,4,0,1},{7,3,6,2,1}},
+        {{6,4,2,0,2},{7,5,3,1,2}}
+    };
+
+    const int processEdgeMask[3][4] = { {3,2,1,0}, {7,5,6,4}, {11,10,9,8} };
+
+    // bits of the corners at the lower and upper x of a cell in the index of classifyCells, per voxel row
+    const unsigned char lowerCornerBits[4] = { 1, 4, 16, 64 };
+    const unsigned char upperCornerBits[4] = { 2, 8, 32, 128 };
+
+    /**
+     * Quadratic error of a point to a set of tangent planes, relative to the volume origin.
+     */
+    struct Qef
+    {
+        double ata[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };  // xx, xy, xz, yy, yz, zz
+        double atb[3] = { 0.0, 0.0, 0.0 };
+        double btb = 0.0;
+        double pointSum[3] = { 0.0, 0.0, 0.0 };
+        double normalSum[3] = { 0.0, 0.0, 0.0 };
+        int nbrOfPoints = 0;
+
+        void add( const double p[3], const double n[3] )
+        {
+            const double b = n[0] * p[0] + n[1] * p[1] + n[2] * p[2];
+            ata[0] += n[0] * n[0]; ata[1] += n[0] * n[1]; ata[2] += n[0] * n[2];
+            ata[3] += n[1] * n[1]; ata[4] += n[1] * n[2]; ata[5] += n[2] * n[2];
+            for( int a = 0; a < 3; a++ )
+            {
+                atb[a] += n[a] * b;
+                pointSum[a] += p[a];
+                normalSum[a] += n[a];
+            }
+            btb += b * b;
+            nbrOfPoints++;
+        }
+
+        void add( const Qef& other )
+        {
+            for( int a = 0; a < 6; a++ )
+                ata[a] += other.ata[a];
+            for( int a = 0; a < 3; a++ )
+            {
+                atb[a] += other.atb[a];
+                pointSum[a] += other.pointSum[a];
+                normalSum[a] += other.normalSum[a];
+            }
+            btb += other.btb;
+            nbrOfPoints += other.nbrOfPoints;
+        }
+
+        double getError( const double x[3] ) const
+        {
+            const double ax[3] = { ata[0] * x[0] + ata[1] * x[1] + ata[2] * x[2],
+                                   ata[1] * x[0] + ata[3] * x[1] + ata[4] * x[2],
+                                   ata[2] * x[0] + ata[4] * x[1] + ata[5] * x[2] };
+            const double error = x[0] * ( ax[0] - 2.0 * atb[0] ) + x[1] * ( ax[1] - 2.0 * atb[1] ) + x[2] * ( ax[2] - 2.0 * atb[2] ) + btb;
+            return std::max( error, 0.0 );
+        }
+
+        /**
+         * Minimizes the error with a truncated pseudo-inverse around the mass point.
+         * Vertices outside of the cell are replaced by the mass point.
+         * @return Error at the vertex.
+         */
+        double solve( const double cellMin[3], const double cellMax[3], double x[3] ) const
+        {
+            double massPoint[3];
+            for( int a = 0; a < 3; a++ )
+                massPoint[a] = pointSum[a] / nbrOfPoints;
+
+            double m[3][3] = { { ata[0], ata[1], ata[2] }, { ata[1], ata[3], ata[4] }, { ata[2], ata[4], ata[5] } };
+            double v[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+            diagonalize( m, v );
+
+            // right hand side relative to the mass point
+            const double am[3] = { ata[0] * massPoint[0] + ata[1] * massPoint[1] + ata[2] * massPoint[2],
+                                   ata[1] * massPoint[0] + ata[3] * massPoint[1] + ata[4] * massPoint[2],
+                                   ata[2] * massPoint[0] + ata[4] * massPoint[1] + ata[5] * massPoint[2] };
+            const double r[3] = { atb[0] - am[0], atb[1] - am[1], atb[2] - am[2] };
+
+            const double largest = std::max( { std::fabs(m[0][0]), std::fabs(m[1][1]), std::fabs(m[2][2]) } );
+            for( int a = 0; a < 3; a++ )
+                x[a] = massPoint[a];
+            for( int e = 0; e < 3; e++ )
+            {
+                // directions the planes hardly constrain keep the mass point
+                if( std::fabs( m[e][e] ) < 0.1 * largest || largest <= 0.0 )
+                    continue;
+                const double c = ( v[0][e] * r[0] + v[1][e] * r[1] + v[2][e] * r[2] ) / m[e][e];
+                for( int a = 0; a < 3; a++ )
+                    x[a] += c * v[a][e];
+            }
+
+            for( int a = 0; a < 3; a++ )
+            {
+                if( x[a] < cellMin[a] || x[a] > cellMax[a] )
+                {
+                    std::copy( massPoint, massPoint + 3, x );
+                    break;
+                }
+            }
+            return getError( x );
+        }
+
+        /**
+         * Jacobi eigenvalue iteration of a symmetric 3x3 matrix. The eigenvalues
+         * end up on the diagonal of m, the eigenvectors in the columns of v.
+         */
+        static void diagonalize( double m[3][3], double v[3][3] )
+        {
+            for( int sweep = 0; sweep < 20; sweep++ )
+            {
+                const double offDiagonal = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+                if( offDiagonal < 1e-24 )
+                    return;
+
+                for( int p = 0; p < 2; p++ )
+                {
+                    for( int q = p + 1; q < 3; q++ )
+                    {
+                        if( m[p][q] == 0.0 )
+                            continue;
+
+                        const double theta = ( m[q][q] - m[p][p] ) / ( 2.0 * m[p][q] );
+                        const double t = ( theta >= 0.0 ? 1.0 : -1.0 ) / ( std::fabs(theta) + std::sqrt( theta * theta + 1.0 ) );
+                        const double c = 1.0 / std::sqrt( t * t + 1.0 );
+                        const double s = t * c;
+
+                        for( int k = 0; k < 3; k++ )
+                        {
+                            const double mkp = m[k][p];
+                            const double mkq = m[k][q];
+                            m[k][p] = c * mkp - s * mkq;
+                            m[k][q] = s * mkp + c * mkq;
+                        }
+                        for( int k = 0; k < 3; k++ )
+                        {
+                            const double mpk = m[p][k];
+                            const double mqk = m[q][k];
+                            m[p][k] = c * mpk - s * mqk;
+                            m[q][k] = s * mpk + c * mqk;
+                        }
+                        for( int k = 0; k < 3; k++ )
+                        {
+                            const double vkp = v[k][p];
+                            const double vkq = v[k][q];
+                            v[k][p] = c * vkp - s * vkq;
+                            v[k][q] = s * vkp + c * vkq;
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    /**
+     * Node of the octree. Leaves hold a vertex, internal nodes up to eight children.
+     */
+    struct Node
+    {
+        uint64_t key = 0;           // interleaved cell coordinates at the level of the node
+        int level = 0;              // edge length 2^level voxel cells
+        bool isLeaf = true;
+        unsigned char corners = 0;  // bit c is set if corner c is inside
+        std::array<int,8> children = {{ -1, -1, -1, -1, -1, -1, -1, -1 }};
+        Qef qef;
+        double vertex[3] = { 0.0, 0.0, 0.0 };
+    };
+
+    uint64_t encodeKey( int x, int y, int z )
+    {
+        uint64_t key = 0;
+        for( int b = 0; b < 21; b++ )
+        {
+            key |= uint64_t( ( x >> b ) & 1 ) << ( 3 * b + 2 );
+            key |= uint64_t( ( y >> b ) & 1 ) << ( 3 * b + 1 );
+            key |= uint64_t( ( z >> b ) & 1 ) << ( 3 * b );
+        }
+        return key;
+    }
+
+    void decodeKey( uint64_t key, int cell[3] )
+    {
+        cell[0] = cell[1] = cell[2] = 0;
+        for( int b = 0; b < 21; b++ )
+        {
+            cell[0] |= int( ( key >> ( 3 * b + 2 ) ) & 1 ) << b;
+            cell[1] |= int( ( key >> ( 3 * b + 1 ) ) & 1 ) << b;
+            cell[2] |= int( ( key >> ( 3 * b ) ) & 1 ) << b;
+        }
+    }
+
+    /**
+     * Tells for each sign configuration of a cell if its inside corners and its
+     * outside corners are each connected along the cell edges, so that one vertex
+     * represents the surface within the cell.
+     */
+    const std::array<bool,256>& getManifoldTable()
+    {
+        static const std::array<bool,256> table = []()
+        {
+            std::array<bool,256> manifold;
+            for( int config = 0; config < 256; config++ )
+            {
+                manifold[config] = true;
+                for( int inside = 0; inside < 2; inside++ )
+                {
+                    // flood fill the corners of one side from its first corner
+                    int side = inside ? config : ( ~config & 0xff );
+                    if( side == 0 )
+                        continue;
+                    int reached = side & -side;
+                    for( int step = 0; step < 8; step++ )
+                        for( int c = 0; c < 8; c++ )
+                            if( reached & ( 1 << c ) )
+                                for( int a = 0; a < 3; a++ )
+                                    reached |= side & ( 1 << ( c ^ ( 1 << a ) ) );
+                    if( reached != side )
+                        manifold[config] = false;
+                }
+            }
+            return manifold;
+        }();
+        return table;
+    }
+
+    /**
+     * Octree of the cells the surface crosses.
+     */
+    struct Octree
+    {
+        std::vector<Node> nodes;
+        int root = -1;
+    };
+
+    /**
+     * Samples the sign of the voxels and builds the octree bottom-up.
+     */
+    template<class T>
+    class OctreeBuilder
+    {
+    public:
+        OctreeBuilder( const T* voxels, const int dims[3], const double spacing[3], const VTKIsoSurface::IsoRange& isoRange,
+                       double tolerance, unsigned int nbrOfThreads )
+            : m_voxels( voxels ), m_band( isoRange.threshold, isoRange.useUpperThreshold, isoRange.upperThreshold ),
+              m_excludedVoxels( isoRange.excludedVoxels.get() ), m_value( double(isoRange.threshold) ), m_tolerance( tolerance ),
+              m_nbrOfThreads( nbrOfThreads )
+        {
+            std::copy( dims, dims + 3, m_dims );
+            std::copy( spacing, spacing + 3, m_spacing );
+            m_sliceSize = vtkIdType(dims[0]) * vtkIdType(dims[1]);
+        }
+
+        void build( Octree& octree, const VTKIsoSurface::ActiveBlocks* activeBlocks, const std::function<void(double)>& progress )
+        {
+            std::vector<std::pair<uint64_t,int>> level;
+            findSurfaceCells( octree, activeBlocks, level, progress );
+
+            int maxLevel = 0;
+            while( ( 1 << maxLevel ) < std::max( { m_dims[0] - 1, m_dims[1] - 1, m_dims[2] - 1 } ) )
+                maxLevel++;
+
+            for( int l = 0; l < maxLevel && !level.empty(); l++ )
+                level = buildParents( octree, level, l + 1 );
+
+            octree.root = level.empty() ? -1 : level.front().second;
+        }
+
+    private:
+
+        double sample( int i, int j, int k ) const
+        {
+            // an excluded voxel counts just below the iso value
+            if( m_excludedVoxels != NULL && m_excludedVoxels->contains( size_t(k) * size_t(m_dims[1]) + size_t(j), i ) )
+                return m_value - 1.0;
+            return m_band( m_voxels[i + j * m_dims[0] + k * m_sliceSize] );
+        }
+
+        bool isInside( int i, int j, int k ) const
+        {
+            return sample( i, j, k ) >= m_value;
+        }
+
+        /**
+         * Outward normal at a voxel, the negative gradient by central differences
+         * inside the volume and one-sided differences on its border.
+         */
+        void computeNormal( const int p[3], double n[3] ) const
+        {
+            const vtkIdType strides[3] = { 1, m_dims[0], m_sliceSize };
+            const vtkIdType center = p[0] + p[1] * strides[1] + p[2] * strides[2];
+            for( int a = 0; a < 3; a++ )
+            {
+                const int lower = p[a] > 0 ? 1 : 0;
+                const int upper = p[a] < m_dims[a] - 1 ? 1 : 0;
+                n[a] = ( m_band( m_voxels[center - lower * strides[a]] ) - m_band( m_voxels[center + upper * strides[a]] ) ) /
+                       ( ( lower + upper ) * m_spacing[a] );
+            }
+        }
+
+        /**
+         * Tells for a run of cells whether the surface crosses them, by their marching
+         * cubes case index. The four voxel rows of the cells start at the first cell.
+         * 16 bit voxels are classified with SIMD instructions, all others voxel by voxel.
+         */
+        void classifyCells( const T* const rows[4], size_t nbrOfCells, unsigned char* indices ) const
+        {
+            if constexpr( std::is_same<T, short>::value || std::is_same<T, unsigned short>::value )
+            {
+                double lower, upper;
+                m_band.getInsideRange( m_value, lower, upper );
+                VTKCellClassifier::computeCubeIndices( rows, nbrOfCells, lower, upper, indices );
+            }
+            else
+            {
+                for( size_t i = 0; i < nbrOfCells; i++ )
+                {
+                    int index = 0;
+                    for( int r = 0; r < 4; r++ )
+                    {
+                        index |= ( m_band( rows[r][i] ) >= m_value ? 1 : 0 ) << ( 2 * r );
+                        index |= ( m_band( rows[r][i + 1] ) >= m_value ? 2 : 0 ) << ( 2 * r );
+                    }
+                    indices[i] = (unsigned char)index;
+                }
+            }
+        }
+
+        /**
+         * Creates the leaf of a voxel cell the surface crosses, with the tangent
+         * planes at its edge intersections.
+         */
+        Node createLeaf( int i, int j, int k ) const
+        {
+            double values[8];
+            Node node;
+            node.key = encodeKey( i, j, k );
+            for( int c = 0; c < 8; c++ )
+            {
+                values[c] = sample( i + ( ( c >> 2 ) & 1 ), j + ( ( c >> 1 ) & 1 ), k + ( c & 1 ) );
+                if( values[c] >= m_value )
+                    node.corners |= (unsigned char)( 1 << c );
+            }
+
+            for( int e = 0; e < 12; e++ )
+            {
+                const int c0 = edgeCorners[e][0];
+                const int c1 = edgeCorners[e][1];
+                if( ( ( node.corners >> c0 ) & 1 ) == ( ( node.corners >> c1 ) & 1 ) )
+                    continue;
+
+                const int p0[3] = { i + ( ( c0 >> 2 ) & 1 ), j + ( ( c0 >> 1 ) & 1 ), k + ( c0 & 1 ) };
+                const int p1[3] = { i + ( ( c1 >> 2 ) & 1 ), j + ( ( c1 >> 1 ) & 1 ), k + ( c1 & 1 ) };
+                const double t = ( m_value - values[c0] ) / ( values[c1] - values[c0] );
+                double n0[3], n1[3], p[3], n[3];
+                computeNormal( p0, n0 );
+                computeNormal( p1, n1 );
+                for( int a = 0; a < 3; a++ )
+                {
+                    p[a] = ( p0[a] + t * ( p1[a] - p0[a] ) ) * m_spacing[a];
+                    n[a] = n0[a] + t * ( n1[a] - n0[a] );
+                }
+                const double length = std::sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+                if( length > 0.0 )
+                {
+                    for( int a = 0; a < 3; a++ )
+                        n[a] /= length;
+                    node.qef.add( p, n );
+                }
+            }
+
+            // a cell whose intersections lack normals keeps its center
+            if( node.qef.nbrOfPoints == 0 )
+            {
+                const double p[3] = { ( i + 0.5 ) * m_spacing[0], ( j + 0.5 ) * m_spacing[1], ( k + 0.5 ) * m_spacing[2] };
+                const double n[3] = { 0.0, 0.0, 0.0 };
+                node.qef.add( p, n );
+            }
+
+            const double cellMin[3] = { i * m_spacing[0], j * m_spacing[1], k * m_spacing[2] };
+            const double cellMax[3] = { ( i + 1 ) * m_spacing[0], ( j + 1 ) * m_spacing[1], ( k + 1 ) * m_spacing[2] };
+            node.qef.solve( cellMin, cellMax, node.vertex );
+            return node;
+        }
+
+        /**
+         * Creates a leaf for each voxel cell the surface crosses. One slice of cells per task.
+         */
+        void findSurfaceCells( Octree& octree, const VTKIsoSurface::ActiveBlocks* activeBlocks,
+                               std::vector<std::pair<uint64_t,int>>& level, const std::function<void(double)>& progress )
+        {
+            const int nbrOfRowCells = m_dims[0] - 1;
+            std::vector<std::vector<Node>> slices( m_dims[2] - 1 );
+            ParallelTools::parallelFor( 0, slices.size(), m_nbrOfThreads, [&]( size_t slice )
+            {
+                const int k = int( slice );
+                std::vector<unsigned char> indices( nbrOfRowCells );
+                for( int j = 0; j < m_dims[1] - 1; j++ )
+                {
+                    const char* activeRow = NULL;
+                    int blockSize = nbrOfRowCells;
+                    if( activeBlocks != NULL )
+                    {
+                        blockSize = activeBlocks->blockSize;
+                        activeRow = activeBlocks->active.data() +
+                                    ( size_t( k / blockSize ) * activeBlocks->nbrOfBlocks[1] + j / blockSize ) * activeBlocks->nbrOfBlocks[0];
+                    }
+
+                    const T* row = m_voxels + j * m_dims[0] + k * m_sliceSize;
+                    const T* rows[4] = { row, row + m_dims[0], row + m_sliceSize, row + m_dims[0] + m_sliceSize };
+                    const size_t rowIndex = size_t(k) * size_t(m_dims[1]) + size_t(j);
+                    const size_t rowIndices[4] = { rowIndex, rowIndex + 1, rowIndex + size_t(m_dims[1]), rowIndex + size_t(m_dims[1]) + 1 };
+                    for( int runBegin = 0; runBegin < nbrOfRowCells; )
+                    {
+                        if( activeRow != NULL && !activeRow[runBegin / blockSize] )
+                        {
+                            runBegin += blockSize;
+                            continue;
+                        }
+                        int runEnd = runBegin + blockSize;
+                        while( runEnd < nbrOfRowCells && ( activeRow == NULL || activeRow[runEnd / blockSize] ) )
+                            runEnd += blockSize;
+                        runEnd = std::min( runEnd, nbrOfRowCells );
+
+                        const T* runRows[4] = { rows[0] + runBegin, rows[1] + runBegin, rows[2] + runBegin, rows[3] + runBegin };
+                        classifyCells( runRows, size_t( runEnd - runBegin ), indices.data() );
+                        if( m_excludedVoxels != NULL )
+                            m_excludedVoxels->clearCorners( rowIndices, runBegin, runEnd, lowerCornerBits, upperCornerBits, indices.data() );
+                        for( int i = runBegin; i < runEnd; i++ )
+                        {
+                            const unsigned char index = indices[i - runBegin];
+                            if( index != 0 && index != 0xff )
+                                slices[slice].push_back( createLeaf( i, j, k ) );
+                        }
+                        runBegin = runEnd;
+                    }
+                }
+            }, progress );
+
+            size_t nbrOfCells = 0;
+            for( const std::vector<Node>& slice : slices )
+                nbrOfCells += slice.size();
+            octree.nodes.reserve( nbrOfCells + nbrOfCells / 2 );
+            for( std::vector<Node>& slice : slices )
+            {
+                octree.nodes.insert( octree.nodes.end(), slice.begin(), slice.end() );
+                std::vector<Node>().swap( slice );
+            }
+
+            // sorted keys place the children of a parent next to each other
+            level.resize( octree.nodes.size() );
+            for( size_t n = 0; n < octree.nodes.size(); n++ )
+                level[n] = std::make_pair( octree.nodes[n].key, int(n) );
+            std::sort( level.begin(), level.end() );
+        }
+
+        /**
+         * Creates the parents of the nodes of a level. A parent becomes a leaf if
+         * its children are leaves and merging them keeps the error and the topology.
+         */
+        std::vector<std::pair<uint64_t,int>> buildParents( Octree& octree, const std::vector<std::pair<uint64_t,int>>& children, int level )
+        {
+            std::vector<size_t> groupStart;
+            for( size_t c = 0; c < children.size(); c++ )
+                if( c == 0 || ( children[c].first >> 3 ) != ( children[c - 1].first >> 3 ) )
+                    groupStart.push_back( c );
+            groupStart.push_back( children.size() );
+
+            const size_t nbrOfParents = groupStart.size() - 1;
+            const size_t firstParent = octree.nodes.size();
+            octree.nodes.resize( firstParent + nbrOfParents );
+
+            ParallelTools::parallelFor( 0, nbrOfParents, m_nbrOfThreads, [&]( size_t g )
+            {
+                Node& parent = octree.nodes[firstParent + g];
+                parent.key = children[groupStart[g]].first >> 3;
+                parent.level = level;
+                bool childrenAreLeaves = true;
+                for( size_t c = groupStart[g]; c < groupStart[g + 1]; c++ )
+                {
+                    const Node& child = octree.nodes[children[c].second];
+                    parent.children[children[c].first & 7] = children[c].second;
+                    parent.qef.add( child.qef );
+                    childrenAreLeaves = childrenAreLeaves && child.isLeaf;
+                }
+                parent.isLeaf = childrenAreLeaves && m_tolerance > 0.0 && collapse( parent );
+            });
+
+            std::vector<std::pair<uint64_t,int>> parents( nbrOfParents );
+            for( size_t g = 0; g < nbrOfParents; g++ )
+                parents[g] = std::make_pair( octree.nodes[firstParent + g].key, int( firstParent + g ) );
+            return parents;
+        }
+
+        /**
+         * Places the vertex of a merged cell, if the merge keeps the topology of the surface
+         * and the error within the tolerance.
+         */
+        bool collapse( Node& node ) const
+        {
+            int cell[3];
+            decodeKey( node.key, cell );
+            const int size = 1 << node.level;
+            const int half = size / 2;
+            for( int a = 0; a < 3; a++ )
+                if( ( cell[a] + 1 ) * size > m_dims[a] - 1 )
+                    return false;
+
+            // signs at the corners, edge midpoints, face centers and the center of the cell
+            bool inside[3][3][3];
+            for( int u = 0; u < 3; u++ )
+                for( int v = 0; v < 3; v++ )
+                    for( int w = 0; w < 3; w++ )
+                        inside[u][v][w] = isInside( cell[0] * size + u * half, cell[1] * size + v * half, cell[2] * size + w * half );
+
+            unsigned char corners = 0;
+            for( int c = 0; c < 8; c++ )
+                if( inside[2 * ( ( c >> 2 ) & 1 )][2 * ( ( c >> 1 ) & 1 )][2 * ( c & 1 )] )
+                    corners |= (unsigned char)( 1 << c );
+            if( !getManifoldTable()[corners] )
+                return false;
+
+            // a sample agreeing with none of the corners it lies between would be lost
+            for( int u = 0; u < 3; u++ )
+                for( int v = 0; v < 3; v++ )
+                    for( int w = 0; w < 3; w++ )
+                    {
+                        if( u != 1 && v != 1 && w != 1 )
+                            continue;
+
+                        bool agrees = false;
+                        for( int c = 0; c < 8 && !agrees; c++ )
+                        {
+                            const int cu = 2 * ( ( c >> 2 ) & 1 ), cv = 2 * ( ( c >> 1 ) & 1 ), cw = 2 * ( c & 1 );
+                            const bool spans = ( u == 1 || u == cu ) && ( v == 1 || v == cv ) && ( w == 1 || w == cw );
+                            agrees = spans && inside[cu][cv][cw] == inside[u][v][w];
+                        }
+                        if( !agrees )
+                            return false;
+                    }
+
+            const double cellMin[3] = { cell[0] * size * m_spacing[0], cell[1] * size * m_spacing[1], cell[2] * size * m_spacing[2] };
+            const double cellMax[3] = { ( cell[0] + 1 ) * size * m_spacing[0], ( cell[1] + 1 ) * size * m_spacing[1],
+                                        ( cell[2] + 1 ) * size * m_spacing[2] };
+            const double error = node.qef.solve( cellMin, cellMax, node.vertex );
+            if( error > m_tolerance * m_tolerance * node.qef.nbrOfPoints )
+                return false;
+
+            node.corners = corners;
+            return true;
+        }
+
+        const T* m_voxels;
+        const VTKIsoSurface::Band<T> m_band;
+        const VTKIsoSurface::ExcludedVoxels* m_excludedVoxels;
+        const double m_value;
+        const double m_tolerance;
+        const unsigned int m_nbrOfThreads;
+        int m_dims[3];
+        double m_spacing[3];
+        vtkIdType m_sliceSize;
+    };
+
+    /**
+     * Connects the vertices of the leaves around each edge the surface crosses
+     * by two triangles, recursing over the cells, faces and edges of the octree.
+     */
+    class Contourer
+    {
+    public:
+        Contourer( const Octree& octree ) : m_octree( octree ), m_pointIds( octree.nodes.size(), -1 )
+        {
+        }
+
+        void contour( std::vector<int>& leaves, std::vector<vtkIdType>& triangles )
+        {
+            m_leaves = &leaves;
+            m_triangles = &triangles;
+            if( m_octree.root >= 0 )
+                cellProc( m_octree.root );
+        }
+
+    private:
+
+        const Node* getNode( int index ) const
+        {
+            return index < 0 ? NULL : &m_octree.nodes[index];
+        }
+
+        int getChild( int index, int child ) const
+        {
+            return m_octree.nodes[index].isLeaf ? index : m_octree.nodes[index].children[child];
+        }
+
+        void cellProc( int index )
+        {
+            const Node* node = getNode( index );
+            if( node == NULL || node->isLeaf )
+                return;
+
+            for( int c = 0; c < 8; c++ )
+                cellProc( node->children[c] );
+
+            for( int f = 0; f < 12; f++ )
+            {
+                const int faceNodes[2] = { node->children[cellProcFaceMask[f][0]], node->children[cellProcFaceMask[f][1]] };
+                faceProc( faceNodes, cellProcFaceMask[f][2] );
+            }
+
+            for( int e = 0; e < 6; e++ )
+            {
+                int edgeNodes[4];
+                for( int n = 0; n < 4; n++ )
+                    edgeNodes[n] = node->children[cellProcEdgeMask[e][n]];
+                edgeProc( edgeNodes, cellProcEdgeMask[e][4] );
+            }
+        }
+
+        void faceProc( const int nodes[2], int dir )
+        {
+            if( nodes[0] < 0 || nodes[1] < 0 )
+                return;
+            if( m_octree.nodes[nodes[0]].isLeaf && m_octree.nodes[nodes[1]].isLeaf )
+                return;
+
+            for( int f = 0; f < 4; f++ )
+            {
+                const int faceNodes[2] = { getChild( nodes[0], faceProcFaceMask[dir][f][0] ), getChild( nodes[1], faceProcFaceMask[dir][f][1] ) };
+                faceProc( faceNodes, faceProcFaceMask[dir][f][2] );
+            }
+
+            const int orders[2][4] = { { 0, 0, 1, 1 }, { 0, 1, 0, 1 } };
+            for( int e = 0; e < 4; e++ )
+            {
+                const int* order = orders[faceProcEdgeMask[dir][e][0]];
+                int edgeNodes[4];
+                for( int n = 0; n < 4; n++ )
+                    edgeNodes[n] = getChild( nodes[order[n]], faceProcEdgeMask[dir][e][n + 1] );
+                edgeProc( edgeNodes, faceProcEdgeMask[dir][e][5] );
+            }
+        }
+
+        void edgeProc( const int nodes[4], int dir )
+        {
+            for( int n = 0; n < 4; n++ )
+                if( nodes[n] < 0 )
+                    return;
+
+            bool allLeaves = true;
+            for( int n = 0; n < 4; n++ )
+                allLeaves = allLeaves && m_octree.nodes[nodes[n]].isLeaf;
+            if( allLeaves )
+            {
+                processEdge( nodes, dir );
+                return;
+            }
+
+            for( int e = 0; e < 2; e++ )
+            {
+                int edgeNodes[4];
+                for( int n = 0; n < 4; n++ )
+                    edgeNodes[n] = getChild( nodes[n], edgeProcEdgeMask[dir][e][n] );
+                edgeProc( edgeNodes, edgeProcEdgeMask[dir][e][4] );
+            }
+        }
+
+        /**
+         * Emits the quad of the edge, if the smallest of the four leaves sees a sign change on it.
+         */
+        void processEdge( const int nodes[4], int dir )
+        {
+            int smallest = 0;
+            for( int n = 1; n < 4; n++ )
+                if( m_octree.nodes[nodes[n]].level < m_octree.nodes[nodes[smallest]].level )
+                    smallest = n;
+
+            const Node& node = m_octree.nodes[nodes[smallest]];
+            const int edge = processEdgeMask[dir][smallest];
+            const int inside0 = ( node.corners >> edgeCorners[edge][0] ) & 1;
+            const int inside1 = ( node.corners >> edgeCorners[edge][1] ) & 1;
+            if( ( inside0 ^ inside1 ) == 0 )
+                return;
+
+            vtkIdType ids[4];
+            for( int n = 0; n < 4; n++ )
+                ids[n] = getPointId( nodes[n] );
+
+            // the triangles face the outside, which lies towards the lower end if it is inside
+            if( inside0 != 0 )
+            {
+                addTriangle( ids[0], ids[3], ids[1] );
+                addTriangle( ids[0], ids[2], ids[3] );
+            }
+            else
+            {
+                addTriangle( ids[0], ids[1], ids[3] );
+                addTriangle( ids[0], ids[3], ids[2] );
+            }
+        }
+
+        /**
+         * Adds a triangle, unless two of its corners are the vertex of the same coarse leaf.
+         */
+        void addTriangle( vtkIdType a, vtkIdType b, vtkIdType c )
+        {
+            if( a == b || b == c || a == c )
+                return;
+            m_triangles->push_back( a );
+            m_triangles->push_back( b );
+            m_triangles->push_back( c );
+        }
+
+        vtkIdType getPointId( int index )
+        {
+            if( m_pointIds[index] < 0 )
+            {
+                m_pointIds[index] = vtkIdType( m_leaves->size() );
+                m_leaves->push_back( index );
+            }
+            return m_pointIds[index];
+        }
+
+        const Octree& m_octree;
+        std::vector<vtkIdType> m_pointIds;
+        std::vector<int>* m_leaves = NULL;
+        std::vector<vtkIdType>* m_triangles = NULL;
+    };
+}
+
+vtkSmartPointer<vtkPolyData> VTKDualContouring::extract( vtkImageData* volume, const VTKIsoSurface::IsoRange& isoRange, double tolerance,
+                                                         unsigned int nbrOfThreads, vtkAlgorithm* progressReporter,
+                                                         const VTKIsoSurface::ActiveBlocks* activeBlocks, Statistics* statistics )
+{
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+
+    vtkDataArray* inScalars = volume->GetPointData()->GetScalars();
+    int dims[3], extent[6];
+    volume->GetDimensions( dims );
+    volume->GetExtent( extent );
+    if( inScalars == NULL || inScalars->GetNumberOfComponents() != 1 )
+    {
+        cerr << "Surface extraction needs a volume with one scalar component" << endl;
+        return mesh;
+    }
+    if( dims[0] < 2 || dims[1] < 2 || dims[2] < 2 )
+    {
+        cerr << "Surface extraction needs a volume with at least two voxels in each direction" << endl;
+        return mesh;
+    }
+    if( activeBlocks != NULL &&
+        ( activeBlocks->blockSize <= 0 ||
+          activeBlocks->nbrOfBlocks[0] * activeBlocks->blockSize < dims[0] - 1 ||
+          activeBlocks->nbrOfBlocks[1] * activeBlocks->blockSize < dims[1] - 1 ||
+          activeBlocks->nbrOfBlocks[2] * activeBlocks->blockSize < dims[2] - 1 ||
+          activeBlocks->active.size() != size_t(activeBlocks->nbrOfBlocks[0]) * activeBlocks->nbrOfBlocks[1] * activeBlocks->nbrOfBlocks[2] ) )
+    {
+        cerr << "Active blocks do not cover the volume - all cells are visited" << endl;
+        activeBlocks = NULL;
+    }
+    VTKIsoSurface::IsoRange range = isoRange;
+    if( range.excludedVoxels && !range.excludedVoxels->covers( size_t(dims[1]) * size_t(dims[2]) ) )
+    {
+        cerr << "Excluded voxels do not cover the volume - no voxel is excluded" << endl;
+        range.excludedVoxels.reset();
+    }
+
+    double origin[3], spacing[3];
+    volume->GetOrigin( origin );
+    volume->GetSpacing( spacing );
+
+    // the classification of the cells takes most of the time
+    std::function<void(double)> progress;
+    if( progressReporter != NULL )
+        progress = [progressReporter]( double done ) { progressReporter->UpdateProgress( 0.9 * done ); };
+
+    Octree octree;
+    switch( inScalars->GetDataType() )
+    {
+        vtkTemplateMacro( OctreeBuilder<VTK_TT>( static_cast<const VTK_TT*>( inScalars->GetVoidPointer(0) ), dims, spacing, range,
+                                                 tolerance, nbrOfThreads ).build( octree, activeBlocks, progress ) );
+    }
+
+    std::vector<int> leaves;
+    std::vector<vtkIdType> triangles;
+    Contourer( octree ).contour( leaves, triangles );
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetNumberOfPoints( vtkIdType( leaves.size() ) );
+    vtkSmartPointer<vtkFloatArray> normals = vtkSmartPointer<vtkFloatArray>::New();
+    normals->SetNumberOfComponents( 3 );
+    normals->SetName( "Normals" );
+    normals->SetNumberOfTuples( vtkIdType( leaves.size() ) );
+    for( size_t p = 0; p < leaves.size(); p++ )
+    {
+        const Node& node = octree.nodes[leaves[p]];
+        double point[3], normal[3];
+        for( int a = 0; a < 3; a++ )
+        {
+            point[a] = origin[a] + extent[2 * a] * spacing[a] + node.vertex[a];
+            normal[a] = node.qef.normalSum[a];
+        }
+        const double length = std::sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+        if( length > 0.0 )
+            for( int a = 0; a < 3; a++ )
+                normal[a] /= length;
+        points->SetPoint( vtkIdType(p), point );
+        normals->SetTuple( vtkIdType(p), normal );
+    }
+
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+#if VTK_MAJOR_VERSION >= 9
+    polys->AllocateExact( vtkIdType( triangles.size() / 3 ), vtkIdType( triangles.size() ) );
+#else
+    polys->Allocate( vtkIdType( triangles.size() / 3 * 4 ) );
+#endif
+    for( size_t t = 0; t < triangles.size(); t += 3 )
+        polys->InsertNextCell( 3, &triangles[t] );
+
+    mesh->SetPoints( points );
+    mesh->SetPolys( polys );
+    mesh->GetPointData()->SetNormals( normals );
+
+    if( statistics != NULL )
+    {
+        statistics->nbrOfSurfaceCells = 0;
+        for( const Node& node : octree.nodes )
+            if( node.level == 0 )
+                statistics->nbrOfSurfaceCells++;
+        statistics->nbrOfLeafCells = leaves.size();
+    }
+
+    if( progressReporter != NULL )
+        progressReporter->UpdateProgress( 1.0 );
+
+    return mesh;
+}
@@ -0,0 +1,748 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "isoSurface.h"
+#include "cellClassifier.h"
+#include "parallelTools.h"
+
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkVersion.h>
+#include <vtkFloatArray.h>
+#include <vtkMarchingCubesTriangleCases.h>
+#include <vtkMath.h>
+#include <iostream>
+#include <cmath>
+#include <array>
+#include <functional>
+#include <type_traits>
+
+using namespace std;
+
+namespace
+{
+    /**
+     * Negative gradient of the masked voxels at a grid point, by central
+     * differences inside the volume and one-sided differences on its border.
+     */
+    template<class T>
+    void computePointGradient( int i, int j, int k, const T* s, const int dims[3], vtkIdType sliceSize,
+                               const double spacing[3], const VTKIsoSurface::Band<T>& band, double n[3] )
+    {
+        double sp, sm;
+
+        // x-direction
+        if( i == 0 )
+        {
+            sp = band( s[i + 1 + j * dims[0] + k * sliceSize] );
+            sm = band( s[i + j * dims[0] + k * sliceSize] );
+            n[0] = ( sm - sp ) / spacing[0];
+        }
+        else if( i == ( dims[0] - 1 ) )
+        {
+            sp = band( s[i + j * dims[0] + k * sliceSize] );
+            sm = band( s[i - 1 + j * dims[0] + k * sliceSize] );
+            n[0] = ( sm - sp ) / spacing[0];
+        }
+        else
+        {
+            sp = band( s[i + 1 + j * dims[0] + k * sliceSize] );
+            sm = band( s[i - 1 + j * dims[0] + k * sliceSize] );
+            n[0] = 0.5 * ( sm - sp ) / spacing[0];
+        }
+
+        // y-direction
+        if( j == 0 )
+        {
+            sp = band( s[i + ( j + 1 ) * dims[0] + k * sliceSize] );
+            sm = band( s[i + j * dims[0] + k * sliceSize] );
+            n[1] = ( sm - sp ) / spacing[1];
+        }
+        else if( j == ( dims[1] - 1 ) )
+        {
+            sp = band( s[i + j * dims[0] + k * sliceSize] );
+            sm = band( s[i + ( j - 1 ) * dims[0] + k * sliceSize] );
+            n[1] = ( sm - sp ) / spacing[1];
+        }
+        else
+        {
+            sp = band( s[i + ( j + 1 ) * dims[0] + k * sliceSize] );
+            sm = band( s[i + ( j - 1 ) * dims[0] + k * sliceSize] );
+            n[1] = 0.5 * ( sm - sp ) / spacing[1];
+        }
+
+        // z-direction
+        if( k == 0 )
+        {
+            sp = band( s[i + j * dims[0] + ( k + 1 ) * sliceSize] );
+            sm = band( s[i + j * dims[0] + k * sliceSize] );
+            n[2] = ( sm - sp ) / spacing[2];
+        }
+        else if( k == ( dims[2] - 1 ) )
+        {
+            sp = band( s[i + j * dims[0] + k * sliceSize] );
+            sm = band( s[i + j * dims[0] + ( k - 1 ) * sliceSize] );
+            n[2] = ( sm - sp ) / spacing[2];
+        }
+        else
+        {
+            sp = band( s[i + j * dims[0] + ( k + 1 ) * sliceSize] );
+            sm = band( s[i + j * dims[0] + ( k - 1 ) * sliceSize] );
+            n[2] = 0.5 * ( sm - sp ) / spacing[2];
+        }
+    }
+
+    /**
+     * Computes the case indices of a run of cells. The four voxel rows of the
+     * cells start at the first cell. 16 bit voxels are classified with SIMD
+     * instructions, all others voxel by voxel.
+     */
+    template<class T>
+    void classifyCells( const T* const rows[4], size_t nbrOfCells, const VTKIsoSurface::Band<T>& band, double value,
+                        unsigned char* indices )
+    {
+        if constexpr( std::is_same<T, short>::value || std::is_same<T, unsigned short>::value )
+        {
+            double lower, upper;
+            band.getInsideRange( value, lower, upper );
+            VTKCellClassifier::computeCubeIndices( rows, nbrOfCells, lower, upper, indices );
+        }
+        else
+        {
+            static const int CASE_MASK[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+            for( size_t i = 0; i < nbrOfCells; i++ )
+            {
+                const T corners[8] = { rows[0][i], rows[0][i + 1], rows[1][i + 1], rows[1][i],
+                                       rows[2][i], rows[2][i + 1], rows[3][i + 1], rows[3][i] };
+                int index = 0;
+                for( int ii = 0; ii < 8; ii++ )
+                {
+                    if( band( corners[ii] ) >= value )
+                        index |= CASE_MASK[ii];
+                }
+                indices[i] = (unsigned char)index;
+            }
+        }
+    }
+
+    /**
+     * Bits of the corners at the lower and upper x of a cell in the case index,
+     * for the voxel rows (j,k), (j+1,k), (j,k+1) and (j+1,k+1) of the cell.
+     */
+    const unsigned char LOWER_CORNER_BITS[4] = { 1, 8, 16, 128 };
+    const unsigned char UPPER_CORNER_BITS[4] = { 2, 4, 32, 64 };
+
+    /**
+     * Excluded voxels of each iso range, NULL if it has none or if they do not
+     * cover the rows of the volume.
+     */
+    std::vector<const VTKIsoSurface::ExcludedVoxels*> findExcludedVoxels( const std::vector<VTKIsoSurface::IsoRange>& isoRanges,
+                                                                          size_t nbrOfRows )
+    {
+        std::vector<const VTKIsoSurface::ExcludedVoxels*> excludedVoxels( isoRanges.size(), NULL );
+        for( size_t surface = 0; surface < isoRanges.size(); surface++ )
+        {
+            const VTKIsoSurface::ExcludedVoxels* excluded = isoRanges[surface].excludedVoxels.get();
+            if( excluded == NULL )
+                continue;
+            if( excluded->covers( nbrOfRows ) )
+                excludedVoxels[surface] = excluded;
+            else
+                cerr << "Excluded voxels do not cover the volume - no voxel is excluded" << endl;
+        }
+        return excludedVoxels;
+    }
+
+    /**
+     * Ids of the vertices on the cell edges and voxel corners of the two slices
+     * bounding the layer of cells being marched. Cells sharing an edge share its
+     * vertex. A vertex lying on a voxel corner is shared by all edges meeting
+     * there, so that such triangles collapse and are dropped as by vtkMergePoints.
+     */
+    class VertexCache
+    {
+    public:
+        void init( int dimX, int dimY )
+        {
+            m_dimX = dimX;
+            const size_t sliceSize = size_t(dimX) * size_t(dimY);
+            for( int slice = 0; slice < 2; slice++ )
+            {
+                m_xEdges[slice].assign( sliceSize, -1 );
+                m_yEdges[slice].assign( sliceSize, -1 );
+                m_corners[slice].assign( sliceSize, -1 );
+            }
+            m_zEdges.assign( sliceSize, -1 );
+        }
+
+        /**
+         * Moves on to the next layer of cells: the upper slice becomes the lower one.
+         */
+        void nextLayer()
+        {
+            std::swap( m_xEdges[0], m_xEdges[1] );
+            std::swap( m_yEdges[0], m_yEdges[1] );
+            std::swap( m_corners[0], m_corners[1] );
+            std::fill( m_xEdges[1].begin(), m_xEdges[1].end(), -1 );
+            std::fill( m_yEdges[1].begin(), m_yEdges[1].end(), -1 );
+            std::fill( m_corners[1].begin(), m_corners[1].end(), -1 );
+            std::fill( m_zEdges.begin(), m_zEdges.end(), -1 );
+        }
+
+        /**
+         * Vertex id slot of an edge of cell (i,j) in the vtkMarchingCubes edge numbering.
+         */
+        vtkIdType& edge( int edgeIndex, int i, int j )
+        {
+            // axis and corner offset of the edge's first voxel
+            static const int EDGE_AXIS[12] = { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 };
+            static const int EDGE_OFFSET[12][3] = { {0,0,0}, {1,0,0}, {0,1,0}, {0,0,0}, {0,0,1}, {1,0,1},
+                                                    {0,1,1}, {0,0,1}, {0,0,0}, {1,0,0}, {0,1,0}, {1,1,0} };
+            const int* offset = EDGE_OFFSET[edgeIndex];
+            const size_t idx = size_t( i + offset[0] ) + size_t( j + offset[1] ) * size_t(m_dimX);
+            switch( EDGE_AXIS[edgeIndex] )
+            {
+                case 0:
+                    return m_xEdges[offset[2]][idx];
+                case 1:
+                    return m_yEdges[offset[2]][idx];
+                default:
+                    return m_zEdges[idx];
+            }
+        }
+
+        /**
+         * Vertex id slot of a corner of cell (i,j) in the vtkMarchingCubes corner numbering.
+         */
+        vtkIdType& corner( int cornerIndex, int i, int j )
+        {
+            static const int CORNER_OFFSET[8][3] = { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+            const int* offset = CORNER_OFFSET[cornerIndex];
+            return m_corners[offset[2]][size_t( i + offset[0] ) + size_t( j + offset[1] ) * size_t(m_dimX)];
+        }
+
+    private:
+        int m_dimX = 0;
+        std::vector<vtkIdType> m_xEdges[2];
+        std::vector<vtkIdType> m_yEdges[2];
+        std::vector<vtkIdType> m_corners[2];
+        std::vector<vtkIdType> m_zEdges;
+    };
+
+    /**
+     * Output of one surface while the cubes are marched.
+     */
+    struct SurfaceOutput
+    {
+        double value;
+        vtkSmartPointer<vtkPoints> points;
+        VertexCache vertexCache;
+        vtkSmartPointer<vtkDataArray> scalars;
+        vtkSmartPointer<vtkFloatArray> normals;
+        vtkSmartPointer<vtkCellArray> polys;
+    };
+
+    /**
+     * Marching cubes over all cells of a volume, in the cell order and with
+     * the arithmetic of vtkMarchingCubes, so that the points, their order and
+     * the triangles of each surface are the same. The voxels of a cell are
+     * read once for all surfaces, and only if one of them crosses the cell.
+     * The cells are classified row by row. Cells in inactive blocks are passed over.
+     * Excluded voxels are cleared from the case indices. Their values are not used
+     * for the gradients, so the normals only depend on the voxels of the volume.
+     */
+    template<class T>
+    void marchCubes( const T* scalars, const int dims[3], const int extent[6], const double origin[3], const double spacing[3],
+                     const std::vector<VTKIsoSurface::IsoRange>& isoRanges,
+                     const std::vector<const VTKIsoSurface::ExcludedVoxels*>& excludedVoxels, std::vector<SurfaceOutput>& outputs,
+                     vtkAlgorithm* progressReporter, const VTKIsoSurface::ActiveBlocks* activeBlocks, int firstSlice )
+    {
+        static const int edges[12][2] = { {0,1}, {1,2}, {3,2}, {0,3}, {4,5}, {5,6}, {7,6}, {4,7}, {0,4}, {1,5}, {3,7}, {2,6} };
+        vtkMarchingCubesTriangleCases* triCases = vtkMarchingCubesTriangleCases::GetCases();
+
+        std::vector<VTKIsoSurface::Band<T>> bands;
+        for( const VTKIsoSurface::IsoRange& isoRange : isoRanges )
+            bands.emplace_back( isoRange.threshold, isoRange.useUpperThreshold, isoRange.upperThreshold );
+
+        const vtkIdType sliceSize = vtkIdType(dims[0]) * vtkIdType(dims[1]);
+        const int nbrOfRowCells = dims[0] - 1;
+        std::vector<std::vector<unsigned char>> cubeIndices( outputs.size(), std::vector<unsigned char>( nbrOfRowCells ) );
+        T voxels[8];
+        double s[8], pts[8][3], gradients[8][3];
+        vtkIdType ptIds[3];
+
+        for( SurfaceOutput& output : outputs )
+            output.vertexCache.init( dims[0], dims[1] );
+
+        for( int k = 0; k < ( dims[2] - 1 ); k++ )
+        {
+            if( progressReporter != NULL )
+                progressReporter->UpdateProgress( k / static_cast<double>( dims[2] - 1 ) );
+
+            if( k > 0 )
+            {
+                for( SurfaceOutput& output : outputs )
+                    output.vertexCache.nextLayer();
+            }
+
+            const vtkIdType kOffset = k * sliceSize;
+            pts[0][2] = origin[2] + ( k + extent[4] ) * spacing[2];
+            const double zp = pts[0][2] + spacing[2];
+            for( int j = 0; j < ( dims[1] - 1 ); j++ )
+            {
+                const vtkIdType jOffset = vtkIdType(j) * dims[0];
+                pts[0][1] = origin[1] + ( j + extent[2] ) * spacing[1];
+                const double yp = pts[0][1] + spacing[1];
+
+                const char* activeRow = NULL;
+                int blockSize = nbrOfRowCells;
+                if( activeBlocks != NULL )
+                {
+                    blockSize = activeBlocks->blockSize;
+                    activeRow = activeBlocks->active.data() +
+                                ( size_t( ( k + firstSlice ) / blockSize ) * activeBlocks->nbrOfBlocks[1] + j / blockSize ) * activeBlocks->nbrOfBlocks[0];
+                }
+
+                // case indices of the runs of active cells, for all surfaces
+                const T* rows[4] = { scalars + jOffset + kOffset, scalars + jOffset + dims[0] + kOffset,
+                                     scalars + jOffset + kOffset + sliceSize, scalars + jOffset + dims[0] + kOffset + sliceSize };
+                const size_t row = size_t( k + firstSlice ) * size_t(dims[1]) + size_t(j);
+                const size_t rowIndices[4] = { row, row + 1, row + size_t(dims[1]), row + size_t(dims[1]) + 1 };
+                for( int runBegin = 0; runBegin < nbrOfRowCells; )
+                {
+                    if( activeRow != NULL && !activeRow[runBegin / blockSize] )
+                    {
+                        runBegin += blockSize;
+                        continue;
+                    }
+                    int runEnd = runBegin + blockSize;
+                    while( runEnd < nbrOfRowCells && ( activeRow == NULL || activeRow[runEnd / blockSize] ) )
+                        runEnd += blockSize;
+                    runEnd = std::min( runEnd, nbrOfRowCells );
+
+                    const T* runRows[4] = { rows[0] + runBegin, rows[1] + runBegin, rows[2] + runBegin, rows[3] + runBegin };
+                    for( size_t surface = 0; surface < outputs.size(); surface++ )
+                    {
+                        unsigned char* runIndices = cubeIndices[surface].data() + runBegin;
+                        classifyCells( runRows, size_t( runEnd - runBegin ), bands[surface], outputs[surface].value, runIndices );
+                        if( excludedVoxels[surface] != NULL )
+                            excludedVoxels[surface]->clearCorners( rowIndices, runBegin, runEnd, LOWER_CORNER_BITS, UPPER_CORNER_BITS, runIndices );
+                    }
+                    runBegin = runEnd;
+                }
+
+                for( int i = 0; i < nbrOfRowCells; i++ )
+                {
+                    if( activeRow != NULL && !activeRow[i / blockSize] )
+                    {
+                        // continue with the first cell of the next block
+                        i += blockSize - 1 - i % blockSize;
+                        continue;
+                    }
+
+                    bool cellPointsSet = false;
+                    for( size_t surface = 0; surface < outputs.size(); surface++ )
+                    {
+                        const int index = cubeIndices[surface][i];
+                        if( index == 0 || index == 255 )
+                            continue;
+
+                        // the voxels and corners of a cell are read once for all surfaces it holds
+                        if( !cellPointsSet )
+                        {
+                            const vtkIdType idx = i + jOffset + kOffset;
+                            voxels[0] = scalars[idx];
+                            voxels[1] = scalars[idx + 1];
+                            voxels[2] = scalars[idx + 1 + dims[0]];
+                            voxels[3] = scalars[idx + dims[0]];
+                            voxels[4] = scalars[idx + sliceSize];
+                            voxels[5] = scalars[idx + 1 + sliceSize];
+                            voxels[6] = scalars[idx + 1 + dims[0] + sliceSize];
+                            voxels[7] = scalars[idx + dims[0] + sliceSize];
+
+                            pts[0][0] = origin[0] + ( i + extent[0] ) * spacing[0];
+                            const double xp = pts[0][0] + spacing[0];
+
+                            pts[1][0] = xp;        pts[1][1] = pts[0][1]; pts[1][2] = pts[0][2];
+                            pts[2][0] = xp;        pts[2][1] = yp;        pts[2][2] = pts[0][2];
+                            pts[3][0] = pts[0][0]; pts[3][1] = yp;        pts[3][2] = pts[0][2];
+                            pts[4][0] = pts[0][0]; pts[4][1] = pts[0][1]; pts[4][2] = zp;
+                            pts[5][0] = xp;        pts[5][1] = pts[0][1]; pts[5][2] = zp;
+                            pts[6][0] = xp;        pts[6][1] = yp;        pts[6][2] = zp;
+                            pts[7][0] = pts[0][0]; pts[7][1] = yp;        pts[7][2] = zp;
+                            cellPointsSet = true;
+                        }
+
+                        // voxels at or above the upper threshold are masked here, not in a copy of the volume
+                        const VTKIsoSurface::Band<T>& band = bands[surface];
+                        SurfaceOutput& output = outputs[surface];
+                        const double value = output.value;
+                        for( int ii = 0; ii < 8; ii++ )
+                            s[ii] = band( voxels[ii] );
+
+                        // an excluded voxel counts just below the iso value
+                        if( excludedVoxels[surface] != NULL )
+                        {
+                            for( int ii = 0; ii < 8; ii++ )
+                            {
+                                if( s[ii] >= value && ( index & ( 1 << ii ) ) == 0 )
+                                    s[ii] = value - 1.0;
+                            }
+                        }
+
+                        // the gradients depend on the band of the surface
+                        if( output.normals.Get() != NULL )
+                        {
+                            computePointGradient( i, j, k, scalars, dims, sliceSize, spacing, band, gradients[0] );
+                            computePointGradient( i + 1, j, k, scalars, dims, sliceSize, spacing, band, gradients[1] );
+                            computePointGradient( i + 1, j + 1, k, scalars, dims, sliceSize, spacing, band, gradients[2] );
+                            computePointGradient( i, j + 1, k, scalars, dims, sliceSize, spacing, band, gradients[3] );
+                            computePointGradient( i, j, k + 1, scalars, dims, sliceSize, spacing, band, gradients[4] );
+                            computePointGradient( i + 1, j, k + 1, scalars, dims, sliceSize, spacing, band, gradients[5] );
+                            computePointGradient( i + 1, j + 1, k + 1, scalars, dims, sliceSize, spacing, band, gradients[6] );
+                            computePointGradient( i, j + 1, k + 1, scalars, dims, sliceSize, spacing, band, gradients[7] );
+                        }
+
+                        for( EDGE_LIST* edge = triCases[index].edges; edge[0] > -1; edge += 3 )
+                        {
+                            for( int ii = 0; ii < 3; ii++ )
+                            {
+                                const int* vert = edges[edge[ii]];
+                                const double t = ( value - s[vert[0]] ) / ( s[vert[1]] - s[vert[0]] );
+
+                                // a vertex is created once per edge, or per voxel corner if it lies on one
+                                vtkIdType& vertexId = t == 0.0 ? output.vertexCache.corner( vert[0], i, j ) :
+                                                      t == 1.0 ? output.vertexCache.corner( vert[1], i, j ) :
+                                                                 output.vertexCache.edge( edge[ii], i, j );
+                                ptIds[ii] = vertexId;
+                                if( vertexId < 0 )
+                                {
+                                    const double* x1 = pts[vert[0]];
+                                    const double* x2 = pts[vert[1]];
+                                    double x[3];
+                                    x[0] = x1[0] + t * ( x2[0] - x1[0] );
+                                    x[1] = x1[1] + t * ( x2[1] - x1[1] );
+                                    x[2] = x1[2] + t * ( x2[2] - x1[2] );
+
+                                    ptIds[ii] = output.points->InsertNextPoint( x );
+                                    vertexId = ptIds[ii];
+                                    output.scalars->InsertTuple( ptIds[ii], &value );
+                                    if( output.normals.Get() != NULL )
+                                    {
+                                        const double* n1 = gradients[vert[0]];
+                                        const double* n2 = gradients[vert[1]];
+                                        double n[3];
+                                        n[0] = n1[0] + t * ( n2[0] - n1[0] );
+                                        n[1] = n1[1] + t * ( n2[1] - n1[1] );
+                                        n[2] = n1[2] + t * ( n2[2] - n1[2] );
+                                        vtkMath::Normalize( n );
+                                        output.normals->InsertTuple( ptIds[ii], n );
+                                    }
+                                }
+                            }
+
+                            // skip degenerate triangles
+                            if( ptIds[0] != ptIds[1] && ptIds[0] != ptIds[2] && ptIds[1] != ptIds[2] )
+                                output.polys->InsertNextCell( 3, ptIds );
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Counts the voxels of a slice which count as at or above the iso value.
+     */
+    template<class T>
+    size_t countInsideVoxels( const T* scalars, const int dims[3], size_t slice, const VTKIsoSurface::Band<T>& band, double value,
+                              const VTKIsoSurface::ExcludedVoxels* excluded )
+    {
+        size_t count = 0;
+        for( int j = 0; j < dims[1]; j++ )
+        {
+            const size_t row = slice * size_t(dims[1]) + size_t(j);
+            const T* line = scalars + row * size_t(dims[0]);
+            for( int i = 0; i < dims[0]; i++ )
+                count += band( line[i] ) >= value ? 1 : 0;
+
+            if( excluded != NULL )
+            {
+                for( size_t run = excluded->rowStart[row]; run < excluded->rowStart[row + 1]; run++ )
+                    for( int i = excluded->runs[run][0]; i < excluded->runs[run][1]; i++ )
+                        count -= band( line[i] ) >= value ? 1 : 0;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Counts the cells each surface crosses, the triangles of their cases and the
+     * inside voxels, slice by slice in parallel. Cells in inactive blocks are passed
+     * over, their voxels are counted all the same.
+     */
+    template<class T>
+    void countCubeCases( const T* scalars, const int dims[3], const std::vector<VTKIsoSurface::IsoRange>& isoRanges,
+                         const std::vector<const VTKIsoSurface::ExcludedVoxels*>& excludedVoxels,
+                         std::vector<VTKIsoSurface::SurfaceSize>& sizes, unsigned int nbrOfThreads,
+                         const std::function<void(double)>& progress, const VTKIsoSurface::ActiveBlocks* activeBlocks )
+    {
+        // number of triangles of each case
+        vtkMarchingCubesTriangleCases* triCases = vtkMarchingCubesTriangleCases::GetCases();
+        std::array<int,256> caseTriangles;
+        for( int index = 0; index < 256; index++ )
+        {
+            int nbrOfEdges = 0;
+            while( nbrOfEdges < 16 && triCases[index].edges[nbrOfEdges] >= 0 )
+                nbrOfEdges++;
+            caseTriangles[index] = nbrOfEdges / 3;
+        }
+
+        std::vector<VTKIsoSurface::Band<T>> bands;
+        for( const VTKIsoSurface::IsoRange& isoRange : isoRanges )
+            bands.emplace_back( isoRange.threshold, isoRange.useUpperThreshold, isoRange.upperThreshold );
+
+        const size_t sliceSize = size_t(dims[0]) * size_t(dims[1]);
+        const int nbrOfRowCells = dims[0] - 1;
+        std::vector<std::vector<VTKIsoSurface::SurfaceSize>> sliceSizes( size_t( dims[2] - 1 ),
+                                                                         std::vector<VTKIsoSurface::SurfaceSize>( isoRanges.size() ) );
+        ParallelTools::parallelFor( 0, sliceSizes.size(), nbrOfThreads, [&]( size_t k )
+        {
+            // the last layer of cells counts the voxels of both its slices
+            const size_t lastSlice = k + 2 == size_t(dims[2]) ? k + 1 : k;
+            for( size_t surface = 0; surface < isoRanges.size(); surface++ )
+                for( size_t slice = k; slice <= lastSlice; slice++ )
+                    sliceSizes[k][surface].nbrOfInsideVoxels += countInsideVoxels( scalars, dims, slice, bands[surface],
+                                                                                   double( isoRanges[surface].threshold ),
+                                                                                   excludedVoxels[surface] );
+
+            std::vector<unsigned char> indices( nbrOfRowCells );
+            for( int j = 0; j < ( dims[1] - 1 ); j++ )
+            {
+                const char* activeRow = NULL;
+                int blockSize = nbrOfRowCells;
+                if( activeBlocks != NULL )
+                {
+                    blockSize = activeBlocks->blockSize;
+                    activeRow = activeBlocks->active.data() +
+                                ( ( k / blockSize ) * activeBlocks->nbrOfBlocks[1] + j / blockSize ) * activeBlocks->nbrOfBlocks[0];
+                }
+
+                const T* rows[4] = { scalars + k * sliceSize + size_t(j) * dims[0], scalars + k * sliceSize + size_t(j + 1) * dims[0],
+                                     scalars + ( k + 1 ) * sliceSize + size_t(j) * dims[0], scalars + ( k + 1 ) * sliceSize + size_t(j + 1) * dims[0] };
+                const size_t row = k * size_t(dims[1]) + size_t(j);
+                const size_t rowIndices[4] = { row, row + 1, row + size_t(dims[1]), row + size_t(dims[1]) + 1 };
+                for( int runBegin = 0; runBegin < nbrOfRowCells; )
+                {
+                    if( activeRow != NULL && !activeRow[runBegin / blockSize] )
+                    {
+                        runBegin += blockSize;
+                        continue;
+                    }
+                    int runEnd = runBegin;
+                    while( runEnd < nbrOfRowCells && ( activeRow == NULL || activeRow[runEnd / blockSize] ) )
+                        runEnd += blockSize;
+                    runEnd = std::min( runEnd, nbrOfRowCells );
+
+                    const T* runRows[4] = { rows[0] + runBegin, rows[1] + runBegin, rows[2] + runBegin, rows[3] + runBegin };
+                    for( size_t surface = 0; surface < isoRanges.size(); surface++ )
+                    {
+                        classifyCells( runRows, size_t( runEnd - runBegin ), bands[surface], double( isoRanges[surface].threshold ),
+                                       indices.data() );
+                        if( excludedVoxels[surface] != NULL )
+                            excludedVoxels[surface]->clearCorners( rowIndices, runBegin, runEnd, LOWER_CORNER_BITS, UPPER_CORNER_BITS,
+                                                                   indices.data() );
+                        VTKIsoSurface::SurfaceSize& size = sliceSizes[k][surface];
+                        for( int i = 0; i < runEnd - runBegin; i++ )
+                        {
+                            if( indices[i] == 0 || indices[i] == 0xff )
+                                continue;
+                            size.nbrOfCells++;
+                            size.nbrOfTriangles += size_t( caseTriangles[indices[i]] );
+                        }
+                    }
+                    runBegin = runEnd;
+                }
+            }
+        }, progress );
+
+        for( const std::vector<VTKIsoSurface::SurfaceSize>& slice : sliceSizes )
+            for( size_t surface = 0; surface < isoRanges.size(); surface++ )
+            {
+                sizes[surface].nbrOfCells += slice[surface].nbrOfCells;
+                sizes[surface].nbrOfTriangles += slice[surface].nbrOfTriangles;
+                sizes[surface].nbrOfInsideVoxels += slice[surface].nbrOfInsideVoxels;
+            }
+    }
+}
+
+vtkSmartPointer<vtkPolyData> VTKIsoSurface::extract( vtkImageData* volume, int threshold, bool useUpperThreshold, int upperThreshold,
+                                                     bool computeNormals, vtkAlgorithm* progressReporter )
+{
+    IsoRange isoRange;
+    isoRange.threshold = threshold;
+    isoRange.useUpperThreshold = useUpperThreshold;
+    isoRange.upperThreshold = upperThreshold;
+    return extract( volume, std::vector<IsoRange>{ isoRange }, computeNormals, progressReporter ).front();
+}
+
+std::vector<vtkSmartPointer<vtkPolyData>> VTKIsoSurface::extract( vtkImageData* volume, const std::vector<IsoRange>& isoRanges,
+                                                                  bool computeNormals, vtkAlgorithm* progressReporter,
+                                                                  const ActiveBlocks* activeBlocks, int firstSlice )
+{
+    std::vector<vtkSmartPointer<vtkPolyData>> meshes;
+    for( size_t surface = 0; surface < isoRanges.size(); surface++ )
+        meshes.push_back( vtkSmartPointer<vtkPolyData>::New() );
+
+    vtkDataArray* inScalars = volume->GetPointData()->GetScalars();
+    int dims[3], extent[6];
+    volume->GetDimensions( dims );
+    volume->GetExtent( extent );
+    if( inScalars == NULL || inScalars->GetNumberOfComponents() != 1 )
+    {
+        cerr << "Surface extraction needs a volume with one scalar component" << endl;
+        return meshes;
+    }
+    if( dims[0] < 2 || dims[1] < 2 || dims[2] < 2 )
+    {
+        cerr << "Surface extraction needs a volume with at least two voxels in each direction" << endl;
+        return meshes;
+    }
+    if( activeBlocks != NULL &&
+        ( activeBlocks->blockSize <= 0 ||
+          activeBlocks->nbrOfBlocks[0] * activeBlocks->blockSize < dims[0] - 1 ||
+          activeBlocks->nbrOfBlocks[1] * activeBlocks->blockSize < dims[1] - 1 ||
+          activeBlocks->nbrOfBlocks[2] * activeBlocks->blockSize < dims[2] - 1 + firstSlice ||
+          activeBlocks->active.size() != size_t(activeBlocks->nbrOfBlocks[0]) * activeBlocks->nbrOfBlocks[1] * activeBlocks->nbrOfBlocks[2] ) )
+    {
+        cerr << "Active blocks do not cover the volume - all cells are visited" << endl;
+        activeBlocks = NULL;
+    }
+    const std::vector<const ExcludedVoxels*> excludedVoxels = findExcludedVoxels( isoRanges, size_t( dims[2] + firstSlice ) * size_t(dims[1]) );
+
+    double origin[3], spacing[3];
+    volume->GetOrigin( origin );
+    volume->GetSpacing( spacing );
+
+    // sizes estimated as by vtkMarchingCubes
+    vtkIdType estimatedSize = static_cast<vtkIdType>( std::pow( double(dims[0]) * double(dims[1]) * double(dims[2]), 0.75 ) );
+    estimatedSize = std::max( estimatedSize / 1024 * 1024, vtkIdType(1024) );
+
+    std::vector<SurfaceOutput> outputs( isoRanges.size() );
+    for( size_t surface = 0; surface < isoRanges.size(); surface++ )
+    {
+        SurfaceOutput& output = outputs[surface];
+        output.value = double( isoRanges[surface].threshold );
+
+        output.points = vtkSmartPointer<vtkPoints>::New();
+        output.points->Allocate( estimatedSize, estimatedSize / 2 );
+        output.polys = vtkSmartPointer<vtkCellArray>::New();
+#if VTK_MAJOR_VERSION >= 9
+        output.polys->AllocateEstimate( estimatedSize, 3 );
+#else
+        output.polys->Allocate( 4 * estimatedSize );
+#endif
+
+        output.scalars = vtkSmartPointer<vtkDataArray>::Take( inScalars->NewInstance() );
+        output.scalars->SetNumberOfComponents( 1 );
+        output.scalars->SetName( inScalars->GetName() );
+        output.scalars->Allocate( 5000, 25000 );
+
+        if( computeNormals )
+        {
+            output.normals = vtkSmartPointer<vtkFloatArray>::New();
+            output.normals->SetNumberOfComponents( 3 );
+            output.normals->SetName( "Normals" );
+            output.normals->Allocate( 3 * estimatedSize, 3 * estimatedSize / 2 );
+        }
+    }
+
+    switch( inScalars->GetDataType() )
+    {
+        vtkTemplateMacro( marchCubes( static_cast<const VTK_TT*>( inScalars->GetVoidPointer(0) ), dims, extent, origin, spacing,
+                                      isoRanges, excludedVoxels, outputs, progressReporter, activeBlocks, firstSlice ) );
+    }
+
+    if( progressReporter != NULL )
+        progressReporter->UpdateProgress( 1.0 );
+
+    for( size_t surface = 0; surface < isoRanges.size(); surface++ )
+    {
+        SurfaceOutput& output = outputs[surface];
+
+        vtkPolyData* mesh = meshes[surface];
+        mesh->SetPoints( output.points );
+        mesh->SetPolys( output.polys );
+        mesh->GetPointData()->SetScalars( output.scalars );
+        if( computeNormals )
+            mesh->GetPointData()->SetNormals( output.normals );
+        mesh->Squeeze();
+    }
+
+    return meshes;
+}
+
+std::vector<VTKIsoSurface::SurfaceSize> VTKIsoSurface::countTriangles( vtkImageData* volume, const std::vector<IsoRange>& isoRanges,
+                                                                       unsigned int nbrOfThreads, vtkAlgorithm* progressReporter,
+                                                                       const ActiveBlocks* activeBlocks )
+{
+    std::vector<SurfaceSize> sizes( isoRanges.size() );
+
+    vtkDataArray* inScalars = volume->GetPointData()->GetScalars();
+    int dims[3];
+    volume->GetDimensions( dims );
+    if( inScalars == NULL || inScalars->GetNumberOfComponents() != 1 )
+    {
+        cerr << "Surface estimation needs a volume with one scalar component" << endl;
+        return sizes;
+    }
+    if( dims[0] < 2 || dims[1] < 2 || dims[2] < 2 )
+        return sizes;
+    if( activeBlocks != NULL &&
+        ( activeBlocks->blockSize <= 0 ||
+          activeBlocks->nbrOfBlocks[0] * activeBlocks->blockSize < dims[0] - 1 ||
+          activeBlocks->nbrOfBlocks[1] * activeBlocks->blockSize < dims[1] - 1 ||
+          activeBlocks->nbrOfBlocks[2] * activeBlocks->blockSize < dims[2] - 1 ||
+          activeBlocks->active.size() != size_t(activeBlocks->nbrOfBlocks[0]) * activeBlocks->nbrOfBlocks[1] * activeBlocks->nbrOfBlocks[2] ) )
+    {
+        cerr << "Active blocks do not cover the volume - all cells are visited" << endl;
+        activeBlocks = NULL;
+    }
+    const std::vector<const ExcludedVoxels*> excludedVoxels = findExcludedVoxels( isoRanges, size_t(dims[2]) * size_t(dims[1]) );
+
+    std::function<void(double)> progress;
+    if( progressReporter != NULL )
+        progress = [progressReporter]( double done ) { progressReporter->UpdateProgress( done ); };
+
+    switch( inScalars->GetDataType() )
+    {
+        vtkTemplateMacro( countCubeCases( static_cast<const VTK_TT*>( inScalars->GetVoidPointer(0) ), dims, isoRanges, excludedVoxels, sizes,
+                                          nbrOfThreads, progress, activeBlocks ) );
+    }
+
+    if( progressReporter != NULL )
+        progressReporter->UpdateProgress( 1.0 );
+
+    return sizes;
+}
@@ -0,0 +1,532 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "labelSurfaces.h"
+#include "parallelTools.h"
+
+#include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkVersion.h>
+#include <vtkIntArray.h>
+#include <vtkDataArray.h>
+#include <vtkIdList.h>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+const char* const VTKLabelSurfaces::LabelsArrayName = "Labels";
+
+namespace
+{
+    // corners of a cell are numbered (x << 2) | (y << 1) | z
+    const int cellEdges[12][2] = {
+        {0,4},{1,5},{2,6},{3,7},    // x-axis
+        {0,2},{1,3},{4,6},{5,7},    // y-axis
+        {0,1},{2,3},{4,5},{6,7}     // z-axis
+    };
+
+    /**
+     * Cells of one slice holding a vertex, row by row. Cell c spans the voxels c to c + 1,
+     * cells range from -1 to the dimension - 1 so that the volume border is enclosed.
+     */
+    struct CellSlice
+    {
+        std::vector<int> rowStart;                  // first cell of each row, followed by the end of the last row
+        std::vector<int> x;                         // x-coordinate + 1 of the cells, ascending within a row
+        std::vector<std::array<float,3>> offset;    // vertex position within the cell
+        vtkIdType firstId = 0;
+    };
+
+    /**
+     * Triangles of the boundaries between labels, with the two labels of each triangle.
+     */
+    struct Faces
+    {
+        std::vector<vtkIdType> triangles;
+        std::vector<int> labels;
+    };
+
+    template <typename T>
+    class SurfaceNets
+    {
+
+    public:
+
+        SurfaceNets( const T* voxels, const int dims[3], unsigned int nbrOfThreads )
+            : m_voxels( voxels ), m_nbrOfThreads( nbrOfThreads )
+        {
+            std::copy( dims, dims + 3, m_dims );
+        }
+
+        /**
+         * Places the vertices in voxel coordinates and connects them.
+         */
+        void run( unsigned int nbrOfSmoothingIterations, std::vector<std::array<double,3>>& positions, Faces& faces,
+                  const std::function<void(double)>& progress )
+        {
+            std::function<void(double)> findProgress, connectProgress, smoothProgress;
+            if( progress )
+            {
+                findProgress = [&progress]( double done ) { progress( 0.4 * done ); };
+                connectProgress = [&progress]( double done ) { progress( 0.4 + 0.3 * done ); };
+                smoothProgress = [&progress]( double done ) { progress( 0.7 + 0.3 * done ); };
+            }
+
+            // cells with different labels, slice by slice
+            m_slices.resize( size_t( m_dims[2] ) + 1 );
+            ParallelTools::parallelFor( 0, m_slices.size(), m_nbrOfThreads, [&]( size_t s )
+            {
+                findCells( int(s) - 1, m_slices[s] );
+            }, findProgress );
+
+            vtkIdType nbrOfVertices = 0;
+            for( CellSlice& slice : m_slices )
+            {
+                slice.firstId = nbrOfVertices;
+                nbrOfVertices += vtkIdType( slice.x.size() );
+            }
+
+            positions.resize( size_t( nbrOfVertices ) );
+            m_cells.resize( size_t( nbrOfVertices ) );
+            ParallelTools::parallelFor( 0, m_slices.size(), m_nbrOfThreads, [&]( size_t s )
+            {
+                const CellSlice& slice = m_slices[s];
+                for( int y = 0; y + 1 < int( slice.rowStart.size() ); y++ )
+                    for( int c = slice.rowStart[y]; c < slice.rowStart[y + 1]; c++ )
+                    {
+                        const size_t id = size_t( slice.firstId ) + size_t(c);
+                        m_cells[id] = {{ slice.x[c] - 1, y - 1, int(s) - 1 }};
+                        for( int a = 0; a < 3; a++ )
+                            positions[id][a] = m_cells[id][a] + slice.offset[c][a];
+                    }
+            } );
+
+            // one quad per pair of neighbouring voxels with different labels
+            std::vector<Faces> sliceFaces( size_t( m_dims[2] ) + 1 );
+            ParallelTools::parallelFor( 0, sliceFaces.size(), m_nbrOfThreads, [&]( size_t s )
+            {
+                connectCells( int(s) - 1, sliceFaces[s] );
+            }, connectProgress );
+
+            size_t nbrOfTriangles = 0;
+            for( const Faces& f : sliceFaces )
+                nbrOfTriangles += f.labels.size() / 2;
+            faces.triangles.reserve( 3 * nbrOfTriangles );
+            faces.labels.reserve( 2 * nbrOfTriangles );
+            for( Faces& f : sliceFaces )
+            {
+                faces.triangles.insert( faces.triangles.end(), f.triangles.begin(), f.triangles.end() );
+                faces.labels.insert( faces.labels.end(), f.labels.begin(), f.labels.end() );
+                std::vector<vtkIdType>().swap( f.triangles );
+                std::vector<int>().swap( f.labels );
+            }
+
+            smooth( nbrOfSmoothingIterations, positions, smoothProgress );
+        }
+
+    private:
+
+        /**
+         * Label of a voxel. Voxels outside of the volume are background.
+         */
+        T getLabel( int x, int y, int z ) const
+        {
+            if( x < 0 || y < 0 || z < 0 || x >= m_dims[0] || y >= m_dims[1] || z >= m_dims[2] )
+                return T(0);
+            return m_voxels[ ( size_t(z) * m_dims[1] + y ) * m_dims[0] + x ];
+        }
+
+        /**
+         * Copies a row of voxels, padded by a background voxel at both ends.
+         */
+        void fillRow( T* row, int y, int z ) const
+        {
+            row[0] = T(0);
+            row[m_dims[0] + 1] = T(0);
+            if( y < 0 || z < 0 || y >= m_dims[1] || z >= m_dims[2] )
+                std::fill( row + 1, row + m_dims[0] + 1, T(0) );
+            else
+                std::copy( m_voxels + ( size_t(z) * m_dims[1] + y ) * m_dims[0],
+                           m_voxels + ( size_t(z) * m_dims[1] + y + 1 ) * m_dims[0], row + 1 );
+        }
+
+        /**
+         * Finds the cells of a slice holding different labels. Their vertex is
+         * placed at the mean of the midpoints of the edges with a label change.
+         */
+        void findCells( int z, CellSlice& slice ) const
+        {
+            const size_t rowLength = size_t( m_dims[0] ) + 2;
+            std::vector<T> buffer( 4 * rowLength );
+            T* rows[2][2] = { { &buffer[0], &buffer[rowLength] }, { &buffer[2 * rowLength], &buffer[3 * rowLength] } };
+            fillRow( rows[1][0], -1, z );
+            fillRow( rows[1][1], -1, z + 1 );
+
+            slice.rowStart.assign( size_t( m_dims[1] ) + 2, 0 );
+            for( int y = -1; y < m_dims[1]; y++ )
+            {
+                std::swap( rows[0][0], rows[1][0] );
+                std::swap( rows[0][1], rows[1][1] );
+                fillRow( rows[1][0], y + 1, z );
+                fillRow( rows[1][1], y + 1, z + 1 );
+
+                slice.rowStart[y + 1] = int( slice.x.size() );
+                for( int i = 0; i <= m_dims[0]; i++ )
+                {
+                    T value[8];
+                    bool uniform = true;
+                    for( int c = 0; c < 8; c++ )
+                    {
+                        value[c] = rows[( c >> 1 ) & 1][c & 1][i + ( c >> 2 )];
+                        uniform = uniform && value[c] == value[0];
+                    }
+                    if( uniform )
+                        continue;
+
+                    std::array<float,3> offset = {{ 0.0f, 0.0f, 0.0f }};
+                    int nbrOfChanges = 0;
+                    for( const auto& edge : cellEdges )
+                    {
+                        if( value[edge[0]] == value[edge[1]] )
+                            continue;
+                        offset[0] += 0.5f * float( ( ( edge[0] >> 2 ) & 1 ) + ( ( edge[1] >> 2 ) & 1 ) );
+                        offset[1] += 0.5f * float( ( ( edge[0] >> 1 ) & 1 ) + ( ( edge[1] >> 1 ) & 1 ) );
+                        offset[2] += 0.5f * float( ( edge[0] & 1 ) + ( edge[1] & 1 ) );
+                        nbrOfChanges++;
+                    }
+                    for( float& o : offset )
+                        o /= float( nbrOfChanges );
+
+                    slice.x.push_back( i );
+                    slice.offset.push_back( offset );
+                }
+            }
+            slice.rowStart[m_dims[1] + 1] = int( slice.x.size() );
+        }
+
+        /**
+         * Returns the vertex of a cell holding different labels.
+         */
+        vtkIdType getVertex( int x, int y, int z ) const
+        {
+            const CellSlice& slice = m_slices[z + 1];
+            const auto begin = slice.x.begin() + slice.rowStart[y + 1];
+            const auto end = slice.x.begin() + slice.rowStart[y + 2];
+            return slice.firstId + vtkIdType( std::lower_bound( begin, end, x + 1 ) - slice.x.begin() );
+        }
+
+        /**
+         * Adds the quad around the edge from voxel a to voxel b. The cells are given
+         * counter-clockwise seen from b. The triangles face away from the higher label.
+         */
+        void addQuad( T a, T b, const int cells[4][3], Faces& faces ) const
+        {
+            vtkIdType ids[4];
+            for( int c = 0; c < 4; c++ )
+                ids[c] = getVertex( cells[c][0], cells[c][1], cells[c][2] );
+
+            const int order[2][6] = { { 0, 1, 2, 0, 2, 3 }, { 0, 2, 1, 0, 3, 2 } };
+            const int* triangles = order[ a > b ? 0 : 1 ];
+            for( int t = 0; t < 6; t++ )
+                faces.triangles.push_back( ids[triangles[t]] );
+            for( int t = 0; t < 2; t++ )
+            {
+                faces.labels.push_back( int( std::max( a, b ) ) );
+                faces.labels.push_back( int( std::min( a, b ) ) );
+            }
+        }
+
+        /**
+         * Connects the cells around the edges starting at the voxels of a slice.
+         */
+        void connectCells( int z, Faces& faces ) const
+        {
+            const size_t rowLength = size_t( m_dims[0] ) + 2;
+            std::vector<T> buffer( 3 * rowLength );
+            T* row = &buffer[0];               // voxels at y, z
+            T* nextRow = &buffer[rowLength];   // voxels at y + 1, z
+            T* upperRow = &buffer[2 * rowLength];   // voxels at y, z + 1
+            fillRow( nextRow, -1, z );
+
+            for( int y = -1; y < m_dims[1]; y++ )
+            {
+                std::swap( row, nextRow );
+                fillRow( nextRow, y + 1, z );
+                fillRow( upperRow, y, z + 1 );
+
+                for( int x = -1; x < m_dims[0]; x++ )
+                {
+                    const T label = row[x + 1];
+                    if( y >= 0 && z >= 0 && label != row[x + 2] )
+                    {
+                        const int cells[4][3] = { { x, y - 1, z - 1 }, { x, y, z - 1 }, { x, y, z }, { x, y - 1, z } };
+                        addQuad( label, row[x + 2], cells, faces );
+                    }
+                    if( x >= 0 && z >= 0 && label != nextRow[x + 1] )
+                    {
+                        const int cells[4][3] = { { x - 1, y, z - 1 }, { x - 1, y, z }, { x, y, z }, { x, y, z - 1 } };
+                        addQuad( label, nextRow[x + 1], cells, faces );
+                    }
+                    if( x >= 0 && y >= 0 && label != upperRow[x + 1] )
+                    {
+                        const int cells[4][3] = { { x - 1, y - 1, z }, { x, y - 1, z }, { x, y, z }, { x - 1, y, z } };
+                        addQuad( label, upperRow[x + 1], cells, faces );
+                    }
+                }
+            }
+        }
+
+        /**
+         * Moves the vertices towards the mean of their neighbours on the surface,
+         * keeping each within its cell.
+         */
+        void smooth( unsigned int nbrOfIterations, std::vector<std::array<double,3>>& positions,
+                     const std::function<void(double)>& progress ) const
+        {
+            if( nbrOfIterations == 0 || positions.empty() )
+                return;
+
+            // neighbouring cells share a quad edge if the voxels of their common face differ
+            const size_t nbrOfVertices = positions.size();
+            const size_t chunkSize = 4096;
+            const size_t nbrOfChunks = ( nbrOfVertices + chunkSize - 1 ) / chunkSize;
+            std::vector<std::array<vtkIdType,6>> neighbours( nbrOfVertices );
+            ParallelTools::parallelFor( 0, nbrOfChunks, m_nbrOfThreads, [&]( size_t chunk )
+            {
+                for( size_t v = chunk * chunkSize; v < std::min( nbrOfVertices, ( chunk + 1 ) * chunkSize ); v++ )
+                {
+                    const std::array<int,3>& cell = m_cells[v];
+                    for( int d = 0; d < 6; d++ )
+                    {
+                        const int axis = d / 2, u = ( axis + 1 ) % 3, w = ( axis + 2 ) % 3;
+                        int voxel[3] = { cell[0], cell[1], cell[2] };
+                        voxel[axis] += d % 2;   // face at the lower or upper side of the cell
+
+                        bool uniform = true;
+                        const T first = getLabel( voxel[0], voxel[1], voxel[2] );
+                        for( int f = 1; f < 4 && uniform; f++ )
+                        {
+                            int corner[3] = { voxel[0], voxel[1], voxel[2] };
+                            corner[u] += f & 1;
+                            corner[w] += f >> 1;
+                            uniform = getLabel( corner[0], corner[1], corner[2] ) == first;
+                        }
+
+                        neighbours[v][d] = -1;
+                        if( !uniform )
+                        {
+                            int other[3] = { cell[0], cell[1], cell[2] };
+                            other[axis] += d % 2 == 0 ? -1 : 1;
+                            neighbours[v][d] = getVertex( other[0], other[1], other[2] );
+                        }
+                    }
+                }
+            } );
+
+            std::vector<std::array<double,3>> relaxed( nbrOfVertices );
+            for( unsigned int iteration = 0; iteration < nbrOfIterations; iteration++ )
+            {
+                ParallelTools::parallelFor( 0, nbrOfChunks, m_nbrOfThreads, [&]( size_t chunk )
+                {
+                    for( size_t v = chunk * chunkSize; v < std::min( nbrOfVertices, ( chunk + 1 ) * chunkSize ); v++ )
+                    {
+                        double mean[3] = { 0.0, 0.0, 0.0 };
+                        int nbrOfNeighbours = 0;
+                        for( vtkIdType n : neighbours[v] )
+                        {
+                            if( n < 0 )
+                                continue;
+                            for( int a = 0; a < 3; a++ )
+                                mean[a] += positions[n][a];
+                            nbrOfNeighbours++;
+                        }
+
+                        relaxed[v] = positions[v];
+                        if( nbrOfNeighbours == 0 )
+                            continue;
+                        for( int a = 0; a < 3; a++ )
+                        {
+                            const double p = 0.5 * ( positions[v][a] + mean[a] / nbrOfNeighbours );
+                            relaxed[v][a] = std::min( std::max( p, double( m_cells[v][a] ) ), double( m_cells[v][a] + 1 ) );
+                        }
+                    }
+                } );
+                positions.swap( relaxed );
+
+                if( progress )
+                    progress( double( iteration + 1 ) / nbrOfIterations );
+            }
+        }
+
+        const T* m_voxels;
+        const unsigned int m_nbrOfThreads;
+        int m_dims[3];
+        std::vector<CellSlice> m_slices;
+        std::vector<std::array<int,3>> m_cells;
+    };
+}
+
+vtkSmartPointer<vtkPolyData> VTKLabelSurfaces::extract( vtkImageData* labels, unsigned int nbrOfSmoothingIterations,
+                                                        unsigned int nbrOfThreads, vtkAlgorithm* progressReporter )
+{
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+
+    vtkDataArray* inScalars = labels->GetPointData()->GetScalars();
+    if( inScalars == NULL || inScalars->GetNumberOfComponents() != 1 ||
+        inScalars->GetDataType() == VTK_FLOAT || inScalars->GetDataType() == VTK_DOUBLE )
+    {
+        cerr << "Label surface extraction needs a volume with one integer scalar component" << endl;
+        return mesh;
+    }
+
+    int dims[3], extent[6];
+    double origin[3], spacing[3];
+    labels->GetDimensions( dims );
+    labels->GetExtent( extent );
+    labels->GetOrigin( origin );
+    labels->GetSpacing( spacing );
+
+    std::function<void(double)> progress;
+    if( progressReporter != NULL )
+        progress = [progressReporter]( double done ) { progressReporter->UpdateProgress( 0.95 * done ); };
+
+    std::vector<std::array<double,3>> positions;
+    Faces faces;
+    switch( inScalars->GetDataType() )
+    {
+        vtkTemplateMacro( SurfaceNets<VTK_TT>( static_cast<const VTK_TT*>( inScalars->GetVoidPointer(0) ), dims, nbrOfThreads )
+                              .run( nbrOfSmoothingIterations, positions, faces, progress ) );
+    }
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetNumberOfPoints( vtkIdType( positions.size() ) );
+    for( size_t p = 0; p < positions.size(); p++ )
+    {
+        double point[3];
+        for( int a = 0; a < 3; a++ )
+            point[a] = origin[a] + ( extent[2 * a] + positions[p][a] ) * spacing[a];
+        points->SetPoint( vtkIdType(p), point );
+    }
+
+    const vtkIdType nbrOfTriangles = vtkIdType( faces.labels.size() / 2 );
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+#if VTK_MAJOR_VERSION >= 9
+    polys->AllocateExact( nbrOfTriangles, 3 * nbrOfTriangles );
+#else
+    polys->Allocate( 4 * nbrOfTriangles );
+#endif
+    for( size_t t = 0; t < faces.triangles.size(); t += 3 )
+        polys->InsertNextCell( 3, &faces.triangles[t] );
+
+    vtkSmartPointer<vtkIntArray> triangleLabels = vtkSmartPointer<vtkIntArray>::New();
+    triangleLabels->SetName( LabelsArrayName );
+    triangleLabels->SetNumberOfComponents( 2 );
+    triangleLabels->SetNumberOfTuples( nbrOfTriangles );
+    std::copy( faces.labels.begin(), faces.labels.end(), triangleLabels->GetPointer(0) );
+
+    mesh->SetPoints( points );
+    mesh->SetPolys( polys );
+    mesh->GetCellData()->AddArray( triangleLabels );
+
+    if( progressReporter != NULL )
+        progressReporter->UpdateProgress( 1.0 );
+
+    return mesh;
+}
+
+std::map<int, vtkSmartPointer<vtkPolyData>> VTKLabelSurfaces::splitByLabel( vtkPolyData* labelledMesh )
+{
+    std::map<int, vtkSmartPointer<vtkPolyData>> meshes;
+
+    vtkDataArray* labels = labelledMesh->GetCellData()->GetArray( LabelsArrayName );
+    if( labels == NULL || labels->GetNumberOfComponents() != 2 || labels->GetNumberOfTuples() != labelledMesh->GetNumberOfCells() )
+    {
+        cerr << "Mesh has no labelled triangles" << endl;
+        return meshes;
+    }
+
+    // the triangles face away from the first label, and are turned for the second
+    std::map<int, std::vector<vtkIdType>> triangles;
+    vtkSmartPointer<vtkIdList> ids = vtkSmartPointer<vtkIdList>::New();
+    for( vtkIdType c = 0; c < labelledMesh->GetNumberOfCells(); c++ )
+    {
+        labelledMesh->GetCellPoints( c, ids );
+        if( ids->GetNumberOfIds() != 3 )
+            continue;
+
+        const int outer = int( labels->GetComponent( c, 0 ) );
+        const int inner = int( labels->GetComponent( c, 1 ) );
+        if( outer != 0 )
+        {
+            std::vector<vtkIdType>& t = triangles[outer];
+            t.insert( t.end(), { ids->GetId(0), ids->GetId(1), ids->GetId(2) } );
+        }
+        if( inner != 0 )
+        {
+            std::vector<vtkIdType>& t = triangles[inner];
+            t.insert( t.end(), { ids->GetId(0), ids->GetId(2), ids->GetId(1) } );
+        }
+    }
+
+    std::vector<vtkIdType> newIds( size_t( labelledMesh->GetNumberOfPoints() ), -1 );
+    std::vector<vtkIdType> usedIds;
+    for( auto& [label, labelTriangles] : triangles )
+    {
+        vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+        for( vtkIdType& id : labelTriangles )
+        {
+            if( newIds[id] < 0 )
+            {
+                newIds[id] = points->InsertNextPoint( labelledMesh->GetPoint( id ) );
+                usedIds.push_back( id );
+            }
+            id = newIds[id];
+        }
+
+        vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+#if VTK_MAJOR_VERSION >= 9
+        polys->AllocateExact( vtkIdType( labelTriangles.size() / 3 ), vtkIdType( labelTriangles.size() ) );
+#else
+        polys->Allocate( vtkIdType( labelTriangles.size() / 3 * 4 ) );
+#endif
+        for( size_t t = 0; t < labelTriangles.size(); t += 3 )
+            polys->InsertNextCell( 3, &labelTriangles[t] );
+
+        vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+        mesh->SetPoints( points );
+        mesh->SetPolys( polys );
+        meshes[label] = mesh;
+
+        for( vtkIdType id : usedIds )
+            newIds[id] = -1;
+        usedIds.clear();
+    }
+
+    return meshes;
+}
@@ -29,16 +29,59 @@
 #include <vtkOBJReader.h>
 #include <vtkSTLReader.h>
 #include <vtkPLYReader.h>
+#include <vtkCleanPolyData.h>
+#include <vtkPointData.h>
 #include <vtkTypedArray.h>
 #include <vtkIdTypeArray.h>
 #include <vtkIdList.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
 
 #include <iostream>
 #include <fstream>
+#include <array>
+#include <cstring>
+#include <iterator>
 
 
 using namespace std;
 
+namespace
+{
+    const char progressiveMeshMagic[4] = { 'D', '2', 'P', 'M' };
+    const uint32_t progressiveMeshVersion = 1;
+
+    /**
+     * Appends a value in the byte order of the machine, which is little-endian on all supported platforms.
+     */
+    template <typename T>
+    void appendValue( std::vector<char>& buffer, T value )
+    {
+        char bytes[sizeof(T)];
+        std::memcpy( bytes, &value, sizeof(T) );
+        buffer.insert( buffer.end(), bytes, bytes + sizeof(T) );
+    }
+
+    /**
+     * Reads a value at the read position and advances it.
+     * @return False if the buffer ends before the value.
+     */
+    template <typename T>
+    bool readValue( const std::vector<char>& buffer, size_t& position, T& value )
+    {
+        if( buffer.size() - position < sizeof(T) )
+            return false;
+        std::memcpy( &value, buffer.data() + position, sizeof(T) );
+        position += sizeof(T);
+        return true;
+    }
+
+    bool readPosition( const std::vector<char>& buffer, size_t& position, std::array<float,3>& xyz )
+    {
+        return readValue( buffer, position, xyz[0] ) && readValue( buffer, position, xyz[1] ) && readValue( buffer, position, xyz[2] );
+    }
+}
+
 VTKMeshData::VTKMeshData()
 {
     m_progressCallback = vtkSmartPointer<vtkCallbackCommand>(NULL);
@@ -168,12 +211,33 @@ vtkSmartPointer<vtkPolyData> VTKMeshData::importObjFile( const std::string& path
     reader->Update();
 
     vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
-    mesh->DeepCopy( reader->GetOutput() );
+    mesh->ShallowCopy( reader->GetOutput() );
+
+    // the reader gives every face its own vertices when the face carries its own normal
+    mesh->GetPointData()->SetNormals( NULL );
+    weldVertices( mesh );
 
     cout << endl << endl;
     return mesh;
 }
 
+void VTKMeshData::weldVertices( vtkSmartPointer<vtkPolyData> mesh )
+{
+    vtkIdType numberOfVerticesBefore = mesh->GetNumberOfPoints();
+
+    vtkSmartPointer<vtkCleanPolyData> cleaner = vtkSmartPointer<vtkCleanPolyData>::New();
+    cleaner->SetInputData( mesh );
+    cleaner->PointMergingOn();
+    cleaner->SetTolerance( 0.0 );
+    cleaner->ConvertLinesToPointsOff();
+    cleaner->ConvertPolysToLinesOff();
+    cleaner->ConvertStripsToPolysOff();
+    cleaner->Update();
+
+    mesh->ShallowCopy( cleaner->GetOutput() );
+    cout << "Welded " << numberOfVerticesBefore << " to " << mesh->GetNumberOfPoints() << " vertices" << endl;
+}
+
 void VTKMeshData::exportAsStlFile(const vtkSmartPointer<vtkPolyData>& mesh, const string& path , bool useBinaryExport)
 {
     cout << "Mesh export as stl file: " << path << endl;
@@ -209,7 +273,7 @@ vtkSmartPointer<vtkPolyData> VTKMeshData::importStlFile( const std::string& path
     reader->Update();
 
     vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
-    mesh->DeepCopy( reader->GetOutput() );
+    mesh->ShallowCopy( reader->GetOutput() );
 
     cout << endl << endl;
     return mesh;
@@ -228,7 +292,7 @@ vtkSmartPointer<vtkPolyData> VTKMeshData::importPlyFile( const std::string& path
     reader->Update();
 
     vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
-    mesh->DeepCopy( reader->GetOutput() );
+    mesh->ShallowCopy( reader->GetOutput() );
 
     cout << endl << endl;
     return mesh;
@@ -248,3 +312,152 @@ void VTKMeshData::exportAsPlyFile( const vtkSmartPointer<vtkPolyData>& mesh, con
     writer->Write();
     cout << endl << endl;
 }
+
+// Like the obj export, the whole content is assembled in memory and written at once.
+void VTKMeshData::exportAsProgressiveMeshFile( const vtkSmartPointer<vtkPolyData>& baseMesh,
+                                               const std::vector<VTKQuadricDecimation::VertexSplit>& vertexSplits, const std::string& path )
+{
+    cout << "Mesh export as progressive mesh file: " << path << endl;
+
+    vtkIdType numberOfVertices = baseMesh->GetNumberOfPoints();
+    vtkIdType numberOfFaces = baseMesh->GetNumberOfCells();
+
+    std::vector<char> buffer;
+    buffer.insert( buffer.end(), progressiveMeshMagic, progressiveMeshMagic + 4 );
+    appendValue( buffer, progressiveMeshVersion );
+    appendValue( buffer, uint32_t(numberOfVertices) );
+    appendValue( buffer, uint32_t(numberOfFaces) );
+    appendValue( buffer, uint32_t(vertexSplits.size()) );
+
+    for( vtkIdType i = 0; i < numberOfVertices; i++ )
+    {
+        double p[3];
+        baseMesh->GetPoint( i, p );
+        for( double c : p )
+            appendValue( buffer, float(c) );
+    }
+
+    vtkSmartPointer<vtkIdList> face = vtkSmartPointer<vtkIdList>::New();
+    for( vtkIdType i = 0; i < numberOfFaces; i++ )
+    {
+        baseMesh->GetCellPoints( i, face );
+        if( face->GetNumberOfIds() != 3 )
+        {
+            cerr << "Progressive mesh export needs a triangle mesh" << endl;
+            return;
+        }
+        for( vtkIdType k = 0; k < 3; k++ )
+            appendValue( buffer, uint32_t(face->GetId(k)) );
+    }
+
+    for( const VTKQuadricDecimation::VertexSplit& split : vertexSplits )
+    {
+        appendValue( buffer, uint32_t(split.vertex) );
+        for( double c : split.position )
+            appendValue( buffer, float(c) );
+        for( double c : split.newVertexPosition )
+            appendValue( buffer, float(c) );
+        for( const std::array<vtkIdType,3>& triangle : split.newTriangles )
+            for( vtkIdType c : triangle )
+                appendValue( buffer, uint32_t(c) );
+        appendValue( buffer, uint32_t(split.movedTriangles.size()) );
+        for( vtkIdType t : split.movedTriangles )
+            appendValue( buffer, uint32_t(t) );
+    }
+
+    ofstream pmFile( path, ios::out | ios::binary );
+    pmFile.write( buffer.data(), std::streamsize(buffer.size()) );
+    pmFile.close();
+
+    cout << numberOfFaces << " base faces, " << vertexSplits.size() << " vertex splits, " << buffer.size() << " bytes" << endl;
+    cout << "Done" << endl << endl;
+}
+
+vtkSmartPointer<vtkPolyData> VTKMeshData::importProgressiveMeshFile( const std::string& pathToProgressiveMeshFile, size_t maxNbrOfVertexSplits )
+{
+    cout << "Load progressive mesh file " << pathToProgressiveMeshFile << endl;
+
+    ifstream pmFile( pathToProgressiveMeshFile, ios::in | ios::binary );
+    std::vector<char> buffer( (std::istreambuf_iterator<char>(pmFile)), std::istreambuf_iterator<char>() );
+
+    size_t position = 0;
+    uint32_t version = 0, numberOfVertices = 0, numberOfFaces = 0, numberOfSplits = 0;
+    if( buffer.size() < 4 || std::memcmp( buffer.data(), progressiveMeshMagic, 4 ) != 0 )
+    {
+        cerr << "Not a progressive mesh file: " << pathToProgressiveMeshFile << endl;
+        return NULL;
+    }
+    position = 4;
+    if( !readValue( buffer, position, version ) || version != progressiveMeshVersion ||
+        !readValue( buffer, position, numberOfVertices ) || !readValue( buffer, position, numberOfFaces ) ||
+        !readValue( buffer, position, numberOfSplits ) )
+    {
+        cerr << "Unsupported progressive mesh file: " << pathToProgressiveMeshFile << endl;
+        return NULL;
+    }
+
+    std::vector<std::array<float,3>> vertices( numberOfVertices );
+    std::vector<std::array<uint32_t,3>> faces( numberOfFaces );
+    bool ok = true;
+    for( std::array<float,3>& vertex : vertices )
+        ok = ok && readPosition( buffer, position, vertex );
+    for( std::array<uint32_t,3>& face : faces )
+        for( uint32_t& c : face )
+            ok = ok && readValue( buffer, position, c ) && c < numberOfVertices;
+
+    // each split moves one vertex, appends the new vertex and two faces, and hands faces over to the new vertex
+    const size_t numberOfAppliedSplits = std::min( size_t(numberOfSplits), maxNbrOfVertexSplits );
+    for( size_t s = 0; s < numberOfAppliedSplits && ok; s++ )
+    {
+        uint32_t vertex = 0, numberOfMovedFaces = 0;
+        std::array<float,3> vertexPosition, newVertexPosition;
+        ok = readValue( buffer, position, vertex ) && vertex < vertices.size() &&
+             readPosition( buffer, position, vertexPosition ) && readPosition( buffer, position, newVertexPosition );
+        const uint32_t newVertex = uint32_t(vertices.size());
+        for( int k = 0; k < 2 && ok; k++ )
+        {
+            std::array<uint32_t,3> face;
+            for( uint32_t& c : face )
+                ok = ok && readValue( buffer, position, c ) && c <= newVertex;
+            faces.push_back( face );
+        }
+        ok = ok && readValue( buffer, position, numberOfMovedFaces );
+        for( uint32_t m = 0; m < numberOfMovedFaces && ok; m++ )
+        {
+            uint32_t f = 0;
+            ok = readValue( buffer, position, f ) && f < faces.size();
+            if( ok )
+                for( uint32_t& c : faces[f] )
+                    if( c == vertex )
+                        c = newVertex;
+        }
+        if( ok )
+        {
+            vertices[vertex] = vertexPosition;
+            vertices.push_back( newVertexPosition );
+        }
+    }
+    if( !ok )
+    {
+        cerr << "Corrupt progressive mesh file: " << pathToProgressiveMeshFile << endl;
+        return NULL;
+    }
+
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetNumberOfPoints( vtkIdType(vertices.size()) );
+    for( size_t v = 0; v < vertices.size(); v++ )
+        points->SetPoint( vtkIdType(v), vertices[v][0], vertices[v][1], vertices[v][2] );
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+    for( const std::array<uint32_t,3>& face : faces )
+    {
+        const vtkIdType triangle[3] = { vtkIdType(face[0]), vtkIdType(face[1]), vtkIdType(face[2]) };
+        polys->InsertNextCell( 3, triangle );
+    }
+
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->SetPoints( points );
+    mesh->SetPolys( polys );
+
+    cout << faces.size() << " faces after " << numberOfAppliedSplits << " of " << numberOfSplits << " vertex splits" << endl << endl;
+    return mesh;
+}
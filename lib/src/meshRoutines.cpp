@@ -32,8 +32,10 @@
 #include <vtkIdTypeArray.h>
 #include <vtkIdList.h>
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <memory>
 
 
 using namespace std;
@@ -41,6 +43,8 @@ using namespace std;
 VTKMeshRoutines::VTKMeshRoutines()
 {
     m_progressCallback = vtkSmartPointer<vtkCallbackCommand>(NULL);
+    m_nbrOfThreads = 0;
+    m_decimator = Decimator::QuadricDecimation;
 }
 
 VTKMeshRoutines::~VTKMeshRoutines()
@@ -52,6 +56,26 @@ void VTKMeshRoutines::SetProgressCallback( vtkSmartPointer<vtkCallbackCommand> p
     m_progressCallback = progressCallback;
 }
 
+void VTKMeshRoutines::SetNumberOfThreads( unsigned int nbrOfThreads )
+{
+    m_nbrOfThreads = nbrOfThreads;
+}
+
+unsigned int VTKMeshRoutines::GetNumberOfThreads() const
+{
+    return m_nbrOfThreads;
+}
+
+void VTKMeshRoutines::SetDecimator( Decimator decimator )
+{
+    m_decimator = decimator;
+}
+
+VTKMeshRoutines::Decimator VTKMeshRoutines::GetDecimator() const
+{
+    return m_decimator;
+}
+
 vtkVector3d VTKMeshRoutines::moveMeshToCOSCenter( vtkSmartPointer<vtkPolyData> mesh )
 {
     vtkSmartPointer<vtkCenterOfMass> computeCenter = vtkSmartPointer<vtkCenterOfMass>::New();
@@ -73,7 +97,7 @@ vtkVector3d VTKMeshRoutines::moveMeshToCOSCenter( vtkSmartPointer<vtkPolyData> m
     transformFilter->SetTransform( translation );
     transformFilter->Update();
 
-    mesh->DeepCopy( transformFilter->GetOutput() );
+    mesh->ShallowCopy( transformFilter->GetOutput() );
 
     // Free memory
     delete[] objectCenter;
@@ -88,24 +112,107 @@ void VTKMeshRoutines::meshReduction( vtkSmartPointer<vtkPolyData> mesh, double r
     long long numberOfCellsBefore = mesh->GetNumberOfCells();
     cout << "Mesh reduction by " << std::fixed << std::setprecision( 3 ) << reduction << endl;
 
-    // Note1: vtkQuadricDecimation seems to be better than vtkDecimatePro
-    // Note2: vtkQuadricDecimation might have problem with face normals
-    vtkSmartPointer<vtkQuadricDecimation> decimator = vtkSmartPointer<vtkQuadricDecimation>::New();
-    decimator->SetInputData( mesh );
-    decimator->SetTargetReduction( reduction );
-    if( m_progressCallback.Get() != NULL )
+    vtkSmartPointer<vtkPolyData> reduced;
+    if( m_decimator == Decimator::ParallelQuadricDecimation )
     {
-        decimator->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+        vtkSmartPointer<vtkAlgorithm> progressReporter = createProgressReporter();
+        VTKQuadricDecimation::Statistics statistics;
+        reduced = VTKQuadricDecimation::decimate( mesh, reduction, m_nbrOfThreads, progressReporter.Get(), &statistics );
+        if( reduced.Get() != NULL )
+            printDecimationStatistics( statistics );
+        else
+            cout << endl << "Parallel decimation needs a triangle mesh, vtkQuadricDecimation is used instead" << endl;
     }
-    decimator->Update();
 
-    mesh->DeepCopy( decimator->GetOutput() );
+    if( reduced.Get() == NULL )
+        reduced = quadricDecimation( mesh, reduction );
+
+    mesh->ShallowCopy( reduced );
 
     long long numberOfCellsAfter = mesh->GetNumberOfCells();
     cout << endl << "Mesh reduced from " << numberOfCellsBefore << " to " <<  numberOfCellsAfter << " faces" << endl;
     cout << endl << endl;
 }
 
+bool VTKMeshRoutines::meshReduction( vtkSmartPointer<vtkPolyData> mesh, double reduction,
+                                     std::vector<VTKQuadricDecimation::VertexSplit>& vertexSplits )
+{
+    long long numberOfCellsBefore = mesh->GetNumberOfCells();
+    cout << "Progressive mesh reduction by " << std::fixed << std::setprecision( 3 ) << reduction << endl;
+
+    VTKQuadricDecimation decimation;
+    decimation.setRecordVertexSplits( true );
+    if( !decimation.setMesh( mesh, m_nbrOfThreads ) )
+    {
+        cerr << "Progressive mesh reduction needs a triangle mesh" << endl;
+        return false;
+    }
+
+    const size_t nbrOfTriangles = decimation.getNumberOfTriangles();
+    const size_t nbrToRemove = size_t( std::clamp( reduction, 0.0, 1.0 ) * double(nbrOfTriangles) + 0.5 );
+    vtkSmartPointer<vtkAlgorithm> progressReporter = createProgressReporter();
+    printDecimationStatistics( decimation.reduceTo( nbrOfTriangles - nbrToRemove, m_nbrOfThreads, progressReporter.Get() ) );
+    mesh->ShallowCopy( decimation.getMesh() );
+    vertexSplits = decimation.getVertexSplits();
+
+    long long numberOfCellsAfter = mesh->GetNumberOfCells();
+    cout << endl << "Mesh reduced from " << numberOfCellsBefore << " to " <<  numberOfCellsAfter << " faces, "
+         << vertexSplits.size() << " vertex splits recorded" << endl;
+    cout << endl << endl;
+    return true;
+}
+
+std::vector<vtkSmartPointer<vtkPolyData>> VTKMeshRoutines::meshLevelsOfDetail( vtkSmartPointer<vtkPolyData> mesh,
+                                                                               const std::vector<unsigned long>& polygonLimits )
+{
+    cout << "Levels of detail from " << mesh->GetNumberOfCells() << " faces" << endl;
+
+    // the levels are reduced from the finest to the coarsest, each continues where the former stopped
+    std::vector<size_t> order( polygonLimits.size() );
+    for( size_t l = 0; l < order.size(); l++ )
+        order[l] = l;
+    std::stable_sort( order.begin(), order.end(), [&polygonLimits]( size_t a, size_t b ) { return polygonLimits[a] > polygonLimits[b]; } );
+
+    std::vector<vtkSmartPointer<vtkPolyData>> levels( polygonLimits.size() );
+    std::unique_ptr<VTKQuadricDecimation> decimation;
+    if( m_decimator == Decimator::ParallelQuadricDecimation )
+    {
+        decimation.reset( new VTKQuadricDecimation() );
+        if( !decimation->setMesh( mesh, m_nbrOfThreads ) )
+        {
+            cout << "Parallel decimation needs a triangle mesh, vtkQuadricDecimation is used instead" << endl;
+            decimation.reset();
+        }
+    }
+
+    vtkSmartPointer<vtkPolyData> current = mesh;
+    vtkSmartPointer<vtkAlgorithm> progressReporter = createProgressReporter();
+    for( size_t l : order )
+    {
+        const vtkIdType polygonLimit = vtkIdType( polygonLimits[l] );
+        if( current->GetNumberOfCells() > polygonLimit )
+        {
+            if( decimation )
+            {
+                // the decimation keeps its state, so its quadrics carry the error of all former collapses
+                printDecimationStatistics( decimation->reduceTo( size_t(polygonLimit), m_nbrOfThreads, progressReporter.Get() ) );
+                current = decimation->getMesh();
+            }
+            else
+            {
+                current = quadricDecimation( current, 1.0 - double(polygonLimit) / double(current->GetNumberOfCells()) );
+            }
+        }
+
+        levels[l] = vtkSmartPointer<vtkPolyData>::New();
+        levels[l]->ShallowCopy( current );
+        cout << endl << "Level of detail with at most " << polygonLimit << " faces: " << levels[l]->GetNumberOfCells() << " faces" << endl;
+    }
+    cout << endl << endl;
+
+    return levels;
+}
+
 void VTKMeshRoutines::removeSmallObjects( vtkSmartPointer<vtkPolyData> mesh, double ratio )
 {
     cout << "Remove small connected objects: Size ratio = " << std::fixed << std::setprecision( 3 ) << ratio << endl;
@@ -133,10 +240,43 @@ void VTKMeshRoutines::removeSmallObjects( vtkSmartPointer<vtkPolyData> mesh, dou
 
     connectivityFilter->Update();
 
-    mesh->DeepCopy( connectivityFilter->GetOutput() );
+    mesh->ShallowCopy( connectivityFilter->GetOutput() );
     cout << "Done" << endl << endl << endl;
 }
 
+vtkSmartPointer<vtkAlgorithm> VTKMeshRoutines::createProgressReporter() const
+{
+    vtkSmartPointer<vtkAlgorithm> progressReporter;
+    if( m_progressCallback.Get() != NULL )
+    {
+        progressReporter = vtkSmartPointer<vtkAlgorithm>::New();
+        progressReporter->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+    }
+    return progressReporter;
+}
+
+vtkSmartPointer<vtkPolyData> VTKMeshRoutines::quadricDecimation( vtkPolyData* mesh, double reduction ) const
+{
+    // Note1: vtkQuadricDecimation seems to be better than vtkDecimatePro
+    // Note2: vtkQuadricDecimation might have problem with face normals
+    vtkSmartPointer<vtkQuadricDecimation> decimator = vtkSmartPointer<vtkQuadricDecimation>::New();
+    decimator->SetInputData( mesh );
+    decimator->SetTargetReduction( reduction );
+    if( m_progressCallback.Get() != NULL )
+    {
+        decimator->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
+    }
+    decimator->Update();
+    return decimator->GetOutput();
+}
+
+void VTKMeshRoutines::printDecimationStatistics( const VTKQuadricDecimation::Statistics& statistics ) const
+{
+    cout << endl << "Parallel decimation: " << statistics.nbrOfPartitions << " partitions, "
+         << statistics.nbrOfPartitionCollapses << " collapses within the partitions, "
+         << statistics.nbrOfBorderCollapses << " at their borders" << endl;
+}
+
 //Todo: Understand FeatureAngle and RelaxationFactor. Then add it as argument.
 void VTKMeshRoutines::smoothMesh( vtkSmartPointer<vtkPolyData> mesh, unsigned int nbrOfSmoothingIterations )
 {
@@ -153,6 +293,6 @@ void VTKMeshRoutines::smoothMesh( vtkSmartPointer<vtkPolyData> mesh, unsigned in
     }
     smoother->Update();
 
-    mesh->DeepCopy( smoother->GetOutput() );
+    mesh->ShallowCopy( smoother->GetOutput() );
     cout << endl << endl;
 }
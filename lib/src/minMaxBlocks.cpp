@@ -0,0 +1,221 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "minMaxBlocks.h"
+#include "parallelTools.h"
+
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+
+using namespace std;
+
+namespace
+{
+    /**
+     * Computes the value ranges of the blocks, one row of blocks along x per task.
+     */
+    template<class T>
+    void computeBlockRanges( const T* voxels, const int dims[3], const int nbrOfBlocks[3], unsigned int nbrOfThreads,
+                             std::vector<double>& minimum, std::vector<double>& maximum )
+    {
+        const int blockSize = VTKMinMaxBlocks::BlockSize;
+        const vtkIdType sliceSize = vtkIdType(dims[0]) * vtkIdType(dims[1]);
+
+        ParallelTools::parallelFor( 0, size_t(nbrOfBlocks[1]) * size_t(nbrOfBlocks[2]), nbrOfThreads, [&]( size_t row )
+        {
+            const int by = int( row % size_t(nbrOfBlocks[1]) );
+            const int bz = int( row / size_t(nbrOfBlocks[1]) );
+
+            // a block reaches up to the first voxel layer of the next block
+            const int j0 = by * blockSize;
+            const int j1 = std::min( j0 + blockSize, dims[1] - 1 );
+            const int k0 = bz * blockSize;
+            const int k1 = std::min( k0 + blockSize, dims[2] - 1 );
+
+            std::vector<T> lowest( nbrOfBlocks[0], std::numeric_limits<T>::max() );
+            std::vector<T> highest( nbrOfBlocks[0], std::numeric_limits<T>::lowest() );
+            for( int k = k0; k <= k1; k++ )
+            {
+                for( int j = j0; j <= j1; j++ )
+                {
+                    const T* line = voxels + k * sliceSize + vtkIdType(j) * dims[0];
+                    for( int bx = 0; bx < nbrOfBlocks[0]; bx++ )
+                    {
+                        const int i0 = bx * blockSize;
+                        const int i1 = std::min( i0 + blockSize, dims[0] - 1 );
+                        T lo = lowest[bx];
+                        T hi = highest[bx];
+                        for( int i = i0; i <= i1; i++ )
+                        {
+                            lo = std::min( lo, line[i] );
+                            hi = std::max( hi, line[i] );
+                        }
+                        lowest[bx] = lo;
+                        highest[bx] = hi;
+                    }
+                }
+            }
+
+            for( int bx = 0; bx < nbrOfBlocks[0]; bx++ )
+            {
+                minimum[row * nbrOfBlocks[0] + bx] = double( lowest[bx] );
+                maximum[row * nbrOfBlocks[0] + bx] = double( highest[bx] );
+            }
+        });
+    }
+
+    /**
+     * Flags the blocks one of the iso ranges may cross, with the band segmentation of the voxel type.
+     */
+    template<class T>
+    size_t flagActiveBlocks( const std::vector<double>& minimum, const std::vector<double>& maximum,
+                             const std::vector<VTKIsoSurface::IsoRange>& isoRanges, std::vector<char>& active )
+    {
+        std::vector<VTKIsoSurface::Band<T>> bands;
+        for( const VTKIsoSurface::IsoRange& isoRange : isoRanges )
+            bands.emplace_back( isoRange.threshold, isoRange.useUpperThreshold, isoRange.upperThreshold );
+
+        size_t nbrOfSkipped = 0;
+        for( size_t b = 0; b < minimum.size(); b++ )
+        {
+            bool mayCross = false;
+            for( size_t surface = 0; surface < bands.size() && !mayCross; surface++ )
+                mayCross = bands[surface].mayCross( minimum[b], maximum[b], double(isoRanges[surface].threshold) );
+
+            active[b] = mayCross ? 1 : 0;
+            if( !mayCross )
+                nbrOfSkipped++;
+        }
+        return nbrOfSkipped;
+    }
+}
+
+VTKMinMaxBlocks::VTKMinMaxBlocks()
+{
+    clear();
+}
+
+VTKMinMaxBlocks::~VTKMinMaxBlocks()
+{
+}
+
+void VTKMinMaxBlocks::clear()
+{
+    m_nbrOfBlocks[0] = m_nbrOfBlocks[1] = m_nbrOfBlocks[2] = 0;
+    m_minimum.clear();
+    m_maximum.clear();
+    m_scalarType = VTK_VOID;
+    m_dims[0] = m_dims[1] = m_dims[2] = 0;
+    m_voxels = NULL;
+    m_voxelsMTime = 0;
+}
+
+bool VTKMinMaxBlocks::build( vtkImageData* volume, unsigned int nbrOfThreads )
+{
+    clear();
+
+    vtkDataArray* scalars = volume->GetPointData()->GetScalars();
+    int dims[3];
+    volume->GetDimensions( dims );
+    if( scalars == NULL || scalars->GetNumberOfComponents() != 1 || dims[0] < 2 || dims[1] < 2 || dims[2] < 2 )
+    {
+        cerr << "Min/max blocks need a volume with one scalar component and at least two voxels in each direction" << endl;
+        return false;
+    }
+
+    for( int a = 0; a < 3; a++ )
+        m_nbrOfBlocks[a] = ( dims[a] - 1 + BlockSize - 1 ) / BlockSize;
+
+    const size_t nbrOfBlocks = size_t(m_nbrOfBlocks[0]) * size_t(m_nbrOfBlocks[1]) * size_t(m_nbrOfBlocks[2]);
+    m_minimum.resize( nbrOfBlocks );
+    m_maximum.resize( nbrOfBlocks );
+
+    switch( scalars->GetDataType() )
+    {
+        vtkTemplateMacro( computeBlockRanges( static_cast<const VTK_TT*>( scalars->GetVoidPointer(0) ), dims, m_nbrOfBlocks,
+                                              nbrOfThreads, m_minimum, m_maximum ) );
+        default:
+            cerr << "Min/max blocks: unsupported voxel type" << endl;
+            clear();
+            return false;
+    }
+
+    m_scalarType = scalars->GetDataType();
+    std::copy( dims, dims + 3, m_dims );
+    m_voxels = scalars->GetVoidPointer(0);
+    m_voxelsMTime = scalars->GetMTime();
+    return true;
+}
+
+bool VTKMinMaxBlocks::isBuiltFor( vtkImageData* volume ) const
+{
+    if( m_voxels == NULL )
+        return false;
+
+    vtkDataArray* scalars = volume->GetPointData()->GetScalars();
+    if( scalars == NULL )
+        return false;
+
+    int dims[3];
+    volume->GetDimensions( dims );
+    return scalars->GetVoidPointer(0) == m_voxels && scalars->GetMTime() == m_voxelsMTime &&
+           scalars->GetDataType() == m_scalarType && std::equal( dims, dims + 3, m_dims );
+}
+
+size_t VTKMinMaxBlocks::getNumberOfBlocks() const
+{
+    return m_minimum.size();
+}
+
+size_t VTKMinMaxBlocks::getBlockIndex( int bx, int by, int bz ) const
+{
+    return ( size_t(bz) * size_t(m_nbrOfBlocks[1]) + size_t(by) ) * size_t(m_nbrOfBlocks[0]) + size_t(bx);
+}
+
+double VTKMinMaxBlocks::getMinimum( int bx, int by, int bz ) const
+{
+    return m_minimum[getBlockIndex( bx, by, bz )];
+}
+
+double VTKMinMaxBlocks::getMaximum( int bx, int by, int bz ) const
+{
+    return m_maximum[getBlockIndex( bx, by, bz )];
+}
+
+VTKIsoSurface::ActiveBlocks VTKMinMaxBlocks::findActiveBlocks( const std::vector<VTKIsoSurface::IsoRange>& isoRanges ) const
+{
+    VTKIsoSurface::ActiveBlocks activeBlocks;
+    activeBlocks.blockSize = BlockSize;
+    std::copy( m_nbrOfBlocks, m_nbrOfBlocks + 3, activeBlocks.nbrOfBlocks );
+    activeBlocks.active.resize( m_minimum.size() );
+
+    switch( m_scalarType )
+    {
+        vtkTemplateMacro( activeBlocks.nbrOfSkippedBlocks = flagActiveBlocks<VTK_TT>( m_minimum, m_maximum, isoRanges, activeBlocks.active ) );
+    }
+
+    return activeBlocks;
+}
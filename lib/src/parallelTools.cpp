@@ -0,0 +1,240 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "parallelTools.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+unsigned int ParallelTools::resolveNumberOfThreads( unsigned int requested )
+{
+    if( requested > 0 )
+        return requested;
+
+    // hardware_concurrency may return 0 if the value is not computable
+    return std::max( 1u, std::thread::hardware_concurrency() );
+}
+
+void ParallelTools::parallelFor( size_t begin, size_t end, unsigned int nbrOfThreads,
+                                 const std::function<void(size_t)>& func,
+                                 const std::function<void(double)>& progress )
+{
+    if( end <= begin )
+        return;
+
+    const size_t nbrOfItems = end - begin;
+    const unsigned int nThreads = unsigned( std::min<size_t>( resolveNumberOfThreads( nbrOfThreads ), nbrOfItems ) );
+
+    std::atomic<size_t> nextItem( begin );
+    std::atomic<size_t> finishedItems( 0 );
+    std::atomic<bool> abort( false );
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto worker = [&]( bool isCallingThread )
+    {
+        size_t i;
+        while( !abort && (i = nextItem.fetch_add( 1 )) < end )
+        {
+            try
+            {
+                func( i );
+            }
+            catch( ... )
+            {
+                std::lock_guard<std::mutex> lock( errorMutex );
+                if( !error )
+                    error = std::current_exception();
+                abort = true;
+            }
+
+            size_t finished = ++finishedItems;
+            if( isCallingThread && progress )
+                progress( double(finished) / double(nbrOfItems) );
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for( unsigned int t = 1; t < nThreads; t++ )
+        threads.emplace_back( worker, false );
+
+    worker( true );
+
+    for( std::thread& t : threads )
+        t.join();
+
+    if( error )
+        std::rethrow_exception( error );
+
+    if( progress )
+        progress( 1.0 );
+}
+
+ParallelTools::PipelineStatistics ParallelTools::pipelineFor( size_t begin, size_t end, unsigned int nbrOfFetchThreads,
+                                                              unsigned int nbrOfProcessThreads, size_t queueDepth,
+                                                              const std::function<void(size_t)>& fetch,
+                                                              const std::function<void(size_t)>& process,
+                                                              const std::function<void(double)>& progress )
+{
+    using Clock = std::chrono::steady_clock;
+
+    PipelineStatistics statistics;
+    if( end <= begin )
+        return statistics;
+
+    const Clock::time_point pipelineBegin = Clock::now();
+    const size_t nbrOfItems = end - begin;
+    const unsigned int nFetchThreads = unsigned( std::min<size_t>( std::max( nbrOfFetchThreads, 1u ), nbrOfItems ) );
+    const unsigned int nProcessThreads = unsigned( std::min<size_t>( resolveNumberOfThreads( nbrOfProcessThreads ), nbrOfItems ) );
+    queueDepth = std::max<size_t>( queueDepth, 1 );
+
+    std::deque<size_t> fetchedItems;
+    std::mutex queueMutex;
+    std::condition_variable queueNotFull;
+    std::condition_variable queueNotEmpty;
+    unsigned int runningFetchThreads = nFetchThreads;
+
+    std::atomic<size_t> nextItem( begin );
+    std::atomic<size_t> processedItems( 0 );
+    std::atomic<bool> abort( false );
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    // phase durations in nanoseconds
+    std::atomic<long long> fetchTime( 0 ), processTime( 0 ), fetchWaitTime( 0 ), processWaitTime( 0 );
+    auto elapsed = []( Clock::time_point since )
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - since ).count();
+    };
+
+    auto fail = [&]()
+    {
+        {
+            std::lock_guard<std::mutex> lock( errorMutex );
+            if( !error )
+                error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock( queueMutex );
+        abort = true;
+        queueNotFull.notify_all();
+        queueNotEmpty.notify_all();
+    };
+
+    auto fetchWorker = [&]()
+    {
+        size_t i;
+        while( !abort && (i = nextItem.fetch_add( 1 )) < end )
+        {
+            Clock::time_point fetchBegin = Clock::now();
+            try
+            {
+                fetch( i );
+            }
+            catch( ... )
+            {
+                fail();
+            }
+            fetchTime += elapsed( fetchBegin );
+
+            Clock::time_point waitBegin = Clock::now();
+            std::unique_lock<std::mutex> lock( queueMutex );
+            queueNotFull.wait( lock, [&]() { return abort || fetchedItems.size() < queueDepth; } );
+            fetchWaitTime += elapsed( waitBegin );
+            if( abort )
+                break;
+
+            fetchedItems.push_back( i );
+            queueNotEmpty.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lock( queueMutex );
+        runningFetchThreads--;
+        queueNotEmpty.notify_all();
+    };
+
+    auto processWorker = [&]( bool isCallingThread )
+    {
+        for( ;; )
+        {
+            Clock::time_point waitBegin = Clock::now();
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock( queueMutex );
+                queueNotEmpty.wait( lock, [&]() { return abort || !fetchedItems.empty() || runningFetchThreads == 0; } );
+                if( abort || fetchedItems.empty() )
+                    break;
+
+                i = fetchedItems.front();
+                fetchedItems.pop_front();
+                queueNotFull.notify_one();
+            }
+            processWaitTime += elapsed( waitBegin );
+
+            Clock::time_point processBegin = Clock::now();
+            try
+            {
+                process( i );
+            }
+            catch( ... )
+            {
+                fail();
+            }
+            processTime += elapsed( processBegin );
+
+            size_t processed = ++processedItems;
+            if( isCallingThread && progress )
+                progress( double(processed) / double(nbrOfItems) );
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for( unsigned int t = 0; t < nFetchThreads; t++ )
+        threads.emplace_back( fetchWorker );
+    for( unsigned int t = 1; t < nProcessThreads; t++ )
+        threads.emplace_back( processWorker, false );
+
+    processWorker( true );
+
+    for( std::thread& t : threads )
+        t.join();
+
+    if( error )
+        std::rethrow_exception( error );
+
+    if( progress )
+        progress( 1.0 );
+
+    statistics.wallSeconds = double( elapsed( pipelineBegin ) ) * 1e-9;
+    statistics.fetchSeconds = double( fetchTime ) * 1e-9;
+    statistics.processSeconds = double( processTime ) * 1e-9;
+    statistics.fetchWaitSeconds = double( fetchWaitTime ) * 1e-9;
+    statistics.processWaitSeconds = double( processWaitTime ) * 1e-9;
+    return statistics;
+}
@@ -0,0 +1,734 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "quadricDecimation.h"
+#include "parallelTools.h"
+
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <iterator>
+
+using namespace std;
+
+namespace
+{
+    typedef std::array<double,10> Quadric; // a², ab, ac, ad, b², bc, bd, c², cd, d² of the planes ax + by + cz + d = 0
+
+    /**
+     * Adds the plane of a triangle to a quadric, weighted by the triangle area.
+     */
+    void addTrianglePlane( const std::array<double,3>& p0, const std::array<double,3>& p1, const std::array<double,3>& p2, Quadric& q )
+    {
+        const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        const double length = std::sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+        if( length == 0.0 )
+            return;
+
+        for( double& c : n )
+            c /= length;
+        const double d = -( n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2] );
+        const double area = 0.5 * length;
+        q[0] += area * n[0] * n[0]; q[1] += area * n[0] * n[1]; q[2] += area * n[0] * n[2]; q[3] += area * n[0] * d;
+        q[4] += area * n[1] * n[1]; q[5] += area * n[1] * n[2]; q[6] += area * n[1] * d;
+        q[7] += area * n[2] * n[2]; q[8] += area * n[2] * d;
+        q[9] += area * d * d;
+    }
+
+    /**
+     * Squared distance of a point to the planes of a quadric, weighted by their areas.
+     */
+    double quadricError( const Quadric& q, const double x[3] )
+    {
+        const double error = q[0] * x[0] * x[0] + 2.0 * q[1] * x[0] * x[1] + 2.0 * q[2] * x[0] * x[2] + 2.0 * q[3] * x[0]
+                           + q[4] * x[1] * x[1] + 2.0 * q[5] * x[1] * x[2] + 2.0 * q[6] * x[1]
+                           + q[7] * x[2] * x[2] + 2.0 * q[8] * x[2]
+                           + q[9];
+        return std::max( error, 0.0 );
+    }
+
+    /**
+     * Normal of a triangle, scaled by twice its area.
+     */
+    void triangleNormal( const double p0[3], const double p1[3], const double p2[3], double n[3] )
+    {
+        const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    /**
+     * Edge waiting for its collapse. The versions of its vertices tell if it is outdated.
+     */
+    struct QueuedEdge
+    {
+        double cost;
+        vtkIdType u;
+        vtkIdType v;
+        unsigned int versionU;
+        unsigned int versionV;
+
+        bool operator<( const QueuedEdge& other ) const
+        {
+            // lowest cost first, ties broken by the vertices for a deterministic order
+            if( cost != other.cost )
+                return cost > other.cost;
+            if( u != other.u )
+                return u > other.u;
+            return v > other.v;
+        }
+    };
+
+    /**
+     * Collects the vertices sharing an alive triangle with a vertex.
+     */
+    void collectNeighbours( const std::vector<vtkIdType>& triangles, const std::vector<std::array<vtkIdType,3>>& corners,
+                            const std::vector<char>& alive, vtkIdType vertex, std::vector<vtkIdType>& neighbours )
+    {
+        neighbours.clear();
+        for( vtkIdType t : triangles )
+        {
+            if( !alive[size_t(t)] )
+                continue;
+            for( vtkIdType c : corners[size_t(t)] )
+                if( c != vertex )
+                    neighbours.push_back( c );
+        }
+        std::sort( neighbours.begin(), neighbours.end() );
+        neighbours.erase( std::unique( neighbours.begin(), neighbours.end() ), neighbours.end() );
+    }
+}
+
+VTKQuadricDecimation::VTKQuadricDecimation()
+{
+    m_nbrOfTriangles = 0;
+    m_nbrOfPartitions = 0;
+    m_pointDataType = VTK_FLOAT;
+    m_cutAxis = 0;
+    m_recordCollapses = false;
+}
+
+VTKQuadricDecimation::~VTKQuadricDecimation()
+{
+}
+
+bool VTKQuadricDecimation::setMesh( vtkPolyData* mesh, unsigned int nbrOfThreads )
+{
+    const vtkIdType nbrOfPoints = mesh->GetNumberOfPoints();
+    if( mesh->GetNumberOfCells() != mesh->GetNumberOfPolys() )
+        return false;
+
+    m_triangles.clear();
+    m_triangles.reserve( size_t( mesh->GetNumberOfPolys() ) );
+    vtkCellArray* polys = mesh->GetPolys();
+    vtkSmartPointer<vtkIdList> cellPoints = vtkSmartPointer<vtkIdList>::New();
+    polys->InitTraversal();
+    while( polys->GetNextCell( cellPoints ) )
+    {
+        if( cellPoints->GetNumberOfIds() != 3 )
+            return false;
+        m_triangles.push_back( {{ cellPoints->GetId(0), cellPoints->GetId(1), cellPoints->GetId(2) }} );
+    }
+
+    m_pointDataType = nbrOfPoints > 0 ? mesh->GetPoints()->GetDataType() : VTK_FLOAT;
+    m_positions.resize( size_t(nbrOfPoints) );
+    for( vtkIdType p = 0; p < nbrOfPoints; p++ )
+        mesh->GetPoint( p, m_positions[size_t(p)].data() );
+
+    m_vertexTriangles.assign( size_t(nbrOfPoints), std::vector<vtkIdType>() );
+    for( size_t t = 0; t < m_triangles.size(); t++ )
+        for( vtkIdType c : m_triangles[t] )
+            m_vertexTriangles[size_t(c)].push_back( vtkIdType(t) );
+
+    m_triangleAlive.assign( m_triangles.size(), 1 );
+    m_vertexAlive.assign( size_t(nbrOfPoints), 1 );
+    m_versions.assign( size_t(nbrOfPoints), 0 );
+    m_quadrics.assign( size_t(nbrOfPoints), Quadric() );
+    m_onMeshBorder.assign( size_t(nbrOfPoints), 0 );
+    m_collapses.clear();
+    m_nbrOfTriangles = m_triangles.size();
+
+    // each vertex sums the planes of its own triangles, so no two threads write the same quadric
+    const size_t chunkSize = 4096;
+    ParallelTools::parallelFor( 0, ( size_t(nbrOfPoints) + chunkSize - 1 ) / chunkSize, nbrOfThreads, [&]( size_t chunk )
+    {
+        std::vector<vtkIdType> neighbours;
+        for( size_t v = chunk * chunkSize; v < std::min( size_t(nbrOfPoints), ( chunk + 1 ) * chunkSize ); v++ )
+        {
+            Quadric& q = m_quadrics[v];
+            q.fill( 0.0 );
+            for( vtkIdType t : m_vertexTriangles[v] )
+            {
+                const std::array<vtkIdType,3>& c = m_triangles[size_t(t)];
+                addTrianglePlane( m_positions[size_t(c[0])], m_positions[size_t(c[1])], m_positions[size_t(c[2])], q );
+            }
+
+            // on a closed manifold, each neighbour shares two triangles with the vertex
+            neighbours.clear();
+            for( vtkIdType t : m_vertexTriangles[v] )
+                for( vtkIdType c : m_triangles[size_t(t)] )
+                    if( size_t(c) != v )
+                        neighbours.push_back( c );
+            std::sort( neighbours.begin(), neighbours.end() );
+            for( size_t n = 0; n < neighbours.size() && !m_onMeshBorder[v]; )
+            {
+                size_t m = n;
+                while( m < neighbours.size() && neighbours[m] == neighbours[n] )
+                    m++;
+                m_onMeshBorder[v] = ( m - n ) != 2 ? 1 : 0;
+                n = m;
+            }
+        }
+    });
+
+    return true;
+}
+
+void VTKQuadricDecimation::setNumberOfPartitions( unsigned int nbrOfPartitions )
+{
+    m_nbrOfPartitions = nbrOfPartitions;
+}
+
+size_t VTKQuadricDecimation::getNumberOfTriangles() const
+{
+    return m_nbrOfTriangles;
+}
+
+unsigned int VTKQuadricDecimation::partition( unsigned int nbrOfPartitions, bool shifted, unsigned int nbrOfThreads )
+{
+    const size_t nbrOfVertices = m_positions.size();
+    m_vertexPartition.assign( nbrOfVertices, 0 );
+    m_locked.assign( nbrOfVertices, 0 );
+
+    if( shifted )
+    {
+        // the shifted cuts lie halfway between the previous ones, so that the previous borders are inside a slab
+        std::vector<double> cuts;
+        for( size_t c = 1; c < m_cuts.size(); c++ )
+            cuts.push_back( 0.5 * ( m_cuts[c - 1] + m_cuts[c] ) );
+        m_cuts = cuts;
+    }
+    else
+    {
+        m_cuts.clear();
+        if( nbrOfPartitions <= 1 )
+            return 1;
+
+        // slabs along the longest axis, cut at the quantiles of a sample of the vertices
+        double lower[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL }, upper[3] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+        for( size_t v = 0; v < nbrOfVertices; v++ )
+        {
+            if( !m_vertexAlive[v] )
+                continue;
+            for( int a = 0; a < 3; a++ )
+            {
+                lower[a] = std::min( lower[a], m_positions[v][a] );
+                upper[a] = std::max( upper[a], m_positions[v][a] );
+            }
+        }
+        m_cutAxis = 0;
+        for( int a = 1; a < 3; a++ )
+            if( upper[a] - lower[a] > upper[m_cutAxis] - lower[m_cutAxis] )
+                m_cutAxis = a;
+
+        std::vector<double> sample;
+        const size_t sampleStride = std::max( size_t(1), nbrOfVertices / 65536 );
+        for( size_t v = 0; v < nbrOfVertices; v += sampleStride )
+            if( m_vertexAlive[v] )
+                sample.push_back( m_positions[v][m_cutAxis] );
+        if( sample.empty() )
+            return 1;
+        std::sort( sample.begin(), sample.end() );
+        for( unsigned int p = 1; p < nbrOfPartitions; p++ )
+            m_cuts.push_back( sample[ sample.size() * p / nbrOfPartitions ] );
+    }
+    if( m_cuts.empty() )
+        return 1;
+
+    const std::vector<double>& cuts = m_cuts;
+    const int axis = m_cutAxis;
+    const size_t chunkSize = 4096;
+    const size_t nbrOfChunks = ( nbrOfVertices + chunkSize - 1 ) / chunkSize;
+    ParallelTools::parallelFor( 0, nbrOfChunks, nbrOfThreads, [&]( size_t chunk )
+    {
+        for( size_t v = chunk * chunkSize; v < std::min( nbrOfVertices, ( chunk + 1 ) * chunkSize ); v++ )
+            m_vertexPartition[v] = int( std::upper_bound( cuts.begin(), cuts.end(), m_positions[v][axis] ) - cuts.begin() );
+    });
+
+    // a vertex with a neighbour in another partition is locked, so that the triangles
+    // around the unlocked vertices of a partition all lie within the partition
+    ParallelTools::parallelFor( 0, nbrOfChunks, nbrOfThreads, [&]( size_t chunk )
+    {
+        for( size_t v = chunk * chunkSize; v < std::min( nbrOfVertices, ( chunk + 1 ) * chunkSize ); v++ )
+        {
+            for( vtkIdType t : m_vertexTriangles[v] )
+            {
+                if( !m_triangleAlive[size_t(t)] )
+                    continue;
+                for( vtkIdType c : m_triangles[size_t(t)] )
+                    if( m_vertexPartition[size_t(c)] != m_vertexPartition[v] )
+                        m_locked[v] = 1;
+            }
+        }
+    });
+
+    return unsigned( m_cuts.size() + 1 );
+}
+
+size_t VTKQuadricDecimation::collapsePartitions( unsigned int nbrOfPartitions, bool shifted, size_t nbrOfTriangles,
+                                                 unsigned int nbrOfThreads, const std::function<void(double)>& progress )
+{
+    nbrOfPartitions = partition( nbrOfPartitions, shifted, nbrOfThreads );
+
+    std::vector<std::vector<vtkIdType>> partitionVertices( nbrOfPartitions );
+    for( size_t v = 0; v < m_positions.size(); v++ )
+        if( m_vertexAlive[v] && !m_locked[v] )
+            partitionVertices[size_t(m_vertexPartition[v])].push_back( vtkIdType(v) );
+
+    std::vector<size_t> innerTriangles( nbrOfPartitions, 0 );
+    size_t nbrOfInnerTriangles = 0;
+    for( size_t t = 0; t < m_triangles.size(); t++ )
+    {
+        if( !m_triangleAlive[t] )
+            continue;
+        const std::array<vtkIdType,3>& c = m_triangles[t];
+        if( !m_locked[size_t(c[0])] && !m_locked[size_t(c[1])] && !m_locked[size_t(c[2])] )
+        {
+            innerTriangles[size_t(m_vertexPartition[size_t(c[0])])]++;
+            nbrOfInnerTriangles++;
+        }
+    }
+    if( nbrOfInnerTriangles == 0 )
+        return 0;
+
+    // the unshifted slabs leave out the triangles at their borders, which the shifted slabs catch up on
+    const size_t nbrToRemove = m_nbrOfTriangles - nbrOfTriangles;
+    const double fraction = shifted ? std::min( 1.0, double(nbrToRemove) / double(nbrOfInnerTriangles) )
+                                    : double(nbrToRemove) / double(m_nbrOfTriangles);
+    std::vector<size_t> partitionCollapses( nbrOfPartitions, 0 );
+    std::vector<std::vector<CollapseRecord>> partitionRecords( m_recordCollapses ? nbrOfPartitions : 0 );
+    ParallelTools::parallelFor( 0, nbrOfPartitions, nbrOfThreads, [&]( size_t p )
+    {
+        // an even share, as each collapse removes two triangles
+        const size_t share = 2 * size_t( 0.5 * fraction * double(innerTriangles[p]) );
+        partitionCollapses[p] = collapseEdges( partitionVertices[p], share, int(p), m_recordCollapses ? &partitionRecords[p] : NULL );
+    }, progress );
+
+    // the partitions share no vertex, so their collapses can be recorded one partition after the other
+    for( std::vector<CollapseRecord>& records : partitionRecords )
+        std::move( records.begin(), records.end(), std::back_inserter( m_collapses ) );
+
+    // each collapse of a closed manifold edge removes two triangles
+    size_t nbrOfCollapses = 0;
+    for( size_t collapses : partitionCollapses )
+        nbrOfCollapses += collapses;
+    m_nbrOfTriangles -= 2 * nbrOfCollapses;
+    return nbrOfCollapses;
+}
+
+bool VTKQuadricDecimation::isCollapsible( vtkIdType u, vtkIdType v, int partition ) const
+{
+    if( m_onMeshBorder[size_t(u)] || m_onMeshBorder[size_t(v)] )
+        return false;
+    if( partition < 0 )
+        return true;
+    return !m_locked[size_t(u)] && !m_locked[size_t(v)] &&
+           m_vertexPartition[size_t(u)] == partition && m_vertexPartition[size_t(v)] == partition;
+}
+
+double VTKQuadricDecimation::computeCollapse( vtkIdType u, vtkIdType v, double position[3] ) const
+{
+    Quadric q;
+    for( size_t k = 0; k < q.size(); k++ )
+        q[k] = m_quadrics[size_t(u)][k] + m_quadrics[size_t(v)][k];
+
+    const std::array<double,3>& pu = m_positions[size_t(u)];
+    const std::array<double,3>& pv = m_positions[size_t(v)];
+    const double midpoint[3] = { 0.5 * ( pu[0] + pv[0] ), 0.5 * ( pu[1] + pv[1] ), 0.5 * ( pu[2] + pv[2] ) };
+    const double edgeLength = std::sqrt( ( pu[0] - pv[0] ) * ( pu[0] - pv[0] ) + ( pu[1] - pv[1] ) * ( pu[1] - pv[1] ) +
+                                         ( pu[2] - pv[2] ) * ( pu[2] - pv[2] ) );
+
+    // the position minimizing the error solves A x = -b, by Cramer's rule
+    const double a00 = q[0], a01 = q[1], a02 = q[2], a11 = q[4], a12 = q[5], a22 = q[7];
+    const double b0 = -q[3], b1 = -q[6], b2 = -q[8];
+    const double c00 = a11 * a22 - a12 * a12, c01 = a02 * a12 - a01 * a22, c02 = a01 * a12 - a02 * a11;
+    const double det = a00 * c00 + a01 * c01 + a02 * c02;
+    const double scale = std::max( { std::abs(a00), std::abs(a11), std::abs(a22) } );
+    if( std::abs( det ) > 1e-10 * scale * scale * scale && scale > 0.0 )
+    {
+        const double c11 = a00 * a22 - a02 * a02, c12 = a01 * a02 - a00 * a12, c22 = a00 * a11 - a01 * a01;
+        const double x[3] = { ( c00 * b0 + c01 * b1 + c02 * b2 ) / det,
+                              ( c01 * b0 + c11 * b1 + c12 * b2 ) / det,
+                              ( c02 * b0 + c12 * b1 + c22 * b2 ) / det };
+
+        // a nearly flat neighbourhood may place the optimum far away from the edge
+        const double distance = std::sqrt( ( x[0] - midpoint[0] ) * ( x[0] - midpoint[0] ) + ( x[1] - midpoint[1] ) * ( x[1] - midpoint[1] ) +
+                                           ( x[2] - midpoint[2] ) * ( x[2] - midpoint[2] ) );
+        if( distance <= edgeLength )
+        {
+            std::copy( x, x + 3, position );
+            return quadricError( q, x );
+        }
+    }
+
+    // otherwise the best of the end points and the midpoint
+    const double* candidates[3] = { pu.data(), pv.data(), midpoint };
+    double bestError = HUGE_VAL;
+    for( const double* candidate : candidates )
+    {
+        const double error = quadricError( q, candidate );
+        if( error < bestError )
+        {
+            bestError = error;
+            std::copy( candidate, candidate + 3, position );
+        }
+    }
+    return bestError;
+}
+
+bool VTKQuadricDecimation::canCollapse( vtkIdType u, vtkIdType v, const double position[3] ) const
+{
+    // the edge lies between two triangles, and their opposite vertices are the only common neighbours
+    std::vector<vtkIdType> opposite;
+    for( vtkIdType t : m_vertexTriangles[size_t(v)] )
+    {
+        if( !m_triangleAlive[size_t(t)] )
+            continue;
+        const std::array<vtkIdType,3>& c = m_triangles[size_t(t)];
+        if( c[0] == u || c[1] == u || c[2] == u )
+            for( vtkIdType k : c )
+                if( k != u && k != v )
+                    opposite.push_back( k );
+    }
+    if( opposite.size() != 2 || opposite[0] == opposite[1] )
+        return false;
+
+    std::vector<vtkIdType> neighboursU, neighboursV, common;
+    collectNeighbours( m_vertexTriangles[size_t(u)], m_triangles, m_triangleAlive, u, neighboursU );
+    collectNeighbours( m_vertexTriangles[size_t(v)], m_triangles, m_triangleAlive, v, neighboursV );
+    std::set_intersection( neighboursU.begin(), neighboursU.end(), neighboursV.begin(), neighboursV.end(), std::back_inserter( common ) );
+    if( common.size() != 2 )
+        return false;
+
+    // the merged vertex keeps at least three neighbours
+    if( neighboursU.size() + neighboursV.size() < 7 )
+        return false;
+
+    // no remaining triangle around the edge may flip
+    for( vtkIdType vertex : { u, v } )
+    {
+        for( vtkIdType t : m_vertexTriangles[size_t(vertex)] )
+        {
+            if( !m_triangleAlive[size_t(t)] )
+                continue;
+            const std::array<vtkIdType,3>& c = m_triangles[size_t(t)];
+            const bool hasU = c[0] == u || c[1] == u || c[2] == u;
+            const bool hasV = c[0] == v || c[1] == v || c[2] == v;
+            if( hasU && hasV )
+                continue;
+
+            const double* before[3];
+            const double* after[3];
+            for( int k = 0; k < 3; k++ )
+            {
+                before[k] = m_positions[size_t(c[k])].data();
+                after[k] = c[k] == vertex ? position : before[k];
+            }
+            double normalBefore[3], normalAfter[3];
+            triangleNormal( before[0], before[1], before[2], normalBefore );
+            triangleNormal( after[0], after[1], after[2], normalAfter );
+            if( normalBefore[0] * normalAfter[0] + normalBefore[1] * normalAfter[1] + normalBefore[2] * normalAfter[2] <= 0.0 )
+                return false;
+        }
+    }
+    return true;
+}
+
+size_t VTKQuadricDecimation::collapse( vtkIdType u, vtkIdType v, const double position[3], CollapseRecord* record )
+{
+    if( record != NULL )
+    {
+        record->kept = u;
+        record->removed = v;
+        record->keptPosition = m_positions[size_t(u)];
+        record->removedPosition = m_positions[size_t(v)];
+        record->changedTriangles.clear();
+    }
+
+    size_t nbrOfRemovedTriangles = 0;
+    std::vector<vtkIdType>& trianglesU = m_vertexTriangles[size_t(u)];
+    for( vtkIdType t : m_vertexTriangles[size_t(v)] )
+    {
+        if( !m_triangleAlive[size_t(t)] )
+            continue;
+        std::array<vtkIdType,3>& c = m_triangles[size_t(t)];
+        if( c[0] == u || c[1] == u || c[2] == u )
+        {
+            // the triangles of the edge degenerate, their third vertex forgets them
+            m_triangleAlive[size_t(t)] = 0;
+            if( record != NULL )
+                record->removedTriangles[nbrOfRemovedTriangles] = t;
+            nbrOfRemovedTriangles++;
+            for( vtkIdType k : c )
+            {
+                if( k == u || k == v )
+                    continue;
+                std::vector<vtkIdType>& trianglesK = m_vertexTriangles[size_t(k)];
+                trianglesK.erase( std::remove( trianglesK.begin(), trianglesK.end(), t ), trianglesK.end() );
+            }
+        }
+        else
+        {
+            for( vtkIdType& k : c )
+                if( k == v )
+                    k = u;
+            trianglesU.push_back( t );
+            if( record != NULL )
+                record->changedTriangles.push_back( t );
+        }
+    }
+    trianglesU.erase( std::remove_if( trianglesU.begin(), trianglesU.end(), [this]( vtkIdType t ) { return !m_triangleAlive[size_t(t)]; } ),
+                      trianglesU.end() );
+    std::vector<vtkIdType>().swap( m_vertexTriangles[size_t(v)] );
+
+    for( size_t k = 0; k < m_quadrics[size_t(u)].size(); k++ )
+        m_quadrics[size_t(u)][k] += m_quadrics[size_t(v)][k];
+    std::copy( position, position + 3, m_positions[size_t(u)].begin() );
+    m_vertexAlive[size_t(v)] = 0;
+    m_versions[size_t(u)]++;
+    m_versions[size_t(v)]++;
+    return nbrOfRemovedTriangles;
+}
+
+size_t VTKQuadricDecimation::collapseEdges( const std::vector<vtkIdType>& seeds, size_t nbrOfTrianglesToRemove, int partition,
+                                            std::vector<CollapseRecord>* records )
+{
+    std::vector<QueuedEdge> queue;
+    std::vector<vtkIdType> neighbours;
+    auto queueEdges = [&]( vtkIdType u, bool allNeighbours )
+    {
+        collectNeighbours( m_vertexTriangles[size_t(u)], m_triangles, m_triangleAlive, u, neighbours );
+        for( vtkIdType w : neighbours )
+        {
+            // an edge between two seeds is queued by its lower vertex only
+            if( ( allNeighbours || u < w || !m_locked[size_t(w)] ) && isCollapsible( u, w, partition ) )
+            {
+                double position[3];
+                queue.push_back( { computeCollapse( u, w, position ), u, w, m_versions[size_t(u)], m_versions[size_t(w)] } );
+                if( allNeighbours )
+                    std::push_heap( queue.begin(), queue.end() );
+            }
+        }
+    };
+
+    // the first edges are ordered at once
+    for( vtkIdType u : seeds )
+        if( m_vertexAlive[size_t(u)] )
+            queueEdges( u, false );
+    std::make_heap( queue.begin(), queue.end() );
+
+    size_t nbrOfRemovedTriangles = 0;
+    size_t nbrOfCollapses = 0;
+    while( nbrOfRemovedTriangles < nbrOfTrianglesToRemove && !queue.empty() )
+    {
+        std::pop_heap( queue.begin(), queue.end() );
+        const QueuedEdge edge = queue.back();
+        queue.pop_back();
+        if( !m_vertexAlive[size_t(edge.u)] || !m_vertexAlive[size_t(edge.v)] ||
+            m_versions[size_t(edge.u)] != edge.versionU || m_versions[size_t(edge.v)] != edge.versionV )
+            continue;
+
+        double position[3];
+        computeCollapse( edge.u, edge.v, position );
+        if( !canCollapse( edge.u, edge.v, position ) )
+            continue;
+
+        CollapseRecord* record = NULL;
+        if( records != NULL )
+        {
+            records->emplace_back();
+            record = &records->back();
+        }
+        nbrOfRemovedTriangles += collapse( edge.u, edge.v, position, record );
+        nbrOfCollapses++;
+        queueEdges( edge.u, true );
+    }
+    return nbrOfCollapses;
+}
+
+VTKQuadricDecimation::Statistics VTKQuadricDecimation::reduceTo( size_t nbrOfTriangles, unsigned int nbrOfThreads,
+                                                                 vtkAlgorithm* progressReporter )
+{
+    Statistics statistics;
+    if( m_nbrOfTriangles <= nbrOfTriangles )
+        return statistics;
+
+    unsigned int nbrOfPartitions = m_nbrOfPartitions;
+    if( nbrOfPartitions == 0 )
+        nbrOfPartitions = unsigned( std::clamp( m_nbrOfTriangles / 50000, size_t(1), size_t(256) ) );
+    statistics.nbrOfPartitions = nbrOfPartitions;
+
+    std::function<void(double)> progress, shiftedProgress;
+    if( progressReporter != NULL )
+    {
+        progress = [progressReporter]( double done ) { progressReporter->UpdateProgress( 0.6 * done ); };
+        shiftedProgress = [progressReporter]( double done ) { progressReporter->UpdateProgress( 0.6 + 0.3 * done ); };
+    }
+    statistics.nbrOfPartitionCollapses += collapsePartitions( nbrOfPartitions, false, nbrOfTriangles, nbrOfThreads, progress );
+    if( nbrOfPartitions > 1 && m_nbrOfTriangles > nbrOfTriangles )
+        statistics.nbrOfPartitionCollapses += collapsePartitions( nbrOfPartitions, true, nbrOfTriangles, nbrOfThreads, shiftedProgress );
+
+    // the border pass starts at the locked vertices, and takes all edges if that is not enough
+    if( m_nbrOfTriangles > nbrOfTriangles )
+    {
+        std::vector<vtkIdType> borderVertices;
+        for( size_t v = 0; v < m_positions.size(); v++ )
+            if( m_vertexAlive[v] && m_locked[v] )
+                borderVertices.push_back( vtkIdType(v) );
+        size_t collapses = collapseEdges( borderVertices, m_nbrOfTriangles - nbrOfTriangles, -1, m_recordCollapses ? &m_collapses : NULL );
+        statistics.nbrOfBorderCollapses += collapses;
+        m_nbrOfTriangles -= 2 * collapses;
+    }
+    if( m_nbrOfTriangles > nbrOfTriangles )
+    {
+        std::fill( m_locked.begin(), m_locked.end(), 0 );
+        std::vector<vtkIdType> vertices;
+        for( size_t v = 0; v < m_positions.size(); v++ )
+            if( m_vertexAlive[v] )
+                vertices.push_back( vtkIdType(v) );
+        size_t collapses = collapseEdges( vertices, m_nbrOfTriangles - nbrOfTriangles, -1, m_recordCollapses ? &m_collapses : NULL );
+        statistics.nbrOfBorderCollapses += collapses;
+        m_nbrOfTriangles -= 2 * collapses;
+    }
+
+    if( progressReporter != NULL )
+        progressReporter->UpdateProgress( 1.0 );
+    return statistics;
+}
+
+std::vector<vtkIdType> VTKQuadricDecimation::numberVertices( vtkIdType& nbrOfVertices ) const
+{
+    // vertices keep their order, the removed ones are left out
+    std::vector<vtkIdType> newIds( m_positions.size(), -1 );
+    for( size_t t = 0; t < m_triangles.size(); t++ )
+        if( m_triangleAlive[t] )
+            for( vtkIdType c : m_triangles[t] )
+                newIds[size_t(c)] = 0;
+    nbrOfVertices = 0;
+    for( size_t v = 0; v < m_positions.size(); v++ )
+        if( newIds[v] == 0 )
+            newIds[v] = nbrOfVertices++;
+    return newIds;
+}
+
+vtkSmartPointer<vtkPolyData> VTKQuadricDecimation::getMesh() const
+{
+    vtkIdType nbrOfPoints = 0;
+    const std::vector<vtkIdType> newIds = numberVertices( nbrOfPoints );
+    vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataType( m_pointDataType );
+    points->SetNumberOfPoints( nbrOfPoints );
+    for( size_t v = 0; v < m_positions.size(); v++ )
+        if( newIds[v] >= 0 )
+            points->SetPoint( newIds[v], m_positions[v].data() );
+
+    vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+    for( size_t t = 0; t < m_triangles.size(); t++ )
+    {
+        if( !m_triangleAlive[t] )
+            continue;
+        const vtkIdType triangle[3] = { newIds[size_t(m_triangles[t][0])], newIds[size_t(m_triangles[t][1])], newIds[size_t(m_triangles[t][2])] };
+        polys->InsertNextCell( 3, triangle );
+    }
+
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->SetPoints( points );
+    mesh->SetPolys( polys );
+    return mesh;
+}
+
+void VTKQuadricDecimation::setRecordVertexSplits( bool record )
+{
+    m_recordCollapses = record;
+}
+
+std::vector<VTKQuadricDecimation::VertexSplit> VTKQuadricDecimation::getVertexSplits() const
+{
+    // the current mesh numbers the vertices and triangles as getMesh does, each split appends
+    // the vertex and the two triangles its collapse removed
+    vtkIdType nbrOfVertices = 0;
+    std::vector<vtkIdType> vertexIds = numberVertices( nbrOfVertices );
+    std::vector<vtkIdType> triangleIds( m_triangles.size(), -1 );
+    vtkIdType nbrOfTriangles = 0;
+    for( size_t t = 0; t < m_triangles.size(); t++ )
+        if( m_triangleAlive[t] )
+            triangleIds[t] = nbrOfTriangles++;
+
+    std::vector<VertexSplit> splits( m_collapses.size() );
+    for( size_t s = 0; s < splits.size(); s++ )
+    {
+        const CollapseRecord& record = m_collapses[m_collapses.size() - 1 - s];
+        vertexIds[size_t(record.removed)] = nbrOfVertices++;
+        for( vtkIdType t : record.removedTriangles )
+            triangleIds[size_t(t)] = nbrOfTriangles++;
+    }
+
+    for( size_t s = 0; s < splits.size(); s++ )
+    {
+        const CollapseRecord& record = m_collapses[m_collapses.size() - 1 - s];
+        VertexSplit& split = splits[s];
+        split.vertex = vertexIds[size_t(record.kept)];
+        split.position = record.keptPosition;
+        split.newVertexPosition = record.removedPosition;
+        for( size_t k = 0; k < 2; k++ )
+            for( size_t c = 0; c < 3; c++ )
+                split.newTriangles[k][c] = vertexIds[size_t(m_triangles[size_t(record.removedTriangles[k])][c])];
+        split.movedTriangles.clear();
+        for( vtkIdType t : record.changedTriangles )
+            split.movedTriangles.push_back( triangleIds[size_t(t)] );
+    }
+    return splits;
+}
+
+vtkSmartPointer<vtkPolyData> VTKQuadricDecimation::decimate( vtkPolyData* mesh, double reduction, unsigned int nbrOfThreads,
+                                                             vtkAlgorithm* progressReporter, Statistics* statistics )
+{
+    VTKQuadricDecimation decimation;
+    if( !decimation.setMesh( mesh, nbrOfThreads ) )
+        return NULL;
+
+    const size_t nbrOfTriangles = decimation.getNumberOfTriangles();
+    const size_t nbrToRemove = size_t( std::clamp( reduction, 0.0, 1.0 ) * double(nbrOfTriangles) + 0.5 );
+    Statistics reductionStatistics = decimation.reduceTo( nbrOfTriangles - nbrToRemove, nbrOfThreads, progressReporter );
+    if( statistics != NULL )
+        *statistics = reductionStatistics;
+    return decimation.getMesh();
+}
@@ -0,0 +1,138 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "slabStitcher.h"
+
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkPointData.h>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    // vertices within a few float steps of the seam plane lie on the seam
+    double seamTolerance( double seamZ )
+    {
+        float z = static_cast<float>( seamZ );
+        return 4.0 * ( double(std::nextafter( z, std::numeric_limits<float>::infinity() )) - double(z) );
+    }
+
+    uint64_t seamKey( double x, double y )
+    {
+        float fx = static_cast<float>( x );
+        float fy = static_cast<float>( y );
+        uint32_t bx, by;
+        std::memcpy( &bx, &fx, sizeof(bx) );
+        std::memcpy( &by, &fy, sizeof(by) );
+        return ( uint64_t(bx) << 32 ) | uint64_t(by);
+    }
+}
+
+VTKSlabStitcher::VTKSlabStitcher()
+{
+    m_mesh = vtkSmartPointer<vtkPolyData>::New();
+}
+
+VTKSlabStitcher::~VTKSlabStitcher()
+{
+}
+
+void VTKSlabStitcher::appendSlab( vtkPolyData* slabMesh, double lowerSeamZ, double upperSeamZ )
+{
+    vtkPoints* slabPoints = slabMesh->GetPoints();
+    vtkCellArray* slabPolys = slabMesh->GetPolys();
+    if( slabPoints == NULL || slabPolys == NULL || slabMesh->GetNumberOfPoints() == 0 )
+    {
+        // nothing to connect the next slab to
+        m_upperSeamVertices.clear();
+        return;
+    }
+
+    vtkPointData* slabPointData = slabMesh->GetPointData();
+    vtkPointData* meshPointData = m_mesh->GetPointData();
+    if( m_mesh->GetPoints() == NULL )
+    {
+        vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+        points->SetDataTypeToFloat();
+        m_mesh->SetPoints( points );
+        m_mesh->SetPolys( vtkSmartPointer<vtkCellArray>::New() );
+        meshPointData->CopyAllocate( slabPointData );
+    }
+
+    vtkPoints* meshPoints = m_mesh->GetPoints();
+    vtkCellArray* meshPolys = m_mesh->GetPolys();
+
+    const double lowerTolerance = seamTolerance( lowerSeamZ );
+    const double upperTolerance = seamTolerance( upperSeamZ );
+
+    std::unordered_map<uint64_t, vtkIdType> upperSeamVertices;
+    const vtkIdType nbrOfSlabPoints = slabMesh->GetNumberOfPoints();
+    std::vector<vtkIdType> meshIds( nbrOfSlabPoints );
+    for( vtkIdType i = 0; i < nbrOfSlabPoints; i++ )
+    {
+        double p[3];
+        slabPoints->GetPoint( i, p );
+        const uint64_t key = seamKey( p[0], p[1] );
+
+        vtkIdType meshId = -1;
+        if( std::abs( p[2] - lowerSeamZ ) <= lowerTolerance )
+        {
+            auto seamVertex = m_upperSeamVertices.find( key );
+            if( seamVertex != m_upperSeamVertices.end() )
+                meshId = seamVertex->second;
+        }
+
+        if( meshId < 0 )
+        {
+            meshId = meshPoints->InsertNextPoint( p );
+            meshPointData->CopyData( slabPointData, i, meshId );
+        }
+
+        if( std::abs( p[2] - upperSeamZ ) <= upperTolerance )
+            upperSeamVertices[key] = meshId;
+
+        meshIds[i] = meshId;
+    }
+    m_upperSeamVertices.swap( upperSeamVertices );
+
+    std::vector<vtkIdType> cellIds;
+    vtkSmartPointer<vtkIdList> cellPoints = vtkSmartPointer<vtkIdList>::New();
+    slabPolys->InitTraversal();
+    while( slabPolys->GetNextCell( cellPoints ) )
+    {
+        const vtkIdType nbrOfCellPoints = cellPoints->GetNumberOfIds();
+        cellIds.resize( nbrOfCellPoints );
+        for( vtkIdType k = 0; k < nbrOfCellPoints; k++ )
+            cellIds[k] = meshIds[cellPoints->GetId(k)];
+        meshPolys->InsertNextCell( nbrOfCellPoints, cellIds.data() );
+    }
+}
+
+vtkSmartPointer<vtkPolyData> VTKSlabStitcher::getMesh() const
+{
+    return m_mesh;
+}
@@ -0,0 +1,272 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "volumeCache.h"
+
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const char CACHE_MAGIC[8] = { 'D', '2', 'M', 'V', 'O', 'L', '0', '1' };
+    const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+    const uint64_t CACHE_DATA_OFFSET = 4096; // page aligned voxel data
+
+    struct CacheFileHeader
+    {
+        char magic[8];
+        uint32_t byteOrder;
+        int32_t scalarType;
+        int32_t nbrOfComponents;
+        int32_t extent[6];
+        double spacing[3];
+        double origin[3];
+        uint64_t dataOffset;
+        uint64_t dataSize;
+    };
+
+    uint64_t fnv1a( uint64_t hash, const void* data, size_t length )
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>( data );
+        for( size_t i = 0; i < length; i++ )
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+#ifndef _WIN32
+    // Mapped voxel buffers and the lengths of their mappings. VTK frees
+    // user defined buffers with a callback which only gets the pointer.
+    std::mutex mappingsMutex;
+    std::map<void*, std::pair<void*, size_t>> mappings;
+
+    void unmapVoxels( void* voxels )
+    {
+        std::lock_guard<std::mutex> lock( mappingsMutex );
+        auto it = mappings.find( voxels );
+        if( it != mappings.end() )
+        {
+            munmap( it->second.first, it->second.second );
+            mappings.erase( it );
+        }
+    }
+#endif
+}
+
+VTKVolumeCache::VTKVolumeCache( const std::string& cacheDirectory )
+{
+    m_cacheDirectory = cacheDirectory;
+}
+
+VTKVolumeCache::~VTKVolumeCache()
+{
+}
+
+std::string VTKVolumeCache::computeKey( const std::vector<std::string>& files, const std::string& variant )
+{
+    std::vector<std::string> sortedFiles = files;
+    std::sort( sortedFiles.begin(), sortedFiles.end() );
+
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for( const std::string& file : sortedFiles )
+    {
+        std::error_code ec;
+        int64_t fileSize = int64_t( std::filesystem::file_size( file, ec ) );
+        if( ec )
+            fileSize = -1;
+        int64_t modTime = int64_t( std::filesystem::last_write_time( file, ec ).time_since_epoch().count() );
+        if( ec )
+            modTime = -1;
+
+        hash = fnv1a( hash, file.c_str(), file.size() + 1 );
+        hash = fnv1a( hash, &fileSize, sizeof(fileSize) );
+        hash = fnv1a( hash, &modTime, sizeof(modTime) );
+    }
+    hash = fnv1a( hash, variant.c_str(), variant.size() + 1 );
+
+    std::ostringstream key;
+    key << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return key.str();
+}
+
+std::vector<std::string> VTKVolumeCache::listFiles( const std::string& directory )
+{
+    std::vector<std::string> files;
+    std::error_code ec;
+    for( const auto& entry : std::filesystem::directory_iterator( directory, ec ) )
+    {
+        if( entry.is_regular_file( ec ) )
+            files.push_back( entry.path().string() );
+    }
+    std::sort( files.begin(), files.end() );
+    return files;
+}
+
+std::string VTKVolumeCache::getCacheFilePath( const std::string& key ) const
+{
+    return ( std::filesystem::path( m_cacheDirectory ) / ( key + ".d2mvol" ) ).string();
+}
+
+vtkSmartPointer<vtkImageData> VTKVolumeCache::load( const std::string& key ) const
+{
+    std::string path = getCacheFilePath( key );
+    std::error_code ec;
+    if( !std::filesystem::exists( path, ec ) )
+        return NULL;
+
+    CacheFileHeader header;
+    std::ifstream headerFile( path, ios::in | ios::binary );
+    if( !headerFile.read( reinterpret_cast<char*>( &header ), sizeof(header) ) ||
+        std::memcmp( header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC) ) != 0 || header.byteOrder != CACHE_BYTE_ORDER )
+    {
+        cerr << "Invalid volume cache file " << path << endl;
+        return NULL;
+    }
+    headerFile.close();
+
+    vtkSmartPointer<vtkDataArray> scalars = vtkSmartPointer<vtkDataArray>::Take( vtkDataArray::CreateDataArray( header.scalarType ) );
+    if( scalars.Get() == NULL || header.nbrOfComponents < 1 )
+        return NULL;
+
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetExtent( header.extent );
+    volume->SetSpacing( header.spacing );
+    volume->SetOrigin( header.origin );
+
+    const uint64_t nbrOfValues = uint64_t( volume->GetNumberOfPoints() ) * uint64_t( header.nbrOfComponents );
+    if( nbrOfValues * uint64_t( scalars->GetDataTypeSize() ) != header.dataSize ||
+        std::filesystem::file_size( path, ec ) < header.dataOffset + header.dataSize )
+    {
+        cerr << "Truncated volume cache file " << path << endl;
+        return NULL;
+    }
+
+    scalars->SetNumberOfComponents( header.nbrOfComponents );
+
+#ifdef _WIN32
+    scalars->SetNumberOfTuples( volume->GetNumberOfPoints() );
+    std::ifstream dataFile( path, ios::in | ios::binary );
+    dataFile.seekg( std::streamoff( header.dataOffset ) );
+    if( !dataFile.read( static_cast<char*>( scalars->GetVoidPointer(0) ), std::streamsize( header.dataSize ) ) )
+        return NULL;
+#else
+    int fd = open( path.c_str(), O_RDONLY );
+    if( fd < 0 )
+        return NULL;
+
+    // private mapping: voxel changes stay in memory and never reach the cache file
+    size_t mappingLength = size_t( header.dataOffset + header.dataSize );
+    void* mapping = mmap( NULL, mappingLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( mapping == MAP_FAILED )
+    {
+        cerr << "Could not map volume cache file " << path << endl;
+        return NULL;
+    }
+
+    void* voxels = static_cast<char*>( mapping ) + header.dataOffset;
+    {
+        std::lock_guard<std::mutex> lock( mappingsMutex );
+        mappings[voxels] = std::make_pair( mapping, mappingLength );
+    }
+
+    scalars->SetVoidArray( voxels, vtkIdType( nbrOfValues ), 0, vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED );
+    scalars->SetArrayFreeFunction( &unmapVoxels );
+#endif
+
+    scalars->SetName( "ImageScalars" );
+    volume->GetPointData()->SetScalars( scalars );
+
+    return volume;
+}
+
+bool VTKVolumeCache::store( const std::string& key, vtkImageData* volume ) const
+{
+    vtkDataArray* scalars = volume->GetPointData()->GetScalars();
+    if( scalars == NULL )
+        return false;
+
+    std::error_code ec;
+    std::filesystem::create_directories( m_cacheDirectory, ec );
+
+    CacheFileHeader header;
+    std::memset( &header, 0, sizeof(header) );
+    std::memcpy( header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC) );
+    header.byteOrder = CACHE_BYTE_ORDER;
+    header.scalarType = scalars->GetDataType();
+    header.nbrOfComponents = scalars->GetNumberOfComponents();
+    volume->GetExtent( header.extent );
+    volume->GetSpacing( header.spacing );
+    volume->GetOrigin( header.origin );
+    header.dataOffset = CACHE_DATA_OFFSET;
+    header.dataSize = uint64_t( scalars->GetNumberOfValues() ) * uint64_t( scalars->GetDataTypeSize() );
+
+    // write to a temporary file first, so that readers never see a partial entry
+    std::string path = getCacheFilePath( key );
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file( tmpPath, ios::out | ios::binary | ios::trunc );
+        std::vector<char> padding( size_t( CACHE_DATA_OFFSET - sizeof(header) ), 0 );
+        file.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+        file.write( padding.data(), std::streamsize( padding.size() ) );
+        file.write( static_cast<const char*>( scalars->GetVoidPointer(0) ), std::streamsize( header.dataSize ) );
+        if( !file.good() )
+        {
+            cerr << "Could not write volume cache file " << tmpPath << endl;
+            file.close();
+            std::filesystem::remove( tmpPath, ec );
+            return false;
+        }
+    }
+
+    std::filesystem::rename( tmpPath, path, ec );
+    if( ec )
+    {
+        std::filesystem::remove( tmpPath, ec );
+        return false;
+    }
+
+    return true;
+}
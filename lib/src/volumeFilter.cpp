@@ -0,0 +1,243 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "volumeFilter.h"
+#include "parallelTools.h"
+
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+    /**
+     * Samples a Gaussian up to three standard deviations and normalizes the weights.
+     * @param sigma Standard deviation in voxels.
+     * @return Weights from -radius to radius. A single weight if sigma is below a tenth of a voxel.
+     */
+    std::vector<float> gaussianKernel( double sigma )
+    {
+        if( !( sigma >= 0.1 ) )
+            return { 1.0f };
+
+        const int radius = int( std::ceil( 3.0 * sigma ) );
+        std::vector<double> weights( size_t( 2 * radius + 1 ) );
+        double sum = 0.0;
+        for( int k = -radius; k <= radius; k++ )
+        {
+            weights[size_t(k + radius)] = std::exp( -0.5 * double(k * k) / ( sigma * sigma ) );
+            sum += weights[size_t(k + radius)];
+        }
+
+        std::vector<float> kernel( weights.size() );
+        for( size_t k = 0; k < weights.size(); k++ )
+            kernel[k] = float( weights[k] / sum );
+        return kernel;
+    }
+
+    /**
+     * Adds a weighted row to an accumulated row.
+     */
+    inline void addWeightedRow( float weight, const float* row, float* sum, int length )
+    {
+        for( int x = 0; x < length; x++ )
+            sum[x] += weight * row[x];
+    }
+
+    /**
+     * Converts a filtered value to the voxel type, rounding and clamping integers.
+     */
+    template<class T>
+    inline T toVoxel( float value )
+    {
+        if constexpr( std::is_integral<T>::value )
+        {
+            const double rounded = std::round( double(value) );
+            if( rounded <= double( std::numeric_limits<T>::lowest() ) )
+                return std::numeric_limits<T>::lowest();
+            if( rounded >= double( std::numeric_limits<T>::max() ) )
+                return std::numeric_limits<T>::max();
+            return T( rounded );
+        }
+        else
+        {
+            return T( value );
+        }
+    }
+
+    /**
+     * Filters a slice along x and y.
+     * @param slice Voxels of the slice.
+     * @param target Filtered slice.
+     * @param nx Width of the slice.
+     * @param ny Height of the slice.
+     * @param kernels Kernels along x and y.
+     * @param padded Buffer of nx + 2 * radius values along x.
+     * @param rows Buffer of one slice.
+     */
+    template<class T>
+    void filterSlice( const T* slice, float* target, int nx, int ny, const std::vector<float> kernels[3],
+                      std::vector<float>& padded, std::vector<float>& rows )
+    {
+        const int rx = int( kernels[0].size() / 2 ), ry = int( kernels[1].size() / 2 );
+
+        // each row is padded with its border voxels, then filtered along x
+        for( int y = 0; y < ny; y++ )
+        {
+            const T* row = slice + size_t(y) * size_t(nx);
+            std::fill( padded.begin(), padded.begin() + rx, float( row[0] ) );
+            for( int x = 0; x < nx; x++ )
+                padded[size_t(x + rx)] = float( row[x] );
+            std::fill( padded.begin() + rx + nx, padded.end(), float( row[nx - 1] ) );
+
+            // shifted copies of the padded row are summed, which vectorizes like the other axes
+            float* filteredRow = rows.data() + size_t(y) * size_t(nx);
+            std::fill( filteredRow, filteredRow + nx, 0.0f );
+            for( size_t k = 0; k < kernels[0].size(); k++ )
+                addWeightedRow( kernels[0][k], padded.data() + k, filteredRow, nx );
+        }
+
+        // along y, whole rows are combined, so that the slice is read sequentially
+        std::fill( target, target + size_t(nx) * size_t(ny), 0.0f );
+        for( int y = 0; y < ny; y++ )
+        {
+            for( int k = -ry; k <= ry; k++ )
+            {
+                const int yy = std::clamp( y + k, 0, ny - 1 );
+                addWeightedRow( kernels[1][size_t(k + ry)], rows.data() + size_t(yy) * size_t(nx), target + size_t(y) * size_t(nx), nx );
+            }
+        }
+    }
+
+    template<class T>
+    void filterVolume( const T* voxels, T* filtered, const int dims[3], const std::vector<float> kernels[3],
+                       unsigned int nbrOfThreads, const std::function<void(double)>& progress )
+    {
+        const int nx = dims[0], ny = dims[1], nz = dims[2];
+        const size_t sliceSize = size_t(nx) * size_t(ny);
+        const int rx = int( kernels[0].size() / 2 ), rz = int( kernels[2].size() / 2 );
+        const size_t windowSize = size_t( 2 * rz + 1 );
+
+        // Each chunk of slices runs along z with a window of the 2 * rz + 1 slices filtered
+        // along x and y which the current output slice needs, so only one window per thread
+        // is held instead of the whole volume in floats. The slices around a chunk are
+        // filtered by both neighbouring chunks: there are at least as many chunks as
+        // threads, and more only as long as a chunk spans several windows.
+        const size_t nbrOfThreadsUsed = ParallelTools::resolveNumberOfThreads( nbrOfThreads );
+        const size_t nbrOfChunks = std::min( size_t(nz), std::max( nbrOfThreadsUsed,
+                                             std::min( 4 * nbrOfThreadsUsed, size_t(nz) / ( 8 * windowSize ) ) ) );
+
+        ParallelTools::parallelFor( 0, nbrOfChunks, nbrOfThreads, [&]( size_t chunk )
+        {
+            const int zBegin = int( chunk * size_t(nz) / nbrOfChunks );
+            const int zEnd = int( ( chunk + 1 ) * size_t(nz) / nbrOfChunks );
+
+            std::vector<float> padded( size_t( nx + 2 * rx ) );
+            std::vector<float> rows( sliceSize );
+            std::vector<float> window( windowSize * sliceSize );
+            std::vector<float> sum( nx );
+
+            // slice k of the volume, clamped to its border slices, lives in slot k mod windowSize
+            auto windowSlice = [&]( int k ) -> float*
+            {
+                const int slot = ( k % int(windowSize) + int(windowSize) ) % int(windowSize);
+                return window.data() + size_t(slot) * sliceSize;
+            };
+            auto loadSlice = [&]( int k )
+            {
+                const size_t zz = size_t( std::clamp( k, 0, nz - 1 ) );
+                filterSlice( voxels + zz * sliceSize, windowSlice(k), nx, ny, kernels, padded, rows );
+            };
+
+            for( int k = zBegin - rz; k < zBegin + rz; k++ )
+                loadSlice( k );
+
+            for( int z = zBegin; z < zEnd; z++ )
+            {
+                // replaces slice z - rz - 1, which is not needed anymore
+                loadSlice( z + rz );
+
+                // along z, each output row combines the same row of the neighbouring slices
+                for( int y = 0; y < ny; y++ )
+                {
+                    std::fill( sum.begin(), sum.end(), 0.0f );
+                    for( int k = -rz; k <= rz; k++ )
+                        addWeightedRow( kernels[2][size_t(k + rz)], windowSlice( z + k ) + size_t(y) * size_t(nx), sum.data(), nx );
+
+                    T* filteredRow = filtered + size_t(z) * sliceSize + size_t(y) * size_t(nx);
+                    for( int x = 0; x < nx; x++ )
+                        filteredRow[x] = toVoxel<T>( sum[size_t(x)] );
+                }
+            }
+        }, progress );
+    }
+}
+
+vtkSmartPointer<vtkImageData> VTKVolumeFilter::gaussian( vtkImageData* volume, double sigma, unsigned int nbrOfThreads,
+                                                         vtkAlgorithm* progressReporter )
+{
+    vtkDataArray* scalars = volume->GetPointData()->GetScalars();
+    int dims[3];
+    volume->GetDimensions( dims );
+    if( scalars == NULL || scalars->GetNumberOfComponents() != 1 || dims[0] < 1 || dims[1] < 1 || dims[2] < 1 )
+    {
+        cerr << "Gaussian filter needs a volume with one scalar component" << endl;
+        return NULL;
+    }
+
+    // the same sigma in mm covers fewer voxels along an axis of coarse spacing
+    double spacing[3];
+    volume->GetSpacing( spacing );
+    std::vector<float> kernels[3];
+    for( int a = 0; a < 3; a++ )
+        kernels[a] = gaussianKernel( spacing[a] != 0.0 ? sigma / std::abs( spacing[a] ) : 0.0 );
+
+    vtkSmartPointer<vtkImageData> filtered = vtkSmartPointer<vtkImageData>::New();
+    filtered->CopyStructure( volume );
+    filtered->AllocateScalars( scalars->GetDataType(), 1 );
+
+    std::function<void(double)> progress;
+    if( progressReporter != NULL )
+        progress = [progressReporter]( double done ) { progressReporter->UpdateProgress( done ); };
+
+    switch( scalars->GetDataType() )
+    {
+        vtkTemplateMacro( filterVolume( static_cast<const VTK_TT*>( scalars->GetVoidPointer(0) ),
+                                        static_cast<VTK_TT*>( filtered->GetScalarPointer() ), dims, kernels, nbrOfThreads, progress ) );
+        default:
+            cerr << "Gaussian filter: unsupported voxel type" << endl;
+            return NULL;
+    }
+
+    if( progressReporter != NULL )
+        progressReporter->UpdateProgress( 1.0 );
+    return filtered;
+}
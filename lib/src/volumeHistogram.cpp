@@ -0,0 +1,154 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "volumeHistogram.h"
+#include "parallelTools.h"
+
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+using namespace std;
+
+namespace
+{
+    template<class T>
+    void computeHistogram( const T* voxels, size_t nbrOfVoxels, unsigned int nbrOfBins, unsigned int nbrOfThreads,
+                           VTKVolumeHistogram::Histogram& histogram )
+    {
+        // a few chunks per thread balance the load and keep the per-chunk bins small
+        const size_t nbrOfChunks = std::max( size_t(1), std::min( nbrOfVoxels / 4096,
+                                                                  size_t( 4 * ParallelTools::resolveNumberOfThreads( nbrOfThreads ) ) ) );
+        const size_t chunkSize = ( nbrOfVoxels + nbrOfChunks - 1 ) / nbrOfChunks;
+
+        std::vector<std::pair<double,double>> ranges( nbrOfChunks, std::make_pair( std::numeric_limits<double>::infinity(),
+                                                                                   -std::numeric_limits<double>::infinity() ) );
+        ParallelTools::parallelFor( 0, nbrOfChunks, nbrOfThreads, [&]( size_t chunk )
+        {
+            double lowest = ranges[chunk].first, highest = ranges[chunk].second;
+            for( size_t v = chunk * chunkSize; v < std::min( nbrOfVoxels, ( chunk + 1 ) * chunkSize ); v++ )
+            {
+                const double value = double( voxels[v] );
+                if( std::isnan( value ) )
+                    continue;
+                lowest = std::min( lowest, value );
+                highest = std::max( highest, value );
+            }
+            ranges[chunk] = std::make_pair( lowest, highest );
+        } );
+
+        double minimum = std::numeric_limits<double>::infinity(), maximum = -std::numeric_limits<double>::infinity();
+        for( const std::pair<double,double>& range : ranges )
+        {
+            minimum = std::min( minimum, range.first );
+            maximum = std::max( maximum, range.second );
+        }
+        if( minimum > maximum )
+            return;
+
+        size_t nbrOfUsedBins = nbrOfBins;
+        double binWidth = 1.0;
+        if( std::is_integral<T>::value )
+        {
+            binWidth = std::max( 1.0, std::ceil( ( maximum - minimum + 1.0 ) / nbrOfBins ) );
+            nbrOfUsedBins = size_t( ( maximum - minimum ) / binWidth ) + 1;
+        }
+        else if( maximum > minimum )
+        {
+            binWidth = ( maximum - minimum ) / nbrOfBins;
+        }
+        else
+        {
+            nbrOfUsedBins = 1;
+        }
+
+        std::vector<std::vector<size_t>> chunkCounts( nbrOfChunks );
+        ParallelTools::parallelFor( 0, nbrOfChunks, nbrOfThreads, [&]( size_t chunk )
+        {
+            std::vector<size_t>& counts = chunkCounts[chunk];
+            counts.assign( nbrOfUsedBins, 0 );
+            for( size_t v = chunk * chunkSize; v < std::min( nbrOfVoxels, ( chunk + 1 ) * chunkSize ); v++ )
+            {
+                const double value = double( voxels[v] );
+                if( std::isnan( value ) )
+                    continue;
+                counts[ std::min( size_t( ( value - minimum ) / binWidth ), nbrOfUsedBins - 1 ) ]++;
+            }
+        } );
+
+        histogram.minimum = minimum;
+        histogram.maximum = maximum;
+        histogram.binWidth = binWidth;
+        histogram.counts.assign( nbrOfUsedBins, 0 );
+        for( const std::vector<size_t>& counts : chunkCounts )
+            for( size_t b = 0; b < nbrOfUsedBins; b++ )
+                histogram.counts[b] += counts[b];
+        for( size_t count : histogram.counts )
+            histogram.nbrOfVoxels += count;
+    }
+}
+
+double VTKVolumeHistogram::Histogram::getBinStart( size_t bin ) const
+{
+    return minimum + double(bin) * binWidth;
+}
+
+size_t VTKVolumeHistogram::Histogram::countFrom( double value ) const
+{
+    size_t count = 0;
+    for( size_t b = 0; b < counts.size(); b++ )
+    {
+        if( getBinStart( b ) >= value )
+            count += counts[b];
+    }
+    return count;
+}
+
+VTKVolumeHistogram::Histogram VTKVolumeHistogram::compute( vtkImageData* volume, unsigned int nbrOfBins, unsigned int nbrOfThreads )
+{
+    Histogram histogram;
+
+    vtkDataArray* inScalars = volume->GetPointData()->GetScalars();
+    if( inScalars == NULL || inScalars->GetNumberOfComponents() != 1 )
+    {
+        cerr << "Histogram needs a volume with one scalar component" << endl;
+        return histogram;
+    }
+
+    const size_t nbrOfVoxels = size_t( inScalars->GetNumberOfTuples() );
+    if( nbrOfVoxels == 0 )
+        return histogram;
+
+    switch( inScalars->GetDataType() )
+    {
+        vtkTemplateMacro( computeHistogram( static_cast<const VTK_TT*>( inScalars->GetVoidPointer(0) ), nbrOfVoxels,
+                                            std::max( nbrOfBins, 1u ), nbrOfThreads, histogram ) );
+    }
+
+    return histogram;
+}
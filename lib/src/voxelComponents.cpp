@@ -0,0 +1,284 @@
+/****************************************************************************
+** Copyright (c) 2017 Adrian Schneider, https://github.com/eidelen
+**
+** Permission is hereby granted, free of charge, to any person obtaining a
+** copy of this software and associated documentation files (the "Software"),
+** to deal in the Software without restriction, including without limitation
+** the rights to use, copy, modify, merge, publish, distribute, sublicense,
+** and/or sell copies of the Software, and to permit persons to whom the
+** Software is furnished to do so, subject to the following conditions:
+**
+** The above copyright notice and this permission notice shall be included in
+** all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+** AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+** LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+** FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+*****************************************************************************/
+
+#include "voxelComponents.h"
+#include "parallelTools.h"
+
+#include <vtkPointData.h>
+#include <vtkDataArray.h>
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+
+using namespace std;
+
+namespace
+{
+    /**
+     * Voxels [x0, x1) of a row inside the iso range.
+     */
+    struct Run
+    {
+        int x0;
+        int x1;
+    };
+
+    /**
+     * Runs of all rows, row j of slice k having index k * dims[1] + j.
+     */
+    struct RunSet
+    {
+        std::vector<Run> runs;
+        std::vector<size_t> rowStart; // first run of each row, one entry more than rows
+    };
+
+    /**
+     * Range of slices labelled by one task.
+     */
+    struct Slab
+    {
+        int k0;
+        int k1;
+    };
+
+    size_t findRoot( std::vector<size_t>& parent, size_t run )
+    {
+        while( parent[run] != run )
+        {
+            parent[run] = parent[parent[run]];
+            run = parent[run];
+        }
+        return run;
+    }
+
+    void unite( std::vector<size_t>& parent, size_t a, size_t b )
+    {
+        const size_t rootA = findRoot( parent, a );
+        const size_t rootB = findRoot( parent, b );
+        if( rootA < rootB )
+            parent[rootB] = rootA;
+        else if( rootB < rootA )
+            parent[rootA] = rootB;
+    }
+
+    /**
+     * Joins the runs of two rows which touch, diagonal neighbours included.
+     */
+    void uniteRows( const RunSet& set, size_t row, size_t otherRow, std::vector<size_t>& parent )
+    {
+        size_t a = set.rowStart[row];
+        size_t b = set.rowStart[otherRow];
+        const size_t aEnd = set.rowStart[row + 1];
+        const size_t bEnd = set.rowStart[otherRow + 1];
+        while( a < aEnd && b < bEnd )
+        {
+            const Run& runA = set.runs[a];
+            const Run& runB = set.runs[b];
+            if( runA.x0 <= runB.x1 && runB.x0 <= runA.x1 )
+                unite( parent, a, b );
+
+            // advance the run ending first, the other one may touch the next run
+            if( runA.x1 < runB.x1 )
+                a++;
+            else
+                b++;
+        }
+    }
+
+    /**
+     * Joins the runs of a row with the touching runs of the previous row
+     * and of the three neighbouring rows in the previous slice.
+     */
+    void uniteWithPreviousRows( const RunSet& set, int j, int k, bool withPreviousSlice, const int dims[3], std::vector<size_t>& parent )
+    {
+        const size_t row = size_t(k) * size_t(dims[1]) + size_t(j);
+        if( j > 0 )
+            uniteRows( set, row, row - 1, parent );
+
+        if( withPreviousSlice )
+        {
+            const size_t below = row - size_t(dims[1]);
+            for( int dj = std::max( j - 1, 0 ); dj <= std::min( j + 1, dims[1] - 1 ); dj++ )
+                uniteRows( set, row, below - size_t(j) + size_t(dj), parent );
+        }
+    }
+
+    /**
+     * Collects the runs of voxels inside the iso range, one slab per task.
+     */
+    template<class T>
+    void findRuns( const T* voxels, const int dims[3], const VTKIsoSurface::IsoRange& isoRange, const std::vector<Slab>& slabs,
+                   unsigned int nbrOfThreads, RunSet& set )
+    {
+        const VTKIsoSurface::Band<T> band( isoRange.threshold, isoRange.useUpperThreshold, isoRange.upperThreshold );
+        const double value = double( isoRange.threshold );
+        const size_t nbrOfRows = size_t(dims[1]) * size_t(dims[2]);
+
+        std::vector<std::vector<Run>> slabRuns( slabs.size() );
+        set.rowStart.assign( nbrOfRows + 1, 0 );
+
+        ParallelTools::parallelFor( 0, slabs.size(), nbrOfThreads, [&]( size_t s )
+        {
+            for( size_t row = size_t(slabs[s].k0) * size_t(dims[1]); row < size_t(slabs[s].k1) * size_t(dims[1]); row++ )
+            {
+                const T* line = voxels + vtkIdType(row) * dims[0];
+                const size_t nbrOfRuns = slabRuns[s].size();
+                int i = 0;
+                while( i < dims[0] )
+                {
+                    while( i < dims[0] && band( line[i] ) < value )
+                        i++;
+                    if( i == dims[0] )
+                        break;
+
+                    const int x0 = i;
+                    while( i < dims[0] && band( line[i] ) >= value )
+                        i++;
+                    slabRuns[s].push_back( { x0, i } );
+                }
+                set.rowStart[row + 1] = slabRuns[s].size() - nbrOfRuns;
+            }
+        });
+
+        std::partial_sum( set.rowStart.begin(), set.rowStart.end(), set.rowStart.begin() );
+        set.runs.resize( set.rowStart.back() );
+
+        ParallelTools::parallelFor( 0, slabs.size(), nbrOfThreads, [&]( size_t s )
+        {
+            const size_t first = set.rowStart[size_t(slabs[s].k0) * size_t(dims[1])];
+            std::copy( slabRuns[s].begin(), slabRuns[s].end(), set.runs.begin() + first );
+            std::vector<Run>().swap( slabRuns[s] );
+        });
+    }
+}
+
+std::shared_ptr<const VTKIsoSurface::ExcludedVoxels> VTKVoxelComponents::findSmallComponents( vtkImageData* volume,
+                                                                                             const VTKIsoSurface::IsoRange& isoRange,
+                                                                                             double ratio, unsigned int nbrOfThreads,
+                                                                                             Statistics& statistics )
+{
+    statistics = Statistics();
+
+    vtkDataArray* scalars = volume->GetPointData()->GetScalars();
+    int dims[3];
+    volume->GetDimensions( dims );
+    if( scalars == NULL || scalars->GetNumberOfComponents() != 1 || dims[0] < 1 || dims[1] < 1 || dims[2] < 1 )
+    {
+        cerr << "Voxel components need a volume with one scalar component" << endl;
+        return NULL;
+    }
+
+    // several slabs per thread balance uneven slabs
+    nbrOfThreads = ParallelTools::resolveNumberOfThreads( nbrOfThreads );
+    const int nbrOfSlabs = std::min( dims[2], int(nbrOfThreads) * 4 );
+    std::vector<Slab> slabs( nbrOfSlabs );
+    for( int s = 0; s < nbrOfSlabs; s++ )
+        slabs[s] = { int( vtkIdType(dims[2]) * s / nbrOfSlabs ), int( vtkIdType(dims[2]) * ( s + 1 ) / nbrOfSlabs ) };
+
+    RunSet set;
+    switch( scalars->GetDataType() )
+    {
+        vtkTemplateMacro( findRuns( static_cast<const VTK_TT*>( scalars->GetVoidPointer(0) ), dims, isoRange, slabs, nbrOfThreads, set ) );
+        default:
+            cerr << "Voxel components: unsupported voxel type" << endl;
+            return NULL;
+    }
+
+    // the runs of a slab are joined within the slab first, touching only its own runs
+    std::vector<size_t> parent( set.runs.size() );
+    std::iota( parent.begin(), parent.end(), size_t(0) );
+
+    ParallelTools::parallelFor( 0, slabs.size(), nbrOfThreads, [&]( size_t s )
+    {
+        for( int k = slabs[s].k0; k < slabs[s].k1; k++ )
+            for( int j = 0; j < dims[1]; j++ )
+                uniteWithPreviousRows( set, j, k, k > slabs[s].k0, dims, parent );
+    });
+
+    for( size_t s = 1; s < slabs.size(); s++ )
+    {
+        for( int j = 0; j < dims[1]; j++ )
+        {
+            const size_t row = size_t(slabs[s].k0) * size_t(dims[1]) + size_t(j);
+            for( int dj = std::max( j - 1, 0 ); dj <= std::min( j + 1, dims[1] - 1 ); dj++ )
+                uniteRows( set, row, row - size_t(dims[1]) - size_t(j) + size_t(dj), parent );
+        }
+    }
+
+    // voxels per component, counted at the root run
+    std::vector<size_t> componentSize( set.runs.size(), 0 );
+    for( size_t r = 0; r < set.runs.size(); r++ )
+    {
+        const size_t root = findRoot( parent, r );
+        parent[r] = root;
+        if( root == r )
+            statistics.nbrOfComponents++;
+        componentSize[root] += size_t( set.runs[r].x1 - set.runs[r].x0 );
+    }
+
+    std::shared_ptr<VTKIsoSurface::ExcludedVoxels> excluded = std::make_shared<VTKIsoSurface::ExcludedVoxels>();
+    if( statistics.nbrOfComponents == 0 )
+        return excluded;
+
+    statistics.biggestComponentSize = *std::max_element( componentSize.begin(), componentSize.end() );
+    const double minimumSize = double( statistics.biggestComponentSize ) * ratio;
+
+    // a root is the first run of its component, so it is flagged before its other runs
+    std::vector<char> removed( set.runs.size(), 0 );
+    for( size_t r = 0; r < set.runs.size(); r++ )
+    {
+        const size_t root = parent[r];
+        if( root == r )
+        {
+            removed[r] = double( componentSize[r] ) > minimumSize ? 0 : 1;
+            if( removed[r] )
+            {
+                statistics.nbrOfRemovedComponents++;
+                statistics.nbrOfRemovedVoxels += componentSize[r];
+            }
+        }
+        else
+        {
+            removed[r] = removed[root];
+        }
+    }
+
+    if( statistics.nbrOfRemovedComponents == 0 )
+        return excluded;
+
+    // the removed runs are kept in place of a filtered copy of the volume
+    excluded->rowStart.assign( set.rowStart.size(), 0 );
+    excluded->runs.reserve( set.runs.size() );
+    for( size_t row = 0; row + 1 < set.rowStart.size(); row++ )
+    {
+        for( size_t r = set.rowStart[row]; r < set.rowStart[row + 1]; r++ )
+        {
+            if( removed[r] )
+                excluded->runs.push_back( {{ set.runs[r].x0, set.runs[r].x1 }} );
+        }
+        excluded->rowStart[row + 1] = excluded->runs.size();
+    }
+    excluded->runs.shrink_to_fit();
+
+    return excluded;
+}
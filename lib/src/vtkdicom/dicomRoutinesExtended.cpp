@@ -22,12 +22,121 @@
 *****************************************************************************/
 
 #include "dicomRoutinesExtended.h"
+#include "dicomFrameIndex.h"
+#include "volumeCache.h"
+#include "parallelTools.h"
 
 #include <iostream>
 #include <vtkDICOMDirectory.h>
 #include <vtkDICOMItem.h>
 #include <vtkStringArray.h>
 #include <vtkDICOMReader.h>
+#include <vtkDICOMMetaData.h>
+#include <vtkDICOMImageCodec.h>
+#include <vtkIntArray.h>
+#include <vtkExtractVOI.h>
+#include <vtkInformation.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+#include <array>
+#include <set>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <atomic>
+
+namespace
+{
+    /**
+     * Reads a part of the volume by requesting an update extent.
+     * @param reader Reader with updated information.
+     * @param extent Requested extent.
+     * @return Volume with extent starting at 0 and origin at the first voxel read, or NULL.
+     */
+    vtkSmartPointer<vtkImageData> readExtent( vtkDICOMReader* reader, const int extent[6] )
+    {
+        int updateExtent[6] = { extent[0], extent[1], extent[2], extent[3], extent[4], extent[5] };
+        if( reader->UpdateExtent( updateExtent ) == 0 )
+            return NULL;
+
+        vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+        int outputExtent[6];
+        reader->GetOutput()->GetExtent( outputExtent );
+        if( std::equal( outputExtent, outputExtent + 6, updateExtent ) )
+        {
+            volume->ShallowCopy( reader->GetOutput() );
+        }
+        else
+        {
+            // the reader delivered more than requested
+            vtkSmartPointer<vtkExtractVOI> cropper = vtkSmartPointer<vtkExtractVOI>::New();
+            cropper->SetInputData( reader->GetOutput() );
+            cropper->SetVOI( updateExtent );
+            cropper->Update();
+            volume->ShallowCopy( cropper->GetOutput() );
+        }
+
+        // place the volume at extent 0
+        double origin[3], spacing[3];
+        volume->GetOrigin( origin );
+        volume->GetSpacing( spacing );
+        volume->SetExtent( 0, extent[1] - extent[0], 0, extent[3] - extent[2], 0, extent[5] - extent[4] );
+        volume->SetOrigin( origin[0] + extent[0] * spacing[0], origin[1] + extent[2] * spacing[1],
+                           origin[2] + extent[4] * spacing[2] );
+        return volume;
+    }
+
+    /**
+     * Reads every stride-th slice of an extent, keeping every stride-th row and
+     * column. Each sampled slice is requested on its own, so that the files of
+     * the skipped slices are not read.
+     * @param reader Reader with updated information.
+     * @param extent Requested extent.
+     * @param stride Sampling stride.
+     * @return Volume with extent starting at 0, origin at the first voxel read and
+     *         spacing grown by the stride, or NULL.
+     */
+    vtkSmartPointer<vtkImageData> readExtent( vtkDICOMReader* reader, const int extent[6], int stride )
+    {
+        if( stride == 1 )
+            return readExtent( reader, extent );
+
+        vtkSmartPointer<vtkImageData> volume;
+        const int nbrOfSlices = ( extent[5] - extent[4] ) / stride + 1;
+        for( int k = 0; k < nbrOfSlices; k++ )
+        {
+            const int z = extent[4] + k * stride;
+            int sliceExtent[6] = { extent[0], extent[1], extent[2], extent[3], z, z };
+            vtkSmartPointer<vtkImageData> slice = readExtent( reader, sliceExtent );
+            if( slice.Get() == NULL )
+                return NULL;
+
+            vtkSmartPointer<vtkExtractVOI> sampler = vtkSmartPointer<vtkExtractVOI>::New();
+            sampler->SetInputData( slice );
+            sampler->SetVOI( slice->GetExtent() );
+            sampler->SetSampleRate( stride, stride, 1 );
+            sampler->Update();
+            vtkImageData* sampledSlice = sampler->GetOutput();
+
+            if( volume.Get() == NULL )
+            {
+                int dims[3];
+                sampledSlice->GetDimensions( dims );
+                double* spacing = slice->GetSpacing();
+                volume = vtkSmartPointer<vtkImageData>::New();
+                volume->SetExtent( 0, dims[0] - 1, 0, dims[1] - 1, 0, nbrOfSlices - 1 );
+                volume->SetSpacing( spacing[0] * stride, spacing[1] * stride, spacing[2] * stride );
+                volume->SetOrigin( slice->GetOrigin() );
+                volume->AllocateScalars( sampledSlice->GetScalarType(), sampledSlice->GetNumberOfScalarComponents() );
+            }
+
+            const size_t sliceBytes = size_t( sampledSlice->GetNumberOfPoints() ) * size_t( sampledSlice->GetNumberOfScalarComponents() ) *
+                                      size_t( sampledSlice->GetScalarSize() );
+            std::memcpy( static_cast<char*>( volume->GetScalarPointer() ) + k * sliceBytes, sampledSlice->GetScalarPointer(), sliceBytes );
+        }
+
+        return volume;
+    }
+}
 
 VTKDicomRoutinesExtended::VTKDicomRoutinesExtended()
 {
@@ -37,71 +146,354 @@ VTKDicomRoutinesExtended::~VTKDicomRoutinesExtended()
 {
 }
 
-vtkSmartPointer<vtkImageData> VTKDicomRoutinesExtended::loadDicomImage( const std::string& pathToDicom )
+std::vector<DicomSeriesIndex::Series> VTKDicomRoutinesExtended::scanDicomDirectory( const std::string& pathToDicom )
 {
-    using namespace std;
-
-    // analyze dicom directory. there might be multiple data
+    // vtkDICOMDirectory also follows a DICOMDIR file
     vtkSmartPointer<vtkDICOMDirectory> dicomDirectory = vtkSmartPointer<vtkDICOMDirectory>::New();
     dicomDirectory->SetDirectoryName(pathToDicom.c_str());
     dicomDirectory->SetScanDepth(1);
     dicomDirectory->Update();
 
+    std::vector<DicomSeriesIndex::Series> series;
+    for( int s = 0; s < dicomDirectory->GetNumberOfSeries(); s++ )
+    {
+        const vtkDICOMItem& dicomSeries_s = dicomDirectory->GetSeriesRecord( s );
+        vtkStringArray* files_s = dicomDirectory->GetFileNamesForSeries( s );
+
+        DicomSeriesIndex::Series entry;
+        entry.seriesInstanceUid = dicomSeries_s.Get(DC::SeriesInstanceUID).AsString();
+        entry.seriesDescription = dicomSeries_s.Get(DC::SeriesDescription).AsString();
+        entry.modality = dicomSeries_s.Get(DC::Modality).AsString();
+        for( vtkIdType i = 0; i < files_s->GetNumberOfValues(); i++ )
+            entry.files.push_back( files_s->GetValue(i) );
+        series.push_back( entry );
+    }
+
+    return series;
+}
+
+vtkSmartPointer<vtkStringArray> VTKDicomRoutinesExtended::selectSeriesFiles( const std::string& pathToDicom )
+{
+    using namespace std;
+
     cout << "Read DICOM images located under " << pathToDicom << endl;
-    cout << "Nbr of patients = "<< dicomDirectory->GetNumberOfPatients() << ", ";
-    cout << "Nbr of studies = " << dicomDirectory->GetNumberOfStudies() << ", ";
 
-    const int& nbrOfSeries = dicomDirectory->GetNumberOfSeries();
+    // analyze dicom directory. there might be multiple data
+    std::vector<DicomSeriesIndex::Series> series = DicomSeriesIndex::indexDirectory( pathToDicom,
+                                                   ParallelTools::resolveNumberOfThreads( m_nbrOfThreads ) );
+    if( series.empty() )
+        series = scanDicomDirectory( pathToDicom );
+
+    std::set<std::string> patients, studies;
+    for( const DicomSeriesIndex::Series& s : series )
+    {
+        patients.insert( s.patientId );
+        studies.insert( s.studyInstanceUid );
+    }
+
+    const int nbrOfSeries = int( series.size() );
+    cout << "Nbr of patients = "<< patients.size() << ", ";
+    cout << "Nbr of studies = " << studies.size() << ", ";
     cout << "Nbr of series = "<< nbrOfSeries << endl;
     for( int s = 0; s < nbrOfSeries; s++ )
     {
-        const vtkDICOMItem& dicomSeries_s = dicomDirectory->GetSeriesRecord( s );
-        vtkStringArray* files_s = dicomDirectory->GetFileNamesForSeries( s );
-        vtkIdType nbrOfSlices_s = files_s->GetNumberOfValues();
-
-        cout << "(" << s << ")  :  " << nbrOfSlices_s << " files, name = " << dicomSeries_s.Get(DC::SeriesDescription).AsString() << endl;
+        cout << "(" << s << ")  :  " << series[s].files.size() << " files, name = " << series[s].seriesDescription
+             << ", uid = " << series[s].seriesInstanceUid << endl;
     }
 
 
     // choose a particular dicom serie
     int s_nbr;
-    if( nbrOfSeries == 1 ) // only one
+    if( nbrOfSeries == 0 )
+    {
+        cerr << "No DICOM data in directory" << endl;
+        return NULL;
+    }
+    else if( !m_seriesSelector.empty() ) // chosen upfront
+    {
+        s_nbr = DicomSeriesIndex::selectSeries( series, m_seriesSelector );
+        if( s_nbr < 0 )
+        {
+            cerr << "No DICOM serie matches " << m_seriesSelector << endl;
+            return NULL;
+        }
+    }
+    else if( nbrOfSeries == 1 ) // only one
     {
         s_nbr = 0;
     }
-    else if( nbrOfSeries > 1 ) // multiple dicom series
+    else // multiple dicom series
     {
         cout << "Which DICOM series you wish to load? ";
         int scanRes = std::scanf("%d", &s_nbr);
-        if( scanRes == 1 && (s_nbr < 0 || s_nbr >= nbrOfSeries) )
+        if( scanRes != 1 || s_nbr < 0 || s_nbr >= nbrOfSeries )
         {
             cerr << "Wrong DICOM serie index" << endl;
             return NULL;
         }
     }
-    else
-    {
-        cerr << "No DICOM data in directory" << endl;
+
+    // load dicom serie
+    cout << endl << "Load serie " << s_nbr << ", " << series[s_nbr].seriesDescription << endl;
+
+    vtkSmartPointer<vtkStringArray> seriesFiles = vtkSmartPointer<vtkStringArray>::New();
+    for( const std::string& file : series[s_nbr].files )
+        seriesFiles->InsertNextValue( file );
+    return seriesFiles;
+}
+
+vtkSmartPointer<vtkImageData> VTKDicomRoutinesExtended::loadDicomImage( const std::string& pathToDicom )
+{
+    using namespace std;
+
+    vtkSmartPointer<vtkStringArray> seriesFiles = selectSeriesFiles( pathToDicom );
+    if( seriesFiles.Get() == NULL )
         return NULL;
+
+    std::string cacheKey;
+    if( !m_cacheDirectory.empty() )
+    {
+        std::vector<std::string> files;
+        for( vtkIdType i = 0; i < seriesFiles->GetNumberOfValues(); i++ )
+            files.push_back( seriesFiles->GetValue(i) );
+
+        cacheKey = VTKVolumeCache::computeKey( files, "vtkDICOMReader" + getLoadOptionsKey() );
+        vtkSmartPointer<vtkImageData> cachedVolume = loadFromCache( cacheKey );
+        if( cachedVolume.Get() != NULL )
+            return cachedVolume;
     }
 
-    // load dicom serie
-    const vtkDICOMItem& selected_serie = dicomDirectory->GetSeriesRecord( s_nbr );
-    cout << endl << "Load serie " << s_nbr << ", " << selected_serie.Get(DC::SeriesDescription).AsString() << endl;
+    // vtkDICOMReader reads and decodes the files of the series itself
+    m_loadStatistics = ParallelTools::PipelineStatistics();
+    if( m_nbrOfIoThreads > 0 )
+        cout << "Prefetching is not used by the vtk-dicom reader" << endl;
 
     vtkSmartPointer<vtkDICOMReader> reader = vtkSmartPointer<vtkDICOMReader>::New();
-    reader->SetFileNames( dicomDirectory->GetFileNamesForSeries( s_nbr ) );
+    reader->SetFileNames( seriesFiles );
     if( m_progressCallback.Get() != NULL )
     {
         reader->AddObserver(vtkCommand::ProgressEvent, m_progressCallback);
     }
-    reader->Update();
 
-    vtkSmartPointer<vtkImageData> rawVolumeData = vtkSmartPointer<vtkImageData>::New();
-    rawVolumeData->DeepCopy(reader->GetOutput());
+    vtkSmartPointer<vtkImageData> rawVolumeData;
+    const unsigned int nbrOfThreads = ParallelTools::resolveNumberOfThreads( m_nbrOfThreads );
+    if( seriesFiles->GetNumberOfValues() == 1 && nbrOfThreads > 1 )
+    {
+        // a multi-frame object: decode its frames in parallel
+        reader->UpdateInformation();
+        int extent[6];
+        reader->GetOutputInformation(0)->Get( vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), extent );
+        if( restrictToVolume( reader, extent ) )
+        {
+            rawVolumeData = decodeFramesInParallel( reader, seriesFiles->GetValue(0), extent );
+            if( rawVolumeData.Get() == NULL )
+                cout << "Frames cannot be decoded independently - fall back to sequential loading" << endl;
+        }
+    }
+
+    if( rawVolumeData.Get() == NULL && ( hasVolumeOfInterest() || m_previewStride > 1 ) )
+    {
+        // only the files of the requested slices are read
+        reader->UpdateInformation();
+        int extent[6];
+        reader->GetOutputInformation(0)->Get( vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), extent );
+        if( restrictToVolume( reader, extent ) )
+            rawVolumeData = readExtent( reader, extent, int(m_previewStride) );
+
+        if( rawVolumeData.Get() == NULL )
+        {
+            cerr << "Volume of interest outside of the DICOM data" << endl;
+            return NULL;
+        }
+    }
+    else if( rawVolumeData.Get() == NULL )
+    {
+        reader->Update();
+        rawVolumeData = vtkSmartPointer<vtkImageData>::New();
+        rawVolumeData->ShallowCopy(reader->GetOutput());
+    }
+
+    storeInCache( cacheKey, rawVolumeData );
 
     cout << endl << endl;
     return rawVolumeData;
 }
 
+VTKDicomRoutines::SlabReader VTKDicomRoutinesExtended::openDicomSlabs( const std::string& pathToDicom )
+{
+    SlabReader slabReader;
+
+    vtkSmartPointer<vtkStringArray> seriesFiles = selectSeriesFiles( pathToDicom );
+    if( seriesFiles.Get() == NULL )
+        return slabReader;
+
+    vtkSmartPointer<vtkDICOMReader> reader = vtkSmartPointer<vtkDICOMReader>::New();
+    reader->SetFileNames( seriesFiles );
+    reader->UpdateInformation();
+
+    std::array<int,6> extent;
+    reader->GetOutputInformation(0)->Get( vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), extent.data() );
+
+    if( !restrictToVolume( reader, extent.data() ) )
+        return slabReader;
+
+    // slabs count the sampled slices
+    const int stride = int( m_previewStride );
+    slabReader.nbrOfSlices = getNumberOfSampledSlices( extent.data() );
+    slabReader.read = [reader, extent, stride]( int zStart, int zEnd )
+    {
+        int slabExtent[6] = { extent[0], extent[1], extent[2], extent[3],
+                              extent[4] + zStart * stride, extent[4] + zEnd * stride };
+        return readExtent( reader, slabExtent, stride );
+    };
+
+    return slabReader;
+}
+
+bool VTKDicomRoutinesExtended::restrictToVolume( vtkDICOMReader* reader, int extent[6] ) const
+{
+    double origin[3] = { 0.0, 0.0, 0.0 };
+    double spacing[3] = { 1.0, 1.0, 1.0 };
+    vtkInformation* info = reader->GetOutputInformation(0);
+    if( info->Has( vtkDataObject::ORIGIN() ) )
+        info->Get( vtkDataObject::ORIGIN(), origin );
+    if( info->Has( vtkDataObject::SPACING() ) )
+        info->Get( vtkDataObject::SPACING(), spacing );
+    return restrictToVolumeOfInterest( extent, origin, spacing );
+}
+
+vtkSmartPointer<vtkImageData> VTKDicomRoutinesExtended::decodeFramesInParallel( vtkDICOMReader* reader, const std::string& file,
+                                                                                 const int extent[6] )
+{
+    using namespace std;
 
+    vtkDICOMMetaData* meta = reader->GetMetaData();
+    const int nbrOfFrames = meta->Get( DC::NumberOfFrames ).AsInt();
+    const int rows = meta->Get( DC::Rows ).AsInt();
+    const int columns = meta->Get( DC::Columns ).AsInt();
+    const int bitsAllocated = meta->Get( DC::BitsAllocated ).AsInt();
+    const int bitsStored = meta->Get( DC::BitsStored ).AsInt();
+    const int highBit = meta->Get( DC::HighBit ).AsInt();
+    const bool isSigned = meta->Get( DC::PixelRepresentation ).AsInt() == 1;
+
+    // the reader masks and sign-extends pixels with fewer stored than allocated bits,
+    // and MONOCHROME1 or color frames are not copied as they are
+    if( bitsStored != bitsAllocated || highBit != bitsStored - 1 ||
+        meta->Get( DC::PhotometricInterpretation ).AsString() != "MONOCHROME2" )
+        return NULL;
+
+    // only single-sample frames which the reader keeps in their stored type
+    int storedType = VTK_VOID;
+    if( bitsAllocated == 8 )
+        storedType = isSigned ? VTK_SIGNED_CHAR : VTK_UNSIGNED_CHAR;
+    else if( bitsAllocated == 16 )
+        storedType = isSigned ? VTK_SHORT : VTK_UNSIGNED_SHORT;
+
+    vtkInformation* outInfo = reader->GetOutputInformation(0);
+    vtkIntArray* frameIndices = reader->GetFrameIndexArray();
+    if( nbrOfFrames < 2 || storedType == VTK_VOID || meta->Get( DC::SamplesPerPixel ).AsInt() > 1 ||
+        vtkImageData::GetScalarType( outInfo ) != storedType || vtkImageData::GetNumberOfScalarComponents( outInfo ) != 1 ||
+        frameIndices == NULL || frameIndices->GetNumberOfComponents() != 1 || frameIndices->GetNumberOfTuples() <= extent[5] )
+        return NULL;
+
+    int wholeExtent[6];
+    outInfo->Get( vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), wholeExtent );
+    if( wholeExtent[1] - wholeExtent[0] + 1 != columns || wholeExtent[3] - wholeExtent[2] + 1 != rows )
+        return NULL;
+
+    const size_t pixelBytes = size_t( bitsAllocated / 8 );
+    const size_t frameBytes = size_t(rows) * size_t(columns) * pixelBytes;
+    DicomFrameIndex::PixelData pixelData;
+    if( !DicomFrameIndex::locateFrames( file, size_t(nbrOfFrames), frameBytes, pixelData ) )
+        return NULL;
+
+    // the volume of interest and the preview stride select the frames and the rows and columns read
+    const int stride = int( m_previewStride );
+    const int width = ( extent[1] - extent[0] ) / stride + 1;
+    const int height = ( extent[3] - extent[2] ) / stride + 1;
+    const int depth = ( extent[5] - extent[4] ) / stride + 1;
+
+    double spacing[3], origin[3];
+    outInfo->Get( vtkDataObject::SPACING(), spacing );
+    outInfo->Get( vtkDataObject::ORIGIN(), origin );
+
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetExtent( 0, width - 1, 0, height - 1, 0, depth - 1 );
+    volume->SetSpacing( spacing[0] * stride, spacing[1] * stride, spacing[2] * stride );
+    volume->SetOrigin( origin[0] + extent[0] * spacing[0], origin[1] + extent[2] * spacing[1], origin[2] + extent[4] * spacing[2] );
+    volume->AllocateScalars( storedType, 1 );
+    char* volumeBuffer = static_cast<char*>( volume->GetScalarPointer() );
+
+    // the reader stacks the rows bottom-up by default
+    const bool flipRows = reader->GetMemoryRowOrder() == vtkDICOMReader::BottomUp;
+    const bool swapBytes = pixelData.bigEndian && !pixelData.encapsulated && pixelBytes == 2;
+    const vtkDICOMImageCodec codec( pixelData.transferSyntax );
+
+    cout << "Decode " << depth << " of " << nbrOfFrames << " frames with " << ParallelTools::resolveNumberOfThreads( m_nbrOfThreads ) << " threads" << endl;
+
+    std::atomic<bool> framesDecoded( true );
+    ParallelTools::parallelFor( 0, size_t(depth), m_nbrOfThreads, [&]( size_t k )
+    {
+        if( !framesDecoded )
+            return;
+
+        const int frame = frameIndices->GetValue( extent[4] + int(k) * stride );
+        std::ifstream in( file, std::ios::in | std::ios::binary );
+        std::vector<char> fileBytes;
+        if( frame < 0 || frame >= nbrOfFrames || !DicomFrameIndex::readFrame( in, pixelData.frames[frame], fileBytes ) )
+        {
+            framesDecoded = false;
+            return;
+        }
+
+        const char* pixels = fileBytes.data();
+        std::vector<char> decodedBytes;
+        if( pixelData.encapsulated )
+        {
+            decodedBytes.resize( frameBytes );
+            if( codec.Decode( meta, reinterpret_cast<const unsigned char*>( fileBytes.data() ), vtkIdType( fileBytes.size() ),
+                              reinterpret_cast<unsigned char*>( decodedBytes.data() ), vtkIdType( frameBytes ) ) != vtkDICOMImageCodec::NoError )
+            {
+                framesDecoded = false;
+                return;
+            }
+            pixels = decodedBytes.data();
+        }
+        else if( fileBytes.size() < frameBytes )
+        {
+            framesDecoded = false;
+            return;
+        }
+
+        char* target = volumeBuffer + k * size_t(width) * size_t(height) * pixelBytes;
+        for( int y = 0; y < height; y++ )
+        {
+            const int memoryRow = extent[2] + y * stride;
+            const int fileRow = flipRows ? rows - 1 - memoryRow : memoryRow;
+            const char* source = pixels + ( size_t(fileRow) * size_t(columns) + size_t(extent[0]) ) * pixelBytes;
+            for( int x = 0; x < width; x++ )
+            {
+                const char* sourcePixel = source + size_t(x) * size_t(stride) * pixelBytes;
+                if( swapBytes )
+                {
+                    *target++ = sourcePixel[1];
+                    *target++ = sourcePixel[0];
+                }
+                else
+                {
+                    std::memcpy( target, sourcePixel, pixelBytes );
+                    target += pixelBytes;
+                }
+            }
+        }
+    },
+    [reader]( double progress )
+    {
+        reader->UpdateProgress( progress );
+    });
+
+    if( !framesDecoded )
+        return NULL;
+
+    return volume;
+}
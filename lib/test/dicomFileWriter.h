@@ -0,0 +1,98 @@
+#ifndef _dicomFileWriter_H_
+#define _dicomFileWriter_H_
+
+#include <fstream>
+#include <string>
+#include <cstdint>
+
+// Minimal DICOM writer for tests: little endian, explicit or implicit VR.
+class DicomFileWriter
+{
+public:
+    DicomFileWriter(bool explicitVr) : m_explicitVr(explicitVr), m_pixels(8, '\1') {}
+
+    void add(uint16_t group, uint16_t element, const char* vr, std::string value)
+    {
+        if( value.size() % 2 == 1 )
+            value.push_back(vr[0] == 'U' && vr[1] == 'I' ? '\0' : ' ');
+        addTag(m_data, group, element);
+        addLength(m_data, vr, uint32_t(value.size()), m_explicitVr);
+        m_data += value;
+    }
+
+    // binary unsigned short, e.g. rows or bits allocated
+    void addUShort(uint16_t group, uint16_t element, uint16_t value)
+    {
+        addTag(m_data, group, element);
+        addLength(m_data, "US", 2, m_explicitVr);
+        addU16(m_data, value);
+    }
+
+    // sequence and item with undefined length holding one element
+    void addSequence(uint16_t group, uint16_t element)
+    {
+        addTag(m_data, group, element);
+        addLength(m_data, "SQ", 0xFFFFFFFF, m_explicitVr);
+        addTag(m_data, 0xFFFE, 0xE000); addU32(m_data, 0xFFFFFFFF);
+        add(0x0008, 0x1150, "UI", "1.2.3");
+        addTag(m_data, 0xFFFE, 0xE00D); addU32(m_data, 0);
+        addTag(m_data, 0xFFFE, 0xE0DD); addU32(m_data, 0);
+    }
+
+    // little endian pixel bytes, 8 bytes of 1 by default
+    void setPixelData(const std::string& pixels)
+    {
+        m_pixels = pixels;
+    }
+
+    void write(const std::string& path) const
+    {
+        std::string meta;
+        std::string transferSyntax = m_explicitVr ? "1.2.840.10008.1.2.1" : "1.2.840.10008.1.2";
+        transferSyntax.push_back('\0');
+        addTag(meta, 0x0002, 0x0010);
+        addLength(meta, "UI", uint32_t(transferSyntax.size()), true);
+        meta += transferSyntax;
+
+        std::ofstream out(path, std::ios::binary);
+        out << std::string(128, '\0') << "DICM" << meta << m_data;
+
+        // pixel data
+        std::string pixels;
+        addTag(pixels, 0x7FE0, 0x0010);
+        addLength(pixels, "OW", uint32_t(m_pixels.size()), m_explicitVr);
+        out << pixels << m_pixels;
+    }
+
+private:
+    static void addU16(std::string& s, uint16_t v) { s.push_back(char(v & 0xFF)); s.push_back(char(v >> 8)); }
+    static void addU32(std::string& s, uint32_t v) { addU16(s, uint16_t(v & 0xFFFF)); addU16(s, uint16_t(v >> 16)); }
+    static void addTag(std::string& s, uint16_t group, uint16_t element) { addU16(s, group); addU16(s, element); }
+
+    static void addLength(std::string& s, const char* vr, uint32_t length, bool explicitVr)
+    {
+        if( !explicitVr )
+        {
+            addU32(s, length);
+            return;
+        }
+
+        s.append(vr, 2);
+        std::string longVr = vr;
+        if( longVr == "OB" || longVr == "OW" || longVr == "SQ" || longVr == "UN" || longVr == "UT" )
+        {
+            addU16(s, 0);
+            addU32(s, length);
+        }
+        else
+        {
+            addU16(s, uint16_t(length));
+        }
+    }
+
+    bool m_explicitVr;
+    std::string m_data;
+    std::string m_pixels;
+};
+
+#endif // _dicomFileWriter_H_
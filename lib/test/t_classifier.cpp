@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <iostream>
+#include "cellClassifier.h"
+
+// Case index of a cell computed voxel by voxel.
+template<class T>
+unsigned char referenceIndex(const T* const rows[4], size_t i, double lower, double upper)
+{
+    auto inside = [&](T v) { return double(v) >= lower && double(v) < upper ? 1 : 0; };
+    return (unsigned char)( inside(rows[0][i]) | inside(rows[0][i + 1]) << 1 | inside(rows[1][i + 1]) << 2 | inside(rows[1][i]) << 3 |
+                            inside(rows[2][i]) << 4 | inside(rows[2][i + 1]) << 5 | inside(rows[3][i + 1]) << 6 | inside(rows[3][i]) << 7 );
+}
+
+template<class T>
+void checkAllInstructionSets()
+{
+    // rows of random voxels around the bounds, with lengths giving SIMD steps and leftover cells
+    const size_t nbrOfCells = 77;
+    std::array<std::vector<T>, 4> voxels;
+    unsigned int noise = 4711;
+    for( auto& row : voxels )
+        for( size_t i = 0; i <= nbrOfCells; i++ )
+        {
+            noise = noise * 1103515245u + 12345u;
+            const int choice = (noise >> 16) % 4;
+            row.push_back( choice == 0 ? std::numeric_limits<T>::lowest() : choice == 1 ? std::numeric_limits<T>::max()
+                                                                           : T( 300 + int((noise >> 8) % 400) ) );
+        }
+    const T* rows[4] = { voxels[0].data(), voxels[1].data(), voxels[2].data(), voxels[3].data() };
+
+    const double infinity = std::numeric_limits<double>::infinity();
+    const std::vector<std::array<double,2>> bounds = { {400, infinity}, {400, 600}, {300, 301}, {-1e6, infinity}, {1e6, infinity},
+                                                       {double(std::numeric_limits<T>::max()), infinity}, {500, 450},
+                                                       {double(std::numeric_limits<T>::lowest()), double(std::numeric_limits<T>::max())},
+                                                       {450.5, 600.5} };
+
+    const VTKCellClassifier::InstructionSet supported = VTKCellClassifier::getSupportedInstructionSet();
+    for( int set = 0; set <= int(supported); set++ )
+    {
+        ASSERT_EQ(VTKCellClassifier::setInstructionSet(VTKCellClassifier::InstructionSet(set)), VTKCellClassifier::InstructionSet(set));
+        for( const auto& b : bounds )
+        {
+            for( size_t n : { nbrOfCells, size_t(5), size_t(16) } )
+            {
+                std::vector<unsigned char> indices(n, 17);
+                VTKCellClassifier::computeCubeIndices(rows, n, b[0], b[1], indices.data());
+                for( size_t i = 0; i < n; i++ )
+                    ASSERT_EQ(indices[i], referenceIndex(rows, i, b[0], b[1])) << VTKCellClassifier::getName(VTKCellClassifier::InstructionSet(set));
+            }
+        }
+    }
+    VTKCellClassifier::setInstructionSet(supported);
+}
+
+TEST(Classifier, SignedVoxels)
+{
+    checkAllInstructionSets<short>();
+}
+
+TEST(Classifier, UnsignedVoxels)
+{
+    checkAllInstructionSets<unsigned short>();
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests
+TEST(Classifier, DISABLED_BenchmarkCubeIndices)
+{
+    // one thread on rows of a 512 wide CT slice
+    const size_t nbrOfCells = 511;
+    const int nbrOfRows = 512 * 64;
+    std::vector<short> slices(4 * 512 * 512);
+    unsigned int noise = 12345;
+    for( short& v : slices )
+    {
+        noise = noise * 1103515245u + 12345u;
+        v = short( int((noise >> 16) % 2000) - 1000 );
+    }
+    std::vector<unsigned char> indices(nbrOfCells);
+
+    const VTKCellClassifier::InstructionSet supported = VTKCellClassifier::getSupportedInstructionSet();
+    for( int set = 0; set <= int(supported); set++ )
+    {
+        VTKCellClassifier::setInstructionSet(VTKCellClassifier::InstructionSet(set));
+
+        unsigned long checksum = 0;
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for( int r = 0; r < nbrOfRows; r++ )
+        {
+            const short* row = slices.data() + size_t(r % 511) * 512;
+            const short* rows[4] = { row, row + 512, row + 512 * 512, row + 512 * 513 };
+            VTKCellClassifier::computeCubeIndices(rows, nbrOfCells, 400.0, std::numeric_limits<double>::infinity(), indices.data());
+            checksum += indices[r % nbrOfCells];
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        const double seconds = std::max(std::chrono::duration<double>(end - begin).count(), 1e-9);
+        std::cout << VTKCellClassifier::getName(VTKCellClassifier::InstructionSet(set)) << ": "
+                  << double(nbrOfCells) * nbrOfRows / seconds / 1e6 << " million voxels per second per core"
+                  << " (checksum " << checksum << ")" << std::endl;
+    }
+    VTKCellClassifier::setInstructionSet(supported);
+}
@@ -1,5 +1,109 @@
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <filesystem>
+#include <vtkPNGWriter.h>
+#include <vtkPointData.h>
 #include "dicomRoutines.h"
+#include "volumeCache.h"
+#include "dicomFileWriter.h"
+
+#ifdef USEVTKDICOM
+#include <vtkDICOMWriter.h>
+#include <vtkDICOMCTGenerator.h>
+#include <vtkDICOMReader.h>
+#include "dicomRoutinesExtended.h"
+#endif
+
+// Creates a cubic int16 volume with a sphere of value 1000 in its center.
+vtkSmartPointer<vtkImageData> createSphereVolume(int size, double radius)
+{
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetDimensions(size, size, size);
+    volume->AllocateScalars(VTK_SHORT, 1);
+
+    short* voxels = static_cast<short*>(volume->GetScalarPointer());
+    double c = (size - 1) / 2.0;
+    for( int z = 0; z < size; z++ )
+        for( int y = 0; y < size; y++ )
+            for( int x = 0; x < size; x++ )
+            {
+                double d2 = (x - c) * (x - c) + (y - c) * (y - c) + (z - c) * (z - c);
+                *voxels++ = d2 < radius * radius ? 1000 : 0;
+            }
+
+    return volume;
+}
+
+// Writes a series of int16 DICOM slices with the value x + 10 * y + 100 * z - 500 at
+// voxel (x, y, z). The files are named out of slice order, which follows the patient position.
+void writeDicomSeries(const std::string& dir, int width, int height, int nbrOfSlices,
+                      const double spacing[3], const double origin[3])
+{
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    for( int i = 0; i < nbrOfSlices; i++ )
+    {
+        const int z = (3 * i) % nbrOfSlices;
+
+        std::string pixels;
+        for( int y = 0; y < height; y++ )
+            for( int x = 0; x < width; x++ )
+            {
+                uint16_t value = uint16_t(int16_t(x + 10 * y + 100 * z - 500));
+                pixels.push_back(char(value & 0xFF));
+                pixels.push_back(char(value >> 8));
+            }
+
+        DicomFileWriter writer(true);
+        writer.add(0x0008, 0x0060, "CS", "CT");
+        writer.add(0x0010, 0x0020, "LO", "patient1");
+        writer.add(0x0018, 0x0050, "DS", std::to_string(spacing[2]));
+        writer.add(0x0020, 0x000D, "UI", "1.2.826.1");
+        writer.add(0x0020, 0x000E, "UI", "1.2.826.1.1");
+        writer.add(0x0020, 0x0013, "IS", std::to_string(i + 1));
+        writer.add(0x0020, 0x0032, "DS", std::to_string(origin[0]) + "\\" + std::to_string(origin[1]) + "\\" +
+                                         std::to_string(origin[2] + z * spacing[2]));
+        writer.add(0x0020, 0x0037, "DS", "1\\0\\0\\0\\1\\0");
+        writer.addUShort(0x0028, 0x0002, 1);
+        writer.add(0x0028, 0x0004, "CS", "MONOCHROME2");
+        writer.addUShort(0x0028, 0x0010, uint16_t(height));
+        writer.addUShort(0x0028, 0x0011, uint16_t(width));
+        writer.add(0x0028, 0x0030, "DS", std::to_string(spacing[1]) + "\\" + std::to_string(spacing[0]));
+        writer.addUShort(0x0028, 0x0100, 16);
+        writer.addUShort(0x0028, 0x0101, 16);
+        writer.addUShort(0x0028, 0x0102, 15);
+        writer.addUShort(0x0028, 0x0103, 1);
+        writer.setPixelData(pixels);
+        writer.write(dir + "/slice" + std::to_string(i) + ".dcm");
+    }
+}
+
+// Reads a memory value in kB from /proc/self/status, e.g. VmHWM (peak) or VmRSS (current).
+long readProcStatusKb(const std::string& key)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while( std::getline(status, line) )
+    {
+        if( line.rfind(key + ":", 0) == 0 )
+            return std::stol(line.substr(key.size() + 1));
+    }
+    return -1;
+}
+
+// Resets the peak resident set size of this process (Linux >= 4.0).
+bool resetPeakRss()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.close();
+    return !clearRefs.fail() && readProcStatusKb("VmHWM") > 0;
+}
 
 TEST(Dicom, LoadFromInexistentPng)
 {
@@ -64,3 +168,673 @@ TEST(Dicom, CreateFromPngs)
 
     delete dr;
 }
+
+TEST(Dicom, LoadFrom16BitPngs)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+
+    // write three 16 bit slices with value 1000 * (z+1) and a gradient in x
+    std::vector<std::string> paths;
+    for( int z = 0; z < 3; z++ )
+    {
+        vtkSmartPointer<vtkImageData> slice = vtkSmartPointer<vtkImageData>::New();
+        slice->SetDimensions(20, 10, 1);
+        slice->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+        for( int y = 0; y < 10; y++ )
+            for( int x = 0; x < 20; x++ )
+                *static_cast<unsigned short*>(slice->GetScalarPointer(x, y, 0)) = static_cast<unsigned short>(1000 * (z + 1) + x);
+
+        std::string path = "slice16_" + std::to_string(z) + ".png";
+        vtkSmartPointer<vtkPNGWriter> writer = vtkSmartPointer<vtkPNGWriter>::New();
+        writer->SetFileName(path.c_str());
+        writer->SetInputData(slice);
+        writer->Write();
+        paths.push_back(path);
+    }
+
+    dr->SetNumberOfThreads(2);
+    vtkSmartPointer<vtkImageData> imgData = dr->loadPngImages(paths, 0.5, 0.5, 2.0);
+    ASSERT_FALSE(imgData.Get() == nullptr);
+    ASSERT_EQ(imgData->GetScalarType(), VTK_UNSIGNED_SHORT);
+
+    int* dims = imgData->GetDimensions();
+    ASSERT_EQ(dims[0], 20);
+    ASSERT_EQ(dims[1], 10);
+    ASSERT_EQ(dims[2], 3);
+
+    for( int z = 0; z < 3; z++ )
+    {
+        ASSERT_EQ(imgData->GetScalarComponentAsDouble(0, 0, z, 0), 1000.0 * (z + 1));
+        ASSERT_EQ(imgData->GetScalarComponentAsDouble(19, 9, z, 0), 1000.0 * (z + 1) + 19);
+    }
+
+    for( const std::string& path : paths )
+        remove(path.c_str());
+
+    delete dr;
+}
+
+TEST(Dicom, PeakMemoryOfRangeMeshing)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+
+    // 256^3 int16 voxels = 32 MB
+    vtkSmartPointer<vtkImageData> imgData = createSphereVolume(256, 40.0);
+    const double volumeKb = 256.0 * 256.0 * 256.0 * sizeof(short) / 1024.0;
+
+    if( !resetPeakRss() )
+    {
+        delete dr;
+        GTEST_SKIP() << "Peak RSS not measurable on this system";
+    }
+
+    long rssBefore = readProcStatusKb("VmRSS");
+    vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(imgData, 500, true, 2000);
+    long peakRss = readProcStatusKb("VmHWM");
+
+    ASSERT_GT(mesh->GetNumberOfCells(), 0);
+
+    // The range segmentation needs at most one additional volume. Copying the
+    // intermediate results would take at least two.
+    ASSERT_LT(double(peakRss - rssBefore), 1.5 * volumeKb);
+
+    delete dr;
+}
+
+TEST(Dicom, LoadPngsThroughCache)
+{
+    std::string cacheDir = "volumeCacheTest";
+    std::vector<std::string> paths = {"lib/test/data/imgset/0.png", "lib/test/data/imgset/1.png",
+                                      "lib/test/data/imgset/2.png"};
+
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    dr->SetCacheDirectory(cacheDir);
+
+    // first load decodes the images and fills the cache
+    vtkSmartPointer<vtkImageData> decoded = dr->loadPngImages(paths, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(decoded.Get() == nullptr);
+    std::string key = VTKVolumeCache::computeKey(paths, "vtkPNGReader " + std::to_string(1.0) + " " +
+                                                 std::to_string(1.5) + " " + std::to_string(2.0));
+    VTKVolumeCache cache(cacheDir);
+    ASSERT_TRUE(std::filesystem::exists(cache.getCacheFilePath(key)));
+
+    // second load maps the cached volume
+    vtkSmartPointer<vtkImageData> mapped = dr->loadPngImages(paths, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(mapped.Get() == nullptr);
+    ASSERT_NE(mapped.Get(), decoded.Get());
+    ASSERT_EQ(mapped->GetScalarType(), decoded->GetScalarType());
+
+    int* dims = mapped->GetDimensions();
+    ASSERT_EQ(dims[0], 256);
+    ASSERT_EQ(dims[1], 256);
+    ASSERT_EQ(dims[2], 3);
+    ASSERT_NEAR(mapped->GetSpacing()[1], 1.5, 0.001);
+
+    size_t nbrOfBytes = size_t(decoded->GetNumberOfPoints()) * size_t(decoded->GetScalarSize()) * size_t(decoded->GetNumberOfScalarComponents());
+    ASSERT_EQ(std::memcmp(mapped->GetScalarPointer(), decoded->GetScalarPointer(), nbrOfBytes), 0);
+
+    // a different spacing is a different volume
+    ASSERT_NE(key, VTKVolumeCache::computeKey(paths, "vtkPNGReader " + std::to_string(1.0) + " " +
+                                              std::to_string(1.0) + " " + std::to_string(2.0)));
+
+    mapped = nullptr;
+    std::filesystem::remove_all(cacheDir);
+    delete dr;
+}
+
+TEST(Dicom, MeshPngsInSlabs)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+
+    // write a sphere of 1000 in 32 slices of 32x32 16 bit pixels
+    vtkSmartPointer<vtkImageData> sphere = createSphereVolume(32, 10.0);
+    std::vector<std::string> paths;
+    for( int z = 0; z < 32; z++ )
+    {
+        vtkSmartPointer<vtkImageData> slice = vtkSmartPointer<vtkImageData>::New();
+        slice->SetDimensions(32, 32, 1);
+        slice->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+        for( int y = 0; y < 32; y++ )
+            for( int x = 0; x < 32; x++ )
+                *static_cast<unsigned short*>(slice->GetScalarPointer(x, y, 0)) = *static_cast<short*>(sphere->GetScalarPointer(x, y, z));
+
+        std::string path = "slab_" + std::to_string(z) + ".png";
+        vtkSmartPointer<vtkPNGWriter> writer = vtkSmartPointer<vtkPNGWriter>::New();
+        writer->SetFileName(path.c_str());
+        writer->SetInputData(slice);
+        writer->Write();
+        paths.push_back(path);
+    }
+
+    vtkSmartPointer<vtkImageData> imgData = dr->loadPngImages(paths, 1.0, 1.0, 2.0);
+    ASSERT_FALSE(imgData.Get() == nullptr);
+    vtkSmartPointer<vtkPolyData> wholeMesh = dr->dicomToMesh(imgData, 500, false, 0);
+    ASSERT_GT(wholeMesh->GetNumberOfCells(), 0);
+
+    // slabs of 5 slices cut the sphere several times. the seams have neither cracks nor duplicated vertices.
+    vtkSmartPointer<vtkPolyData> slabMesh = dr->pngToMeshStreamed(paths, 1.0, 1.0, 2.0, 5, 500, false, 0);
+    ASSERT_FALSE(slabMesh.Get() == nullptr);
+    ASSERT_EQ(slabMesh->GetNumberOfCells(), wholeMesh->GetNumberOfCells());
+    ASSERT_EQ(slabMesh->GetNumberOfPoints(), wholeMesh->GetNumberOfPoints());
+    ASSERT_FALSE(slabMesh->GetPointData()->GetNormals() == nullptr);
+
+    double wholeBounds[6], slabBounds[6];
+    wholeMesh->GetBounds(wholeBounds);
+    slabMesh->GetBounds(slabBounds);
+    for( int i = 0; i < 6; i++ )
+        ASSERT_NEAR(wholeBounds[i], slabBounds[i], 0.0001);
+
+    // same with an upper threshold
+    imgData = dr->loadPngImages(paths, 1.0, 1.0, 2.0);
+    vtkSmartPointer<vtkPolyData> wholeRangeMesh = dr->dicomToMesh(imgData, 500, true, 2000);
+    vtkSmartPointer<vtkPolyData> slabRangeMesh = dr->pngToMeshStreamed(paths, 1.0, 1.0, 2.0, 7, 500, true, 2000);
+    ASSERT_FALSE(slabRangeMesh.Get() == nullptr);
+    ASSERT_EQ(slabRangeMesh->GetNumberOfCells(), wholeRangeMesh->GetNumberOfCells());
+    ASSERT_EQ(slabRangeMesh->GetNumberOfPoints(), wholeRangeMesh->GetNumberOfPoints());
+
+    for( const std::string& path : paths )
+        remove(path.c_str());
+
+    delete dr;
+}
+
+TEST(Dicom, LoadPngVolumeOfInterest)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+
+    std::vector<std::string> paths = {"lib/test/data/imgset/0.png", "lib/test/data/imgset/1.png",
+                                      "lib/test/data/imgset/2.png", "lib/test/data/imgset/3.png",
+                                      "lib/test/data/imgset/4.png", "lib/test/data/imgset/5.png"};
+    vtkSmartPointer<vtkImageData> whole = dr->loadPngImages(paths, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(whole.Get() == nullptr);
+
+    // a broken file outside of the slice range is never read
+    std::string brokenPath = "broken.png";
+    std::ofstream(brokenPath) << "not a png";
+    std::vector<std::string> pathsWithBroken = paths;
+    pathsWithBroken[0] = brokenPath;
+
+    dr->SetVolumeOfInterest(10, 49, 20, 99, 2, 5);
+    vtkSmartPointer<vtkImageData> voi = dr->loadPngImages(pathsWithBroken, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(voi.Get() == nullptr);
+
+    int* dims = voi->GetDimensions();
+    ASSERT_EQ(dims[0], 40);
+    ASSERT_EQ(dims[1], 80);
+    ASSERT_EQ(dims[2], 4);
+
+    double* origin = voi->GetOrigin();
+    ASSERT_NEAR(origin[0], 10.0, 0.0001);
+    ASSERT_NEAR(origin[1], 30.0, 0.0001);
+    ASSERT_NEAR(origin[2], 4.0, 0.0001);
+
+    for( int z = 0; z < dims[2]; z++ )
+        for( int y = 0; y < dims[1]; y += 7 )
+            for( int x = 0; x < dims[0]; x += 3 )
+                ASSERT_EQ(voi->GetScalarComponentAsDouble(x, y, z, 0), whole->GetScalarComponentAsDouble(x + 10, y + 20, z + 2, 0));
+
+    // ranges are clamped to the volume
+    dr->SetVolumeOfInterest(-5, 1000, 0, 1000, 4, 1000);
+    voi = dr->loadPngImages(paths, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(voi.Get() == nullptr);
+    ASSERT_EQ(voi->GetDimensions()[0], 256);
+    ASSERT_EQ(voi->GetDimensions()[2], 2);
+
+    // outside of the volume
+    dr->SetVolumeOfInterest(0, 10, 0, 10, 20, 30);
+    ASSERT_TRUE(dr->loadPngImages(paths, 1.0, 1.5, 2.0).Get() == nullptr);
+
+    remove(brokenPath.c_str());
+    delete dr;
+}
+
+TEST(Dicom, LoadPngRegionOfInterest)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+
+    std::vector<std::string> paths = {"lib/test/data/imgset/0.png", "lib/test/data/imgset/1.png",
+                                      "lib/test/data/imgset/2.png", "lib/test/data/imgset/3.png",
+                                      "lib/test/data/imgset/4.png", "lib/test/data/imgset/5.png"};
+    dr->SetVolumeOfInterest(10, 49, 20, 99, 2, 5);
+    vtkSmartPointer<vtkImageData> voi = dr->loadPngImages(paths, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(voi.Get() == nullptr);
+    dr->ClearVolumeOfInterest();
+
+    // the voxels covering the box in mm are loaded
+    dr->SetRegionOfInterest(10.5, 48.2, 30.0, 148.0, 4.0, 11.0);
+    vtkSmartPointer<vtkImageData> roi = dr->loadPngImages(paths, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(roi.Get() == nullptr);
+
+    for( int a = 0; a < 3; a++ )
+    {
+        ASSERT_EQ(roi->GetDimensions()[a], voi->GetDimensions()[a]);
+        ASSERT_NEAR(roi->GetOrigin()[a], voi->GetOrigin()[a], 0.0001);
+    }
+    ASSERT_EQ(roi->GetScalarComponentAsDouble(7, 9, 1, 0), voi->GetScalarComponentAsDouble(7, 9, 1, 0));
+
+    // the mesh stays within the box, up to one voxel
+    vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(roi, 100, false, 0);
+    ASSERT_FALSE(mesh.Get() == nullptr);
+    if( mesh->GetNumberOfPoints() > 0 )
+    {
+        double* bounds = mesh->GetBounds();
+        ASSERT_GE(bounds[0], 10.0 - 0.0001);
+        ASSERT_LE(bounds[1], 49.0 + 0.0001);
+        ASSERT_GE(bounds[4], 4.0 - 0.0001);
+        ASSERT_LE(bounds[5], 10.0 + 0.0001);
+    }
+
+    // combined with the volume of interest
+    dr->SetVolumeOfInterest(0, 1000, 0, 1000, 3, 1000);
+    roi = dr->loadPngImages(paths, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(roi.Get() == nullptr);
+    ASSERT_EQ(roi->GetDimensions()[2], 3);
+    ASSERT_NEAR(roi->GetOrigin()[2], 6.0, 0.0001);
+    dr->ClearVolumeOfInterest();
+
+    // outside of the volume
+    dr->SetRegionOfInterest(-100.0, -50.0, 0.0, 10.0, 0.0, 10.0);
+    ASSERT_TRUE(dr->loadPngImages(paths, 1.0, 1.5, 2.0).Get() == nullptr);
+
+    delete dr;
+}
+
+TEST(Dicom, LoadPngPreview)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+
+    std::vector<std::string> paths = {"lib/test/data/imgset/0.png", "lib/test/data/imgset/1.png",
+                                      "lib/test/data/imgset/2.png", "lib/test/data/imgset/3.png",
+                                      "lib/test/data/imgset/4.png", "lib/test/data/imgset/5.png",
+                                      "lib/test/data/imgset/6.png"};
+    vtkSmartPointer<vtkImageData> whole = dr->loadPngImages(paths, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(whole.Get() == nullptr);
+    int wholeDims[3];
+    whole->GetDimensions(wholeDims);
+
+    // a broken file between the sampled slices is never read
+    std::string brokenPath = "broken.png";
+    std::ofstream(brokenPath) << "not a png";
+    std::vector<std::string> pathsWithBroken = paths;
+    pathsWithBroken[1] = brokenPath;
+
+    dr->SetPreviewStride(3);
+    vtkSmartPointer<vtkImageData> preview = dr->loadPngImages(pathsWithBroken, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(preview.Get() == nullptr);
+
+    int* dims = preview->GetDimensions();
+    ASSERT_EQ(dims[0], (wholeDims[0] - 1) / 3 + 1);
+    ASSERT_EQ(dims[1], (wholeDims[1] - 1) / 3 + 1);
+    ASSERT_EQ(dims[2], 3);
+
+    double* spacing = preview->GetSpacing();
+    ASSERT_NEAR(spacing[0], 3.0, 0.0001);
+    ASSERT_NEAR(spacing[1], 4.5, 0.0001);
+    ASSERT_NEAR(spacing[2], 6.0, 0.0001);
+
+    for( int z = 0; z < dims[2]; z++ )
+        for( int y = 0; y < dims[1]; y += 5 )
+            for( int x = 0; x < dims[0]; x += 2 )
+                ASSERT_EQ(preview->GetScalarComponentAsDouble(x, y, z, 0), whole->GetScalarComponentAsDouble(3 * x, 3 * y, 3 * z, 0));
+
+    // the volume of interest starts the sampling
+    dr->SetVolumeOfInterest(10, 49, 20, 99, 2, 5);
+    preview = dr->loadPngImages(paths, 1.0, 1.5, 2.0);
+    ASSERT_FALSE(preview.Get() == nullptr);
+    ASSERT_EQ(preview->GetDimensions()[0], 14);
+    ASSERT_EQ(preview->GetDimensions()[1], 27);
+    ASSERT_EQ(preview->GetDimensions()[2], 2);
+    ASSERT_NEAR(preview->GetOrigin()[0], 10.0, 0.0001);
+    ASSERT_NEAR(preview->GetOrigin()[2], 4.0, 0.0001);
+    ASSERT_EQ(preview->GetScalarComponentAsDouble(1, 1, 1, 0), whole->GetScalarComponentAsDouble(13, 23, 5, 0));
+
+    // the preview is meshed like any volume
+    vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(preview, 100, false, 0);
+    ASSERT_FALSE(mesh.Get() == nullptr);
+
+    remove(brokenPath.c_str());
+    delete dr;
+}
+
+TEST(Dicom, LoadPngsWithPrefetch)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+
+    std::vector<std::string> paths = {"lib/test/data/imgset/0.png", "lib/test/data/imgset/1.png",
+                                      "lib/test/data/imgset/2.png", "lib/test/data/imgset/3.png",
+                                      "lib/test/data/imgset/4.png", "lib/test/data/imgset/5.png"};
+    dr->SetNumberOfThreads(1);
+    vtkSmartPointer<vtkImageData> sequential = dr->loadPngImages(paths, 1.0, 1.0, 1.0);
+    ASSERT_FALSE(sequential.Get() == nullptr);
+    ASSERT_EQ(dr->GetLoadStatistics().wallSeconds, 0.0);
+
+    // a queue of one file makes the readers wait for the decoders
+    dr->SetNumberOfThreads(2);
+    dr->SetPrefetch(2, 1);
+    vtkSmartPointer<vtkImageData> prefetched = dr->loadPngImages(paths, 1.0, 1.0, 1.0);
+    ASSERT_FALSE(prefetched.Get() == nullptr);
+    ASSERT_GT(dr->GetLoadStatistics().wallSeconds, 0.0);
+    ASSERT_GT(dr->GetLoadStatistics().processSeconds, 0.0);
+
+    int* dims = prefetched->GetDimensions();
+    ASSERT_EQ(dims[0], sequential->GetDimensions()[0]);
+    ASSERT_EQ(dims[1], sequential->GetDimensions()[1]);
+    ASSERT_EQ(dims[2], 6);
+
+    const size_t nbrOfBytes = size_t(dims[0]) * size_t(dims[1]) * size_t(dims[2]) *
+                              size_t(prefetched->GetNumberOfScalarComponents()) * size_t(prefetched->GetScalarSize());
+    ASSERT_EQ(std::memcmp(prefetched->GetScalarPointer(), sequential->GetScalarPointer(), nbrOfBytes), 0);
+
+    // unreadable files are reported
+    std::vector<std::string> pathsWithMissing = paths;
+    pathsWithMissing[3] = "lib/test/data/imgset";
+    ASSERT_TRUE(dr->loadPngImages(pathsWithMissing, 1.0, 1.0, 1.0).Get() == nullptr);
+
+    delete dr;
+}
+
+TEST(Dicom, LoadDicomSlicesInParallel)
+{
+    std::string dir = (std::filesystem::temp_directory_path() / "d2m_slices").string();
+    const double spacing[3] = {0.7, 0.8, 2.5};
+    const double origin[3] = {-120.5, 35.25, 410.0};
+    writeDicomSeries(dir, 12, 10, 7, spacing, origin);
+
+    // one thread reads the directory with vtkDICOMImageReader
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    dr->SetNumberOfThreads(1);
+    vtkSmartPointer<vtkImageData> sequential = dr->loadDicomImage(dir);
+    ASSERT_FALSE(sequential.Get() == nullptr);
+
+    int* dims = sequential->GetDimensions();
+    ASSERT_EQ(dims[0], 12);
+    ASSERT_EQ(dims[1], 10);
+    ASSERT_EQ(dims[2], 7);
+    for( int a = 0; a < 3; a++ )
+        ASSERT_NEAR(sequential->GetSpacing()[a], spacing[a], 0.0001);
+    ASSERT_NEAR(sequential->GetOrigin()[0], origin[0], 0.0001);
+    ASSERT_NEAR(sequential->GetOrigin()[1], origin[1], 0.0001);
+
+    // the slices follow the patient position, not the file names
+    for( int z = 1; z < dims[2]; z++ )
+        ASSERT_EQ(std::abs(sequential->GetScalarComponentAsDouble(3, 4, z, 0) - sequential->GetScalarComponentAsDouble(3, 4, 0, 0)), 100.0 * z);
+
+    // several threads decode the slices one by one
+    dr->SetNumberOfThreads(4);
+    vtkSmartPointer<vtkImageData> parallel = dr->loadDicomImage(dir);
+    ASSERT_FALSE(parallel.Get() == nullptr);
+    ASSERT_EQ(parallel->GetScalarType(), sequential->GetScalarType());
+
+    int parallelExtent[6], sequentialExtent[6];
+    parallel->GetExtent(parallelExtent);
+    sequential->GetExtent(sequentialExtent);
+    for( int i = 0; i < 6; i++ )
+        ASSERT_EQ(parallelExtent[i], sequentialExtent[i]);
+    for( int a = 0; a < 3; a++ )
+    {
+        ASSERT_DOUBLE_EQ(parallel->GetSpacing()[a], sequential->GetSpacing()[a]);
+        ASSERT_DOUBLE_EQ(parallel->GetOrigin()[a], sequential->GetOrigin()[a]);
+    }
+
+    const size_t nbrOfBytes = size_t(dims[0]) * size_t(dims[1]) * size_t(dims[2]) * size_t(sequential->GetScalarSize());
+    ASSERT_EQ(std::memcmp(parallel->GetScalarPointer(), sequential->GetScalarPointer(), nbrOfBytes), 0);
+
+    delete dr;
+    std::filesystem::remove_all(dir);
+}
+
+TEST(Dicom, LoadDicomVolumeOfInterest)
+{
+    std::string dir = (std::filesystem::temp_directory_path() / "d2m_voi").string();
+    const double spacing[3] = {0.7, 0.8, 2.5};
+    const double origin[3] = {-120.5, 35.25, 410.0};
+    writeDicomSeries(dir, 12, 10, 7, spacing, origin);
+
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    dr->SetNumberOfThreads(1);
+    vtkSmartPointer<vtkImageData> whole = dr->loadDicomImage(dir);
+    ASSERT_FALSE(whole.Get() == nullptr);
+
+    // only the files of the slice range are decoded
+    dr->SetVolumeOfInterest(2, 9, 1, 7, 2, 5);
+    vtkSmartPointer<vtkImageData> voi = dr->loadDicomImage(dir);
+    ASSERT_FALSE(voi.Get() == nullptr);
+
+    int* dims = voi->GetDimensions();
+    ASSERT_EQ(dims[0], 8);
+    ASSERT_EQ(dims[1], 7);
+    ASSERT_EQ(dims[2], 4);
+
+    const int offset[3] = {2, 1, 2};
+    for( int a = 0; a < 3; a++ )
+    {
+        ASSERT_NEAR(voi->GetSpacing()[a], whole->GetSpacing()[a], 0.0001);
+        ASSERT_NEAR(voi->GetOrigin()[a], whole->GetOrigin()[a] + offset[a] * whole->GetSpacing()[a], 0.0001);
+    }
+
+    for( int z = 0; z < dims[2]; z++ )
+        for( int y = 0; y < dims[1]; y++ )
+            for( int x = 0; x < dims[0]; x++ )
+                ASSERT_EQ(voi->GetScalarComponentAsDouble(x, y, z, 0), whole->GetScalarComponentAsDouble(x + 2, y + 1, z + 2, 0));
+
+    delete dr;
+    std::filesystem::remove_all(dir);
+}
+
+TEST(Dicom, LoadDicomPreview)
+{
+    std::string dir = (std::filesystem::temp_directory_path() / "d2m_preview").string();
+    const double spacing[3] = {0.7, 0.8, 2.5};
+    const double origin[3] = {-120.5, 35.25, 410.0};
+    writeDicomSeries(dir, 12, 10, 7, spacing, origin);
+
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    dr->SetNumberOfThreads(1);
+    vtkSmartPointer<vtkImageData> whole = dr->loadDicomImage(dir);
+    ASSERT_FALSE(whole.Get() == nullptr);
+
+    // every second file, row and column
+    dr->SetPreviewStride(2);
+    vtkSmartPointer<vtkImageData> preview = dr->loadDicomImage(dir);
+    ASSERT_FALSE(preview.Get() == nullptr);
+
+    int* dims = preview->GetDimensions();
+    ASSERT_EQ(dims[0], 6);
+    ASSERT_EQ(dims[1], 5);
+    ASSERT_EQ(dims[2], 4);
+
+    for( int a = 0; a < 3; a++ )
+    {
+        ASSERT_NEAR(preview->GetSpacing()[a], 2.0 * whole->GetSpacing()[a], 0.0001);
+        ASSERT_NEAR(preview->GetOrigin()[a], whole->GetOrigin()[a], 0.0001);
+    }
+
+    for( int z = 0; z < dims[2]; z++ )
+        for( int y = 0; y < dims[1]; y++ )
+            for( int x = 0; x < dims[0]; x++ )
+                ASSERT_EQ(preview->GetScalarComponentAsDouble(x, y, z, 0), whole->GetScalarComponentAsDouble(2 * x, 2 * y, 2 * z, 0));
+
+    delete dr;
+    std::filesystem::remove_all(dir);
+}
+
+TEST(Dicom, LoadDicomWithPrefetch)
+{
+    std::string dir = (std::filesystem::temp_directory_path() / "d2m_prefetch").string();
+    const double spacing[3] = {0.7, 0.8, 2.5};
+    const double origin[3] = {-120.5, 35.25, 410.0};
+    writeDicomSeries(dir, 12, 10, 7, spacing, origin);
+
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    dr->SetNumberOfThreads(1);
+    vtkSmartPointer<vtkImageData> sequential = dr->loadDicomImage(dir);
+    ASSERT_FALSE(sequential.Get() == nullptr);
+    ASSERT_EQ(dr->GetLoadStatistics().wallSeconds, 0.0);
+
+    // a queue of one file makes the readers wait for the decoders
+    dr->SetNumberOfThreads(2);
+    dr->SetPrefetch(2, 1);
+    vtkSmartPointer<vtkImageData> prefetched = dr->loadDicomImage(dir);
+    ASSERT_FALSE(prefetched.Get() == nullptr);
+    ASSERT_GT(dr->GetLoadStatistics().wallSeconds, 0.0);
+
+    int* dims = prefetched->GetDimensions();
+    for( int a = 0; a < 3; a++ )
+    {
+        ASSERT_EQ(dims[a], sequential->GetDimensions()[a]);
+        ASSERT_DOUBLE_EQ(prefetched->GetOrigin()[a], sequential->GetOrigin()[a]);
+    }
+
+    const size_t nbrOfBytes = size_t(dims[0]) * size_t(dims[1]) * size_t(dims[2]) * size_t(sequential->GetScalarSize());
+    ASSERT_EQ(std::memcmp(prefetched->GetScalarPointer(), sequential->GetScalarPointer(), nbrOfBytes), 0);
+
+    delete dr;
+    std::filesystem::remove_all(dir);
+}
+
+TEST(Dicom, LoadDicomRegionOfInterest)
+{
+    std::string dir = (std::filesystem::temp_directory_path() / "d2m_roi").string();
+    const double spacing[3] = {0.7, 0.8, 2.5};
+    const double origin[3] = {-120.5, 35.25, 410.0};
+    writeDicomSeries(dir, 12, 10, 7, spacing, origin);
+
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    dr->SetNumberOfThreads(1);
+    vtkSmartPointer<vtkImageData> whole = dr->loadDicomImage(dir);
+    ASSERT_FALSE(whole.Get() == nullptr);
+    double o[3];
+    whole->GetOrigin(o);
+    ASSERT_NEAR(o[0], origin[0], 0.0001);
+    ASSERT_NEAR(o[1], origin[1], 0.0001);
+
+    // the box in mm covers the voxels x 3 - 8, y 1 - 6 and z 1 - 4
+    dr->SetRegionOfInterest(o[0] + 2.3, o[0] + 5.4, o[1] + 1.0, o[1] + 4.5, o[2] + 3.0, o[2] + 9.0);
+    vtkSmartPointer<vtkImageData> roi = dr->loadDicomImage(dir);
+    ASSERT_FALSE(roi.Get() == nullptr);
+
+    int extent[6];
+    roi->GetExtent(extent);
+    const int expectedExtent[6] = {0, 5, 0, 5, 0, 3};
+    for( int i = 0; i < 6; i++ )
+        ASSERT_EQ(extent[i], expectedExtent[i]);
+
+    const int first[3] = {3, 1, 1};
+    for( int a = 0; a < 3; a++ )
+    {
+        ASSERT_NEAR(roi->GetSpacing()[a], spacing[a], 0.0001);
+        ASSERT_NEAR(roi->GetOrigin()[a], o[a] + first[a] * spacing[a], 0.0001);
+    }
+
+    for( int z = 0; z <= extent[5]; z++ )
+        for( int y = 0; y <= extent[3]; y++ )
+            for( int x = 0; x <= extent[1]; x++ )
+                ASSERT_EQ(roi->GetScalarComponentAsDouble(x, y, z, 0), whole->GetScalarComponentAsDouble(x + 3, y + 1, z + 1, 0));
+
+    // outside of the volume
+    dr->SetRegionOfInterest(o[0] - 50.0, o[0] - 10.0, o[1], o[1] + 4.5, o[2], o[2] + 9.0);
+    ASSERT_TRUE(dr->loadDicomImage(dir).Get() == nullptr);
+
+    delete dr;
+    std::filesystem::remove_all(dir);
+}
+
+#ifdef USEVTKDICOM
+TEST(Dicom, DecodeMultiFrameInParallel)
+{
+    // an enhanced CT object with all slices as frames of one file
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "d2m_multiframe";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    vtkSmartPointer<vtkImageData> sphere = createSphereVolume(24, 8.0);
+    sphere->SetSpacing(0.5, 0.5, 1.5);
+    vtkSmartPointer<vtkDICOMCTGenerator> generator = vtkSmartPointer<vtkDICOMCTGenerator>::New();
+    generator->MultiFrameOn();
+    vtkSmartPointer<vtkDICOMWriter> writer = vtkSmartPointer<vtkDICOMWriter>::New();
+    writer->SetInputData(sphere);
+    writer->SetGenerator(generator);
+    writer->SetFileDimensionality(3);
+    writer->SetFileName((dir / "multiframe.dcm").string().c_str());
+    writer->Write();
+
+    VTKDicomRoutinesExtended* sequentialLoader = new VTKDicomRoutinesExtended();
+    sequentialLoader->SetNumberOfThreads(1);
+    vtkSmartPointer<vtkImageData> sequential = sequentialLoader->loadDicomImage(dir.string());
+    ASSERT_FALSE(sequential.Get() == nullptr);
+
+    VTKDicomRoutinesExtended* parallelLoader = new VTKDicomRoutinesExtended();
+    parallelLoader->SetNumberOfThreads(4);
+    vtkSmartPointer<vtkImageData> parallel = parallelLoader->loadDicomImage(dir.string());
+    ASSERT_FALSE(parallel.Get() == nullptr);
+
+    int* dims = parallel->GetDimensions();
+    ASSERT_EQ(dims[0], sequential->GetDimensions()[0]);
+    ASSERT_EQ(dims[1], sequential->GetDimensions()[1]);
+    ASSERT_EQ(dims[2], sequential->GetDimensions()[2]);
+    ASSERT_EQ(parallel->GetScalarType(), sequential->GetScalarType());
+    for( int i = 0; i < 3; i++ )
+    {
+        ASSERT_DOUBLE_EQ(parallel->GetSpacing()[i], sequential->GetSpacing()[i]);
+        ASSERT_DOUBLE_EQ(parallel->GetOrigin()[i], sequential->GetOrigin()[i]);
+    }
+
+    const size_t nbrOfBytes = size_t(dims[0]) * size_t(dims[1]) * size_t(dims[2]) * size_t(parallel->GetScalarSize());
+    ASSERT_EQ(std::memcmp(parallel->GetScalarPointer(), sequential->GetScalarPointer(), nbrOfBytes), 0);
+
+    // signed 12 bit frames stored without sign extension in the unused high bits
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    const int width = 16, height = 12, nbrOfFrames = 6;
+    std::string pixels;
+    for( int z = 0; z < nbrOfFrames; z++ )
+        for( int y = 0; y < height; y++ )
+            for( int x = 0; x < width; x++ )
+            {
+                uint16_t value = uint16_t((x * 37 + y * 11 + z * 101) % 4096 - 2048) & 0x0FFF;
+                pixels.push_back(char(value & 0xFF));
+                pixels.push_back(char(value >> 8));
+            }
+
+    DicomFileWriter frameWriter(true);
+    frameWriter.add(0x0008, 0x0016, "UI", "1.2.840.10008.5.1.4.1.1.2");
+    frameWriter.add(0x0008, 0x0018, "UI", "1.2.826.1.3.1");
+    frameWriter.add(0x0008, 0x0060, "CS", "CT");
+    frameWriter.add(0x0010, 0x0020, "LO", "patient1");
+    frameWriter.add(0x0018, 0x0050, "DS", "1.5");
+    frameWriter.add(0x0020, 0x000D, "UI", "1.2.826.1");
+    frameWriter.add(0x0020, 0x000E, "UI", "1.2.826.1.3");
+    frameWriter.add(0x0020, 0x0013, "IS", "1");
+    frameWriter.addUShort(0x0028, 0x0002, 1);
+    frameWriter.add(0x0028, 0x0004, "CS", "MONOCHROME2");
+    frameWriter.add(0x0028, 0x0008, "IS", std::to_string(nbrOfFrames));
+    frameWriter.addUShort(0x0028, 0x0010, uint16_t(height));
+    frameWriter.addUShort(0x0028, 0x0011, uint16_t(width));
+    frameWriter.add(0x0028, 0x0030, "DS", "0.5\\0.5");
+    frameWriter.addUShort(0x0028, 0x0100, 16);
+    frameWriter.addUShort(0x0028, 0x0101, 12);
+    frameWriter.addUShort(0x0028, 0x0102, 11);
+    frameWriter.addUShort(0x0028, 0x0103, 1);
+    frameWriter.setPixelData(pixels);
+    std::string frameFile = (dir / "frames12.dcm").string();
+    frameWriter.write(frameFile);
+
+    vtkSmartPointer<vtkDICOMReader> reader = vtkSmartPointer<vtkDICOMReader>::New();
+    reader->SetFileName(frameFile.c_str());
+    reader->Update();
+    vtkImageData* expected = reader->GetOutput();
+
+    vtkSmartPointer<vtkImageData> frames = parallelLoader->loadDicomImage(dir.string());
+    ASSERT_FALSE(frames.Get() == nullptr);
+    ASSERT_EQ(frames->GetScalarType(), expected->GetScalarType());
+    for( int i = 0; i < 3; i++ )
+        ASSERT_EQ(frames->GetDimensions()[i], expected->GetDimensions()[i]);
+
+    const size_t nbrOfFrameBytes = size_t(width) * size_t(height) * size_t(nbrOfFrames) * size_t(expected->GetScalarSize());
+    ASSERT_EQ(std::memcmp(frames->GetScalarPointer(), expected->GetScalarPointer(), nbrOfFrameBytes), 0);
+
+    delete sequentialLoader;
+    delete parallelLoader;
+    std::filesystem::remove_all(dir);
+}
+#endif
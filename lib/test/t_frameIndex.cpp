@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include "dicomFrameIndex.h"
+
+namespace
+{
+    void addU16(std::string& s, uint16_t v) { s.push_back(char(v & 0xFF)); s.push_back(char(v >> 8)); }
+    void addU32(std::string& s, uint32_t v) { addU16(s, uint16_t(v & 0xFFFF)); addU16(s, uint16_t(v >> 16)); }
+    void addTag(std::string& s, uint16_t group, uint16_t element) { addU16(s, group); addU16(s, element); }
+
+    // explicit VR little endian file with a sequence in front of the pixel data
+    std::string fileStart(const std::string& transferSyntax)
+    {
+        std::string ts = transferSyntax;
+        if( ts.size() % 2 == 1 )
+            ts.push_back('\0');
+
+        std::string s(128, '\0');
+        s += "DICM";
+        addTag(s, 0x0002, 0x0010); s += "UI"; addU16(s, uint16_t(ts.size())); s += ts;
+        addTag(s, 0x0028, 0x0008); s += "IS"; addU16(s, 2); s += "3 ";
+        addTag(s, 0x5200, 0x9230); s += "SQ"; addU16(s, 0); addU32(s, 0xFFFFFFFF);
+        addTag(s, 0xFFFE, 0xE000); addU32(s, 0xFFFFFFFF);
+        addTag(s, 0x0020, 0x0032); s += "DS"; addU16(s, 6); s += "0\\0\\0 ";
+        addTag(s, 0xFFFE, 0xE00D); addU32(s, 0);
+        addTag(s, 0xFFFE, 0xE0DD); addU32(s, 0);
+        return s;
+    }
+
+    void addItem(std::string& s, const std::string& value)
+    {
+        addTag(s, 0xFFFE, 0xE000); addU32(s, uint32_t(value.size())); s += value;
+    }
+
+    std::string readFrame(const std::string& path, const std::vector<DicomFrameIndex::Fragment>& frame)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<char> bytes;
+        EXPECT_TRUE(DicomFrameIndex::readFrame(in, frame, bytes));
+        return std::string(bytes.begin(), bytes.end());
+    }
+}
+
+class FrameIndex : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::filesystem::create_directories(m_dir);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_dir);
+    }
+
+    std::string write(const std::string& name, const std::string& content)
+    {
+        std::string path = m_dir + "/" + name;
+        std::ofstream(path, std::ios::binary) << content;
+        return path;
+    }
+
+    std::string m_dir = "frameIndexTest";
+};
+
+TEST_F(FrameIndex, NativeFrames)
+{
+    std::string s = fileStart("1.2.840.10008.1.2.1");
+    addTag(s, 0x7FE0, 0x0010); s += "OW"; addU16(s, 0); addU32(s, 12);
+    s += "aaaabbbbcccc";
+    std::string path = write("native.dcm", s);
+
+    DicomFrameIndex::PixelData pixelData;
+    ASSERT_TRUE(DicomFrameIndex::locateFrames(path, 3, 4, pixelData));
+    ASSERT_FALSE(pixelData.encapsulated);
+    ASSERT_FALSE(pixelData.bigEndian);
+    ASSERT_EQ(pixelData.transferSyntax, "1.2.840.10008.1.2.1");
+    ASSERT_EQ(pixelData.frames.size(), 3u);
+    ASSERT_EQ(readFrame(path, pixelData.frames[0]), "aaaa");
+    ASSERT_EQ(readFrame(path, pixelData.frames[2]), "cccc");
+
+    // the pixel data is too short for four frames
+    ASSERT_FALSE(DicomFrameIndex::locateFrames(path, 4, 4, pixelData));
+}
+
+TEST_F(FrameIndex, EncapsulatedFramesWithOffsetTable)
+{
+    // the second frame is split into two fragments
+    std::string s = fileStart("1.2.840.10008.1.2.5");
+    addTag(s, 0x7FE0, 0x0010); s += "OB"; addU16(s, 0); addU32(s, 0xFFFFFFFF);
+    std::string offsetTable;
+    addU32(offsetTable, 0); addU32(offsetTable, 12); addU32(offsetTable, 34);
+    addItem(s, offsetTable);
+    addItem(s, "aaaa");
+    addItem(s, "bb");
+    addItem(s, "bbbb");
+    addItem(s, "cccccc");
+    addTag(s, 0xFFFE, 0xE0DD); addU32(s, 0);
+    std::string path = write("encapsulated.dcm", s);
+
+    DicomFrameIndex::PixelData pixelData;
+    ASSERT_TRUE(DicomFrameIndex::locateFrames(path, 3, 100, pixelData));
+    ASSERT_TRUE(pixelData.encapsulated);
+    ASSERT_EQ(pixelData.frames.size(), 3u);
+    ASSERT_EQ(pixelData.frames[1].size(), 2u);
+    ASSERT_EQ(readFrame(path, pixelData.frames[0]), "aaaa");
+    ASSERT_EQ(readFrame(path, pixelData.frames[1]), "bbbbbb");
+    ASSERT_EQ(readFrame(path, pixelData.frames[2]), "cccccc");
+}
+
+TEST_F(FrameIndex, EncapsulatedFramesWithoutOffsetTable)
+{
+    std::string s = fileStart("1.2.840.10008.1.2.5");
+    addTag(s, 0x7FE0, 0x0010); s += "OB"; addU16(s, 0); addU32(s, 0xFFFFFFFF);
+    addItem(s, "");
+    addItem(s, "aa");
+    addItem(s, "bb");
+    addTag(s, 0xFFFE, 0xE0DD); addU32(s, 0);
+    std::string path = write("noOffsetTable.dcm", s);
+
+    // one fragment per frame
+    DicomFrameIndex::PixelData pixelData;
+    ASSERT_TRUE(DicomFrameIndex::locateFrames(path, 2, 100, pixelData));
+    ASSERT_EQ(readFrame(path, pixelData.frames[1]), "bb");
+
+    // fragments cannot be assigned to three frames
+    ASSERT_FALSE(DicomFrameIndex::locateFrames(path, 3, 100, pixelData));
+
+    // no pixel data
+    std::string noPixels = write("noPixels.dcm", fileStart("1.2.840.10008.1.2.1"));
+    ASSERT_FALSE(DicomFrameIndex::locateFrames(noPixels, 1, 4, pixelData));
+}
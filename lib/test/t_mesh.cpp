@@ -1,7 +1,17 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdio>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+#include <vtkIdList.h>
+#include <vtkOBJReader.h>
 #include "meshRoutines.h"
 #include "meshData.h"
+#include "quadricDecimation.h"
 
 TEST(Mesh, ConstructDestruct)
 {
@@ -21,7 +31,8 @@ TEST(Mesh, OpenOBJ)
     vtkIdType numberOfVertices = mesh->GetPoints()->GetNumberOfPoints();
     vtkIdType numberOfFaces = mesh->GetNumberOfCells();
 
-    ASSERT_EQ( numberOfVertices, 3456 );
+    // the faces carry their own normals, their vertices are welded after reading
+    ASSERT_EQ( numberOfVertices, 576 );
     ASSERT_EQ( numberOfFaces, 1152 );
 
     delete vM;
@@ -90,3 +101,236 @@ TEST(Mesh, TestSaveOpenFormats)
 
     delete vM;
 }
+
+TEST(Mesh, ImportedObjIsWatertight)
+{
+    VTKMeshData* vM = new VTKMeshData();
+    vtkSmartPointer<vtkPolyData> mesh = vM->importObjFile( "lib/test/data/torus.obj" );
+
+    // every edge of the closed torus lies between two faces
+    std::map<std::pair<vtkIdType,vtkIdType>, int> edgeUse;
+    vtkSmartPointer<vtkIdList> face = vtkSmartPointer<vtkIdList>::New();
+    for( vtkIdType c = 0; c < mesh->GetNumberOfCells(); c++ )
+    {
+        mesh->GetCellPoints( c, face );
+        ASSERT_EQ( face->GetNumberOfIds(), 3 );
+        for( vtkIdType e = 0; e < 3; e++ )
+        {
+            vtkIdType a = face->GetId( e );
+            vtkIdType b = face->GetId( (e + 1) % 3 );
+            edgeUse[std::make_pair( std::min(a, b), std::max(a, b) )]++;
+        }
+    }
+    for( const auto& edge : edgeUse )
+        ASSERT_EQ( edge.second, 2 );
+
+    // Euler characteristic of a torus
+    ASSERT_EQ( mesh->GetNumberOfPoints() - vtkIdType(edgeUse.size()) + mesh->GetNumberOfCells(), 0 );
+
+    delete vM;
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests
+TEST(Mesh, DISABLED_BenchmarkObjImport)
+{
+    // the mesh as read by vtkOBJReader, with the vertices of each face duplicated
+    vtkSmartPointer<vtkOBJReader> reader = vtkSmartPointer<vtkOBJReader>::New();
+    reader->SetFileName( "lib/test/data/torus.obj" );
+    reader->Update();
+    vtkSmartPointer<vtkPolyData> unwelded = vtkSmartPointer<vtkPolyData>::New();
+    unwelded->ShallowCopy( reader->GetOutput() );
+
+    VTKMeshData* vM = new VTKMeshData();
+    vtkSmartPointer<vtkPolyData> welded = vM->importObjFile( "lib/test/data/torus.obj" );
+
+    // reduction, small object removal and smoothing of dicom2mesh on copies of the mesh
+    VTKMeshRoutines* vR = new VTKMeshRoutines();
+    const int nbrOfRuns = 20;
+    auto timeStages = [&]( vtkPolyData* original ) -> double
+    {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        for( int r = 0; r < nbrOfRuns; r++ )
+        {
+            vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+            mesh->DeepCopy( original );
+            vR->meshReduction( mesh, 0.5 );
+            vR->removeSmallObjects( mesh, 0.1 );
+            vR->smoothMesh( mesh, 20 );
+        }
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>( end - begin ).count() / nbrOfRuns;
+    };
+
+    const double unweldedMs = timeStages( unwelded );
+    const double weldedMs = timeStages( welded );
+    std::cout << "Reduce, filter and smooth torus.obj" << std::endl;
+    std::cout << "  unwelded, " << unwelded->GetNumberOfPoints() << " vertices: " << unweldedMs << " ms" << std::endl;
+    std::cout << "  welded, " << welded->GetNumberOfPoints() << " vertices: " << weldedMs << " ms" << std::endl;
+
+    delete vR;
+    delete vM;
+}
+
+// Counts the faces at each edge of a mesh, which are two everywhere on a closed manifold.
+std::map<std::pair<vtkIdType,vtkIdType>, int> countEdgeUse( vtkPolyData* mesh )
+{
+    std::map<std::pair<vtkIdType,vtkIdType>, int> edgeUse;
+    vtkSmartPointer<vtkIdList> face = vtkSmartPointer<vtkIdList>::New();
+    for( vtkIdType c = 0; c < mesh->GetNumberOfCells(); c++ )
+    {
+        mesh->GetCellPoints( c, face );
+        for( vtkIdType e = 0; e < face->GetNumberOfIds(); e++ )
+        {
+            vtkIdType a = face->GetId( e );
+            vtkIdType b = face->GetId( (e + 1) % face->GetNumberOfIds() );
+            edgeUse[std::make_pair( std::min(a, b), std::max(a, b) )]++;
+        }
+    }
+    return edgeUse;
+}
+
+TEST(Mesh, ParallelReduction)
+{
+    VTKMeshData* vM = new VTKMeshData();
+    vtkSmartPointer<vtkPolyData> mesh = vM->importObjFile( "lib/test/data/torus.obj" );
+
+    std::vector<vtkSmartPointer<vtkPolyData>> results;
+    for( unsigned int nbrOfThreads : { 1u, 4u } )
+    {
+        VTKQuadricDecimation decimation;
+        ASSERT_TRUE( decimation.setMesh( mesh, nbrOfThreads ) );
+        decimation.setNumberOfPartitions( 4 );
+        VTKQuadricDecimation::Statistics statistics = decimation.reduceTo( 576, nbrOfThreads, NULL );
+        ASSERT_EQ( statistics.nbrOfPartitions, 4 );
+        ASSERT_GT( statistics.nbrOfPartitionCollapses, 0 );
+        ASSERT_EQ( decimation.getNumberOfTriangles(), 576 );
+
+        // the reduced torus stays closed and keeps its genus
+        vtkSmartPointer<vtkPolyData> reduced = decimation.getMesh();
+        ASSERT_EQ( reduced->GetNumberOfCells(), 576 );
+        std::map<std::pair<vtkIdType,vtkIdType>, int> edgeUse = countEdgeUse( reduced );
+        for( const auto& edge : edgeUse )
+            ASSERT_EQ( edge.second, 2 );
+        ASSERT_EQ( reduced->GetNumberOfPoints() - vtkIdType(edgeUse.size()) + reduced->GetNumberOfCells(), 0 );
+        results.push_back( reduced );
+    }
+
+    // the partitions, not the threads, decide on the result
+    ASSERT_EQ( results[0]->GetNumberOfPoints(), results[1]->GetNumberOfPoints() );
+    for( vtkIdType i = 0; i < results[0]->GetNumberOfPoints(); i++ )
+    {
+        double p[3], q[3];
+        results[0]->GetPoint( i, p );
+        results[1]->GetPoint( i, q );
+        ASSERT_EQ( p[0], q[0] );
+        ASSERT_EQ( p[1], q[1] );
+        ASSERT_EQ( p[2], q[2] );
+    }
+
+    // the mesh routines reduce by the same ratio as vtkQuadricDecimation
+    VTKMeshRoutines* vR = new VTKMeshRoutines();
+    vR->SetDecimator( VTKMeshRoutines::Decimator::ParallelQuadricDecimation );
+    vR->SetNumberOfThreads( 2 );
+    vR->meshReduction( mesh, 0.75 );
+    ASSERT_EQ( mesh->GetNumberOfCells(), 288 );
+
+    delete vR;
+    delete vM;
+}
+
+TEST(Mesh, LevelsOfDetail)
+{
+    VTKMeshData* vM = new VTKMeshData();
+    VTKMeshRoutines* vR = new VTKMeshRoutines();
+    vtkSmartPointer<vtkPolyData> mesh = vM->importObjFile( "lib/test/data/torus.obj" );
+    const std::vector<unsigned long> polygonLimits = { 288, 2000, 576, 144 };
+
+    for( VTKMeshRoutines::Decimator decimator : { VTKMeshRoutines::Decimator::QuadricDecimation,
+                                                  VTKMeshRoutines::Decimator::ParallelQuadricDecimation } )
+    {
+        vR->SetDecimator( decimator );
+        std::vector<vtkSmartPointer<vtkPolyData>> levels = vR->meshLevelsOfDetail( mesh, polygonLimits );
+
+        // the levels come in the order of their limits, the input mesh is kept
+        ASSERT_EQ( levels.size(), polygonLimits.size() );
+        ASSERT_EQ( mesh->GetNumberOfCells(), 1152 );
+        ASSERT_EQ( levels[1]->GetNumberOfCells(), 1152 );
+        ASSERT_LT( levels[2]->GetNumberOfCells(), 1152 );
+        ASSERT_LT( levels[0]->GetNumberOfCells(), levels[2]->GetNumberOfCells() );
+        ASSERT_LT( levels[3]->GetNumberOfCells(), levels[0]->GetNumberOfCells() );
+    }
+
+    // the parallel decimation reaches the limits exactly, and each level stays a closed torus
+    std::vector<vtkSmartPointer<vtkPolyData>> levels = vR->meshLevelsOfDetail( mesh, polygonLimits );
+    ASSERT_EQ( levels[0]->GetNumberOfCells(), 288 );
+    ASSERT_EQ( levels[2]->GetNumberOfCells(), 576 );
+    ASSERT_EQ( levels[3]->GetNumberOfCells(), 144 );
+    for( const vtkSmartPointer<vtkPolyData>& level : levels )
+    {
+        std::map<std::pair<vtkIdType,vtkIdType>, int> edgeUse = countEdgeUse( level );
+        for( const auto& edge : edgeUse )
+            ASSERT_EQ( edge.second, 2 );
+        ASSERT_EQ( level->GetNumberOfPoints() - vtkIdType(edgeUse.size()) + level->GetNumberOfCells(), 0 );
+    }
+
+    delete vR;
+    delete vM;
+}
+
+// Lists the triangles of a mesh by the positions of their corners, each starting at its smallest
+// corner so that the orientation is kept, sorted independently of the vertex order.
+std::vector<std::array<std::array<double,3>,3>> sortedTrianglePositions( vtkPolyData* mesh )
+{
+    std::vector<std::array<std::array<double,3>,3>> triangles;
+    vtkSmartPointer<vtkIdList> face = vtkSmartPointer<vtkIdList>::New();
+    for( vtkIdType c = 0; c < mesh->GetNumberOfCells(); c++ )
+    {
+        mesh->GetCellPoints( c, face );
+        std::array<std::array<double,3>,3> triangle;
+        for( vtkIdType k = 0; k < 3; k++ )
+            mesh->GetPoint( face->GetId(k), triangle[size_t(k)].data() );
+        std::rotate( triangle.begin(), std::min_element( triangle.begin(), triangle.end() ), triangle.end() );
+        triangles.push_back( triangle );
+    }
+    std::sort( triangles.begin(), triangles.end() );
+    return triangles;
+}
+
+TEST(Mesh, ProgressiveMesh)
+{
+    VTKMeshData* vM = new VTKMeshData();
+    VTKMeshRoutines* vR = new VTKMeshRoutines();
+    vtkSmartPointer<vtkPolyData> mesh = vM->importObjFile( "lib/test/data/torus.obj" );
+
+    vtkSmartPointer<vtkPolyData> baseMesh = vtkSmartPointer<vtkPolyData>::New();
+    baseMesh->DeepCopy( mesh );
+    std::vector<VTKQuadricDecimation::VertexSplit> vertexSplits;
+    ASSERT_TRUE( vR->meshReduction( baseMesh, 0.75, vertexSplits ) );
+    ASSERT_EQ( baseMesh->GetNumberOfCells(), 288 );
+    ASSERT_EQ( vertexSplits.size(), 432 );
+
+    vM->exportAsProgressiveMeshFile( baseMesh, vertexSplits, "progressiveExport.pm" );
+
+    // each split adds one vertex and two faces, and every prefix of the splits gives a closed torus
+    for( size_t nbrOfSplits : { size_t(0), size_t(100), vertexSplits.size() } )
+    {
+        vtkSmartPointer<vtkPolyData> refined = vM->importProgressiveMeshFile( "progressiveExport.pm", nbrOfSplits );
+        ASSERT_TRUE( refined.Get() != NULL );
+        ASSERT_EQ( refined->GetNumberOfPoints(), baseMesh->GetNumberOfPoints() + vtkIdType(nbrOfSplits) );
+        ASSERT_EQ( refined->GetNumberOfCells(), 288 + 2 * vtkIdType(nbrOfSplits) );
+        std::map<std::pair<vtkIdType,vtkIdType>, int> edgeUse = countEdgeUse( refined );
+        for( const auto& edge : edgeUse )
+            ASSERT_EQ( edge.second, 2 );
+        ASSERT_EQ( refined->GetNumberOfPoints() - vtkIdType(edgeUse.size()) + refined->GetNumberOfCells(), 0 );
+    }
+
+    // all splits restore the original triangles
+    vtkSmartPointer<vtkPolyData> restored = vM->importProgressiveMeshFile( "progressiveExport.pm" );
+    ASSERT_TRUE( sortedTrianglePositions( restored ) == sortedTrianglePositions( mesh ) );
+
+    remove("progressiveExport.pm");
+    ASSERT_TRUE( vM->importProgressiveMeshFile( "lib/test/data/torus.obj" ).Get() == NULL );
+
+    delete vR;
+    delete vM;
+}
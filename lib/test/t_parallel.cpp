@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+#include "parallelTools.h"
+
+TEST(Parallel, ResolveNumberOfThreads)
+{
+    ASSERT_EQ(ParallelTools::resolveNumberOfThreads(3), 3u);
+    ASSERT_GE(ParallelTools::resolveNumberOfThreads(0), 1u);
+}
+
+TEST(Parallel, VisitEachIndexOnce)
+{
+    std::vector<int> visits(1000, 0);
+    double lastProgress = 0.0;
+
+    ParallelTools::parallelFor(0, visits.size(), 8, [&](size_t i) { visits.at(i)++; },
+                               [&](double p) { lastProgress = p; });
+
+    for( int v : visits )
+        ASSERT_EQ(v, 1);
+    ASSERT_NEAR(lastProgress, 1.0, 0.0001);
+}
+
+TEST(Parallel, RethrowException)
+{
+    ASSERT_THROW(ParallelTools::parallelFor(0, 100, 4, [](size_t i) {
+        if( i == 42 )
+            throw std::runtime_error("failed item");
+    }), std::runtime_error);
+}
+
+TEST(Parallel, PipelineProcessesEachFetchedIndexOnce)
+{
+    std::vector<int> fetched(1000, 0);
+    std::vector<int> processed(1000, 0);
+    std::atomic<int> waitingItems(0);
+    std::atomic<int> maxWaitingItems(0);
+    double lastProgress = 0.0;
+
+    ParallelTools::PipelineStatistics statistics = ParallelTools::pipelineFor(0, fetched.size(), 3, 4, 8,
+        [&](size_t i)
+        {
+            fetched.at(i)++;
+            int waiting = ++waitingItems;
+            int maxWaiting = maxWaitingItems;
+            while( waiting > maxWaiting && !maxWaitingItems.compare_exchange_weak(maxWaiting, waiting) ) {}
+        },
+        [&](size_t i)
+        {
+            ASSERT_EQ(fetched.at(i), 1);
+            processed.at(i)++;
+            waitingItems--;
+        },
+        [&](double p) { lastProgress = p; });
+
+    for( size_t i = 0; i < fetched.size(); i++ )
+    {
+        ASSERT_EQ(fetched[i], 1);
+        ASSERT_EQ(processed[i], 1);
+    }
+    ASSERT_NEAR(lastProgress, 1.0, 0.0001);
+
+    // queued items plus the ones held by the fetch and the process threads
+    ASSERT_LE(maxWaitingItems.load(), 8 + 3 + 4);
+
+    ASSERT_GE(statistics.wallSeconds, 0.0);
+    ASSERT_GE(statistics.fetchSeconds, 0.0);
+    ASSERT_GE(statistics.processSeconds, 0.0);
+    ASSERT_GE(statistics.fetchWaitSeconds, 0.0);
+    ASSERT_GE(statistics.processWaitSeconds, 0.0);
+}
+
+TEST(Parallel, PipelineRethrowsException)
+{
+    ASSERT_THROW(ParallelTools::pipelineFor(0, 100, 2, 2, 4, [](size_t i) {
+        if( i == 42 )
+            throw std::runtime_error("failed fetch");
+    }, [](size_t) {}), std::runtime_error);
+
+    ASSERT_THROW(ParallelTools::pipelineFor(0, 100, 2, 2, 4, [](size_t) {}, [](size_t i) {
+        if( i == 17 )
+            throw std::runtime_error("failed process");
+    }), std::runtime_error);
+}
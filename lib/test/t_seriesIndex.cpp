@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include "dicomSeriesIndex.h"
+#include "dicomFileWriter.h"
+
+void writeSlice(const std::string& path, bool explicitVr, const std::string& seriesUid,
+                const std::string& description, int instanceNumber)
+{
+    DicomFileWriter writer(explicitVr);
+    writer.add(0x0008, 0x0060, "CS", "CT");
+    writer.add(0x0008, 0x103E, "LO", description);
+    writer.addSequence(0x0008, 0x1140);
+    writer.add(0x0010, 0x0020, "LO", "patient1");
+    writer.add(0x0020, 0x000D, "UI", "1.2.826.1");
+    writer.add(0x0020, 0x000E, "UI", seriesUid);
+    writer.add(0x0020, 0x0013, "IS", std::to_string(instanceNumber));
+    writer.write(path);
+}
+
+class SeriesIndex : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::filesystem::create_directories(m_dir);
+
+        // instance numbers run against the file names
+        for( int i = 0; i < 3; i++ )
+            writeSlice(m_dir + "/ct" + std::to_string(i) + ".dcm", true, "1.2.826.1.1", "CT Head", 3 - i);
+        for( int i = 0; i < 2; i++ )
+            writeSlice(m_dir + "/mr" + std::to_string(i) + ".dcm", false, "1.2.826.1.2", "MR Knee", 2 - i);
+
+        std::ofstream(m_dir + "/readme.txt") << "no dicom";
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_dir);
+    }
+
+    std::string m_dir = "seriesIndexTest";
+};
+
+TEST_F(SeriesIndex, ReadHeader)
+{
+    DicomSeriesIndex::HeaderInfo info;
+    ASSERT_TRUE(DicomSeriesIndex::readHeader(m_dir + "/mr1.dcm", info));
+    ASSERT_EQ(info.seriesInstanceUid, "1.2.826.1.2");
+    ASSERT_EQ(info.seriesDescription, "MR Knee");
+    ASSERT_EQ(info.modality, "CT");
+    ASSERT_EQ(info.patientId, "patient1");
+    ASSERT_EQ(info.instanceNumber, 1);
+
+    DicomSeriesIndex::HeaderInfo noInfo;
+    ASSERT_FALSE(DicomSeriesIndex::readHeader(m_dir + "/readme.txt", noInfo));
+}
+
+TEST_F(SeriesIndex, GroupBySeries)
+{
+    std::vector<DicomSeriesIndex::Series> series = DicomSeriesIndex::indexDirectory(m_dir, 4);
+    ASSERT_EQ(series.size(), 2u);
+
+    ASSERT_EQ(series[0].seriesDescription, "CT Head");
+    ASSERT_EQ(series[0].files.size(), 3u);
+    ASSERT_EQ(std::filesystem::path(series[0].files[0]).filename().string(), "ct2.dcm");
+    ASSERT_EQ(std::filesystem::path(series[0].files[2]).filename().string(), "ct0.dcm");
+
+    ASSERT_EQ(series[1].seriesInstanceUid, "1.2.826.1.2");
+    ASSERT_EQ(series[1].files.size(), 2u);
+
+    ASSERT_TRUE(std::filesystem::exists(DicomSeriesIndex::getIndexFilePath(m_dir)));
+}
+
+TEST_F(SeriesIndex, ReuseSidecar)
+{
+    std::vector<DicomSeriesIndex::Series> scanned = DicomSeriesIndex::indexDirectory(m_dir, 2);
+    std::vector<DicomSeriesIndex::Series> loaded = DicomSeriesIndex::indexDirectory(m_dir, 2);
+    ASSERT_EQ(loaded.size(), scanned.size());
+    for( size_t s = 0; s < scanned.size(); s++ )
+    {
+        ASSERT_EQ(loaded[s].seriesInstanceUid, scanned[s].seriesInstanceUid);
+        ASSERT_EQ(loaded[s].seriesDescription, scanned[s].seriesDescription);
+        ASSERT_EQ(loaded[s].files, scanned[s].files);
+    }
+
+    // a new file invalidates the sidecar
+    writeSlice(m_dir + "/mr2.dcm", false, "1.2.826.1.2", "MR Knee", 0);
+    std::vector<DicomSeriesIndex::Series> rescanned = DicomSeriesIndex::indexDirectory(m_dir, 2);
+    ASSERT_EQ(rescanned.size(), 2u);
+    ASSERT_EQ(rescanned[1].files.size(), 3u);
+}
+
+TEST_F(SeriesIndex, SelectSeries)
+{
+    std::vector<DicomSeriesIndex::Series> series = DicomSeriesIndex::indexDirectory(m_dir, 2);
+
+    ASSERT_EQ(DicomSeriesIndex::selectSeries(series, "1"), 1);
+    ASSERT_EQ(DicomSeriesIndex::selectSeries(series, "1.2.826.1.1"), 0);
+    ASSERT_EQ(DicomSeriesIndex::selectSeries(series, "knee"), 1);
+    ASSERT_EQ(DicomSeriesIndex::selectSeries(series, "e"), -1); // ambiguous
+    ASSERT_EQ(DicomSeriesIndex::selectSeries(series, "pelvis"), -1);
+    ASSERT_EQ(DicomSeriesIndex::selectSeries(series, "5"), -1);
+}
@@ -0,0 +1,985 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <iostream>
+#include <thread>
+#include <map>
+#include <memory>
+#include <vtkPointData.h>
+#include <vtkCellData.h>
+#include <vtkCellArray.h>
+#include <vtkIdList.h>
+#include <vtkImageThreshold.h>
+#include <vtkMarchingCubes.h>
+#include <vtkCellLocator.h>
+#include <cstring>
+#include "dicomRoutines.h"
+#include "isoSurface.h"
+#include "minMaxBlocks.h"
+#include "voxelComponents.h"
+#include "dualContouring.h"
+#include "labelSurfaces.h"
+#include "volumeHistogram.h"
+#include "volumeFilter.h"
+#include "meshRoutines.h"
+
+// Creates an int16 volume of overlapping balls with some noise, so that many cube cases occur.
+vtkSmartPointer<vtkImageData> createBallsVolume(int dimX, int dimY, int dimZ)
+{
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetDimensions(dimX, dimY, dimZ);
+    volume->SetSpacing(0.7, 0.8, 1.3);
+    volume->SetOrigin(-12.0, 5.0, 30.0);
+    volume->AllocateScalars(VTK_SHORT, 1);
+
+    const double balls[3][4] = { {0.3, 0.4, 0.3, 0.25}, {0.6, 0.5, 0.6, 0.3}, {0.5, 0.7, 0.8, 0.15} };
+    short* voxels = static_cast<short*>(volume->GetScalarPointer());
+    unsigned int noise = 12345;
+    for( int z = 0; z < dimZ; z++ )
+        for( int y = 0; y < dimY; y++ )
+            for( int x = 0; x < dimX; x++ )
+            {
+                double value = 0.0;
+                for( const auto& ball : balls )
+                {
+                    double dx = double(x) / dimX - ball[0], dy = double(y) / dimY - ball[1], dz = double(z) / dimZ - ball[2];
+                    value = std::max(value, 1000.0 * (1.0 - std::sqrt(dx * dx + dy * dy + dz * dz) / ball[3]));
+                }
+                noise = noise * 1103515245u + 12345u;
+                *voxels++ = short(std::max(value, 0.0) + double((noise >> 16) % 200) - 100.0);
+            }
+
+    return volume;
+}
+
+// Identifies a marching cubes vertex by the cell edge it lies on. Vertices from different
+// extractions may differ in the last float digit, their edges do not.
+long long edgeKey(const double p[3], vtkImageData* volume)
+{
+    int dims[3];
+    volume->GetDimensions(dims);
+    double u[3];
+    int edgeAxis = -1;
+    double maxFraction = 1e-3;
+    for( int a = 0; a < 3; a++ )
+    {
+        u[a] = (p[a] - volume->GetOrigin()[a]) / volume->GetSpacing()[a];
+        double fraction = std::abs(u[a] - std::round(u[a]));
+        if( fraction > maxFraction )
+        {
+            maxFraction = fraction;
+            edgeAxis = a;
+        }
+    }
+
+    long long key = 0;
+    for( int a = 2; a >= 0; a-- )
+        key = key * (dims[a] + 1) + (long long)(a == edgeAxis ? std::floor(u[a]) : std::round(u[a]));
+    return key * 4 + edgeAxis + 1;
+}
+
+// Lists the triangles of a mesh by the edges of their vertices, each starting at its smallest
+// vertex so that the orientation is kept, sorted independently of the point order.
+std::vector<std::array<long long,3>> sortedTriangles(vtkPolyData* mesh, vtkImageData* volume)
+{
+    std::vector<std::array<long long,3>> triangles;
+    vtkCellArray* polys = mesh->GetPolys();
+    vtkSmartPointer<vtkIdList> cellPoints = vtkSmartPointer<vtkIdList>::New();
+    polys->InitTraversal();
+    while( polys->GetNextCell(cellPoints) )
+    {
+        std::array<long long,3> triangle;
+        for( int k = 0; k < 3; k++ )
+        {
+            double p[3];
+            mesh->GetPoint(cellPoints->GetId(k), p);
+            triangle[k] = edgeKey(p, volume);
+        }
+        std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+// The band segmentation as it was done before: mask a copy of the volume, then run vtkMarchingCubes.
+vtkSmartPointer<vtkPolyData> thresholdAndMarchCubes(vtkImageData* volume, int threshold, int upperThreshold)
+{
+    vtkSmartPointer<vtkImageThreshold> imageThreshold = vtkSmartPointer<vtkImageThreshold>::New();
+    imageThreshold->SetInputData(volume);
+    imageThreshold->ThresholdByUpper(upperThreshold);
+    imageThreshold->ReplaceInOn();
+    imageThreshold->SetInValue(threshold - 1);
+    imageThreshold->Update();
+
+    vtkSmartPointer<vtkMarchingCubes> marchingCubes = vtkSmartPointer<vtkMarchingCubes>::New();
+    marchingCubes->ComputeNormalsOn();
+    marchingCubes->SetValue(0, threshold);
+    marchingCubes->SetInputData(imageThreshold->GetOutput());
+    marchingCubes->Update();
+    return marchingCubes->GetOutput();
+}
+
+// Checks that two meshes have the same points in the same order, the same triangles and the same normals.
+void expectIdenticalMeshes(vtkPolyData* mesh, vtkPolyData* reference)
+{
+    ASSERT_EQ(mesh->GetNumberOfPoints(), reference->GetNumberOfPoints());
+    ASSERT_EQ(mesh->GetNumberOfCells(), reference->GetNumberOfCells());
+    for( vtkIdType i = 0; i < mesh->GetNumberOfPoints(); i++ )
+    {
+        double p[3], q[3];
+        mesh->GetPoint(i, p);
+        reference->GetPoint(i, q);
+        ASSERT_EQ(p[0], q[0]);
+        ASSERT_EQ(p[1], q[1]);
+        ASSERT_EQ(p[2], q[2]);
+        for( int a = 0; a < 3; a++ )
+            ASSERT_EQ(mesh->GetPointData()->GetNormals()->GetComponent(i, a), reference->GetPointData()->GetNormals()->GetComponent(i, a));
+    }
+
+    vtkSmartPointer<vtkIdList> cellPoints = vtkSmartPointer<vtkIdList>::New();
+    vtkSmartPointer<vtkIdList> referencePoints = vtkSmartPointer<vtkIdList>::New();
+    mesh->GetPolys()->InitTraversal();
+    reference->GetPolys()->InitTraversal();
+    while( reference->GetPolys()->GetNextCell(referencePoints) )
+    {
+        ASSERT_TRUE(mesh->GetPolys()->GetNextCell(cellPoints));
+        ASSERT_EQ(cellPoints->GetNumberOfIds(), referencePoints->GetNumberOfIds());
+        for( vtkIdType k = 0; k < cellPoints->GetNumberOfIds(); k++ )
+            ASSERT_EQ(cellPoints->GetId(k), referencePoints->GetId(k));
+    }
+}
+
+TEST(Surface, BandExtractionMatchesThresholdedMarchingCubes)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(37, 41, 33);
+    vtkSmartPointer<vtkImageData> original = vtkSmartPointer<vtkImageData>::New();
+    original->DeepCopy(volume);
+    const size_t nbrOfBytes = size_t(37 * 41 * 33) * sizeof(short);
+
+    vtkSmartPointer<vtkPolyData> reference = thresholdAndMarchCubes(volume, 250, 700);
+    ASSERT_GT(reference->GetNumberOfCells(), 0);
+
+    vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(volume, 250, true, 700);
+    expectIdenticalMeshes(mesh, reference);
+
+    // the input volume is left as it was
+    ASSERT_EQ(std::memcmp(volume->GetScalarPointer(), original->GetScalarPointer(), nbrOfBytes), 0);
+
+    // an upper threshold beyond the voxel type masks the voxels of the maximum value, as vtkImageThreshold does
+    vtkSmartPointer<vtkImageData> bytes = vtkSmartPointer<vtkImageData>::New();
+    bytes->SetDimensions(12, 12, 12);
+    bytes->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    unsigned char* voxels = static_cast<unsigned char*>(bytes->GetScalarPointer());
+    for( int i = 0; i < 12 * 12 * 12; i++ )
+        voxels[i] = (i % 7 == 0) ? 255 : (unsigned char)((i * 37) % 200);
+    expectIdenticalMeshes(VTKIsoSurface::extract(bytes, 100, true, 1000, true, nullptr), thresholdAndMarchCubes(bytes, 100, 1000));
+
+    // without upper threshold, the extraction equals vtkMarchingCubes
+    vtkSmartPointer<vtkMarchingCubes> marchingCubes = vtkSmartPointer<vtkMarchingCubes>::New();
+    marchingCubes->ComputeNormalsOn();
+    marchingCubes->SetValue(0, 250);
+    marchingCubes->SetInputData(volume);
+    marchingCubes->Update();
+    expectIdenticalMeshes(VTKIsoSurface::extract(volume, 250, false, 0, true, nullptr), marchingCubes->GetOutput());
+
+    delete dr;
+}
+
+TEST(Surface, ParallelMarchingCubesMatchesMarchingCubes)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    ASSERT_EQ(dr->GetSurfaceExtractor(), VTKDicomRoutines::SurfaceExtractor::MarchingCubes);
+
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(48, 40, 57);
+    vtkSmartPointer<vtkPolyData> reference = dr->dicomToMesh(volume, 300, false, 0);
+    ASSERT_GT(reference->GetNumberOfCells(), 0);
+
+    dr->SetSurfaceExtractor(VTKDicomRoutines::SurfaceExtractor::ParallelMarchingCubes);
+    for( unsigned int nbrOfThreads : {2u, 3u, 8u} )
+    {
+        dr->SetNumberOfThreads(nbrOfThreads);
+        vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(volume, 300, false, 0);
+
+        // same vertices and triangles, no duplicated vertices at the block seams
+        ASSERT_EQ(mesh->GetNumberOfPoints(), reference->GetNumberOfPoints());
+        ASSERT_EQ(mesh->GetNumberOfCells(), reference->GetNumberOfCells());
+        ASSERT_TRUE(sortedTriangles(mesh, volume) == sortedTriangles(reference, volume));
+
+        // the normals of vtkMarchingCubes
+        vtkDataArray* normals = mesh->GetPointData()->GetNormals();
+        vtkDataArray* referenceNormals = reference->GetPointData()->GetNormals();
+        ASSERT_FALSE(normals == nullptr);
+        ASSERT_FALSE(referenceNormals == nullptr);
+        double sum[3] = {0.0, 0.0, 0.0}, referenceSum[3] = {0.0, 0.0, 0.0};
+        for( vtkIdType i = 0; i < mesh->GetNumberOfPoints(); i++ )
+            for( int a = 0; a < 3; a++ )
+            {
+                sum[a] += normals->GetComponent(i, a);
+                referenceSum[a] += referenceNormals->GetComponent(i, a);
+            }
+        for( int a = 0; a < 3; a++ )
+            ASSERT_NEAR(sum[a], referenceSum[a], 0.05);
+    }
+
+    // a volume with an extent not starting at 0, as after cropping
+    vtkSmartPointer<vtkImageData> shifted = vtkSmartPointer<vtkImageData>::New();
+    shifted->ShallowCopy(volume);
+    shifted->SetExtent(3, 50, -2, 37, 10, 66);
+    shifted->SetOrigin(-12.0 - 3 * 0.7, 5.0 + 2 * 0.8, 30.0 - 10 * 1.3);
+    vtkSmartPointer<vtkPolyData> shiftedMesh = dr->dicomToMesh(shifted, 300, false, 0);
+    ASSERT_TRUE(sortedTriangles(shiftedMesh, volume) == sortedTriangles(reference, volume));
+
+    delete dr;
+}
+
+TEST(Surface, ParallelMarchingCubesWithRange)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(40, 40, 40);
+    vtkSmartPointer<vtkPolyData> reference = dr->dicomToMesh(volume, 200, true, 600);
+
+    dr->SetSurfaceExtractor(VTKDicomRoutines::SurfaceExtractor::ParallelMarchingCubes);
+    dr->SetNumberOfThreads(4);
+    vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(volume, 200, true, 600);
+    ASSERT_EQ(mesh->GetNumberOfPoints(), reference->GetNumberOfPoints());
+    ASSERT_TRUE(sortedTriangles(mesh, volume) == sortedTriangles(reference, volume));
+
+    delete dr;
+}
+
+TEST(Surface, SeveralIsoRangesInOnePass)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(40, 40, 40);
+
+    std::vector<VTKDicomRoutines::IsoRange> ranges(3);
+    ranges[0].threshold = 250;
+    ranges[1].threshold = 200;
+    ranges[1].useUpperThreshold = true;
+    ranges[1].upperThreshold = 600;
+    ranges[2].threshold = 500;
+
+    std::vector<vtkSmartPointer<vtkPolyData>> meshes = dr->dicomToMeshes(volume, ranges);
+    ASSERT_EQ(meshes.size(), ranges.size());
+    for( size_t r = 0; r < ranges.size(); r++ )
+    {
+        vtkSmartPointer<vtkPolyData> reference = dr->dicomToMesh(volume, ranges[r].threshold, ranges[r].useUpperThreshold, ranges[r].upperThreshold);
+        expectIdenticalMeshes(meshes[r], reference);
+    }
+
+    // block-parallel extraction stitches every surface on its own
+    dr->SetSurfaceExtractor(VTKDicomRoutines::SurfaceExtractor::ParallelMarchingCubes);
+    dr->SetNumberOfThreads(4);
+    std::vector<vtkSmartPointer<vtkPolyData>> parallelMeshes = dr->dicomToMeshes(volume, ranges);
+    ASSERT_EQ(parallelMeshes.size(), ranges.size());
+    for( size_t r = 0; r < ranges.size(); r++ )
+    {
+        ASSERT_EQ(parallelMeshes[r]->GetNumberOfPoints(), meshes[r]->GetNumberOfPoints());
+        ASSERT_TRUE(sortedTriangles(parallelMeshes[r], volume) == sortedTriangles(meshes[r], volume));
+    }
+
+    delete dr;
+}
+
+TEST(Surface, MinMaxBlocks)
+{
+    const int dims[3] = { 37, 29, 18 };
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(dims[0], dims[1], dims[2]);
+    const short* voxels = static_cast<const short*>(volume->GetScalarPointer());
+
+    VTKMinMaxBlocks blocks;
+    ASSERT_FALSE(blocks.isBuiltFor(volume));
+    ASSERT_TRUE(blocks.build(volume, 4));
+    ASSERT_TRUE(blocks.isBuiltFor(volume));
+    ASSERT_EQ(blocks.getNumberOfBlocks(), 5 * 4 * 3);
+
+    // a block covers its 8x8x8 cells, that is up to 9 voxels in each direction
+    for( int bz = 0; bz < 3; bz++ )
+        for( int by = 0; by < 4; by++ )
+            for( int bx = 0; bx < 5; bx++ )
+            {
+                short lowest = std::numeric_limits<short>::max();
+                short highest = std::numeric_limits<short>::lowest();
+                for( int z = bz * 8; z <= std::min(bz * 8 + 8, dims[2] - 1); z++ )
+                    for( int y = by * 8; y <= std::min(by * 8 + 8, dims[1] - 1); y++ )
+                        for( int x = bx * 8; x <= std::min(bx * 8 + 8, dims[0] - 1); x++ )
+                        {
+                            short value = voxels[x + y * dims[0] + z * dims[0] * dims[1]];
+                            lowest = std::min(lowest, value);
+                            highest = std::max(highest, value);
+                        }
+                ASSERT_EQ(blocks.getMinimum(bx, by, bz), double(lowest));
+                ASSERT_EQ(blocks.getMaximum(bx, by, bz), double(highest));
+            }
+
+    // the noise of the background stays below 100
+    std::vector<VTKIsoSurface::IsoRange> ranges(1);
+    ranges[0].threshold = 250;
+    VTKIsoSurface::ActiveBlocks activeBlocks = blocks.findActiveBlocks(ranges);
+    ASSERT_GT(activeBlocks.nbrOfSkippedBlocks, 0);
+    ASSERT_LT(activeBlocks.nbrOfSkippedBlocks, blocks.getNumberOfBlocks());
+
+    // changed voxels need new block ranges
+    volume->GetPointData()->GetScalars()->Modified();
+    ASSERT_FALSE(blocks.isBuiltFor(volume));
+}
+
+TEST(Surface, EmptySpaceSkippingKeepsMesh)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(45, 38, 30);
+
+    std::vector<VTKDicomRoutines::IsoRange> ranges(3);
+    ranges[0].threshold = 250;
+    ranges[1].threshold = 200;
+    ranges[1].useUpperThreshold = true;
+    ranges[1].upperThreshold = 600;
+    ranges[2].threshold = -50;
+
+    dr->SetEmptySpaceSkipping(false);
+    std::vector<vtkSmartPointer<vtkPolyData>> references;
+    for( const VTKDicomRoutines::IsoRange& range : ranges )
+        references.push_back(dr->dicomToMesh(volume, range.threshold, range.useUpperThreshold, range.upperThreshold));
+
+    // the block ranges are computed once and serve all thresholds
+    dr->SetEmptySpaceSkipping(true);
+    ASSERT_TRUE(dr->GetEmptySpaceSkipping());
+    for( size_t r = 0; r < ranges.size(); r++ )
+        expectIdenticalMeshes(dr->dicomToMesh(volume, ranges[r].threshold, ranges[r].useUpperThreshold, ranges[r].upperThreshold), references[r]);
+
+    std::vector<vtkSmartPointer<vtkPolyData>> meshes = dr->dicomToMeshes(volume, ranges);
+    for( size_t r = 0; r < ranges.size(); r++ )
+        expectIdenticalMeshes(meshes[r], references[r]);
+
+    // z-blocks of the parallel extraction start within a block of cells
+    dr->SetSurfaceExtractor(VTKDicomRoutines::SurfaceExtractor::ParallelMarchingCubes);
+    dr->SetNumberOfThreads(3);
+    for( size_t r = 0; r < ranges.size(); r++ )
+    {
+        vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(volume, ranges[r].threshold, ranges[r].useUpperThreshold, ranges[r].upperThreshold);
+        ASSERT_EQ(mesh->GetNumberOfPoints(), references[r]->GetNumberOfPoints());
+        ASSERT_TRUE(sortedTriangles(mesh, volume) == sortedTriangles(references[r], volume));
+    }
+
+    delete dr;
+}
+
+// Creates an int16 volume of a ball, a small cube with a voxel touching one corner and a single voxel.
+vtkSmartPointer<vtkImageData> createObjectsVolume(bool withSmallObjects)
+{
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetDimensions(40, 38, 36);
+    volume->SetSpacing(0.7, 0.8, 1.3);
+    volume->AllocateScalars(VTK_SHORT, 1);
+
+    short* voxels = static_cast<short*>(volume->GetScalarPointer());
+    std::fill(voxels, voxels + 40 * 38 * 36, short(0));
+    for( int z = 0; z < 36; z++ )
+        for( int y = 0; y < 38; y++ )
+            for( int x = 0; x < 40; x++ )
+            {
+                double r = std::sqrt(double((x - 15) * (x - 15) + (y - 15) * (y - 15) + (z - 15) * (z - 15)));
+                voxels[x + y * 40 + z * 40 * 38] = short(std::max(0.0, 1000.0 - 100.0 * r));
+            }
+
+    if( withSmallObjects )
+    {
+        for( int z = 30; z < 32; z++ )
+            for( int y = 30; y < 32; y++ )
+                for( int x = 32; x < 34; x++ )
+                    voxels[x + y * 40 + z * 40 * 38] = 800;
+        voxels[34 + 32 * 40 + 32 * 40 * 38] = 800;
+        voxels[3 + 33 * 40 + 5 * 40 * 38] = 800;
+    }
+    return volume;
+}
+
+TEST(Surface, VoxelComponents)
+{
+    vtkSmartPointer<vtkImageData> volume = createObjectsVolume(true);
+    vtkSmartPointer<vtkImageData> reference = createObjectsVolume(false);
+    VTKIsoSurface::IsoRange range;
+    range.threshold = 300;
+
+    VTKVoxelComponents::Statistics statistics;
+    std::shared_ptr<const VTKIsoSurface::ExcludedVoxels> excluded = VTKVoxelComponents::findSmallComponents(volume, range, 0.0, 4, statistics);
+    ASSERT_TRUE(excluded.get() != NULL);
+    ASSERT_TRUE(excluded->runs.empty());
+    ASSERT_EQ(statistics.nbrOfComponents, 3);
+    ASSERT_EQ(statistics.nbrOfRemovedComponents, 0);
+
+    // the corner voxel belongs to the cube
+    for( unsigned int nbrOfThreads : { 1, 3, 8 } )
+    {
+        excluded = VTKVoxelComponents::findSmallComponents(volume, range, 0.1, nbrOfThreads, statistics);
+        ASSERT_TRUE(excluded.get() != NULL);
+        ASSERT_EQ(statistics.nbrOfComponents, 3);
+        ASSERT_EQ(statistics.nbrOfRemovedComponents, 2);
+        ASSERT_EQ(statistics.nbrOfRemovedVoxels, 10);
+        ASSERT_TRUE(excluded->covers(38 * 36));
+
+        // exactly the voxels of the removed components are excluded
+        const short* voxels = static_cast<const short*>(volume->GetScalarPointer());
+        const short* expected = static_cast<const short*>(reference->GetScalarPointer());
+        for( int z = 0; z < 36; z++ )
+            for( int y = 0; y < 38; y++ )
+                for( int x = 0; x < 40; x++ )
+                {
+                    const int i = x + y * 40 + z * 40 * 38;
+                    ASSERT_EQ(excluded->contains(size_t(z * 38 + y), x), voxels[i] >= 300 && expected[i] < 300);
+                }
+    }
+
+    // the count of the surface passes over the removed components
+    VTKIsoSurface::IsoRange filteredRange = range;
+    filteredRange.excludedVoxels = excluded;
+    std::vector<VTKIsoSurface::SurfaceSize> sizes = VTKIsoSurface::countTriangles(volume, { range, filteredRange }, 2, nullptr);
+    ASSERT_EQ(sizes[1].nbrOfInsideVoxels + 10, sizes[0].nbrOfInsideVoxels);
+    ASSERT_LT(sizes[1].nbrOfCells, sizes[0].nbrOfCells);
+
+    // the volume itself is not changed
+    ASSERT_EQ(static_cast<const short*>(volume->GetScalarPointer())[3 + 33 * 40 + 5 * 40 * 38], 800);
+
+    // with the upper threshold, the center of the ball is outside and the shell stays connected
+    range.useUpperThreshold = true;
+    range.upperThreshold = 900;
+    VTKVoxelComponents::findSmallComponents(volume, range, 0.1, 4, statistics);
+    ASSERT_EQ(statistics.nbrOfComponents, 3);
+    ASSERT_EQ(statistics.nbrOfRemovedComponents, 2);
+}
+
+TEST(Surface, SmallObjectsRemovedBeforeMeshing)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    vtkSmartPointer<vtkImageData> volume = createObjectsVolume(true);
+    vtkSmartPointer<vtkPolyData> reference = dr->dicomToMesh(createObjectsVolume(false), 300, false, 0);
+
+    ASSERT_EQ(dr->GetSmallObjectRatio(), 0.0);
+    dr->SetSmallObjectRatio(0.1);
+    ASSERT_EQ(dr->GetSmallObjectRatio(), 0.1);
+    expectIdenticalMeshes(dr->dicomToMesh(volume, 300, false, 0), reference);
+
+    dr->SetEmptySpaceSkipping(false);
+    expectIdenticalMeshes(dr->dicomToMesh(volume, 300, false, 0), reference);
+
+    std::vector<VTKDicomRoutines::IsoRange> ranges(2);
+    ranges[0].threshold = 300;
+    ranges[1].threshold = 900;
+    std::vector<vtkSmartPointer<vtkPolyData>> meshes = dr->dicomToMeshes(volume, ranges);
+    ASSERT_EQ(meshes.size(), 2);
+    expectIdenticalMeshes(meshes[0], reference);
+    ASSERT_GT(meshes[1]->GetNumberOfCells(), 0);
+
+    // the excluded voxels are honoured by every extractor
+    for( VTKDicomRoutines::SurfaceExtractor extractor : { VTKDicomRoutines::SurfaceExtractor::ParallelMarchingCubes,
+                                                          VTKDicomRoutines::SurfaceExtractor::AdaptiveDualContouring } )
+    {
+        dr->SetSurfaceExtractor(extractor);
+        dr->SetSmallObjectRatio(0.0);
+        vtkSmartPointer<vtkPolyData> expected = dr->dicomToMesh(createObjectsVolume(false), 300, false, 0);
+        dr->SetSmallObjectRatio(0.1);
+        expectIdenticalMeshes(dr->dicomToMesh(volume, 300, false, 0), expected);
+    }
+
+    delete dr;
+}
+
+TEST(Surface, KeptSurfacesKeepTheirNormals)
+{
+    // a voxel two voxels off the ball, within the reach of the gradients of the ball's surface
+    vtkSmartPointer<vtkImageData> volume = createObjectsVolume(false);
+    static_cast<short*>(volume->GetScalarPointer())[24 + 15 * 40 + 15 * 40 * 38] = 800;
+
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    vtkSmartPointer<vtkPolyData> all = dr->dicomToMesh(volume, 300, false, 0);
+    dr->SetSmallObjectRatio(0.1);
+    vtkSmartPointer<vtkPolyData> kept = dr->dicomToMesh(volume, 300, false, 0);
+    ASSERT_LT(kept->GetNumberOfPoints(), all->GetNumberOfPoints());
+
+    // each vertex of the ball has the position and the normal it has without removal
+    std::map<std::array<double,3>, std::array<double,3>> normals;
+    for( vtkIdType p = 0; p < all->GetNumberOfPoints(); p++ )
+    {
+        double* x = all->GetPoint(p);
+        double* n = all->GetPointData()->GetNormals()->GetTuple3(p);
+        normals[{{ x[0], x[1], x[2] }}] = {{ n[0], n[1], n[2] }};
+    }
+    for( vtkIdType p = 0; p < kept->GetNumberOfPoints(); p++ )
+    {
+        double* x = kept->GetPoint(p);
+        auto it = normals.find({{ x[0], x[1], x[2] }});
+        ASSERT_TRUE(it != normals.end());
+        for( int a = 0; a < 3; a++ )
+            ASSERT_EQ(kept->GetPointData()->GetNormals()->GetComponent(p, a), it->second[a]);
+    }
+
+    delete dr;
+}
+
+TEST(Surface, ExtractedMeshIsWelded)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(40, 40, 40);
+
+    for( bool skipEmptySpace : { true, false } )
+    {
+        dr->SetEmptySpaceSkipping(skipEmptySpace);
+        vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(volume, 250, false, 0);
+        ASSERT_GT(mesh->GetNumberOfCells(), 0);
+
+        // neighbouring cells share their vertices: no two vertices lie at the same place
+        std::vector<std::array<float,3>> points;
+        for( vtkIdType p = 0; p < mesh->GetNumberOfPoints(); p++ )
+        {
+            double* x = mesh->GetPoint(p);
+            points.push_back({{ float(x[0]), float(x[1]), float(x[2]) }});
+        }
+        std::sort(points.begin(), points.end());
+        ASSERT_TRUE(std::adjacent_find(points.begin(), points.end()) == points.end());
+
+        // a closed surface has about half as many vertices as triangles, an unwelded one three times as many
+        ASSERT_LT(mesh->GetNumberOfPoints(), mesh->GetNumberOfCells());
+
+        vtkSmartPointer<vtkIdList> triangle = vtkSmartPointer<vtkIdList>::New();
+        for( vtkIdType c = 0; c < mesh->GetNumberOfCells(); c++ )
+        {
+            mesh->GetCellPoints(c, triangle);
+            ASSERT_NE(triangle->GetId(0), triangle->GetId(1));
+            ASSERT_NE(triangle->GetId(0), triangle->GetId(2));
+            ASSERT_NE(triangle->GetId(1), triangle->GetId(2));
+        }
+    }
+
+    delete dr;
+}
+
+// Counts the edges which are not shared by exactly two triangles.
+int countOpenEdges(vtkPolyData* mesh)
+{
+    std::vector<std::pair<vtkIdType,vtkIdType>> edges;
+    vtkSmartPointer<vtkIdList> triangle = vtkSmartPointer<vtkIdList>::New();
+    for( vtkIdType c = 0; c < mesh->GetNumberOfCells(); c++ )
+    {
+        mesh->GetCellPoints(c, triangle);
+        for( int e = 0; e < 3; e++ )
+        {
+            vtkIdType a = triangle->GetId(e), b = triangle->GetId((e + 1) % 3);
+            edges.push_back({ std::min(a, b), std::max(a, b) });
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    int nbrOfOpenEdges = 0;
+    for( size_t i = 0; i < edges.size(); )
+    {
+        size_t j = i;
+        while( j < edges.size() && edges[j] == edges[i] )
+            j++;
+        if( j - i != 2 )
+            nbrOfOpenEdges++;
+        i = j;
+    }
+    return nbrOfOpenEdges;
+}
+
+TEST(Surface, AdaptiveDualContouring)
+{
+    vtkSmartPointer<vtkImageData> volume = createObjectsVolume(false);
+    vtkSmartPointer<vtkPolyData> reference = thresholdAndMarchCubes(volume, 300, 0);
+    VTKIsoSurface::IsoRange range;
+    range.threshold = 300;
+
+    // without merging, there is one vertex per surface cell
+    VTKDualContouring::Statistics statistics;
+    vtkSmartPointer<vtkPolyData> uniform = VTKDualContouring::extract(volume, range, 0.0, 4, nullptr, nullptr, &statistics);
+    ASSERT_EQ(size_t(uniform->GetNumberOfPoints()), statistics.nbrOfSurfaceCells);
+    ASSERT_EQ(statistics.nbrOfLeafCells, statistics.nbrOfSurfaceCells);
+    ASSERT_EQ(countOpenEdges(uniform), 0);
+
+    vtkSmartPointer<vtkPolyData> adaptive = VTKDualContouring::extract(volume, range, 0.2, 4, nullptr, nullptr, &statistics);
+    ASSERT_LT(statistics.nbrOfLeafCells, statistics.nbrOfSurfaceCells);
+    ASSERT_LT(adaptive->GetNumberOfCells(), uniform->GetNumberOfCells());
+    ASSERT_LT(adaptive->GetNumberOfCells(), reference->GetNumberOfCells() / 2);
+    ASSERT_EQ(countOpenEdges(adaptive), 0);
+    ASSERT_NE(adaptive->GetPointData()->GetNormals(), nullptr);
+
+    // the ball keeps its place and size
+    double expected[6], bounds[6];
+    reference->GetBounds(expected);
+    adaptive->GetBounds(bounds);
+    for( int i = 0; i < 6; i++ )
+        ASSERT_NEAR(bounds[i], expected[i], 1.0);
+
+    // the same surface, through the library
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    dr->SetSurfaceExtractor(VTKDicomRoutines::SurfaceExtractor::AdaptiveDualContouring);
+    dr->SetDualContouringTolerance(0.2);
+    ASSERT_EQ(dr->GetDualContouringTolerance(), 0.2);
+    vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(volume, 300, false, 0);
+    ASSERT_EQ(mesh->GetNumberOfCells(), adaptive->GetNumberOfCells());
+    delete dr;
+}
+
+// Volume enclosed by a closed mesh, positive if the triangles face outwards.
+double enclosedVolume(vtkPolyData* mesh)
+{
+    double volume = 0.0;
+    vtkSmartPointer<vtkIdList> triangle = vtkSmartPointer<vtkIdList>::New();
+    for( vtkIdType c = 0; c < mesh->GetNumberOfCells(); c++ )
+    {
+        mesh->GetCellPoints(c, triangle);
+        double a[3], b[3], d[3];
+        mesh->GetPoint(triangle->GetId(0), a);
+        mesh->GetPoint(triangle->GetId(1), b);
+        mesh->GetPoint(triangle->GetId(2), d);
+        volume += ( a[0] * (b[1] * d[2] - b[2] * d[1]) - a[1] * (b[0] * d[2] - b[2] * d[0]) + a[2] * (b[0] * d[1] - b[1] * d[0]) ) / 6.0;
+    }
+    return volume;
+}
+
+TEST(Surface, LabelSurfaces)
+{
+    // two boxes touching each other, the second one at the border of the volume, and a ball
+    vtkSmartPointer<vtkImageData> labels = vtkSmartPointer<vtkImageData>::New();
+    labels->SetDimensions(30, 24, 20);
+    labels->SetSpacing(0.7, 0.8, 1.3);
+    labels->SetOrigin(-5.0, 2.0, 10.0);
+    labels->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    unsigned char* voxels = static_cast<unsigned char*>(labels->GetScalarPointer());
+    size_t nbrOfVoxels[4] = { 0, 0, 0, 0 };
+    for( int z = 0; z < 20; z++ )
+        for( int y = 0; y < 24; y++ )
+            for( int x = 0; x < 30; x++ )
+            {
+                unsigned char label = 0;
+                if( x >= 4 && x < 14 && y >= 4 && y < 16 && z >= 3 && z < 12 )
+                    label = 1;
+                else if( x >= 14 && y >= 4 && y < 16 && z >= 3 && z < 12 )
+                    label = 2;
+                else if( (x - 10) * (x - 10) + (y - 18) * (y - 18) + (z - 15) * (z - 15) < 16 )
+                    label = 3;
+                voxels[x + y * 30 + z * 30 * 24] = label;
+                nbrOfVoxels[label]++;
+            }
+
+    vtkSmartPointer<vtkPolyData> labelledMesh = VTKLabelSurfaces::extract(labels, 0, 4, nullptr);
+    vtkDataArray* triangleLabels = labelledMesh->GetCellData()->GetArray(VTKLabelSurfaces::LabelsArrayName);
+    ASSERT_NE(triangleLabels, nullptr);
+    ASSERT_EQ(triangleLabels->GetNumberOfComponents(), 2);
+    ASSERT_EQ(triangleLabels->GetNumberOfTuples(), labelledMesh->GetNumberOfCells());
+
+    // the boundary between the boxes is extracted once
+    size_t nbrOfShared = 0;
+    for( vtkIdType c = 0; c < labelledMesh->GetNumberOfCells(); c++ )
+    {
+        ASSERT_GT(triangleLabels->GetComponent(c, 0), triangleLabels->GetComponent(c, 1));
+        if( triangleLabels->GetComponent(c, 0) == 2 && triangleLabels->GetComponent(c, 1) == 1 )
+            nbrOfShared++;
+    }
+    ASSERT_EQ(nbrOfShared, 2 * 12 * 9);
+
+    std::map<int, vtkSmartPointer<vtkPolyData>> meshes = VTKLabelSurfaces::splitByLabel(labelledMesh);
+    ASSERT_EQ(meshes.size(), 3);
+    for( int label = 1; label <= 3; label++ )
+    {
+        // closed, facing outwards and close to the volume of the voxels
+        ASSERT_EQ(countOpenEdges(meshes[label]), 0);
+        const double voxelVolume = nbrOfVoxels[label] * 0.7 * 0.8 * 1.3;
+        ASSERT_NEAR(enclosedVolume(meshes[label]), voxelVolume, 0.15 * voxelVolume);
+    }
+
+    // relaxed vertices stay within their cells
+    vtkSmartPointer<vtkPolyData> smoothed = VTKLabelSurfaces::extract(labels, 10, 3, nullptr);
+    ASSERT_EQ(smoothed->GetNumberOfPoints(), labelledMesh->GetNumberOfPoints());
+    ASSERT_EQ(smoothed->GetNumberOfCells(), labelledMesh->GetNumberOfCells());
+    for( vtkIdType p = 0; p < smoothed->GetNumberOfPoints(); p++ )
+    {
+        double a[3], b[3];
+        smoothed->GetPoint(p, a);
+        labelledMesh->GetPoint(p, b);
+        ASSERT_NEAR(a[0], b[0], 0.7);
+        ASSERT_NEAR(a[1], b[1], 0.8);
+        ASSERT_NEAR(a[2], b[2], 1.3);
+    }
+
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    ASSERT_EQ(dr->GetLabelSmoothingIterations(), 10);
+    dr->SetLabelSmoothingIterations(0);
+    std::map<int, vtkSmartPointer<vtkPolyData>> routineMeshes = dr->labelsToMeshes(labels);
+    ASSERT_EQ(routineMeshes.size(), 3);
+    for( int label = 1; label <= 3; label++ )
+        ASSERT_EQ(routineMeshes[label]->GetNumberOfCells(), meshes[label]->GetNumberOfCells());
+    delete dr;
+
+    // a float volume holds no labels
+    vtkSmartPointer<vtkImageData> densities = vtkSmartPointer<vtkImageData>::New();
+    densities->SetDimensions(4, 4, 4);
+    densities->AllocateScalars(VTK_FLOAT, 1);
+    ASSERT_EQ(VTKLabelSurfaces::extract(densities, 0, 1, nullptr)->GetNumberOfCells(), 0);
+}
+
+TEST(Surface, TriangleCountEstimate)
+{
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(48, 40, 36);
+    std::vector<VTKIsoSurface::IsoRange> ranges(3);
+    ranges[0].threshold = 250;
+    ranges[1].threshold = -20;
+    ranges[2].threshold = 100;
+    ranges[2].useUpperThreshold = true;
+    ranges[2].upperThreshold = 600;
+    std::vector<vtkSmartPointer<vtkPolyData>> meshes = VTKIsoSurface::extract(volume, ranges, false, nullptr);
+
+    // voxels inside each band, counted one by one
+    std::vector<size_t> insideVoxels(ranges.size(), 0);
+    const short* voxels = static_cast<const short*>(volume->GetScalarPointer());
+    for( vtkIdType i = 0; i < volume->GetNumberOfPoints(); i++ )
+        for( size_t m = 0; m < ranges.size(); m++ )
+            if( voxels[i] >= ranges[m].threshold && ( !ranges[m].useUpperThreshold || voxels[i] < ranges[m].upperThreshold ) )
+                insideVoxels[m]++;
+
+    // the triangles collapsing at voxels on the iso value are counted, but not created
+    for( unsigned int nbrOfThreads : { 1, 4 } )
+    {
+        std::vector<VTKIsoSurface::SurfaceSize> sizes = VTKIsoSurface::countTriangles(volume, ranges, nbrOfThreads, nullptr);
+        ASSERT_EQ(sizes.size(), 3);
+        for( size_t m = 0; m < sizes.size(); m++ )
+        {
+            ASSERT_GE(sizes[m].nbrOfTriangles, size_t(meshes[m]->GetNumberOfCells()));
+            ASSERT_LE(sizes[m].nbrOfTriangles, size_t(meshes[m]->GetNumberOfCells()) * 105 / 100);
+            ASSERT_GT(sizes[m].nbrOfCells, 0);
+            ASSERT_LE(sizes[m].nbrOfCells, sizes[m].nbrOfTriangles);
+            ASSERT_EQ(sizes[m].nbrOfInsideVoxels, insideVoxels[m]);
+        }
+    }
+
+    // skipping empty space counts the same
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    std::vector<VTKIsoSurface::SurfaceSize> reference = VTKIsoSurface::countTriangles(volume, ranges, 2, nullptr);
+    std::vector<VTKIsoSurface::SurfaceSize> estimated = dr->estimateMeshSizes(volume, ranges);
+    ASSERT_EQ(estimated.size(), 3);
+    for( size_t m = 0; m < estimated.size(); m++ )
+    {
+        ASSERT_EQ(estimated[m].nbrOfCells, reference[m].nbrOfCells);
+        ASSERT_EQ(estimated[m].nbrOfTriangles, reference[m].nbrOfTriangles);
+        ASSERT_EQ(estimated[m].nbrOfInsideVoxels, insideVoxels[m]);
+    }
+    delete dr;
+}
+
+TEST(Surface, VolumeHistogram)
+{
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(30, 20, 10);
+    const short* voxels = static_cast<const short*>(volume->GetScalarPointer());
+    const short minimum = *std::min_element(voxels, voxels + 6000);
+    const short maximum = *std::max_element(voxels, voxels + 6000);
+
+    for( unsigned int nbrOfThreads : { 1, 3 } )
+    {
+        VTKVolumeHistogram::Histogram histogram = VTKVolumeHistogram::compute(volume, 50, nbrOfThreads);
+        ASSERT_EQ(histogram.minimum, minimum);
+        ASSERT_EQ(histogram.maximum, maximum);
+        ASSERT_EQ(histogram.nbrOfVoxels, 6000);
+        ASSERT_LE(histogram.counts.size(), 50);
+        ASSERT_EQ(histogram.binWidth, std::ceil((maximum - minimum + 1) / 50.0));
+
+        // integer bins: each value falls into one bin
+        std::vector<size_t> expected(histogram.counts.size(), 0);
+        for( int v = 0; v < 6000; v++ )
+            expected[size_t((voxels[v] - minimum) / histogram.binWidth)]++;
+        ASSERT_EQ(histogram.counts, expected);
+
+        size_t atOrAbove = 0;
+        const double binStart = histogram.getBinStart(3);
+        for( int v = 0; v < 6000; v++ )
+            atOrAbove += voxels[v] >= binStart ? 1 : 0;
+        ASSERT_EQ(histogram.countFrom(binStart), atOrAbove);
+    }
+
+    vtkSmartPointer<vtkImageData> densities = vtkSmartPointer<vtkImageData>::New();
+    densities->SetDimensions(2, 2, 1);
+    densities->AllocateScalars(VTK_FLOAT, 1);
+    float* values = static_cast<float*>(densities->GetScalarPointer());
+    values[0] = 0.5f; values[1] = 1.0f; values[2] = 2.5f; values[3] = 2.5f;
+    VTKVolumeHistogram::Histogram histogram = VTKVolumeHistogram::compute(densities, 4, 2);
+    ASSERT_EQ(histogram.counts, std::vector<size_t>({ 1, 1, 0, 2 }));
+    ASSERT_DOUBLE_EQ(histogram.binWidth, 0.5);
+}
+
+TEST(Surface, GaussianPreFilter)
+{
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(48, 40, 36);
+    vtkSmartPointer<vtkImageData> smoothed = VTKVolumeFilter::gaussian(volume, 1.0, 1, NULL);
+    ASSERT_FALSE(smoothed.Get() == nullptr);
+    ASSERT_EQ(smoothed->GetScalarType(), VTK_SHORT);
+    for( int a = 0; a < 3; a++ )
+    {
+        ASSERT_EQ(smoothed->GetDimensions()[a], volume->GetDimensions()[a]);
+        ASSERT_EQ(smoothed->GetSpacing()[a], volume->GetSpacing()[a]);
+        ASSERT_EQ(smoothed->GetOrigin()[a], volume->GetOrigin()[a]);
+    }
+
+    // the slices are split among the threads, the result does not depend on them
+    vtkSmartPointer<vtkImageData> smoothedInParallel = VTKVolumeFilter::gaussian(volume, 1.0, 3, NULL);
+    ASSERT_EQ(std::memcmp(smoothed->GetScalarPointer(), smoothedInParallel->GetScalarPointer(), 48 * 40 * 36 * sizeof(short)), 0);
+
+    // the weights sum up to one, and the border voxels are repeated
+    vtkSmartPointer<vtkImageData> constant = vtkSmartPointer<vtkImageData>::New();
+    constant->SetDimensions(9, 7, 5);
+    constant->AllocateScalars(VTK_SHORT, 1);
+    std::fill_n(static_cast<short*>(constant->GetScalarPointer()), 9 * 7 * 5, short(500));
+    vtkSmartPointer<vtkImageData> smoothedConstant = VTKVolumeFilter::gaussian(constant, 1.5, 2, NULL);
+    const short* constantVoxels = static_cast<const short*>(smoothedConstant->GetScalarPointer());
+    ASSERT_TRUE(std::all_of(constantVoxels, constantVoxels + 9 * 7 * 5, [](short v) { return v == 500; }));
+
+    // an impulse spreads symmetrically
+    vtkSmartPointer<vtkImageData> impulse = vtkSmartPointer<vtkImageData>::New();
+    impulse->SetDimensions(15, 15, 15);
+    impulse->AllocateScalars(VTK_FLOAT, 1);
+    float* impulseVoxels = static_cast<float*>(impulse->GetScalarPointer());
+    std::fill_n(impulseVoxels, 15 * 15 * 15, 0.0f);
+    impulseVoxels[(7 * 15 + 7) * 15 + 7] = 1000.0f;
+    vtkSmartPointer<vtkImageData> response = VTKVolumeFilter::gaussian(impulse, 1.0, 2, NULL);
+    const float* responseVoxels = static_cast<const float*>(response->GetScalarPointer());
+    ASSERT_NEAR(std::accumulate(responseVoxels, responseVoxels + 15 * 15 * 15, 0.0), 1000.0, 0.01);
+    ASSERT_FLOAT_EQ(response->GetScalarComponentAsDouble(8, 7, 7, 0), response->GetScalarComponentAsDouble(7, 6, 7, 0));
+    ASSERT_FLOAT_EQ(response->GetScalarComponentAsDouble(7, 7, 8, 0), response->GetScalarComponentAsDouble(6, 7, 7, 0));
+    ASSERT_LT(response->GetScalarComponentAsDouble(8, 7, 7, 0), response->GetScalarComponentAsDouble(7, 7, 7, 0));
+
+    // meshing the smoothed volume removes the bumps of the noise
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    vtkSmartPointer<vtkPolyData> noisyMesh = dr->dicomToMesh(volume, 400, false, 0);
+    vtkSmartPointer<vtkPolyData> smoothedMesh = dr->dicomToMesh(smoothed, 400, false, 0);
+    ASSERT_LT(smoothedMesh->GetNumberOfCells(), noisyMesh->GetNumberOfCells());
+
+    dr->SetGaussianSigma(1.0);
+    ASSERT_EQ(dr->GetGaussianSigma(), 1.0);
+    vtkSmartPointer<vtkPolyData> preFilteredMesh = dr->dicomToMesh(volume, 400, false, 0);
+    ASSERT_EQ(preFilteredMesh->GetNumberOfCells(), smoothedMesh->GetNumberOfCells());
+    ASSERT_EQ(preFilteredMesh->GetNumberOfPoints(), smoothedMesh->GetNumberOfPoints());
+    delete dr;
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests
+TEST(Surface, DISABLED_BenchmarkMarchingCubes)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(192, 192, 192);
+
+    auto timeExtraction = [&]( vtkIdType& nbrOfTriangles ) -> long
+    {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        vtkSmartPointer<vtkPolyData> mesh = dr->dicomToMesh(volume, 300, false, 0);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        nbrOfTriangles = mesh->GetNumberOfCells();
+        return long(std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count());
+    };
+
+    vtkIdType referenceTriangles = 0;
+    const long referenceMs = timeExtraction(referenceTriangles);
+
+    std::vector<std::string> report;
+    report.push_back("marching cubes: " + std::to_string(referenceMs) + " ms");
+
+    dr->SetSurfaceExtractor(VTKDicomRoutines::SurfaceExtractor::ParallelMarchingCubes);
+    const unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for( unsigned int nbrOfThreads = 1; nbrOfThreads <= maxThreads; nbrOfThreads *= 2 )
+    {
+        dr->SetNumberOfThreads(nbrOfThreads);
+        vtkIdType nbrOfTriangles = 0;
+        const long ms = timeExtraction(nbrOfTriangles);
+        ASSERT_EQ(nbrOfTriangles, referenceTriangles);
+        report.push_back("parallel marching cubes, " + std::to_string(nbrOfThreads) + " threads: " + std::to_string(ms) + " ms");
+    }
+
+    std::cout << "Surface extraction of 192^3 voxels, " << referenceTriangles << " triangles" << std::endl;
+    for( const std::string& line : report )
+        std::cout << "  " << line << std::endl;
+
+    delete dr;
+}
+
+// Benchmark, run with --gtest_also_run_disabled_tests
+TEST(Surface, DISABLED_BenchmarkReduction)
+{
+    VTKDicomRoutines* dr = new VTKDicomRoutines();
+    vtkSmartPointer<vtkImageData> volume = createBallsVolume(160, 160, 160);
+    vtkSmartPointer<vtkPolyData> original = dr->dicomToMesh(volume, 300, false, 0);
+    const double reduction = 0.9;
+    const vtkIdType target = original->GetNumberOfCells() - vtkIdType(reduction * double(original->GetNumberOfCells()) + 0.5);
+
+    vtkSmartPointer<vtkCellLocator> locator = vtkSmartPointer<vtkCellLocator>::New();
+    locator->SetDataSet(original);
+    locator->BuildLocator();
+
+    // reduces a copy of the mesh, and measures the distance of its vertices to the original surface
+    VTKMeshRoutines* mr = new VTKMeshRoutines();
+    auto timeReduction = [&]( vtkIdType& nbrOfTriangles, double& meanDistance, double& maxDistance ) -> long
+    {
+        vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+        mesh->DeepCopy(original);
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        mr->meshReduction(mesh, reduction);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        nbrOfTriangles = mesh->GetNumberOfCells();
+        meanDistance = 0.0;
+        maxDistance = 0.0;
+        for( vtkIdType i = 0; i < mesh->GetNumberOfPoints(); i++ )
+        {
+            double p[3], closest[3], distance2;
+            vtkIdType cellId;
+            int subId;
+            mesh->GetPoint(i, p);
+            locator->FindClosestPoint(p, closest, cellId, subId, distance2);
+            meanDistance += std::sqrt(distance2);
+            maxDistance = std::max(maxDistance, std::sqrt(distance2));
+        }
+        meanDistance /= double(std::max(mesh->GetNumberOfPoints(), vtkIdType(1)));
+        return long(std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count());
+    };
+    auto describe = [&]( const std::string& name, long ms, vtkIdType nbrOfTriangles, double meanDistance, double maxDistance )
+    {
+        return name + ": " + std::to_string(ms) + " ms, " + std::to_string(nbrOfTriangles) + " triangles, distance mean "
+               + std::to_string(meanDistance) + " max " + std::to_string(maxDistance) + " mm";
+    };
+
+    vtkIdType referenceTriangles = 0;
+    double referenceMean = 0.0, referenceMax = 0.0;
+    const long referenceMs = timeReduction(referenceTriangles, referenceMean, referenceMax);
+
+    std::vector<std::string> report;
+    report.push_back(describe("vtkQuadricDecimation", referenceMs, referenceTriangles, referenceMean, referenceMax));
+
+    mr->SetDecimator(VTKMeshRoutines::Decimator::ParallelQuadricDecimation);
+    const unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for( unsigned int nbrOfThreads = 1; nbrOfThreads <= maxThreads; nbrOfThreads *= 2 )
+    {
+        mr->SetNumberOfThreads(nbrOfThreads);
+        vtkIdType nbrOfTriangles = 0;
+        double meanDistance = 0.0, maxDistance = 0.0;
+        const long ms = timeReduction(nbrOfTriangles, meanDistance, maxDistance);
+
+        // each collapse removes two triangles, and those at the open borders of the mesh are skipped
+        ASSERT_GE(nbrOfTriangles + 1, target);
+        ASSERT_LE(double(nbrOfTriangles), 1.01 * double(target));
+        ASSERT_LT(meanDistance, 3.0 * referenceMean + 0.01);
+        report.push_back(describe("parallel quadric decimation, " + std::to_string(nbrOfThreads) + " threads",
+                                  ms, nbrOfTriangles, meanDistance, maxDistance));
+    }
+
+    std::cout << "Reduction by " << reduction << " of " << original->GetNumberOfCells() << " triangles" << std::endl;
+    for( const std::string& line : report )
+        std::cout << "  " << line << std::endl;
+
+    delete mr;
+    delete dr;
+}